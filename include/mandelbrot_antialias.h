@@ -0,0 +1,44 @@
+#ifndef MANDELBROT_ANTIALIAS_H_
+#define MANDELBROT_ANTIALIAS_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_progressive.h"
+
+// Adaptive anti-aliasing of a frame rendered at one sample per pixel.
+// Only pixels whose color differs from one of their eight neighbours by
+// AA_MIN_CONTRAST or more in a channel are supersampled, on a jittered
+// grid of side 2 plus one per further AA_CONTRAST_STEP of contrast, as
+// far as the sample limit allows. The subsamples of a tile go through
+// the points kernel of the frame as one batch and their colors are
+// averaged into the pixel. The iteration counts stay those of the frame.
+
+const int AA_MIN_CONTRAST  = 16;
+const int AA_CONTRAST_STEP = 32;
+
+const int AA_MAX_SAMPLES = 64;
+
+const int AA_TILE_SIZE = 32;
+
+struct AntialiasStats
+{
+    uint64_t nPixels;
+    uint64_t nEdgePixels;
+    uint64_t nSubsamples;
+};
+
+// Anti-aliases rows y_from to y_to of a frame of kernel's image,
+// colorized from mandelbrot_iterations(params); the rows around them
+// only serve as neighbours. At most maxSamples subsamples per pixel.
+// params may be a window of a larger view, scale and the shifts are
+// those of the view, as in main.cpp. Adds to stats.
+void mandelbrot_antialias(sf::Uint8* pixels, const RenderParams& params, int maxSamples,
+                          ProgressiveKernel kernel, double scale,
+                          const BigFixed& shiftX, const BigFixed& shiftY,
+                          int y_from, int y_to, AntialiasStats* stats);
+
+#endif // MANDELBROT_ANTIALIAS_H_
@@ -3,9 +3,17 @@
 
 #include <SFML/Graphics.hpp>
 
-void mandelbrot_arrayed_ranged(sf::Uint8* pixels, float magnifier, float shiftX,
-                               int y_from, int y_to);
+#include "mandelbrot_config.h"
 
-void mandelbrot_arrayed(sf::Uint8* pixels, float magnifier, float shiftX);
+// x_from must be a multiple of 8, x_to too unless it is params.width
+void mandelbrot_arrayed_tile(sf::Uint8* pixels, const RenderParams& params,
+                             float magnifier, float shiftX,
+                             int x_from, int x_to, int y_from, int y_to);
+
+void mandelbrot_arrayed_ranged(sf::Uint8* pixels, const RenderParams& params,
+                               float magnifier, float shiftX, int y_from, int y_to);
+
+void mandelbrot_arrayed(sf::Uint8* pixels, const RenderParams& params,
+                        float magnifier, float shiftX);
 
 #endif // MANDELBROT_ARRAYED_H_
@@ -0,0 +1,46 @@
+#ifndef MANDELBROT_AUTO_DEPTH_H_
+#define MANDELBROT_AUTO_DEPTH_H_
+
+#include <SFML/Graphics.hpp>
+
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_progressive.h"
+
+// Iteration depth picked per view (--iterations auto). A probe pass
+// iterates a coarse grid of the view, raising the limit while samples
+// still escape at the higher ones. Most pixels of the view escape below
+// the base depth and the deepest ones below the full depth. The frame
+// is rendered at the base depth, and only the tiles on the boundary,
+// with escaped pixels next to pixels at the limit, have those pixels
+// iterated again at the full depth, where the kernels' interior checks
+// stop the ones inside the set early. Tiles entirely at the base limit
+// are taken as interior.
+
+// Probe samples are this many pixels apart in both directions, farther
+// in frames so large they would take more than AUTO_PROBE_MAX_SAMPLES
+// along the longer side
+const int AUTO_PROBE_STRIDE      = 32;
+const int AUTO_PROBE_MAX_SAMPLES = 64;
+
+const int AUTO_TILE_SIZE = 32;
+
+struct AutoDepth
+{
+    int base;   // above 90% of the escaped samples
+    int depth;  // above twice 99% of them
+};
+
+// Both are params.maxIterations doubled as often as needed, at most
+// MAX_ITERATION_LIMIT. scale and the shifts are given as in main.cpp.
+AutoDepth mandelbrot_auto_depth(const RenderParams& params, double scale,
+                                const BigFixed& shiftX, const BigFixed& shiftY);
+
+// Raises a frame rendered at baseIterations in mandelbrot_iterations(params)
+// to params.maxIterations and colorizes it. kernel is the points kernel
+// whose image the frame is, as for progressive rendering.
+void mandelbrot_auto_refine(sf::Uint8* pixels, const RenderParams& params, int baseIterations,
+                            ProgressiveKernel kernel, double scale,
+                            const BigFixed& shiftX, const BigFixed& shiftY);
+
+#endif // MANDELBROT_AUTO_DEPTH_H_
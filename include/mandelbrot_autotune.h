@@ -0,0 +1,78 @@
+#ifndef MANDELBROT_AUTOTUNE_H_
+#define MANDELBROT_AUTOTUNE_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "mandelbrot_config.h"
+
+// Backend, thread count and chunk picked per view. A calibration times
+// short renders of every benchmark viewport with each parallel backend,
+// thread count and chunk and keeps the fastest setting of each, along
+// with the cost of the viewport: the mean iteration count of its
+// pixels. The tuned backend renders a frame with the setting whose cost
+// is closest to that of the frame before, and moves to another only
+// once the cost has changed by TUNE_SWITCH_RATIO since its last move,
+// so views between two settings don't flip back and forth.
+
+const char DEFAULT_TUNE_PROFILE[] = "mandelbrot.tune";
+
+const int TUNE_WARMUP = 1;
+const int TUNE_FRAMES = 3;
+
+const double TUNE_SWITCH_RATIO = 2.0;
+
+// Every TUNE_SAMPLE_STEP-th pixel counts into the cost of a frame, prime
+// so the samples don't line up in columns
+const int TUNE_SAMPLE_STEP = 61;
+
+struct TuneSetting
+{
+    std::string viewport;
+    double      cost;       // mean iterations per pixel
+    std::string backend;
+    int         nThreads;
+    int         chunk;      // 0 for the backend's default
+    double      medianMs;
+};
+
+// Measured on one machine at one frame size and depth
+struct TuneProfile
+{
+    std::string machine;
+    int         width;
+    int         height;
+    int         maxIterations;
+
+    std::vector<TuneSetting> settings;  // by increasing cost
+};
+
+// CPU model and number of CPUs
+std::string mandelbrot_tune_machine();
+
+// Times the candidates at the frame size and depth of params, printing
+// the winner of every viewport
+void mandelbrot_autotune(const RenderParams& params, TuneProfile* profile);
+
+bool mandelbrot_tune_save(const char* path, const TuneProfile& profile);
+
+// 1 if path holds a profile, 0 if there is none, -1 if it can't be read
+int mandelbrot_tune_load(const char* path, TuneProfile* profile);
+
+void mandelbrot_tune_print(FILE* file, const TuneProfile& profile);
+
+// Profile of the tuned backend, with a warning if it was measured on
+// another machine or frame than params. Without one it renders as the
+// thread-pool.
+void mandelbrot_tuned_use(const TuneProfile& profile, const RenderParams& params);
+
+void mandelbrot_tuned(sf::Uint8* pixels, const RenderParams& params,
+                      float magnifier, float shiftX);
+
+// Setting in use, cost of the last frame and the number of moves
+void mandelbrot_tuned_print_stats(FILE* file);
+
+#endif // MANDELBROT_AUTOTUNE_H_
@@ -0,0 +1,48 @@
+#ifndef MANDELBROT_BACKENDS_H_
+#define MANDELBROT_BACKENDS_H_
+
+#include <cstdio>
+
+#include "mandelbrot_bench.h"
+
+// Sets the work unit a backend splits a frame into, 0 for its default
+typedef void (*MandelbrotChunkFunc)(int chunk);
+
+// Prints what a backend measured over the last frames
+typedef void (*MandelbrotStatsFunc)(FILE* file);
+
+// Every renderer of the program under the name it is selected by.
+// Exactly one of func and deepFunc is set. cached backends leave their
+// iteration counts in mandelbrot_iterations(); parallel ones render on
+// params.nThreads threads and are the candidates of the autotuner,
+// together with the chunks, 0-terminated, that setChunk takes. fractals
+// backends render the fractal picked with mandelbrot_fractal_select(),
+// the others only the Mandelbrot set. sameAsVectorized float backends
+// render the very image of the vectorized kernel, so frames of theirs
+// can be patched with columns of the fractal engine.
+struct MandelbrotBackend
+{
+    const char*         name;
+    MandelbrotFunc      func;
+    MandelbrotDeepFunc  deepFunc;
+    bool                cached;
+    bool                parallel;
+    bool                fractals;
+    bool                sameAsVectorized;
+    MandelbrotChunkFunc setChunk;
+    const int*          chunks;
+    MandelbrotStatsFunc printStats;
+};
+
+extern const MandelbrotBackend BACKENDS[];
+extern const int               N_BACKENDS;
+
+// NULL if this build has no backend of that name
+const MandelbrotBackend* mandelbrot_find_backend(const char* name);
+
+#ifdef GPU
+// Frame on the device the cuda backends render to
+sf::Uint8* mandelbrot_cuda_device_pixels(const RenderParams& params);
+#endif
+
+#endif // MANDELBROT_BACKENDS_H_
@@ -0,0 +1,29 @@
+#ifndef MANDELBROT_BANDS_H_
+#define MANDELBROT_BANDS_H_
+
+#include <SFML/Graphics.hpp>
+
+#include "mandelbrot_bench.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+
+// Parallel driver of the deep kernels for headless renders: images,
+// videos, tiles and farm tiles. A frame is split into bands of BAND_ROWS
+// rows, each a window of the view (RenderParams), and the bands are
+// spread over params.nThreads threads with a context apiece. Kernels
+// that run on one thread thus use all of them. A window gets the pixels
+// of the whole view, so neither the band height nor the number of
+// threads changes the image.
+
+const int BAND_ROWS = 32;
+
+// Renders the frame of func like func itself does, iteration counts in
+// mandelbrot_iterations(params) included; params may be a window of a
+// larger view. Scale and the shifts are those of the view, as in
+// main.cpp. Kernels that are parallel on their own run one band per
+// thread just the same; perturbation computes its reference orbit once
+// for all of them.
+void mandelbrot_bands(MandelbrotDeepFunc func, sf::Uint8* pixels, const RenderParams& params,
+                      double scale, const BigFixed& shiftX, const BigFixed& shiftY);
+
+#endif // MANDELBROT_BANDS_H_
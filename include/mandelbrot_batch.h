@@ -0,0 +1,55 @@
+#ifndef MANDELBROT_BATCH_H_
+#define MANDELBROT_BATCH_H_
+
+#include "mandelbrot_bench.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_image_file.h"
+
+// Rows per strip when none are given
+const int DEFAULT_BATCH_ROWS = 256;
+
+// A headless render of one view to a file. The view is given as in the
+// viewer: the scale before MAGNIFIER_OFFSET and the shifts before
+// SHIFT_X_OFFSET.
+struct BatchJob
+{
+    const char*        output;
+    ImageFormat        format;
+    int                stripRows;
+
+    const char*        modeName;
+    MandelbrotDeepFunc func;
+
+    double   scale;
+    BigFixed shiftX;
+    BigFixed shiftY;
+
+    // Most subsamples per edge pixel, 1 for none. The view must be one
+    // the double kernel resolves, which places the subsamples.
+    int aaSamples;
+};
+
+// Raw strips of DEFAULT_BATCH_ROWS of the whole set, no anti-aliasing
+inline BatchJob default_batch_job()
+{
+    BatchJob job = {};
+    job.format    = IMAGE_RAW;
+    job.stripRows = DEFAULT_BATCH_ROWS;
+    job.scale     = 1.0;
+    job.aaSamples = 1;
+    return job;
+}
+
+// Renders params.width x params.height pixels strip by strip, each strip
+// of stripRows rows a window of the image, so memory is
+// O(width * stripRows) for any height and the pixels do not depend on
+// stripRows. Strips are rendered by mandelbrot_bands on all threads.
+// After every strip the file is synced and "<output>.checkpoint" is
+// updated; running the same job again continues after the last
+// checkpointed strip. The checkpoint is removed at the end.
+// Anti-aliased strips are rendered with a row of the strips next to them,
+// so edges along the strip borders are found. Returns 0 on success.
+int mandelbrot_batch_render(const BatchJob& job, const RenderParams& params);
+
+#endif // MANDELBROT_BATCH_H_
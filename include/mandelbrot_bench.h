@@ -0,0 +1,89 @@
+#ifndef MANDELBROT_BENCH_H_
+#define MANDELBROT_BENCH_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+
+typedef void (*MandelbrotFunc)    (sf::Uint8* pixels, const RenderParams& params,
+                                   float  magnifier, float shiftX);
+typedef void (*MandelbrotDeepFunc)(sf::Uint8* pixels, const RenderParams& params,
+                                   double magnifier,
+                                   const BigFixed& shiftX, const BigFixed& shiftY);
+
+// View in the kernels' own coordinates: magnifier and shiftX are passed
+// to the kernel as is (MAGNIFIER_OFFSET and SHIFT_X_OFFSET still apply).
+struct BenchViewport
+{
+    const char* name;
+    float magnifier;
+    float shiftX;
+};
+
+struct BenchResult
+{
+    const char* mode;
+    const char* viewport;
+
+    RenderParams params;
+    int nFrames;
+
+    double minMs;
+    double medianMs;
+    double p95Ms;
+    double p99Ms;
+    double meanMs;
+
+    double mpixelsPerSec;
+    double nominalItersPerSec;
+    double cyclesPerPixel;
+
+    // Escape counts of the viewport's pixels, interior ones at the full
+    // depth: the same for every mode, not the steps a mode takes
+    uint64_t nominalIterationsPerFrame;
+};
+
+// Options of the benchmark, the frame count comes before them
+struct BenchOptions
+{
+    int         nFrames;
+    int         nWarmup;   // untimed frames before every viewport
+    const char* csvPath;   // NULL for none
+    const char* jsonPath;
+    bool        scaling;   // --scaling on: from one thread to every CPU
+};
+
+inline BenchOptions default_bench_options()
+{
+    BenchOptions options = {};
+    options.nWarmup = 2;
+    return options;
+}
+
+extern const BenchViewport BENCH_VIEWPORTS[];
+extern const int           N_BENCH_VIEWPORTS;
+
+// Runs nWarmup untimed and nFrames timed renders of every benchmark
+// viewport and appends one result per viewport.
+void mandelbrot_bench(sf::Uint8* pixels, const RenderParams& params,
+                      MandelbrotFunc func, const char* name,
+                      int nWarmup, int nFrames, std::vector<BenchResult>* results);
+void mandelbrot_bench(sf::Uint8* pixels, const RenderParams& params,
+                      MandelbrotDeepFunc func, const char* name,
+                      int nWarmup, int nFrames, std::vector<BenchResult>* results);
+
+void mandelbrot_bench_print(const BenchResult& result);
+
+// Speedup and parallel efficiency of every result over the one of the
+// same mode and viewport with the fewest threads, and the NUMA nodes
+// the threads fill
+void mandelbrot_bench_print_scaling(const std::vector<BenchResult>& results);
+
+bool mandelbrot_bench_write_csv (const char* path, const std::vector<BenchResult>& results);
+bool mandelbrot_bench_write_json(const char* path, const std::vector<BenchResult>& results);
+
+#endif // MANDELBROT_BENCH_H_
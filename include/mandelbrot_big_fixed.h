@@ -0,0 +1,39 @@
+#ifndef MANDELBROT_BIG_FIXED_H_
+#define MANDELBROT_BIG_FIXED_H_
+
+#include <cstdint>
+
+#include "mandelbrot_double_double.h"
+
+// 32 integer bits and (BIG_FIXED_LIMBS - 1) * 32 fraction bits, enough
+// to resolve pixel steps down to the smallest normal double
+const int BIG_FIXED_LIMBS = 36;
+
+// Sign-magnitude fixed-point number, limbs[0] is the integer part and
+// the rest is the fraction, most significant limb first
+struct BigFixed
+{
+    bool     negative;
+    uint32_t limbs[BIG_FIXED_LIMBS];
+};
+
+BigFixed bf_from_double(double value);
+
+// A decimal number such as -0.7436438870371587047521915061, an exponent
+// (1.5e-3) is allowed. Digits past the last fraction bit are truncated.
+// false, leaving value alone, for anything else or an integer part that
+// does not fit in 32 bits.
+bool bf_parse(const char* text, BigFixed* value);
+
+double       bf_to_double(const BigFixed& value);
+DoubleDouble bf_to_dd    (const BigFixed& value);
+
+// Two's complement fixed-point with fractionBits (0 to 63) fraction bits,
+// truncated toward zero. The integer part must fit in the rest.
+int64_t bf_to_fixed(const BigFixed& value, int fractionBits);
+
+BigFixed bf_add(const BigFixed& a, const BigFixed& b);
+BigFixed bf_sub(const BigFixed& a, const BigFixed& b);
+BigFixed bf_mul(const BigFixed& a, const BigFixed& b);
+
+#endif // MANDELBROT_BIG_FIXED_H_
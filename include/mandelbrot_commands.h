@@ -0,0 +1,47 @@
+#ifndef MANDELBROT_COMMANDS_H_
+#define MANDELBROT_COMMANDS_H_
+
+#include "mandelbrot_batch.h"
+#include "mandelbrot_bench.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_farm.h"
+#include "mandelbrot_tile_server.h"
+#include "mandelbrot_video.h"
+
+// The headless commands of ./mandelbrot, after main has read the
+// options. Each checks what is specific to it, prints what is wrong and
+// returns the exit status. autoDepth is --iterations auto.
+
+// An image of job to job.output, strip by strip
+int mandelbrot_run_batch(BatchJob job, bool formatGiven, RenderParams params, bool autoDepth);
+
+// A zoom to video.output; the start view and the mode come from the
+// batch options
+int mandelbrot_run_video(VideoJob video, const BatchJob& job, RenderParams params, bool autoDepth);
+
+// The image of job rendered by the workers of a farm; the batch options
+// give the output, the view and the mode
+int mandelbrot_run_farm(FarmJob farm, const BatchJob& job, bool formatGiven,
+                        const RenderParams& params, bool autoDepth);
+
+// Map tiles of modeName over HTTP until stopped
+int mandelbrot_run_server(TileServerConfig serve, const char* modeName, const RenderParams& params,
+                          bool autoDepth);
+
+// Every benchmark viewport with modeName, or every mode for "all";
+// allFractals: every fractal in turn, on the modes that render them
+int mandelbrot_run_benchmark(const RenderParams& params, const BenchOptions& bench,
+                             bool allFractals, const char* modeName);
+
+// ./mandelbrot worker --connect ADDRESS [--threads N] [--isa ...]
+int mandelbrot_run_worker(int argc, char* argv[]);
+
+// ./mandelbrot tune [--profile FILE] [--width W] [--height H] [--iterations N] ...
+int mandelbrot_run_tune(int argc, char* argv[]);
+
+// The tuned backend renders as the thread-pool until it has a profile,
+// which only the tuned mode itself insists on: false if required and
+// there is none, or if path is not a profile
+bool mandelbrot_load_tune_profile(const char* path, const RenderParams& params, bool required);
+
+#endif // MANDELBROT_COMMANDS_H_
@@ -1,17 +1,122 @@
 #ifndef MANDELBROT_CONFIG_H_
 #define MANDELBROT_CONFIG_H_
 
+#include <cstdint>
+#include <thread>
+
+#include "mandelbrot_isa.h"
+
+// Iteration buffer and palette of one renderer (mandelbrot_palette.h)
+struct RenderContext;
+
+// Defaults of RenderParams
 const int WINDOW_WIDTH  = 1920;
 const int WINDOW_HEIGHT = 1080;
+// Where the number of hardware threads is unknown
 const int N_THREADS = 12;
 
 const int   MAX_ITERATION_DEPTH = 256;
 const float MAX_RADIUS          = 2.0f;
 
-const float MAX_RADIUS_2 = MAX_RADIUS * MAX_RADIUS;
-const float ASPECT_RATIO = (float)(WINDOW_WIDTH) / WINDOW_HEIGHT;
-
 const float MAGNIFIER_OFFSET = -0.3f;
 const float SHIFT_X_OFFSET   = -0.5f;
 
+// Iteration counts are stored as uint16_t, the two largest values are
+// kept free for markers
+const int MAX_ITERATION_LIMIT = UINT16_MAX - 2;
+
+// What every kernel renders: the frame size, the iteration depth and
+// the escape radius. Any width and height work, the SIMD kernels mask
+// the lanes past the last column. isa selects the build of the
+// vectorized kernel, all of them render the same image. context is where
+// the kernels keep the iteration counts and find the palette, owned by
+// whoever renders.
+//
+// The strips, bands and tiles of a headless image are windows of it:
+// the frame is then the width x height pixels at x_offset, y_offset of
+// a view of viewWidth x viewHeight, which the magnifier and the shifts
+// describe, and a pixel's coordinates come from its index in the view.
+// A window thus gets the very pixels of the whole view, however the
+// view is split. Only the deep kernels (MandelbrotDeepFunc) and the
+// coordinate functions take windows. viewWidth 0: the frame is the view.
+struct RenderParams
+{
+    int   width;
+    int   height;
+    int   maxIterations;
+    float maxRadius;
+    int   nThreads;
+
+    MandelbrotIsa isa;
+
+    RenderContext* context;
+
+    int viewWidth;
+    int viewHeight;
+    int x_offset;
+    int y_offset;
+};
+
+// One thread per hardware thread
+inline int default_thread_count()
+{
+    const unsigned nThreads = std::thread::hardware_concurrency();
+    return nThreads > 0 ? (int)nThreads : N_THREADS;
+}
+
+inline RenderParams default_render_params()
+{
+    return { WINDOW_WIDTH, WINDOW_HEIGHT, MAX_ITERATION_DEPTH, MAX_RADIUS, default_thread_count(),
+             mandelbrot_isa_best(), NULL, 0, 0, 0, 0 };
+}
+
+// The whole view params is a window of, params itself if it is none
+inline RenderParams view_params(const RenderParams& params)
+{
+    RenderParams view = params;
+    if (params.viewWidth > 0)
+    {
+        view.width  = params.viewWidth;
+        view.height = params.viewHeight;
+    }
+    view.viewWidth  = 0;
+    view.viewHeight = 0;
+    view.x_offset   = 0;
+    view.y_offset   = 0;
+    return view;
+}
+
+// The width x height pixels at x, y of the frame of params, as a window
+// of its view
+inline RenderParams window_params(const RenderParams& params, int x, int y, int width, int height)
+{
+    const RenderParams view = view_params(params);
+
+    RenderParams window = params;
+    window.width      = width;
+    window.height     = height;
+    window.viewWidth  = view.width;
+    window.viewHeight = view.height;
+    window.x_offset   = params.x_offset + x;
+    window.y_offset   = params.y_offset + y;
+    return window;
+}
+
+inline float aspect_ratio(const RenderParams& params)
+{
+    return (float)params.width / params.height;
+}
+
+// For the double and deeper kernels: rounded to float, the x step of a
+// frame would be off its y step by up to 2^-24
+inline double aspect_ratio_double(const RenderParams& params)
+{
+    return (double)params.width / params.height;
+}
+
+inline float max_radius_2(const RenderParams& params)
+{
+    return params.maxRadius * params.maxRadius;
+}
+
 #endif // MANDELBROT_CONFIG_H_
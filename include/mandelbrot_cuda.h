@@ -3,7 +3,9 @@
 
 #include <SFML/Graphics.hpp>
 
-void mandelbrot_cuda       (sf::Uint8* pixels, float magnifier, float shiftX);
-void mandelbrot_cuda_no_cpy(sf::Uint8* pixels, float magnifier, float shiftX);
+#include "mandelbrot_config.h"
+
+void mandelbrot_cuda       (sf::Uint8* pixels, const RenderParams& params, float magnifier, float shiftX);
+void mandelbrot_cuda_no_cpy(sf::Uint8* pixels, const RenderParams& params, float magnifier, float shiftX);
 
 #endif // MANDELBROT_CUDA_H_
@@ -0,0 +1,36 @@
+#ifndef MANDELBROT_DEEP_H_
+#define MANDELBROT_DEEP_H_
+
+#include <SFML/Graphics.hpp>
+
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+
+enum MandelbrotPrecision
+{
+    PRECISION_FLOAT,
+    PRECISION_DOUBLE,
+    PRECISION_DOUBLE_DOUBLE,
+    PRECISION_PERTURBATION,
+};
+
+// A precision is considered exact while the pixel step is at least this
+// many ulps of the largest coordinate on the screen times the square root
+// of the depth: the rounding errors of an orbit add up like a random
+// walk, so each quadrupling of the depth takes one more bit of margin
+const double MIN_PIXEL_STEP_ULPS = 32.0;
+
+const char* mandelbrot_precision_name(MandelbrotPrecision precision);
+
+// Cheapest precision that still resolves every pixel of the view at
+// params.maxIterations. A window of a view gets the pick of the view.
+MandelbrotPrecision mandelbrot_pick_precision(const RenderParams& params, double magnifier,
+                                              const BigFixed& shiftX, const BigFixed& shiftY);
+
+// Renders with the precision picked by mandelbrot_pick_precision, rows in parallel.
+// The float kernels have no vertical shift, so off the real axis
+// at least double is used.
+void mandelbrot_deep(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                     const BigFixed& shiftX, const BigFixed& shiftY);
+
+#endif // MANDELBROT_DEEP_H_
@@ -0,0 +1,27 @@
+#ifndef MANDELBROT_DOUBLE_H_
+#define MANDELBROT_DOUBLE_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+
+#include "mandelbrot_config.h"
+
+void mandelbrot_double_ranged(sf::Uint8* pixels, const RenderParams& params,
+                              double magnifier, double shiftX, double shiftY,
+                              int y_from, int y_to);
+
+void mandelbrot_double(sf::Uint8* pixels, const RenderParams& params,
+                       double magnifier, double shiftX, double shiftY);
+
+// Coordinates mandelbrot_double uses for every column (c_x, params.width
+// of them) and row (c_y, params.height of them), of a window too
+void mandelbrot_double_coords(const RenderParams& params, double magnifier,
+                              double shiftX, double shiftY, double* c_x, double* c_y);
+
+// Iteration counts of n arbitrary points with the arithmetic of
+// mandelbrot_double
+void mandelbrot_double_points(const RenderParams& params, const double* c_x, const double* c_y,
+                              uint16_t* iterations, int n);
+
+#endif // MANDELBROT_DOUBLE_H_
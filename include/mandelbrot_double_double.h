@@ -0,0 +1,57 @@
+#ifndef MANDELBROT_DOUBLE_DOUBLE_H_
+#define MANDELBROT_DOUBLE_DOUBLE_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <cmath>
+
+#include "mandelbrot_config.h"
+
+// Unevaluated sum hi + lo with |lo| <= ulp(hi) / 2, about 106 bits of mantissa
+struct DoubleDouble
+{
+    double hi;
+    double lo;
+};
+
+inline DoubleDouble dd_from(double value)
+{
+    return { value, 0.0 };
+}
+
+inline DoubleDouble dd_quick_two_sum(double a, double b)
+{
+    double s = a + b;
+    return { s, b - (s - a) };
+}
+
+inline DoubleDouble dd_add(DoubleDouble a, DoubleDouble b)
+{
+    double s  = a.hi + b.hi;
+    double bb = s - a.hi;
+    double e  = (a.hi - (s - bb)) + (b.hi - bb);
+
+    return dd_quick_two_sum(s, e + a.lo + b.lo);
+}
+
+inline DoubleDouble dd_add(DoubleDouble a, double b)
+{
+    return dd_add(a, dd_from(b));
+}
+
+inline DoubleDouble dd_mul(DoubleDouble a, DoubleDouble b)
+{
+    double p = a.hi * b.hi;
+    double e = std::fma(a.hi, b.hi, -p);
+
+    return dd_quick_two_sum(p, e + (a.hi * b.lo + a.lo * b.hi));
+}
+
+void mandelbrot_double_double_ranged(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                                     DoubleDouble shiftX, DoubleDouble shiftY,
+                                     int y_from, int y_to);
+
+void mandelbrot_double_double(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                              DoubleDouble shiftX, DoubleDouble shiftY);
+
+#endif // MANDELBROT_DOUBLE_DOUBLE_H_
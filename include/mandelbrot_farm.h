@@ -0,0 +1,64 @@
+#ifndef MANDELBROT_FARM_H_
+#define MANDELBROT_FARM_H_
+
+#include "mandelbrot_batch.h"
+#include "mandelbrot_bench.h"
+#include "mandelbrot_config.h"
+
+// Headless renders spread over worker processes. The coordinator splits
+// the image into tiles and leases them to the workers that connect to
+// it, FARM_LEASES_PER_WORKER at a time so a worker never waits for its
+// next tile. A worker renders a tile as a window of the whole image, as
+// batch strips are, so the output is the batch render's pixel for pixel,
+// and sends it back as RGB rows, which the coordinator receives straight into the mapped output
+// file. A lease that is not returned within its time goes to the next
+// worker asking for work, and once no tile is left to lease, idle
+// workers race the oldest leases; the first result of a tile wins. The
+// tiles of a worker that disconnects are leased again at once. Messages are the
+// structs of the coordinator, so all machines must be alike (x86-64).
+
+const int FARM_TILE_SIZE = 256;
+
+const int FARM_LEASES_PER_WORKER = 2;
+
+// Until a lease is given to another worker, when none is given
+const int DEFAULT_FARM_LEASE_MS = 30000;
+
+// Workers retry connecting to a coordinator that isn't up yet this long
+const int FARM_CONNECT_TIMEOUT_MS = 10000;
+
+struct FarmJob
+{
+    const char* address;    // "unix:/path", "port" or "host:port"
+    int         nWorkers;   // spawned on this machine, 0 for remote ones only
+    int         tileSize;
+    int         leaseMs;
+    bool        scaling;    // renders again with 1, 2, 4 ... nWorkers workers
+
+    BatchJob    batch;      // output, view and mode; tiff or raw only
+};
+
+// No local workers, FARM_TILE_SIZE tiles leased for DEFAULT_FARM_LEASE_MS
+inline FarmJob default_farm_job()
+{
+    FarmJob job = {};
+    job.tileSize = FARM_TILE_SIZE;
+    job.leaseMs  = DEFAULT_FARM_LEASE_MS;
+    job.batch    = default_batch_job();
+    return job;
+}
+
+// Renders job.batch to its output with the workers that connect to
+// job.address, after spawning job.nWorkers of them with params.nThreads
+// threads each. Prints the tiles and throughput of every worker. Returns
+// 0 on success.
+int mandelbrot_farm_render(const FarmJob& job, const RenderParams& params);
+
+// The mode a coordinator names, NULL if this build has none
+typedef MandelbrotDeepFunc (*FarmModeLookup)(const char* modeName);
+
+// Connects to a coordinator and renders the tiles it leases with
+// params.nThreads threads until the job is done. Returns 0 on success.
+int mandelbrot_farm_work(const char* address, const RenderParams& params, FarmModeLookup lookup);
+
+#endif // MANDELBROT_FARM_H_
@@ -0,0 +1,93 @@
+#ifndef MANDELBROT_FRACTAL_H_
+#define MANDELBROT_FRACTAL_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+
+#include "mandelbrot_config.h"
+
+// Fractals of the family z -> f(z) + c on one templated AVX2 engine.
+// Formula, exponent and precision are template parameters: every
+// variant is an instantiation of its own, with the power of z unrolled
+// and no branch in the inner loop but the test for lanes still live.
+// The fractal is picked once per process (--fractal) and the kernel of
+// a frame once per frame, never per iteration. The openmp, thread-pool
+// and numa drivers and the viewer's column shift render every fractal
+// with the engine, the Mandelbrot set included: in float its image is
+// that of mandelbrot_vectorized. The serial modes and the points kernel
+// of the Mandelbrot set stay hand-written, CUDA only knows the
+// Mandelbrot set.
+
+enum FractalFormula
+{
+    FRACTAL_MULTIBROT,      // z^n + c from z = 0, the Mandelbrot set for n = 2
+    FRACTAL_JULIA,          // z^n + k from z = c, k is the Julia constant
+    FRACTAL_BURNING_SHIP,   // (|Re z| + i |Im z|)^2 + c from z = 0
+};
+
+struct Fractal
+{
+    const char*    name;
+    FractalFormula formula;
+    int            exponent;
+};
+
+// The Mandelbrot set first
+extern const Fractal FRACTALS[];
+extern const int     N_FRACTALS;
+
+// Julia constant until --julia-c gives another
+const float DEFAULT_JULIA_X = -0.8f;
+const float DEFAULT_JULIA_Y =  0.156f;
+
+// Picks the fractal rendered from now on, false if there is none of that name
+bool mandelbrot_fractal_select(const char* name);
+
+const Fractal& mandelbrot_fractal_current();
+
+inline bool mandelbrot_fractal_is_mandelbrot()
+{
+    return &mandelbrot_fractal_current() == &FRACTALS[0];
+}
+
+void mandelbrot_fractal_set_julia(float k_x, float k_y);
+void mandelbrot_fractal_julia(float* k_x, float* k_y);
+
+// Renders the columns x_from to x_to of rows y_from to y_to. x_from must
+// be a multiple of 8, x_to too unless it is params.width.
+typedef void (*MandelbrotTileFunc)(sf::Uint8* pixels, const RenderParams& params,
+                                   float magnifier, float shiftX,
+                                   int x_from, int x_to, int y_from, int y_to);
+
+// The kernel the parallel drivers render the tiles of a frame with: the
+// engine in float, or for fractals other than the Mandelbrot set in
+// double where float no longer resolves the pixels
+MandelbrotTileFunc mandelbrot_fractal_tile_func(const RenderParams& params,
+                                                float magnifier, float shiftX);
+
+// Iteration counts of n arbitrary points, as mandelbrot_vectorized_points
+typedef void (*MandelbrotPointsFunc)(const RenderParams& params, const float* c_x, const float* c_y,
+                                     uint16_t* iterations, int n);
+
+// The points kernel of the picked fractal in float: mandelbrot_vectorized_points
+// for the Mandelbrot set, otherwise the engine
+MandelbrotPointsFunc mandelbrot_fractal_points_func();
+
+// Whether the set of the picked fractal is connected, so that a region
+// whose border has a single count has it inside too: the Multibrot
+// sets, the Julia sets of constants in the Mandelbrot set, not the
+// Burning Ship
+bool mandelbrot_fractal_connected();
+
+// The picked fractal on one thread, always with the engine in float as
+// mandelbrot_vectorized is: the two render the same image of the
+// Mandelbrot set, so their speed can be compared.
+void mandelbrot_fractal_render(sf::Uint8* pixels, const RenderParams& params,
+                               float magnifier, float shiftX);
+
+// Nominal iterations of a frame of the picked fractal, the escape counts
+// of its pixels, which the benchmark divides by
+uint64_t mandelbrot_fractal_iterations(const RenderParams& params, float magnifier, float shiftX);
+
+#endif // MANDELBROT_FRACTAL_H_
@@ -0,0 +1,36 @@
+#ifndef MANDELBROT_FRAME_BUFFER_H_
+#define MANDELBROT_FRAME_BUFFER_H_
+
+#include <cstddef>
+#include <cstdio>
+
+// Frame buffers for pixels and iteration counts, mapped straight from
+// the kernel. They start on a cache line, as do their rows in frames
+// 32 pixels wide or any multiple, and come zeroed by the threads of the
+// frame, which only spreads the page faults: the kernels schedule rows
+// dynamically, so where a page lands says nothing of which thread will
+// render it. The numa mode binds the bands of its nodes explicitly.
+// Freed buffers are kept and handed out again, the smallest that fits,
+// to the next frame or to a smaller one after a resize, so a frame never
+// pays for page faults twice. A buffer more than twice the size asked
+// for is not handed out, a new one is mapped instead.
+
+const size_t FRAME_BUFFER_ALIGNMENT = 64;
+const size_t HUGE_PAGE_SIZE         = 2 << 20;
+
+// Buffers of at least HUGE_PAGE_SIZE are then backed by 2 MiB pages:
+// reserved ones (hugetlbfs) if there are enough, transparent huge pages
+// otherwise. Off by default, only buffers mapped later are affected.
+void mandelbrot_frame_buffer_huge_pages(bool enabled);
+
+// rows * rowBytes zeroed bytes, zeroed on nThreads threads.
+// Never NULL, aborts if the memory can't be mapped.
+void* mandelbrot_frame_buffer_alloc(size_t rowBytes, int rows, int nThreads);
+
+// Back to the pool, NULL is ignored
+void mandelbrot_frame_buffer_free(void* buffer);
+
+// Buffers mapped and reused so far
+void mandelbrot_frame_buffer_print_stats(FILE* file);
+
+#endif // MANDELBROT_FRAME_BUFFER_H_
@@ -0,0 +1,41 @@
+#ifndef MANDELBROT_FRAME_CACHE_H_
+#define MANDELBROT_FRAME_CACHE_H_
+
+#include <SFML/Graphics.hpp>
+
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+
+// Reuse of the last frame's iteration counts (mandelbrot_iterations())
+// when the interactive view moves. Views are given as in main.cpp: the
+// scale before MAGNIFIER_OFFSET and the shifts before SHIFT_X_OFFSET.
+
+// The view the iteration buffer holds
+struct FrameCache
+{
+    bool     valid;
+    double   scale;
+    BigFixed shiftX;
+    BigFixed shiftY;
+};
+
+// Distance between two neighbouring pixels, the same along x and y
+double mandelbrot_pixel_step(const RenderParams& params, double scale);
+
+// Moves the buffer so that pixel (x, y) gets the count of (x + dx, y + dy).
+// Pixels without a source are left as they were.
+void mandelbrot_shift_iterations(const RenderParams& params, int dx, int dy);
+
+// Nearest-pixel preview of another view: pixel (x, y) gets the count of
+// old pixel (W/2 + offsetX + (x - W/2) * zoom, H/2 + offsetY + (y - H/2) * zoom),
+// where zoom = new step / old step and the offsets are in old pixels.
+// Pixels outside the old frame are set to params.maxIterations.
+void mandelbrot_resample_iterations(const RenderParams& params,
+                                    double zoom, double offsetX, double offsetY);
+
+// Columns [x_from, x_to) of a float view, rows in parallel. The columns
+// are widened to multiples of 8.
+void mandelbrot_render_columns(sf::Uint8* pixels, const RenderParams& params,
+                               float scale, float shiftX, int x_from, int x_to);
+
+#endif // MANDELBROT_FRAME_CACHE_H_
@@ -0,0 +1,78 @@
+#ifndef MANDELBROT_IMAGE_FILE_H_
+#define MANDELBROT_IMAGE_FILE_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// 8-bit RGB images written rows first to last, so only the rows being
+// written are ever in memory. PNG rows are deflated at a fast zlib level,
+// every write flushed on its own; TIFF is uncompressed and becomes
+// BigTIFF past 4 GB; raw is the bare rows.
+
+enum ImageFormat
+{
+    IMAGE_PNG,
+    IMAGE_TIFF,
+    IMAGE_RAW,
+};
+
+// false if name is none of png, tiff, raw
+bool        mandelbrot_image_format(const char* name, ImageFormat* format);
+const char* mandelbrot_image_format_name(ImageFormat format);
+
+// The format a file name suggests, raw if there is no known extension
+ImageFormat mandelbrot_image_format_of(const char* path);
+
+// How far a file got, enough to continue it after a restart
+struct ImageFileState
+{
+    int      rowsDone;
+    uint64_t offset;    // File size after rowsDone rows
+    uint32_t adler;     // PNG: zlib checksum of the rows so far
+};
+
+struct ImageFile
+{
+    FILE*          file;
+    ImageFormat    format;
+    int            width;
+    int            height;
+    ImageFileState state;
+};
+
+// Creates the file and writes everything that precedes the rows
+bool mandelbrot_image_create(ImageFile* image, const char* path, ImageFormat format,
+                             int width, int height);
+
+// Reopens a file created with the same arguments and drops whatever was
+// written after state
+bool mandelbrot_image_resume(ImageFile* image, const char* path, ImageFormat format,
+                             int width, int height, const ImageFileState& state);
+
+// Appends nRows rows of RGBA pixels, the alpha is dropped
+bool mandelbrot_image_write_rows(ImageFile* image, const sf::Uint8* pixels, int nRows);
+
+// TIFF and raw rows are 3 * width bytes back to back, so they can be
+// filled in any order: extends a newly created file to every row and
+// maps them, shared. NULL for PNG, whose rows are framed and checksummed
+// in order. After mandelbrot_image_unmap_rows all rows count as written.
+uint8_t* mandelbrot_image_map_rows  (ImageFile* image);
+void     mandelbrot_image_unmap_rows(ImageFile* image, uint8_t* rows);
+
+// Makes the rows written so far durable, image->state can be saved after it
+bool mandelbrot_image_sync(ImageFile* image);
+
+// Writes what follows the last row and closes the file.
+// All rows must have been written.
+bool mandelbrot_image_finish(ImageFile* image);
+
+void mandelbrot_image_close(ImageFile* image);
+
+// A whole image of RGBA pixels as the bytes of its file
+bool mandelbrot_image_encode(ImageFormat format, const sf::Uint8* pixels, int width, int height,
+                             std::vector<uint8_t>* data);
+
+#endif // MANDELBROT_IMAGE_FILE_H_
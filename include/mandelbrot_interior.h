@@ -0,0 +1,51 @@
+#ifndef MANDELBROT_INTERIOR_H_
+#define MANDELBROT_INTERIOR_H_
+
+#ifdef __AVX__
+#include <x86intrin.h>
+#endif
+
+// Interior checks shared by the CPU kernels. Both only ever mark points
+// that never escape, so the rendered image does not change.
+
+// Main cardioid: q (q + (x - 1/4)) < y^2 / 4 with q = (x - 1/4)^2 + y^2,
+// period-2 bulb: (x + 1)^2 + y^2 < 1/16
+inline bool is_in_cardioid_or_bulb(float c_x, float c_y)
+{
+    const float x  = c_x - 0.25f;
+    const float y2 = c_y * c_y;
+    const float q  = x * x + y2;
+
+    if (q * (q + x) < 0.25f * y2)
+        return true;
+
+    const float x1 = c_x + 1.0f;
+    return x1 * x1 + y2 < 0.0625f;
+}
+
+#ifdef __AVX__
+// is_in_cardioid_or_bulb for four double points, all bits set in the
+// lanes inside
+inline __m256d cardioid_or_bulb_mask4(__m256d _c_x, __m256d _c_y)
+{
+    __m256d _x  = _mm256_sub_pd(_c_x, _mm256_set1_pd(0.25));
+    __m256d _y2 = _mm256_mul_pd(_c_y, _c_y);
+    __m256d _q  = _mm256_add_pd(_mm256_mul_pd(_x, _x), _y2);
+
+    __m256d _cardioid = _mm256_cmp_pd(_mm256_mul_pd(_q, _mm256_add_pd(_q, _x)),
+                                      _mm256_mul_pd(_mm256_set1_pd(0.25), _y2), _CMP_LT_OQ);
+
+    __m256d _x1 = _mm256_add_pd(_c_x, _mm256_set1_pd(1.0));
+    __m256d _bulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(_x1, _x1), _y2),
+                                  _mm256_set1_pd(0.0625), _CMP_LT_OQ);
+
+    return _mm256_or_pd(_cardioid, _bulb);
+}
+#endif
+
+// Brent's cycle detection: z is saved every PERIOD_CHECK_START, then every
+// 2x longer stretch of iterations. Meeting the saved z again exactly means
+// the orbit is periodic and the point is interior.
+const int PERIOD_CHECK_START = 8;
+
+#endif // MANDELBROT_INTERIOR_H_
@@ -0,0 +1,31 @@
+#ifndef MANDELBROT_INTERLEAVED_H_
+#define MANDELBROT_INTERLEAVED_H_
+
+#include <SFML/Graphics.hpp>
+
+#include "mandelbrot_config.h"
+
+// Iterations between the checks for finished lanes, also the iterations
+// a pixel gets before it is queued for a lane
+const int INTERLEAVED_BURST = 8;
+
+// Chains of the interleaved mode, the others are benchmarked as
+// interleaved-<chains>
+const int INTERLEAVED_CHAINS = 2;
+
+// The vectorized kernel with CHAINS independent 8-wide vectors advanced
+// in the same loop with FMA, so their latencies overlap. Pixels are
+// streamed through the lanes: every INTERLEAVED_BURST iterations a lane
+// that escaped or was found periodic takes the next queued pixel, so one
+// slow pixel no longer holds seven idle lanes. Coordinates are those of
+// mandelbrot_vectorized; FMA rounds differently, so pixels right at the
+// boundary may get other counts. Instantiated for 1 to 4 chains.
+template <int CHAINS>
+void mandelbrot_interleaved_ranged(sf::Uint8* pixels, const RenderParams& params,
+                                   float magnifier, float shiftX, int y_from, int y_to);
+
+template <int CHAINS>
+void mandelbrot_interleaved(sf::Uint8* pixels, const RenderParams& params,
+                            float magnifier, float shiftX);
+
+#endif // MANDELBROT_INTERLEAVED_H_
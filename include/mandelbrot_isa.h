@@ -0,0 +1,29 @@
+#ifndef MANDELBROT_ISA_H_
+#define MANDELBROT_ISA_H_
+
+// Instruction sets the SIMD float kernel is built for, from the oldest.
+// Each level is compiled in a translation unit of its own, so one binary
+// carries all of them. The other kernels are built for AVX2 only, the
+// rest of the program for the ARCH baseline of the Makefile.
+enum MandelbrotIsa
+{
+    ISA_SSE42,
+    ISA_AVX2,
+    ISA_AVX512,
+};
+
+const int N_ISAS = 3;
+
+// "sse4.2", "avx2", "avx512"
+const char* mandelbrot_isa_name(MandelbrotIsa isa);
+
+// false if name is none of the above
+bool mandelbrot_isa_parse(const char* name, MandelbrotIsa* isa);
+
+// Whether the CPU has the instructions and the OS saves their registers
+bool mandelbrot_isa_supported(MandelbrotIsa isa);
+
+// The newest supported level, detected on the first call
+MandelbrotIsa mandelbrot_isa_best();
+
+#endif // MANDELBROT_ISA_H_
@@ -0,0 +1,26 @@
+#ifndef MANDELBROT_MARIANI_SILVER_H_
+#define MANDELBROT_MARIANI_SILVER_H_
+
+#include <SFML/Graphics.hpp>
+
+#include "mandelbrot_config.h"
+
+// Side of the square tiles the frame is split into before subdividing
+const int MARIANI_SILVER_TILE = 64;
+// Rectangles narrower than this are computed pixel by pixel
+const int MARIANI_SILVER_MIN_SIDE = 6;
+// Narrower rows of pixels are batched with others before they are iterated
+const int MARIANI_SILVER_MIN_ROW = 16;
+
+// Mariani-Silver subdivision: only rectangle borders are iterated, with
+// the arithmetic of mandelbrot_vectorized, and rectangles with a single
+// escape count on the whole border are filled with it. The output is the
+// same as mandelbrot_vectorized. Other fractals of --fractal are iterated
+// with the engine in float, and only filled if their set is connected.
+// Tiles run in parallel on OpenMP or on the thread-pool scheduler.
+void mandelbrot_mariani_silver     (sf::Uint8* pixels, const RenderParams& params,
+                                    float magnifier, float shiftX);
+void mandelbrot_mariani_silver_pool(sf::Uint8* pixels, const RenderParams& params,
+                                    float magnifier, float shiftX);
+
+#endif // MANDELBROT_MARIANI_SILVER_H_
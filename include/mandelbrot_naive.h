@@ -3,6 +3,9 @@
 
 #include <SFML/Graphics.hpp>
 
-void mandelbrot_naive(sf::Uint8* pixels, float magnifier, float shiftX);
+#include "mandelbrot_config.h"
+
+void mandelbrot_naive(sf::Uint8* pixels, const RenderParams& params,
+                      float magnifier, float shiftX);
 
 #endif // MANDELBROT_NAIVE_H_
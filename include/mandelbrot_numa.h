@@ -0,0 +1,48 @@
+#ifndef MANDELBROT_NUMA_H_
+#define MANDELBROT_NUMA_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "mandelbrot_config.h"
+
+// NUMA-aware rendering for machines with several sockets. The workers
+// fill the NUMA nodes in order, each pinned to the CPUs of its node;
+// every node gets a contiguous band of the frame, whose pixels and
+// iteration counts are moved to the node's memory, and its workers
+// steal from each other before they steal from another node. On a
+// single node this is the thread-pool with fixed tiles.
+
+struct NumaNode
+{
+    int              id;
+    std::vector<int> cpus;  // the ones this process may run on
+};
+
+// The nodes with CPUs this process may run on, from
+// /sys/devices/system/node. A single node with every allowed CPU
+// where there is no NUMA information.
+const std::vector<NumaNode>& mandelbrot_numa_nodes();
+
+// Nodes nThreads workers spread over: as many as their CPUs take, in
+// order, and the ones past every CPU round-robin
+int mandelbrot_numa_nodes_used(int nThreads);
+
+// Moves the whole pages of rows y_from to y_to of a buffer of rowBytes
+// rows to node and keeps them there, false if the kernel refuses
+bool mandelbrot_numa_bind_rows(void* buffer, size_t rowBytes, int y_from, int y_to, int node);
+
+void mandelbrot_numa(sf::Uint8* pixels, const RenderParams& params,
+                     float magnifier, float shiftX);
+
+// Tiles per node and worker, stolen within and across nodes
+void mandelbrot_numa_print_stats(FILE* file);
+
+// Thread counts for a scaling benchmark: 1, 2, 4 ... up to every CPU
+// of the first node, then as many more on the next node and so on
+std::vector<int> mandelbrot_numa_scaling_threads();
+
+#endif // MANDELBROT_NUMA_H_
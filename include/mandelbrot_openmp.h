@@ -3,6 +3,12 @@
 
 #include <SFML/Graphics.hpp>
 
-void mandelbrot_openmp(sf::Uint8* pixels, float magnifier, float shiftX);
+#include "mandelbrot_config.h"
+
+void mandelbrot_openmp(sf::Uint8* pixels, const RenderParams& params,
+                       float magnifier, float shiftX);
+
+// Smallest number of rows a thread takes at once, 0 for one
+void mandelbrot_openmp_chunk_rows(int rows);
 
 #endif // MANDELBROT_OPENMP_H_
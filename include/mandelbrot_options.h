@@ -0,0 +1,40 @@
+#ifndef MANDELBROT_OPTIONS_H_
+#define MANDELBROT_OPTIONS_H_
+
+#include "mandelbrot_batch.h"
+#include "mandelbrot_bench.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_farm.h"
+#include "mandelbrot_tile_server.h"
+#include "mandelbrot_video.h"
+
+// Command line options, each given as "--name value". The parse
+// functions return false if option is not one of theirs; values are read
+// as they come and checked by the command that uses them.
+
+// Every command and its options, to stderr
+void mandelbrot_print_usage(const char* program);
+
+// value as a whole decimal int, invalid if it is anything else or out of
+// range, so that the command's own check refuses it
+int mandelbrot_parse_int(const char* value, int invalid);
+
+// Options shared by the interactive and the benchmark mode
+bool mandelbrot_parse_render_option(const char* option, const char* value, RenderParams* params);
+
+// Prints what is wrong with params and returns false if anything is
+bool mandelbrot_check_render_params(const RenderParams& params);
+
+// Options of a headless render. formatGiven is set by --format, the
+// format is taken from the extension of the output otherwise.
+bool mandelbrot_parse_batch_option(const char* option, const char* value, BatchJob* job,
+                                   bool* formatGiven);
+
+bool mandelbrot_parse_video_option(const char* option, const char* value, VideoJob* video);
+bool mandelbrot_parse_farm_option (const char* option, const char* value, FarmJob* farm);
+bool mandelbrot_parse_serve_option(const char* option, const char* value, TileServerConfig* serve);
+
+// --warmup that is not a number is negative
+bool mandelbrot_parse_bench_option(const char* option, const char* value, BenchOptions* bench);
+
+#endif // MANDELBROT_OPTIONS_H_
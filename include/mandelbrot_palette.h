@@ -0,0 +1,68 @@
+#ifndef MANDELBROT_PALETTE_H_
+#define MANDELBROT_PALETTE_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "mandelbrot_config.h"
+
+// The CPU kernels only write iteration counts to mandelbrot_iterations().
+// mandelbrot_colorize turns them into RGBA through a palette, so a new
+// palette or color cycling needs no re-render.
+
+// RGBA of every iteration count, packed in the byte order of the pixels.
+// maxIterations (never escapes) is the last entry.
+struct Palette
+{
+    int maxIterations;
+    int offset;
+    std::vector<uint32_t> rgba;
+};
+
+// The original colors for maxIterations, rotated by offset iterations
+// (color cycling)
+void mandelbrot_palette_build(Palette* palette, int maxIterations, int offset);
+
+// The iteration buffer and the palette of a renderer, which points
+// RenderParams::context at one of its own. The kernels of one frame share
+// it from many threads; renderers with contexts of their own can render
+// at the same time.
+struct RenderContext
+{
+    RenderContext();
+    ~RenderContext();
+
+    RenderContext(const RenderContext&) = delete;
+    RenderContext& operator=(const RenderContext&) = delete;
+
+    // The first kernel thread of a new configuration rebuilds them
+    std::mutex mutex;
+    Palette    palette;
+    uint16_t*  iterations;
+    size_t     size;
+};
+
+// The palette of params.context the kernels colorize with, rebuilt when
+// the depth changes
+const Palette& mandelbrot_palette(const RenderParams& params);
+
+// Rotates the colors of mandelbrot_palette()
+void mandelbrot_palette_cycle(RenderContext* context, int offset);
+
+// params.width * params.height iteration counts of the last frame in
+// params.context, row by row like the pixels, in a frame buffer.
+// Reallocated when the frame size changes, so all calls of one frame must
+// use the same params.
+uint16_t* mandelbrot_iterations(const RenderParams& params);
+
+void mandelbrot_colorize(sf::Uint8* pixels, const RenderParams& params,
+                         const uint16_t* iterations, const Palette& palette,
+                         int x_from, int x_to, int y_from, int y_to);
+
+// Whole frame from mandelbrot_iterations() with mandelbrot_palette()
+void mandelbrot_colorize(sf::Uint8* pixels, const RenderParams& params);
+
+#endif // MANDELBROT_PALETTE_H_
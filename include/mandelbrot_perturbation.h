@@ -0,0 +1,29 @@
+#ifndef MANDELBROT_PERTURBATION_H_
+#define MANDELBROT_PERTURBATION_H_
+
+#include <SFML/Graphics.hpp>
+
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+
+// Series approximation is used while the cubic term stays below this
+// fraction of the quadratic one for the farthest pixel
+const double SERIES_TOLERANCE = 1e-6;
+
+// A pixel is rebased onto the start of the reference orbit as soon as
+// |Z + dz| < |dz|, the delta has then lost its precision (a glitch)
+struct PerturbationStats
+{
+    int referenceLength;
+    int skippedIterations;
+};
+
+// Renders with one arbitrary precision reference orbit at the view center
+// and per-pixel double deltas from it, rows in parallel. The orbit and
+// its series are computed once per view: the windows of a view (bands,
+// strips, tiles) only iterate their own deltas.
+void mandelbrot_perturbation(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                             const BigFixed& shiftX, const BigFixed& shiftY,
+                             PerturbationStats* stats = NULL);
+
+#endif // MANDELBROT_PERTURBATION_H_
@@ -0,0 +1,105 @@
+#ifndef MANDELBROT_PROFILE_H_
+#define MANDELBROT_PROFILE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "mandelbrot_config.h"
+
+// Hot-path instrumentation, built with make PROFILE=1 (-DPROFILE) and
+// compiled out otherwise. Kernels time spans of the frame, each a
+// rectangle rendered by one thread; for every span the iteration
+// buffer gives the iterations and the escaped and max-depth pixels,
+// and the vectorized kernels (all three builds) add how many of their
+// lanes were active per loop trip. Spans are kept per frame for the
+// heatmap and over the whole run for a Chrome trace (chrome://tracing,
+// Perfetto).
+
+// A span of the last finished frame
+struct ProfileCell
+{
+    int x_from;
+    int x_to;
+    int y_from;
+    int y_to;
+
+    double ms;
+};
+
+#ifdef PROFILE
+
+typedef std::chrono::steady_clock ProfileClock;
+
+struct ProfileSpan
+{
+    ProfileClock::time_point start;
+
+    // Of the thread when the span began, spans may nest
+    uint64_t laneTrips;
+    uint64_t lanes;
+    uint64_t activeLanes;
+};
+
+// Per-thread lane counters of the vectorized kernels
+struct ProfileLanes
+{
+    uint64_t trips;
+    uint64_t lanes;
+    uint64_t active;
+};
+
+extern thread_local ProfileLanes profileLanes;
+
+// One loop trip of a vector of width lanes
+inline void profile_count_lanes(int activeLanes, int width)
+{
+    profileLanes.trips++;
+    profileLanes.lanes  += width;
+    profileLanes.active += activeLanes;
+}
+
+inline ProfileSpan profile_span_begin()
+{
+    return { ProfileClock::now(), profileLanes.trips, profileLanes.lanes, profileLanes.active };
+}
+
+// name must outlive the run. The counts of the rectangle must be in
+// mandelbrot_iterations(params).
+void profile_span_end(const ProfileSpan& span, const char* name, const RenderParams& params,
+                      int x_from, int x_to, int y_from, int y_to);
+
+// Every span must be ended before frame_end, which is called on the
+// thread that began the frame. Spans outside a frame only go into
+// the trace.
+void mandelbrot_profile_frame_begin(const char* mode, const char* viewport);
+void mandelbrot_profile_frame_end();
+
+#else
+
+struct ProfileSpan {};
+
+inline void profile_count_lanes(int, int) {}
+
+inline ProfileSpan profile_span_begin() { return {}; }
+
+inline void profile_span_end(const ProfileSpan&, const char*, const RenderParams&,
+                             int, int, int, int) {}
+
+inline void mandelbrot_profile_frame_begin(const char*, const char*) {}
+inline void mandelbrot_profile_frame_end() {}
+
+#endif
+
+// Whether the instrumentation is built in
+bool mandelbrot_profile_enabled();
+
+// Spans of the last finished frame, false if there is none. Safe to
+// call from any thread.
+bool mandelbrot_profile_last_frame(std::vector<ProfileCell>* cells);
+
+// Every span and frame so far as Chrome trace events, false if the
+// file can't be written or the instrumentation is not built in
+bool mandelbrot_profile_write_trace(const char* path);
+
+#endif // MANDELBROT_PROFILE_H_
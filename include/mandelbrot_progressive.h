@@ -0,0 +1,62 @@
+#ifndef MANDELBROT_PROGRESSIVE_H_
+#define MANDELBROT_PROGRESSIVE_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <chrono>
+#include <vector>
+
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+
+// Progressive rendering of the interactive view: a pass over every 8th
+// pixel in both directions, then every 4th, 2nd and finally all of
+// them. A pass only iterates the pixels the coarser ones have not, and
+// every new sample fills its block of the iteration buffer, so the
+// screen always shows the nearest sample computed so far.
+
+// Sample spacing of the first pass, halved by every following one
+const int PROGRESSIVE_FIRST_STRIDE = 8;
+
+// The points kernel a view is refined with
+enum ProgressiveKernel
+{
+    PROGRESSIVE_FLOAT,   // mandelbrot_vectorized_points, the image of mandelbrot_vectorized
+    PROGRESSIVE_DOUBLE,  // mandelbrot_double_points, the image of mandelbrot_double
+};
+
+struct ProgressiveFrame
+{
+    ProgressiveKernel kernel;
+
+    // Current pass and the first of its sample rows not done yet
+    int stride;
+    int nextRow;
+
+    // Pixel coordinates of the view, one kernel's worth
+    std::vector<float>  columnC_x;
+    std::vector<float>  rowC_y;
+    std::vector<double> columnC_xd;
+    std::vector<double> rowC_yd;
+};
+
+// Starts over for a new view, dropping whatever the old one had left.
+// scale and the shifts are given as in main.cpp.
+void mandelbrot_progressive_start(ProgressiveFrame* frame, const RenderParams& params,
+                                  ProgressiveKernel kernel, double scale,
+                                  const BigFixed& shiftX, const BigFixed& shiftY);
+
+// Renders bands of sample rows, rows in parallel, until the deadline
+// passes or the frame is complete. The first pass is always finished,
+// so the whole view shows at once. Returns false if there was nothing
+// left.
+bool mandelbrot_progressive_continue(ProgressiveFrame* frame, sf::Uint8* pixels,
+                                     const RenderParams& params,
+                                     std::chrono::steady_clock::time_point deadline);
+
+inline bool mandelbrot_progressive_done(const ProgressiveFrame& frame)
+{
+    return frame.stride == 0;
+}
+
+#endif // MANDELBROT_PROGRESSIVE_H_
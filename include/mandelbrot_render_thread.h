@@ -0,0 +1,92 @@
+#ifndef MANDELBROT_RENDER_THREAD_H_
+#define MANDELBROT_RENDER_THREAD_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+
+// Frames in flight: one the UI thread uploads, the newest finished one
+// and the one being copied out of the render thread's working buffer
+const int RENDER_THREAD_BUFFERS = 3;
+
+// What the UI thread asks to see
+struct RenderView
+{
+    double   scale;
+    BigFixed shiftX;
+    BigFixed shiftY;
+    int      paletteOffset;
+};
+
+// Renders the interactive view on its own thread, so that the UI thread
+// only handles events and uploads. The render thread always works on
+// the latest view asked for; the views posted in between are never
+// rendered, and a finished frame replaces any the UI has not taken yet.
+class RenderThread
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Brings pixels, which hold the last frame it rendered, to view and
+    // returns false if nothing changed. Sets *again if it wants to be
+    // called with the same view at that time; a newer view comes first.
+    typedef std::function<bool(sf::Uint8* pixels, const RenderView& view,
+                               Clock::time_point* again)> RenderFunc;
+
+    RenderThread(const RenderParams& params, const RenderFunc& func);
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // Supersedes the views posted before
+    void post(const RenderView& view);
+
+    // The newest frame finished since the last call, NULL if there is
+    // none. It stays valid until release_frame.
+    const sf::Uint8* acquire_frame();
+    void release_frame();
+
+private:
+    enum SlotState
+    {
+        SLOT_FREE,
+        SLOT_WRITING,
+        SLOT_READY,
+        SLOT_SHOWING,
+    };
+
+    // Frame buffers, all of the size of work_
+    struct Slot
+    {
+        sf::Uint8* pixels;
+        SlotState  state;
+    };
+
+    void render_loop();
+    void publish();
+
+    RenderFunc func_;
+    size_t     size_;
+    sf::Uint8* work_;
+    Slot       slots_[RENDER_THREAD_BUFFERS];
+
+    std::mutex              mutex_;
+    std::condition_variable wakeCond_;
+
+    RenderView view_;
+    unsigned   generation_;
+    bool       stopping_;
+
+    // Last, so that it starts with everything above set up
+    std::thread thread_;
+};
+
+#endif // MANDELBROT_RENDER_THREAD_H_
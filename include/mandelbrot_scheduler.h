@@ -0,0 +1,98 @@
+#ifndef MANDELBROT_SCHEDULER_H_
+#define MANDELBROT_SCHEDULER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Tile
+{
+    int x_from;
+    int x_to;
+    int y_from;
+    int y_to;
+};
+
+struct WorkerStats
+{
+    double busyMs;
+    double idleMs;
+    int    nTiles;
+    int    nStolen;
+    int    nRemote;  // of nStolen, from workers of another node
+};
+
+// Workers that share a NUMA node, pinned to cpus (not pinned if empty)
+struct SchedulerNode
+{
+    int              nWorkers;
+    std::vector<int> cpus;
+};
+
+// Persistent pool of workers, each with its own deque of tiles. A worker
+// pops from the back of its own deque and, when it runs dry, steals from
+// the front of the others': first those of its own node, then the rest.
+class TileScheduler
+{
+public:
+    typedef std::function<void(const Tile& tile)> TileFunc;
+
+    // One node of unpinned workers
+    explicit TileScheduler(int nThreads);
+    // Workers numbered node after node
+    explicit TileScheduler(const std::vector<SchedulerNode>& nodes);
+    ~TileScheduler();
+
+    TileScheduler(const TileScheduler&) = delete;
+    TileScheduler& operator=(const TileScheduler&) = delete;
+
+    // Blocks until every tile is rendered
+    void run(const std::vector<Tile>& tiles, const TileFunc& func);
+
+    int nThreads() const { return (int)workers_.size(); }
+    int nNodes() const { return (int)nodeFirstWorker_.size() - 1; }
+    int workerNode(int worker) const { return workerNode_[worker]; }
+
+    // Every run gives each worker, and so each node, a contiguous block
+    // of the tiles in their order. Node node starts at this index.
+    size_t nodeFirstTile(int node, size_t nTiles) const;
+
+    // Of the last run
+    const std::vector<WorkerStats>& stats() const { return stats_; }
+    double frameMs() const { return frameMs_; }
+
+private:
+    struct alignas(64) WorkerQueue
+    {
+        std::mutex       mutex;
+        std::deque<Tile> tiles;
+    };
+
+    void worker_loop(int id);
+    bool pop_tile(int id, Tile* tile, bool* stolen, bool* remote);
+    bool steal_tile(int victim, Tile* tile);
+
+    std::vector<std::thread>  workers_;
+    std::vector<WorkerQueue>  queues_;
+    std::vector<WorkerStats>  stats_;
+
+    std::vector<int>              workerNode_;
+    std::vector<int>              nodeFirstWorker_;  // and the number of workers last
+    std::vector<std::vector<int>> nodeCpus_;
+
+    std::mutex              mutex_;
+    std::condition_variable startCond_;
+    std::condition_variable doneCond_;
+
+    const TileFunc* func_;
+    unsigned        generation_;
+    bool            stopping_;
+    int             activeWorkers_;
+
+    double frameMs_;
+};
+
+#endif // MANDELBROT_SCHEDULER_H_
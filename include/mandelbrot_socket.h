@@ -0,0 +1,26 @@
+#ifndef MANDELBROT_SOCKET_H_
+#define MANDELBROT_SOCKET_H_
+
+#include <cstddef>
+
+// Stream sockets by address: "unix:/path" for a Unix socket, "port" or
+// "host:port" for TCP. Without a host only 127.0.0.1 is used. Failures
+// are reported on stderr and return -1 or false.
+
+// Bound and listening, accept() doesn't block. A Unix socket left by an
+// earlier process at the path is replaced.
+int mandelbrot_socket_listen(const char* address);
+
+// Closes a listening socket and removes the path of a Unix socket
+void mandelbrot_socket_close_listen(int fd, const char* address);
+
+int mandelbrot_socket_connect(const char* address);
+
+// Sends and receives fail, rather than block, after ms
+void mandelbrot_socket_timeout(int fd, int ms);
+
+// The whole buffer, false if the peer is gone or timed out
+bool mandelbrot_socket_send(int fd, const void* data, size_t size);
+bool mandelbrot_socket_recv(int fd, void* data, size_t size);
+
+#endif // MANDELBROT_SOCKET_H_
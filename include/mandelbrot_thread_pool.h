@@ -3,6 +3,25 @@
 
 #include <SFML/Graphics.hpp>
 
-void mandelbrot_thread_pool(sf::Uint8* pixels, float magnifier, float shiftX);
+#include <cstdio>
+
+#include "mandelbrot_config.h"
+#include "mandelbrot_scheduler.h"
+
+// 2D tiles on a persistent work-stealing TileScheduler. The tile size
+// follows the load balance of the previous frame.
+void mandelbrot_thread_pool(sf::Uint8* pixels, const RenderParams& params,
+                            float magnifier, float shiftX);
+
+// Fixes the tile size to the one closest to height rows, 0 lets it
+// follow the load balance again
+void mandelbrot_thread_pool_tile_height(int height);
+
+// The persistent scheduler behind mandelbrot_thread_pool, for other
+// tiled renderers. Restarted with params.nThreads workers when that changes.
+TileScheduler& mandelbrot_thread_pool_scheduler(const RenderParams& params);
+
+// Per-thread busy and idle time of the last frame
+void mandelbrot_thread_pool_print_stats(FILE* file);
 
 #endif // MANDELBROT_THREAD_POOL_H_
@@ -0,0 +1,76 @@
+#ifndef MANDELBROT_TILE_CACHE_H_
+#define MANDELBROT_TILE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Caches of encoded tiles by a 64-bit content address: the hash of
+// everything the tile's pixels depend on, so an entry never goes stale
+// and needs no invalidation.
+
+// Shared by the caches and the responses still being sent
+typedef std::shared_ptr<const std::vector<uint8_t>> TileData;
+
+// FNV-1a, 64 bits
+uint64_t mandelbrot_tile_hash(const std::string& text);
+
+// Least recently used tiles in memory, split into shards by key so that
+// concurrent requests rarely wait for the same lock. Every shard holds
+// its share of the capacity.
+class TileMemoryCache
+{
+public:
+    TileMemoryCache(size_t capacityBytes, int nShards);
+
+    TileMemoryCache(const TileMemoryCache&) = delete;
+    TileMemoryCache& operator=(const TileMemoryCache&) = delete;
+
+    // NULL if the tile is not held
+    TileData get(uint64_t key);
+    void     put(uint64_t key, const TileData& data);
+
+    size_t bytes();
+
+private:
+    typedef std::list<std::pair<uint64_t, TileData>> Entries;
+
+    struct Shard
+    {
+        std::mutex                                      mutex;
+        Entries                                         entries;  // most recent first
+        std::unordered_map<uint64_t, Entries::iterator> index;
+        size_t                                          bytes;
+    };
+
+    Shard& shard(uint64_t key);
+
+    size_t                              shardCapacity_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+// One file per tile, dir/ab/abcdef0123456789.png after the key. Files
+// are written aside and renamed, so readers, and other processes sharing
+// the directory, never see half a tile. Nothing is ever evicted.
+class TileDiskCache
+{
+public:
+    explicit TileDiskCache(const std::string& dir);
+
+    // NULL if there is no file
+    TileData get(uint64_t key) const;
+    bool     put(uint64_t key, const TileData& data) const;
+
+private:
+    std::string path(uint64_t key) const;
+
+    std::string dir_;
+};
+
+#endif // MANDELBROT_TILE_CACHE_H_
@@ -0,0 +1,65 @@
+#ifndef MANDELBROT_TILE_SERVER_H_
+#define MANDELBROT_TILE_SERVER_H_
+
+#include "mandelbrot_bench.h"
+#include "mandelbrot_config.h"
+
+// Map tiles over HTTP, for slippy map viewers such as Leaflet:
+//
+//   GET /{z}/{x}/{y}.png  TILE_SIZE x TILE_SIZE PNG
+//   GET /stats            cache hit rates and latency percentiles, JSON
+//
+// Zoom 0 is one tile of side 3 around the whole set, [-2.25, 0.75] x
+// [-1.5, 1.5], every zoom halves the side; y grows with the imaginary
+// part as rows do in the viewer. A tile is looked up in a sharded LRU
+// cache in memory, then in a directory of files named by the hash of
+// everything the tile depends on. Misses go to a single render thread,
+// which waits TILE_BATCH_WAIT_MS for more, merges the missing tiles of
+// a zoom that lie close together into rectangular blocks within the
+// TILE_BATCH_MAX aligned squares of tiles, and renders each block with
+// the mode on every thread as a window of its square, so tiles don't
+// depend on their neighbours. Requests for a tile already being
+// rendered wait for that render.
+
+const int TILE_SIZE = 256;
+
+// Tile corners are exact in double up to this zoom
+const int TILE_MAX_ZOOM = 48;
+
+// Blocks lie in aligned squares of this many tiles on a side
+const int TILE_BATCH_MAX = 8;
+
+// How long the render thread collects misses before it renders them
+const int TILE_BATCH_WAIT_MS = 2;
+
+// Connections served at the same time, each by a thread of its own
+const int TILE_SERVER_HANDLERS = 16;
+
+// Memory cache when none is given
+const int DEFAULT_TILE_CACHE_MB = 256;
+
+// Latencies kept for the percentiles, the most recent ones
+const int TILE_LATENCY_SAMPLES = 4096;
+
+struct TileServerConfig
+{
+    const char*        address;   // "unix:/path", "port" or "host:port"
+    const char*        cacheDir;  // NULL for the memory cache only
+    int                cacheMb;   // memory cache
+
+    const char*        modeName;
+    MandelbrotDeepFunc func;
+};
+
+inline TileServerConfig default_tile_server_config()
+{
+    TileServerConfig config = {};
+    config.cacheMb = DEFAULT_TILE_CACHE_MB;
+    return config;
+}
+
+// Serves until SIGINT or SIGTERM, then prints the statistics. Returns 0
+// after a clean shutdown. params.width and params.height are unused.
+int mandelbrot_tile_server_run(const TileServerConfig& config, const RenderParams& params);
+
+#endif // MANDELBROT_TILE_SERVER_H_
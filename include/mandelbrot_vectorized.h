@@ -3,9 +3,24 @@
 
 #include <SFML/Graphics.hpp>
 
-void mandelbrot_vectorized_ranged(sf::Uint8* pixels, float magnifier, float shiftX,
-                                  int y_from, int y_to);
+#include <cstdint>
 
-void mandelbrot_vectorized(sf::Uint8* pixels, float magnifier, float shiftX);
+#include "mandelbrot_config.h"
+
+void mandelbrot_vectorized_ranged(sf::Uint8* pixels, const RenderParams& params,
+                                  float magnifier, float shiftX, int y_from, int y_to);
+
+void mandelbrot_vectorized(sf::Uint8* pixels, const RenderParams& params,
+                           float magnifier, float shiftX);
+
+// Coordinates mandelbrot_vectorized uses for every column (c_x, params.width
+// of them) and row (c_y, params.height of them), of a window too
+void mandelbrot_vectorized_coords(const RenderParams& params, float magnifier, float shiftX,
+                                  float* c_x, float* c_y);
+
+// Iteration counts of n arbitrary points with the arithmetic of
+// mandelbrot_vectorized
+void mandelbrot_vectorized_points(const RenderParams& params, const float* c_x, const float* c_y,
+                                  uint16_t* iterations, int n);
 
 #endif // MANDELBROT_VECTORIZED_H_
@@ -0,0 +1,30 @@
+#ifndef MANDELBROT_VECTORIZED_ISA_H_
+#define MANDELBROT_VECTORIZED_ISA_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+
+#include "mandelbrot_config.h"
+
+// Builds of mandelbrot_vectorized_ranged and mandelbrot_vectorized_points
+// for the instruction sets other than AVX2, which mandelbrot_vectorized.cpp
+// dispatches to by params.isa. Each is in a translation unit compiled for
+// its instruction set and may only be called if the CPU supports it.
+//
+// They walk the columns in the same 8-wide steps as the AVX2 kernel, so
+// the coordinates, and with them the images, match it bit for bit.
+
+void mandelbrot_vectorized_rows_sse42(sf::Uint8* pixels, const RenderParams& params,
+                                      float magnifier, float shiftX, int y_from, int y_to);
+void mandelbrot_vectorized_points_sse42(const RenderParams& params,
+                                        const float* c_x, const float* c_y,
+                                        uint16_t* iterations, int n);
+
+void mandelbrot_vectorized_rows_avx512(sf::Uint8* pixels, const RenderParams& params,
+                                       float magnifier, float shiftX, int y_from, int y_to);
+void mandelbrot_vectorized_points_avx512(const RenderParams& params,
+                                         const float* c_x, const float* c_y,
+                                         uint16_t* iterations, int n);
+
+#endif // MANDELBROT_VECTORIZED_ISA_H_
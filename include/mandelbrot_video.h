@@ -0,0 +1,61 @@
+#ifndef MANDELBROT_VIDEO_H_
+#define MANDELBROT_VIDEO_H_
+
+#include "mandelbrot_bench.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+
+// Zoom videos as raw RGBA frames, params.width x params.height each,
+// back to back for an external encoder, e.g.
+//   ffmpeg -f rawvideo -pix_fmt rgba -s WxH -r 60 -i - zoom.mp4
+//
+// The magnification changes by the same factor every frame. Key frames
+// are rendered by the mode at VIDEO_KEY_RESOLUTION times the frame size,
+// each the widest view of the frames around it whose magnification is
+// within that factor. Those frames are derived from it: a pixel takes
+// the middle count of its four nearest key frame pixels if they differ
+// by at most the tolerance, and never mixes interior with escaped
+// pixels; the others are iterated again with the double kernel. The
+// derived frames of a key frame are computed in parallel and written
+// in order by a thread of their own. Zooms too fast for a key frame to
+// pay off, and views too deep for double, are rendered frame by frame
+// by the mode.
+
+const int VIDEO_KEY_RESOLUTION = 2;
+
+// Frames computed ahead of the writer, more with more threads
+const int VIDEO_QUEUE_FRAMES = 8;
+
+// The view is given as for BatchJob
+struct VideoJob
+{
+    const char*        output;     // "-" for stdout
+    int                nFrames;
+    double             zoomTo;     // scale of the last frame
+    bool               keyFrames;  // false renders every frame in full
+    int                tolerance;  // iterations the key frame pixels may differ by
+
+    const char*        modeName;
+    MandelbrotDeepFunc func;
+
+    double   scale;
+    BigFixed shiftX;
+    BigFixed shiftY;
+};
+
+// 10 s at 60 fps from the scale to 1000, key frames that may be off by
+// one iteration
+inline VideoJob default_video_job()
+{
+    VideoJob job = {};
+    job.nFrames   = 600;
+    job.zoomTo    = 1000.0;
+    job.keyFrames = true;
+    job.tolerance = 1;
+    return job;
+}
+
+// Returns 0 on success. Progress and the frame rate go to stderr.
+int mandelbrot_video_render(const VideoJob& job, const RenderParams& params);
+
+#endif // MANDELBROT_VIDEO_H_
@@ -0,0 +1,13 @@
+#ifndef MANDELBROT_VIEWER_H_
+#define MANDELBROT_VIEWER_H_
+
+#include "mandelbrot_backends.h"
+#include "mandelbrot_config.h"
+
+// The interactive window of mode until it is closed. budgetMs > 0
+// renders progressively within that much of every frame; autoDepth is
+// --iterations auto. Returns the exit status.
+int mandelbrot_run_viewer(const MandelbrotBackend* mode, const RenderParams& params, int budgetMs,
+                          bool autoDepth);
+
+#endif // MANDELBROT_VIEWER_H_
@@ -1,126 +1,269 @@
-#include <SFML/Graphics.hpp>
-
-#include <cassert>
-#include <cmath>
+#include <cstdio>
 #include <cstring>
-#include <immintrin.h>
-
-#include "mandelbrot_naive.h"
-#include "mandelbrot_vectorized.h"
-#include "mandelbrot_arrayed.h"
-#include "mandelbrot_openmp.h"
-#include "mandelbrot_thread_pool.h"
-#ifdef GPU
-#include <cuda_runtime.h>
-#include "mandelbrot_cuda.h"
-#endif
 
+#include "mandelbrot_autotune.h"
+#include "mandelbrot_backends.h"
+#include "mandelbrot_batch.h"
+#include "mandelbrot_bench.h"
+#include "mandelbrot_commands.h"
 #include "mandelbrot_config.h"
+#include "mandelbrot_farm.h"
+#include "mandelbrot_fractal.h"
+#include "mandelbrot_frame_buffer.h"
+#include "mandelbrot_isa.h"
+#include "mandelbrot_options.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_profile.h"
+#include "mandelbrot_tile_server.h"
+#include "mandelbrot_video.h"
+#include "mandelbrot_viewer.h"
 
-static void test_implementation(sf::Uint8* pixels, void (*func)(sf::Uint8*, float, float),
-                                const char* name, int nTests)
+static void write_trace(const char* path)
 {
-    printf("Testing %d times %s\n", nTests, name);
+    if (!path)
+        return;
 
-    for (int i = 0; i < nTests; i++)
-        func(pixels, 1.0f, 0.0f);
+    if (!mandelbrot_profile_enabled())
+        fprintf(stderr, "Built without PROFILE=1, no trace written\n");
+    else if (!mandelbrot_profile_write_trace(path))
+        fprintf(stderr, "Can't write %s\n", path);
 }
 
 int main(int argc, char* argv[])
 {
-    sf::Uint8* pixels = (sf::Uint8*) calloc(WINDOW_WIDTH * WINDOW_HEIGHT * 4,
-                                                            sizeof(sf::Uint8));
-    if (argc == 3)
+    if (argc < 2)
     {
-        int nTests = 0;
-        sscanf(argv[2], "%d", &nTests);
-#ifdef GPU
-        if (strcmp(argv[1], "cuda_no_cpy") == 0) {
-            sf::Uint8* d_pixels;
-            size_t size = WINDOW_WIDTH * WINDOW_HEIGHT * 4 * sizeof(sf::Uint8);
-            cudaMalloc(&d_pixels, size);
-            test_implementation(d_pixels, mandelbrot_cuda_no_cpy, "cuda no cpy", nTests);
-            cudaMemcpy(pixels, d_pixels, size, cudaMemcpyDeviceToHost);
-            cudaFree(d_pixels);
-        }
-        else if (strcmp(argv[1], "cuda"       ) == 0) test_implementation(pixels, mandelbrot_cuda,        "cuda",        nTests);
-        else
-#endif
-        if      (strcmp(argv[1], "naive"      ) == 0) test_implementation(pixels, mandelbrot_naive,       "naive",       nTests);
-        else if (strcmp(argv[1], "vectorized" ) == 0) test_implementation(pixels, mandelbrot_vectorized,  "vectorized",  nTests);
-        else if (strcmp(argv[1], "arrayed"    ) == 0) test_implementation(pixels, mandelbrot_arrayed,     "arrayed",     nTests);
-        else if (strcmp(argv[1], "openmp"     ) == 0) test_implementation(pixels, mandelbrot_openmp,      "openmp",      nTests);
-        else if (strcmp(argv[1], "thread-pool") == 0) test_implementation(pixels, mandelbrot_thread_pool, "thread-pool", nTests);
-        else assert(0 && "Unknown implementation");
-
-        return 0;
+        mandelbrot_print_usage(argv[0]);
+        return 1;
+    }
+
+    // Only the common code is built for the baseline, the kernels for AVX2
+    if (!mandelbrot_isa_supported(ISA_AVX2))
+    {
+        fprintf(stderr, "This CPU does not support AVX2 and FMA, which the kernels are built for\n");
+        return 1;
     }
 
-    sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Mandelbrot");
+    if (strcmp(argv[1], "worker") == 0)
+        return mandelbrot_run_worker(argc, argv);
+
+    if (strcmp(argv[1], "tune") == 0)
+        return mandelbrot_run_tune(argc, argv);
+
+    // A number after the mode selects the benchmark
+    BenchOptions bench = default_bench_options();
+    const bool benchmark = argc >= 3 && strncmp(argv[2], "--", 2) != 0;
+    if (benchmark && (sscanf(argv[2], "%d", &bench.nFrames) != 1 || bench.nFrames < 1))
+    {
+        fprintf(stderr, "Invalid number of benchmark frames %s\n", argv[2]);
+        mandelbrot_print_usage(argv[0]);
+        return 1;
+    }
 
-    sf::Texture texture;
-    texture.create(WINDOW_WIDTH, WINDOW_HEIGHT);
-    texture.update(pixels);
+    RenderContext context;
+    RenderParams  params = default_render_params();
+    params.context = &context;
 
-    sf::Sprite sprite(texture);
+    BatchJob job = default_batch_job();
+    job.modeName = argv[1];
+    bool formatGiven = false;
 
-    double scale  = 1.0f;
-    double shiftX = 0.0f;
+    VideoJob video = default_video_job();
 
-    while (window.isOpen())
+    TileServerConfig serve = default_tile_server_config();
+
+    FarmJob farm = default_farm_job();
+
+    // Progressive rendering within this much of every interactive frame,
+    // 0 renders whole frames
+    int budgetMs = 0;
+
+    // Chrome trace of the instrumented spans, PROFILE=1 builds only
+    const char* tracePath = NULL;
+
+    // Settings of the tuned mode, from ./mandelbrot tune
+    const char* tuneProfilePath = DEFAULT_TUNE_PROFILE;
+
+    // --iterations auto: the depth is picked per view, never below the default
+    bool autoDepth = false;
+
+    // --fractal, the Mandelbrot set if not given; all only in the benchmark
+    const char* fractalName = NULL;
+
+    for (int i = benchmark ? 3 : 2; i < argc; i += 2)
     {
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed)
-                window.close();
-            else if (event.type == sf::Event::KeyPressed)
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value of %s\n", argv[i]);
+            mandelbrot_print_usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(argv[i], "--iterations") == 0 && strcmp(argv[i + 1], "auto") == 0)
+        {
+            if (benchmark)
             {
-                if (event.key.code == sf::Keyboard::RBracket)
-                {
-                    scale *= 1.1;
-                }
-                else if (event.key.code == sf::Keyboard::LBracket)
-                {
-                    scale *= 0.9;
-                }
-                else if (event.key.code == sf::Keyboard::Left)
-                {
-                    shiftX -= 0.1 / scale;
-                }
-                else if (event.key.code == sf::Keyboard::Right)
-                {
-                    shiftX += 0.1 / scale;
-                }
-            }    
+                fprintf(stderr, "The benchmark needs a fixed iteration depth\n");
+                return 1;
+            }
+
+            autoDepth = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--trace") == 0)
+        {
+            tracePath = argv[i + 1];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--profile") == 0)
+        {
+            tuneProfilePath = argv[i + 1];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--fractal") == 0)
+        {
+            fractalName = argv[i + 1];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--julia-c") == 0)
+        {
+            float k_x = 0, k_y = 0;
+            if (sscanf(argv[i + 1], "%f,%f", &k_x, &k_y) != 2)
+            {
+                fprintf(stderr, "--julia-c takes the constant as X,Y\n");
+                return 1;
+            }
+
+            mandelbrot_fractal_set_julia(k_x, k_y);
+            continue;
+        }
+
+        // The center of a headless render, exact to the last digit given
+        if (!benchmark && (strcmp(argv[i], "--shift-x") == 0 || strcmp(argv[i], "--shift-y") == 0))
+        {
+            BigFixed* shift = strcmp(argv[i], "--shift-x") == 0 ? &job.shiftX : &job.shiftY;
+            if (!bf_parse(argv[i + 1], shift))
+            {
+                fprintf(stderr, "%s takes a decimal number, not %s\n", argv[i], argv[i + 1]);
+                return 1;
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "--huge-pages") == 0)
+        {
+            mandelbrot_frame_buffer_huge_pages(strcmp(argv[i + 1], "on") == 0);
+            continue;
         }
 
-#ifdef GPU
-        if (strcmp(argv[1], "cuda_no_cpy") == 0) {
-            sf::Uint8* d_pixels;
-            size_t size = WINDOW_WIDTH * WINDOW_HEIGHT * 4 * sizeof(sf::Uint8);
-            cudaMalloc(&d_pixels, size);
-            mandelbrot_cuda_no_cpy(d_pixels, scale, shiftX);
-            cudaMemcpy(pixels, d_pixels, size, cudaMemcpyDeviceToHost);
-            cudaFree(d_pixels);
+        if (!benchmark && strcmp(argv[i], "--budget") == 0)
+        {
+            budgetMs = mandelbrot_parse_int(argv[i + 1], -1);
+            continue;
         }
-        else if (strcmp(argv[1], "cuda"       ) == 0) mandelbrot_cuda(pixels, scale, shiftX);
-        else
-#endif
-        if      (strcmp(argv[1], "naive"      ) == 0) mandelbrot_naive(pixels, scale, shiftX);
-        else if (strcmp(argv[1], "vectorized" ) == 0) mandelbrot_vectorized(pixels, scale, shiftX);
-        else if (strcmp(argv[1], "arrayed"    ) == 0) mandelbrot_arrayed(pixels, scale, shiftX);
-        else if (strcmp(argv[1], "openmp"     ) == 0) mandelbrot_openmp(pixels, scale, shiftX);
-        else if (strcmp(argv[1], "thread-pool") == 0) mandelbrot_thread_pool(pixels, scale, shiftX);
-        else assert(0 && "Unknown implementation");
-
-        texture.update(pixels);
-
-        window.clear();
-        window.draw(sprite);
-        window.display();
+
+        const bool known = mandelbrot_parse_render_option(argv[i], argv[i + 1], &params) ||
+                           (benchmark ? mandelbrot_parse_bench_option(argv[i], argv[i + 1], &bench)
+                                      : mandelbrot_parse_batch_option(argv[i], argv[i + 1], &job, &formatGiven) ||
+                                        mandelbrot_parse_video_option(argv[i], argv[i + 1], &video) ||
+                                        mandelbrot_parse_serve_option(argv[i], argv[i + 1], &serve) ||
+                                        mandelbrot_parse_farm_option (argv[i], argv[i + 1], &farm));
+        if (!known)
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (!mandelbrot_check_render_params(params))
+        return 1;
+
+    if (budgetMs < 0)
+    {
+        fprintf(stderr, "--budget takes milliseconds, 0 or more\n");
+        return 1;
+    }
+
+    if (bench.nWarmup < 0)
+    {
+        fprintf(stderr, "--warmup takes a number of frames, 0 or more\n");
+        mandelbrot_print_usage(argv[0]);
+        return 1;
     }
 
-    free(pixels);
+    const bool allFractals = benchmark && fractalName && strcmp(fractalName, "all") == 0;
+    if (fractalName && !allFractals && !mandelbrot_fractal_select(fractalName))
+    {
+        fprintf(stderr, "Unknown fractal %s, one of", fractalName);
+        for (int f = 0; f < N_FRACTALS; f++)
+            fprintf(stderr, " %s", FRACTALS[f].name);
+        fprintf(stderr, benchmark ? " or all\n" : "\n");
+        return 1;
+    }
+
+    if (!mandelbrot_fractal_is_mandelbrot())
+    {
+        // The depth estimate and the deep kernels are those of the Mandelbrot set
+        if (autoDepth)
+        {
+            fprintf(stderr, "--iterations auto only works for the Mandelbrot set\n");
+            return 1;
+        }
+
+        const MandelbrotBackend* mode = mandelbrot_find_backend(argv[1]);
+        if (mode && !mode->fractals)
+        {
+            fprintf(stderr, "%s only renders the Mandelbrot set\n", argv[1]);
+            return 1;
+        }
+    }
+
+    const bool tuned = strcmp(argv[1], "tuned") == 0;
+    if ((tuned || (benchmark && strcmp(argv[1], "all") == 0)) &&
+        !mandelbrot_load_tune_profile(tuneProfilePath, params, tuned))
+        return 1;
+
+    if (farm.address && !benchmark)
+    {
+        const int status = mandelbrot_run_farm(farm, job, formatGiven, params, autoDepth);
+        write_trace(tracePath);
+        return status;
+    }
+
+    if (serve.address && !benchmark)
+    {
+        const int status = mandelbrot_run_server(serve, argv[1], params, autoDepth);
+        write_trace(tracePath);
+        return status;
+    }
+
+    if (video.output && !benchmark)
+    {
+        const int status = mandelbrot_run_video(video, job, params, autoDepth);
+        write_trace(tracePath);
+        return status;
+    }
+
+    if (benchmark || job.output)
+    {
+        const int status = benchmark ? mandelbrot_run_benchmark(params, bench, allFractals, argv[1])
+                                     : mandelbrot_run_batch(job, formatGiven, params, autoDepth);
+        write_trace(tracePath);
+        return status;
+    }
+
+    const MandelbrotBackend* mode = mandelbrot_find_backend(argv[1]);
+    if (!mode)
+    {
+        fprintf(stderr, "Unknown implementation %s\n", argv[1]);
+        return 1;
+    }
 
-    return 0;
+    const int status = mandelbrot_run_viewer(mode, params, budgetMs, autoDepth);
+    write_trace(tracePath);
+    return status;
 }
@@ -0,0 +1,231 @@
+#include "mandelbrot_antialias.h"
+#include "mandelbrot_double.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_vectorized.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <omp.h>
+#include <vector>
+
+// Per-thread scratch for the edge pixels of one tile
+struct EdgeBatch
+{
+    std::vector<size_t>   index;
+    std::vector<int>      side;
+    std::vector<float>    c_x;
+    std::vector<float>    c_y;
+    std::vector<double>   c_xd;
+    std::vector<double>   c_yd;
+    std::vector<uint16_t> counts;
+};
+
+// The same offset in [0, 1) for the same pixel and subsample every time,
+// so a resumed render matches an uninterrupted one
+static double jitter(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+
+    return (key >> 11) * (1.0 / (1ULL << 53));
+}
+
+static int channel_contrast(uint32_t a, uint32_t b)
+{
+    int contrast = 0;
+    for (int shift = 0; shift < 24; shift += 8)
+        contrast = std::max(contrast, std::abs((int)(a >> shift & 0xff) - (int)(b >> shift & 0xff)));
+
+    return contrast;
+}
+
+static uint32_t color_of(const Palette& palette, uint16_t count)
+{
+    return palette.rgba[std::min((int)count, palette.maxIterations)];
+}
+
+// Side of the subsample grid of a pixel, 1 if it needs none
+static int grid_side(const RenderParams& params, const Palette& palette, const uint16_t* iterations,
+                     int x, int y, int maxSide)
+{
+    const uint16_t count = iterations[(size_t)y * params.width + x];
+    const uint32_t color = color_of(palette, count);
+
+    // Most pixels have the count of all their neighbours
+    bool uniform = true;
+    for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, params.height - 1) && uniform; ny++)
+        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, params.width - 1); nx++)
+            uniform &= iterations[(size_t)ny * params.width + nx] == count;
+
+    if (uniform)
+        return 1;
+
+    int contrast = 0;
+    for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, params.height - 1); ny++)
+        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, params.width - 1); nx++)
+            contrast = std::max(contrast, channel_contrast(
+                           color, color_of(palette, iterations[(size_t)ny * params.width + nx])));
+
+    if (contrast < AA_MIN_CONTRAST)
+        return 1;
+
+    return std::min(2 + (contrast - AA_MIN_CONTRAST) / AA_CONTRAST_STEP, maxSide);
+}
+
+// Supersamples the edge pixels of a tile, returns the number of them
+// and adds their subsamples to nSubsamples
+static int antialias_tile(sf::Uint8* pixels, const RenderParams& params, int maxSide,
+                          ProgressiveKernel kernel, const Palette& palette, const uint16_t* iterations,
+                          const std::vector<float>&  columnC_x, const std::vector<float>&  rowC_y,
+                          const std::vector<double>& columnC_xd, const std::vector<double>& rowC_yd,
+                          double stepX, double stepY,
+                          int x_from, int x_to, int y_from, int y_to, uint64_t* nSubsamples)
+{
+    const int viewWidth = view_params(params).width;
+
+    static thread_local EdgeBatch batch;
+
+    batch.index.clear();
+    batch.side.clear();
+    batch.c_x.clear();
+    batch.c_y.clear();
+    batch.c_xd.clear();
+    batch.c_yd.clear();
+
+    for (int y = y_from; y < y_to; y++)
+        for (int x = x_from; x < x_to; x++)
+        {
+            const int side = grid_side(params, palette, iterations, x, y, maxSide);
+            if (side < 2)
+                continue;
+
+            const size_t index = (size_t)y * params.width + x;
+            batch.index.push_back(index);
+            batch.side.push_back(side);
+
+            // Jittered by the pixel's index in the view, so a window of it
+            // gets the subsamples of the whole
+            const uint64_t viewIndex = (uint64_t)(params.y_offset + y) * viewWidth +
+                                       params.x_offset + x;
+
+            // One subsample in every cell of a side x side grid over the pixel
+            for (int cell = 0; cell < side * side; cell++)
+            {
+                const uint64_t key = viewIndex * AA_MAX_SAMPLES + cell;
+                const double   dx  = (cell % side + jitter(2 * key))     / side - 0.5;
+                const double   dy  = (cell / side + jitter(2 * key + 1)) / side - 0.5;
+
+                if (kernel == PROGRESSIVE_FLOAT)
+                {
+                    batch.c_x.push_back(columnC_x[x] + (float)(dx * stepX));
+                    batch.c_y.push_back(rowC_y[y]    + (float)(dy * stepY));
+                }
+                else
+                {
+                    batch.c_xd.push_back(columnC_xd[x] + dx * stepX);
+                    batch.c_yd.push_back(rowC_yd[y]    + dy * stepY);
+                }
+            }
+        }
+
+    const int n = (int)(kernel == PROGRESSIVE_FLOAT ? batch.c_x.size() : batch.c_xd.size());
+    if (n == 0)
+        return 0;
+
+    batch.counts.resize(n);
+    if (kernel == PROGRESSIVE_FLOAT)
+        mandelbrot_vectorized_points(params, batch.c_x.data(),  batch.c_y.data(),
+                                     batch.counts.data(), n);
+    else
+        mandelbrot_double_points    (params, batch.c_xd.data(), batch.c_yd.data(),
+                                     batch.counts.data(), n);
+
+    const uint16_t* counts = batch.counts.data();
+    for (size_t i = 0; i < batch.index.size(); i++)
+    {
+        const int nCells = batch.side[i] * batch.side[i];
+
+        int sum[3] = {};
+        for (int cell = 0; cell < nCells; cell++)
+        {
+            const uint32_t color = color_of(palette, counts[cell]);
+            for (int c = 0; c < 3; c++)
+                sum[c] += color >> (8 * c) & 0xff;
+        }
+        counts += nCells;
+
+        sf::Uint8* pixel = pixels + batch.index[i] * 4;
+        for (int c = 0; c < 3; c++)
+            pixel[c] = (sf::Uint8)((sum[c] + nCells / 2) / nCells);
+    }
+
+    *nSubsamples += n;
+    return (int)batch.index.size();
+}
+
+void mandelbrot_antialias(sf::Uint8* pixels, const RenderParams& params, int maxSamples,
+                          ProgressiveKernel kernel, double scale,
+                          const BigFixed& shiftX, const BigFixed& shiftY,
+                          int y_from, int y_to, AntialiasStats* stats)
+{
+    const int maxSide = (int)std::sqrt((double)std::min(maxSamples, AA_MAX_SAMPLES));
+
+    stats->nPixels += (uint64_t)params.width * (y_to - y_from);
+    if (maxSide < 2)
+        return;
+
+    const Palette&  palette    = mandelbrot_palette(params);
+    const uint16_t* iterations = mandelbrot_iterations(params);
+
+    // The coordinates the frame was rendered with, as in progressive
+    std::vector<float>  columnC_x;
+    std::vector<float>  rowC_y;
+    std::vector<double> columnC_xd;
+    std::vector<double> rowC_yd;
+    if (kernel == PROGRESSIVE_FLOAT)
+    {
+        columnC_x.resize(params.width);
+        rowC_y   .resize(params.height);
+        mandelbrot_vectorized_coords(params, (float)scale, (float)bf_to_double(shiftX),
+                                     columnC_x.data(), rowC_y.data());
+    }
+    else
+    {
+        columnC_xd.resize(params.width);
+        rowC_yd   .resize(params.height);
+        mandelbrot_double_coords(params, scale, bf_to_double(shiftX), bf_to_double(shiftY),
+                                 columnC_xd.data(), rowC_yd.data());
+    }
+
+    // Pixel steps of the view, if the frame is a window of it
+    const RenderParams view = view_params(params);
+
+    const double magnifier = scale + MAGNIFIER_OFFSET;
+    const double stepX     = aspect_ratio_double(view) * 2.0 / (view.width * magnifier);
+    const double stepY     = 2.0 / (view.height * magnifier);
+
+    const int nTilesX = (params.width  + AA_TILE_SIZE - 1) / AA_TILE_SIZE;
+    const int nTilesY = (y_to - y_from + AA_TILE_SIZE - 1) / AA_TILE_SIZE;
+
+    uint64_t nEdgePixels = 0;
+    uint64_t nSubsamples = 0;
+
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:nEdgePixels, nSubsamples) \
+                         num_threads(params.nThreads)
+    for (int tile = 0; tile < nTilesX * nTilesY; tile++)
+    {
+        const int x_tile = tile % nTilesX * AA_TILE_SIZE;
+        const int y_tile = y_from + tile / nTilesX * AA_TILE_SIZE;
+        nEdgePixels += antialias_tile(pixels, params, maxSide, kernel, palette, iterations,
+                                      columnC_x, rowC_y, columnC_xd, rowC_yd, stepX, stepY,
+                                      x_tile, std::min(x_tile + AA_TILE_SIZE, params.width),
+                                      y_tile, std::min(y_tile + AA_TILE_SIZE, y_to), &nSubsamples);
+    }
+
+    stats->nEdgePixels += nEdgePixels;
+    stats->nSubsamples += nSubsamples;
+}
@@ -1,5 +1,7 @@
 #include "mandelbrot_arrayed.h"
 #include "mandelbrot_config.h"
+#include "mandelbrot_interior.h"
+#include "mandelbrot_palette.h"
 
 #include <cstring>
 
@@ -8,35 +10,57 @@ const int VEC_SIZE = 8;
 #define FOR_VEC for (int i = 0; i < VEC_SIZE; ++i)
 #define ALIGN alignas(VEC_SIZE * 4)
 
-void mandelbrot_arrayed(sf::Uint8* pixels, float magnifier, float shiftX)
+void mandelbrot_arrayed(sf::Uint8* pixels, const RenderParams& params,
+                        float magnifier, float shiftX)
 {
-    return mandelbrot_arrayed_ranged(pixels, magnifier, shiftX, 0, WINDOW_HEIGHT);
+    return mandelbrot_arrayed_ranged(pixels, params, magnifier, shiftX, 0, params.height);
 }
 
-void mandelbrot_arrayed_ranged(sf::Uint8* pixels, float magnifier, float shiftX,
-                               int y_from, int y_to)
+void mandelbrot_arrayed_ranged(sf::Uint8* pixels, const RenderParams& params,
+                               float magnifier, float shiftX, int y_from, int y_to)
+{
+    mandelbrot_arrayed_tile(pixels, params, magnifier, shiftX, 0, params.width, y_from, y_to);
+}
+
+// HAS_TAIL: the width is not a multiple of VEC_SIZE, lanes past the last
+// column start out done and are not stored
+template <bool HAS_TAIL>
+static void arrayed_tile(sf::Uint8* pixels, const RenderParams& params, float magnifier, float shiftX,
+                         int x_from, int x_to, int y_from, int y_to)
 {
     shiftX    += SHIFT_X_OFFSET;
     magnifier += MAGNIFIER_OFFSET;
 
     const float invMagnifier = 1.0f / magnifier;
-    const float COLOR_SCALE = 255.0f / MAX_ITERATION_DEPTH;
 
-    const float c_step_x = ASPECT_RATIO * invMagnifier * (2.0f / WINDOW_WIDTH);
-    const float c_step_y = invMagnifier * (2.0f / WINDOW_HEIGHT);
+    const float c_step_x = aspect_ratio(params) * invMagnifier * (2.0f / params.width);
+    const float c_step_y = invMagnifier * (2.0f / params.height);
 
-    const float vec_c_step_x = c_step_x * VEC_SIZE;
+    const float maxRadius2    = max_radius_2(params);
+    const int   maxIterations = params.maxIterations;
+
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
 
-    float c_y = -1.0f * invMagnifier + c_step_y * y_from;
+    const float vec_c_step_x = c_step_x * VEC_SIZE;
 
     for (int screenY = y_from; screenY < y_to; screenY++) 
     {
+        // From the row index, so the output does not depend on how the
+        // frame is split into tiles
+        const float c_y = -1.0f * invMagnifier + c_step_y * screenY;
+
         ALIGN float _c_x[VEC_SIZE];
 
-        const float c_x = shiftX - ASPECT_RATIO * invMagnifier;
+        const float c_x = shiftX - aspect_ratio(params) * invMagnifier;
         FOR_VEC _c_x[i] = c_x + c_step_x * i;
 
-        for (int screenX = 0; screenX < WINDOW_WIDTH; screenX += VEC_SIZE) 
+        // The columns are accumulated from the left edge like the whole row
+        for (int screenX = 0; screenX < x_from; screenX += VEC_SIZE)
+            FOR_VEC _c_x[i] += vec_c_step_x;
+
+        uint16_t* rowIterations = iterations + (size_t)screenY * params.width;
+        for (int screenX = x_from; screenX < x_to; screenX += VEC_SIZE) 
         {
             ALIGN float _z_x [VEC_SIZE] = {0};
             ALIGN float _z_y [VEC_SIZE] = {0};
@@ -45,13 +69,25 @@ void mandelbrot_arrayed_ranged(sf::Uint8* pixels, float magnifier, float shiftX,
             ALIGN float _z_y2[VEC_SIZE] = {0};
             ALIGN int _iterations[VEC_SIZE] = {0};
 
-            for (int it = 0; it < MAX_ITERATION_DEPTH; ++it) 
+            // Lanes known to never escape stop counting and no longer
+            // keep the loop running
+            ALIGN int _interior[VEC_SIZE] = {0};
+            FOR_VEC _interior[i] = is_in_cardioid_or_bulb(_c_x[i], c_y);
+            if (HAS_TAIL)
+                FOR_VEC _interior[i] |= screenX + i >= params.width;
+
+            ALIGN float _check_x[VEC_SIZE] = {0};
+            ALIGN float _check_y[VEC_SIZE] = {0};
+            int checkLength    = PERIOD_CHECK_START;
+            int checkRemaining = PERIOD_CHECK_START;
+
+            for (int it = 0; it < maxIterations; ++it) 
             {
                 ALIGN float _radius2[VEC_SIZE] = {0};
                 FOR_VEC _radius2[i] = _z_x2[i] + _z_y2[i];
 
                 ALIGN int _is_active[VEC_SIZE] = {0};
-                FOR_VEC _is_active[i] = _radius2[i] < MAX_RADIUS_2;
+                FOR_VEC _is_active[i] = _radius2[i] < maxRadius2 && !_interior[i];
 
                 bool all_zero = true;
                 FOR_VEC
@@ -75,30 +111,47 @@ void mandelbrot_arrayed_ranged(sf::Uint8* pixels, float magnifier, float shiftX,
                 FOR_VEC _z_x2[i] = _z_x[i] * _z_x[i];
                 FOR_VEC _z_y2[i] = _z_y[i] * _z_y[i];
                 FOR_VEC _z_xy[i] = _z_x[i] * _z_y[i];
+
+                FOR_VEC _interior[i] |= _is_active[i] & (_z_x[i] == _check_x[i]) &
+                                                         (_z_y[i] == _check_y[i]);
+
+                if (--checkRemaining == 0)
+                {
+                    FOR_VEC _check_x[i] = _z_x[i];
+                    FOR_VEC _check_y[i] = _z_y[i];
+                    checkLength   *= 2;
+                    checkRemaining = checkLength;
+                }
             }
 
             FOR_VEC
             {
-                sf::Uint8 r = 0;
-                sf::Uint8 g = 0;
-                sf::Uint8 b = 0;
-                if (_iterations[i] < MAX_ITERATION_DEPTH)
-                {
-                    float iterNormalized = _iterations[i] * COLOR_SCALE;
-                    r = (sf::Uint8)(iterNormalized / 2);
-                    g = (sf::Uint8)(iterNormalized * 2 + 2);
-                    b = (sf::Uint8)(iterNormalized * 2 + 5);
-                }
+                if (_interior[i])
+                    _iterations[i] = maxIterations;
+            }
 
-                int pixelIndex = (screenY * WINDOW_WIDTH + screenX + i) * 4;
-                pixels[pixelIndex + 0] = r;
-                pixels[pixelIndex + 1] = g;
-                pixels[pixelIndex + 2] = b;
-                pixels[pixelIndex + 3] = 255;
+            if (HAS_TAIL && screenX + VEC_SIZE > params.width)
+            {
+                for (int i = 0; screenX + i < params.width; ++i)
+                    rowIterations[screenX + i] = (uint16_t)_iterations[i];
             }
+            else
+                FOR_VEC rowIterations[screenX + i] = (uint16_t)_iterations[i];
 
             FOR_VEC _c_x[i] += vec_c_step_x;
         }
-        c_y += c_step_y;
+
+        mandelbrot_colorize(pixels, params, iterations, palette,
+                            x_from, x_to, screenY, screenY + 1);
     }
 }
+
+void mandelbrot_arrayed_tile(sf::Uint8* pixels, const RenderParams& params,
+                             float magnifier, float shiftX,
+                             int x_from, int x_to, int y_from, int y_to)
+{
+    if (params.width % VEC_SIZE == 0)
+        arrayed_tile<false>(pixels, params, magnifier, shiftX, x_from, x_to, y_from, y_to);
+    else
+        arrayed_tile<true >(pixels, params, magnifier, shiftX, x_from, x_to, y_from, y_to);
+}
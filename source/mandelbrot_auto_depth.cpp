@@ -0,0 +1,216 @@
+#include "mandelbrot_auto_depth.h"
+#include "mandelbrot_double.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_vectorized.h"
+
+#include <algorithm>
+#include <omp.h>
+#include <vector>
+
+// Probe samples per parallel chunk
+const int PROBE_CHUNK = 64;
+
+// Per-thread scratch for the limit pixels of one tile
+struct TileBatch
+{
+    std::vector<size_t>   index;
+    std::vector<float>    c_x;
+    std::vector<float>    c_y;
+    std::vector<double>   c_xd;
+    std::vector<double>   c_yd;
+    std::vector<uint16_t> counts;
+};
+
+static void probe_points(const RenderParams& params, const double* c_x, const double* c_y,
+                         uint16_t* counts, int n)
+{
+#pragma omp parallel for schedule(dynamic, 1) num_threads(params.nThreads)
+    for (int i = 0; i < n; i += PROBE_CHUNK)
+        mandelbrot_double_points(params, c_x + i, c_y + i, counts + i, std::min(PROBE_CHUNK, n - i));
+}
+
+// The lowest of params.maxIterations doubled until it passes count
+static int depth_above(const RenderParams& params, int count)
+{
+    int depth = params.maxIterations;
+    while (depth <= count && depth < MAX_ITERATION_LIMIT)
+        depth *= 2;
+
+    return std::min(depth, MAX_ITERATION_LIMIT);
+}
+
+AutoDepth mandelbrot_auto_depth(const RenderParams& params, double scale,
+                                const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    std::vector<double> columnC_x(params.width);
+    std::vector<double> rowC_y(params.height);
+    mandelbrot_double_coords(params, scale, bf_to_double(shiftX), bf_to_double(shiftY),
+                             columnC_x.data(), rowC_y.data());
+
+    const int stride = std::max(AUTO_PROBE_STRIDE,
+                                std::max(params.width, params.height) / AUTO_PROBE_MAX_SAMPLES);
+
+    // Centered in their cells, at least one for tiny frames
+    std::vector<double> c_x;
+    std::vector<double> c_y;
+    for (int y = std::min(stride / 2, params.height / 2); y < params.height; y += stride)
+        for (int x = std::min(stride / 2, params.width / 2); x < params.width; x += stride)
+        {
+            c_x.push_back(columnC_x[x]);
+            c_y.push_back(rowC_y[y]);
+        }
+
+    RenderParams probe = params;
+    std::vector<uint16_t> counts(c_x.size());
+    probe_points(probe, c_x.data(), c_y.data(), counts.data(), (int)counts.size());
+
+    // Samples still at the limit get 4x the iterations, for as long as
+    // some of them escape within the new ones
+    std::vector<int> escaped;
+    for (;;)
+    {
+        size_t nPending = 0;
+        bool   anyEscaped = false;
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            if (counts[i] < probe.maxIterations)
+            {
+                escaped.push_back(counts[i]);
+                anyEscaped = true;
+                continue;
+            }
+
+            c_x[nPending] = c_x[i];
+            c_y[nPending] = c_y[i];
+            nPending++;
+        }
+
+        // The first pass always goes on, samples past the default depth
+        // are what the probe is for
+        const bool firstPass = probe.maxIterations == params.maxIterations;
+        if (nPending == 0 || (!anyEscaped && !firstPass) || probe.maxIterations >= MAX_ITERATION_LIMIT)
+            break;
+
+        probe.maxIterations = std::min(probe.maxIterations * 4, MAX_ITERATION_LIMIT);
+        counts.resize(nPending);
+        probe_points(probe, c_x.data(), c_y.data(), counts.data(), (int)nPending);
+    }
+
+    if (escaped.empty())
+        return { params.maxIterations, params.maxIterations };
+
+    std::sort(escaped.begin(), escaped.end());
+    const int p90 = escaped[(escaped.size() - 1) * 90 / 100];
+    const int p99 = escaped[(escaped.size() - 1) * 99 / 100];
+
+    // The pixels between the samples go deeper, twice the headroom
+    return { depth_above(params, p90), depth_above(params, 2 * p99) };
+}
+
+// Iterates the limit pixels of a boundary tile again at the full depth
+// and takes those of a tile without escaped pixels as interior
+static void refine_tile(const RenderParams& params, int baseIterations, ProgressiveKernel kernel,
+                        const std::vector<float>&  columnC_x, const std::vector<float>&  rowC_y,
+                        const std::vector<double>& columnC_xd, const std::vector<double>& rowC_yd,
+                        uint16_t* iterations, int x_from, int x_to, int y_from, int y_to)
+{
+    static thread_local TileBatch batch;
+
+    batch.index.clear();
+    bool escaped = false;
+    for (int y = y_from; y < y_to; y++)
+        for (int x = x_from; x < x_to; x++)
+        {
+            const size_t index = (size_t)y * params.width + x;
+            if (iterations[index] == baseIterations)
+                batch.index.push_back(index);
+            else
+                escaped = true;
+        }
+
+    const int n = (int)batch.index.size();
+    if (n == 0)
+        return;
+
+    if (!escaped)
+    {
+        for (size_t index : batch.index)
+            iterations[index] = (uint16_t)params.maxIterations;
+        return;
+    }
+
+    batch.counts.resize(n);
+    if (kernel == PROGRESSIVE_FLOAT)
+    {
+        batch.c_x.resize(n);
+        batch.c_y.resize(n);
+        for (int i = 0; i < n; i++)
+        {
+            batch.c_x[i] = columnC_x[batch.index[i] % params.width];
+            batch.c_y[i] = rowC_y   [batch.index[i] / params.width];
+        }
+        mandelbrot_vectorized_points(params, batch.c_x.data(), batch.c_y.data(),
+                                     batch.counts.data(), n);
+    }
+    else
+    {
+        batch.c_xd.resize(n);
+        batch.c_yd.resize(n);
+        for (int i = 0; i < n; i++)
+        {
+            batch.c_xd[i] = columnC_xd[batch.index[i] % params.width];
+            batch.c_yd[i] = rowC_yd   [batch.index[i] / params.width];
+        }
+        mandelbrot_double_points(params, batch.c_xd.data(), batch.c_yd.data(),
+                                 batch.counts.data(), n);
+    }
+
+    for (int i = 0; i < n; i++)
+        iterations[batch.index[i]] = batch.counts[i];
+}
+
+void mandelbrot_auto_refine(sf::Uint8* pixels, const RenderParams& params, int baseIterations,
+                            ProgressiveKernel kernel, double scale,
+                            const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    uint16_t* iterations = mandelbrot_iterations(params);
+
+    if (params.maxIterations > baseIterations)
+    {
+        // The coordinates the frame was rendered with, as in progressive
+        std::vector<float>  columnC_x;
+        std::vector<float>  rowC_y;
+        std::vector<double> columnC_xd;
+        std::vector<double> rowC_yd;
+        if (kernel == PROGRESSIVE_FLOAT)
+        {
+            columnC_x.resize(params.width);
+            rowC_y   .resize(params.height);
+            mandelbrot_vectorized_coords(params, (float)scale, (float)bf_to_double(shiftX),
+                                         columnC_x.data(), rowC_y.data());
+        }
+        else
+        {
+            columnC_xd.resize(params.width);
+            rowC_yd   .resize(params.height);
+            mandelbrot_double_coords(params, scale, bf_to_double(shiftX), bf_to_double(shiftY),
+                                     columnC_xd.data(), rowC_yd.data());
+        }
+
+        const int nTilesX = (params.width  + AUTO_TILE_SIZE - 1) / AUTO_TILE_SIZE;
+        const int nTilesY = (params.height + AUTO_TILE_SIZE - 1) / AUTO_TILE_SIZE;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(params.nThreads)
+        for (int tile = 0; tile < nTilesX * nTilesY; tile++)
+        {
+            const int x_from = tile % nTilesX * AUTO_TILE_SIZE;
+            const int y_from = tile / nTilesX * AUTO_TILE_SIZE;
+            refine_tile(params, baseIterations, kernel, columnC_x, rowC_y, columnC_xd, rowC_yd,
+                        iterations, x_from, std::min(x_from + AUTO_TILE_SIZE, params.width),
+                        y_from, std::min(y_from + AUTO_TILE_SIZE, params.height));
+        }
+    }
+
+    // The base render colorized with the palette of its own depth
+    mandelbrot_colorize(pixels, params);
+}
@@ -0,0 +1,310 @@
+#include "mandelbrot_autotune.h"
+#include "mandelbrot_backends.h"
+#include "mandelbrot_bench.h"
+#include "mandelbrot_frame_buffer.h"
+#include "mandelbrot_numa.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+static const char PROFILE_MAGIC[] = "mandelbrot-tune 1";
+
+std::string mandelbrot_tune_machine()
+{
+    std::string model = "unknown CPU";
+
+    FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (cpuinfo)
+    {
+        char line[512];
+        while (fgets(line, sizeof(line), cpuinfo))
+        {
+            const char* colon = strchr(line, ':');
+            if (strncmp(line, "model name", 10) != 0 || !colon)
+                continue;
+
+            model = colon + 1 + strspn(colon + 1, " \t");
+            model.erase(model.find_last_not_of(" \t\n") + 1);
+            break;
+        }
+        fclose(cpuinfo);
+    }
+
+    return model + ", " + std::to_string(std::thread::hardware_concurrency()) + " CPUs";
+}
+
+// Mean iteration count of every TUNE_SAMPLE_STEP-th pixel of the last frame
+static double frame_cost(const RenderParams& params)
+{
+    const uint16_t* iterations = mandelbrot_iterations(params);
+    const size_t    nPixels    = (size_t)params.width * params.height;
+
+    double total    = 0;
+    size_t nSamples = 0;
+    for (size_t i = 0; i < nPixels; i += TUNE_SAMPLE_STEP, nSamples++)
+        total += std::min((int)iterations[i], params.maxIterations);
+
+    return nSamples > 0 ? total / nSamples : 0;
+}
+
+static double median_frame_ms(sf::Uint8* pixels, const RenderParams& params,
+                              MandelbrotFunc func, const BenchViewport& viewport)
+{
+    for (int i = 0; i < TUNE_WARMUP; i++)
+        func(pixels, params, viewport.magnifier, viewport.shiftX);
+
+    std::vector<double> frameMs(TUNE_FRAMES);
+    for (int i = 0; i < TUNE_FRAMES; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        func(pixels, params, viewport.magnifier, viewport.shiftX);
+        frameMs[i] = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::sort(frameMs.begin(), frameMs.end());
+    return frameMs[TUNE_FRAMES / 2];
+}
+
+void mandelbrot_autotune(const RenderParams& params, TuneProfile* profile)
+{
+    profile->machine       = mandelbrot_tune_machine();
+    profile->width         = params.width;
+    profile->height        = params.height;
+    profile->maxIterations = params.maxIterations;
+    profile->settings.clear();
+
+    const std::vector<int> threadCounts = mandelbrot_numa_scaling_threads();
+
+    sf::Uint8* pixels = (sf::Uint8*)mandelbrot_frame_buffer_alloc(params.width * 4, params.height,
+                                                                  threadCounts.back());
+
+    for (int v = 0; v < N_BENCH_VIEWPORTS; v++)
+    {
+        const BenchViewport& viewport = BENCH_VIEWPORTS[v];
+
+        TuneSetting best = { viewport.name, 0, "", 0, 0, 0 };
+        int nCandidates = 0;
+
+        for (int b = 0; b < N_BACKENDS; b++)
+        {
+            const MandelbrotBackend& backend = BACKENDS[b];
+            if (!backend.parallel || !backend.func)
+                continue;
+
+            // The default first, then every listed chunk
+            std::vector<int> chunks(1, 0);
+            for (const int* chunk = backend.chunks; chunk && *chunk; chunk++)
+                chunks.push_back(*chunk);
+
+            for (int nThreads : threadCounts)
+                for (int chunk : chunks)
+                {
+                    RenderParams candidate = params;
+                    candidate.nThreads = nThreads;
+                    if (backend.setChunk)
+                        backend.setChunk(chunk);
+
+                    const double ms = median_frame_ms(pixels, candidate, backend.func, viewport);
+                    nCandidates++;
+
+                    if (best.backend.empty() || ms < best.medianMs)
+                    {
+                        best.cost     = frame_cost(candidate);
+                        best.backend  = backend.name;
+                        best.nThreads = nThreads;
+                        best.chunk    = chunk;
+                        best.medianMs = ms;
+                    }
+                }
+
+            if (backend.setChunk)
+                backend.setChunk(0);
+        }
+
+        printf("%-10s cost %8.2f: %s, %d threads, chunk %d, %.3f ms (%d candidates)\n",
+               viewport.name, best.cost, best.backend.c_str(), best.nThreads, best.chunk,
+               best.medianMs, nCandidates);
+        profile->settings.push_back(best);
+    }
+
+    mandelbrot_frame_buffer_free(pixels);
+
+    std::sort(profile->settings.begin(), profile->settings.end(),
+              [](const TuneSetting& a, const TuneSetting& b) { return a.cost < b.cost; });
+}
+
+bool mandelbrot_tune_save(const char* path, const TuneProfile& profile)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "%s\nmachine %s\nwidth %d\nheight %d\niterations %d\n", PROFILE_MAGIC,
+            profile.machine.c_str(), profile.width, profile.height, profile.maxIterations);
+
+    for (const TuneSetting& setting : profile.settings)
+        fprintf(file, "setting %s %.6g %s %d %d %.6g\n", setting.viewport.c_str(), setting.cost,
+                setting.backend.c_str(), setting.nThreads, setting.chunk, setting.medianMs);
+
+    return fclose(file) == 0;
+}
+
+int mandelbrot_tune_load(const char* path, TuneProfile* profile)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return 0;
+
+    *profile = TuneProfile();
+
+    char line[512];
+    bool valid = fgets(line, sizeof(line), file) &&
+                 strncmp(line, PROFILE_MAGIC, strlen(PROFILE_MAGIC)) == 0;
+
+    while (valid && fgets(line, sizeof(line), file))
+    {
+        char viewport[64], backend[64];
+        TuneSetting setting;
+
+        if (strncmp(line, "machine ", 8) == 0)
+        {
+            profile->machine = line + 8;
+            profile->machine.erase(profile->machine.find_last_not_of("\n") + 1);
+        }
+        else if (sscanf(line, "width %d",      &profile->width)         == 1 ||
+                 sscanf(line, "height %d",     &profile->height)        == 1 ||
+                 sscanf(line, "iterations %d", &profile->maxIterations) == 1)
+            continue;
+        else if (sscanf(line, "setting %63s %lf %63s %d %d %lf", viewport, &setting.cost, backend,
+                        &setting.nThreads, &setting.chunk, &setting.medianMs) == 6 &&
+                 mandelbrot_find_backend(backend) && setting.nThreads > 0)
+        {
+            setting.viewport = viewport;
+            setting.backend  = backend;
+            profile->settings.push_back(setting);
+        }
+        else
+            valid = false;
+    }
+    fclose(file);
+
+    if (!valid || profile->settings.empty())
+        return -1;
+
+    std::sort(profile->settings.begin(), profile->settings.end(),
+              [](const TuneSetting& a, const TuneSetting& b) { return a.cost < b.cost; });
+    return 1;
+}
+
+void mandelbrot_tune_print(FILE* file, const TuneProfile& profile)
+{
+    fprintf(file, "Tuned on %s at %dx%d, %d iterations\n", profile.machine.c_str(),
+            profile.width, profile.height, profile.maxIterations);
+
+    for (const TuneSetting& setting : profile.settings)
+        fprintf(file, "  cost %8.2f (%s): %s, %d threads, chunk %d, %.3f ms\n",
+                setting.cost, setting.viewport.c_str(), setting.backend.c_str(),
+                setting.nThreads, setting.chunk, setting.medianMs);
+}
+
+//------------------------------------------------------------------------------
+// The tuned backend
+//------------------------------------------------------------------------------
+
+static TuneProfile tunedProfile;
+
+// Index of the setting in use, the frame cost it was picked at and the
+// cost of the last frame
+static int    current    = -1;
+static double switchCost = 0;
+static double lastCost   = 0;
+
+static int nFrames   = 0;
+static int nSwitches = 0;
+
+void mandelbrot_tuned_use(const TuneProfile& profile, const RenderParams& params)
+{
+    const std::string machine = mandelbrot_tune_machine();
+    if (profile.machine != machine)
+        fprintf(stderr, "The profile was tuned on %s, this is %s\n",
+                profile.machine.c_str(), machine.c_str());
+
+    if (profile.width != params.width || profile.height != params.height ||
+        profile.maxIterations != params.maxIterations)
+        fprintf(stderr, "The profile was tuned at %dx%d with %d iterations\n",
+                profile.width, profile.height, profile.maxIterations);
+
+    tunedProfile = profile;
+    current      = profile.settings.empty() ? -1 : 0;
+    switchCost   = current < 0 ? 0 : profile.settings[0].cost;
+    nSwitches    = 0;
+}
+
+// Index of the setting closest in log cost, the cost is a ratio
+static int nearest_setting(double cost)
+{
+    const double logCost = std::log(std::max(cost, 1.0));
+
+    int nearest = 0;
+    for (int i = 1; i < (int)tunedProfile.settings.size(); i++)
+        if (std::abs(std::log(std::max(tunedProfile.settings[i].cost, 1.0)) - logCost) <
+            std::abs(std::log(std::max(tunedProfile.settings[nearest].cost, 1.0)) - logCost))
+            nearest = i;
+
+    return nearest;
+}
+
+void mandelbrot_tuned(sf::Uint8* pixels, const RenderParams& params,
+                      float magnifier, float shiftX)
+{
+    nFrames++;
+
+    if (current < 0)
+    {
+        mandelbrot_thread_pool(pixels, params, magnifier, shiftX);
+        return;
+    }
+
+    const TuneSetting&       setting = tunedProfile.settings[current];
+    const MandelbrotBackend* backend = mandelbrot_find_backend(setting.backend.c_str());
+
+    RenderParams tuned = params;
+    tuned.nThreads = setting.nThreads;
+    if (backend->setChunk)
+        backend->setChunk(setting.chunk);
+
+    backend->func(pixels, tuned, magnifier, shiftX);
+
+    // The next frame is most likely a view close to this one
+    lastCost = frame_cost(params);
+
+    const int nearest = nearest_setting(lastCost);
+    if (nearest != current && (lastCost > switchCost * TUNE_SWITCH_RATIO ||
+                               lastCost < switchCost / TUNE_SWITCH_RATIO))
+    {
+        current    = nearest;
+        switchCost = lastCost;
+        nSwitches++;
+    }
+}
+
+void mandelbrot_tuned_print_stats(FILE* file)
+{
+    if (current < 0)
+    {
+        fprintf(file, "tuned: no profile, rendered %d frames as the thread-pool\n", nFrames);
+        return;
+    }
+
+    const TuneSetting& setting = tunedProfile.settings[current];
+    fprintf(file, "tuned: %s, %d threads, chunk %d (tuned at cost %.2f), "
+                  "last frame cost %.2f, %d switches in %d frames\n",
+            setting.backend.c_str(), setting.nThreads, setting.chunk, setting.cost,
+            lastCost, nSwitches, nFrames);
+}
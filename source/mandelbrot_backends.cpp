@@ -0,0 +1,187 @@
+#include "mandelbrot_backends.h"
+
+#include <cstring>
+
+#include "mandelbrot_naive.h"
+#include "mandelbrot_vectorized.h"
+#include "mandelbrot_arrayed.h"
+#include "mandelbrot_interleaved.h"
+#include "mandelbrot_openmp.h"
+#include "mandelbrot_thread_pool.h"
+#include "mandelbrot_numa.h"
+#include "mandelbrot_double.h"
+#include "mandelbrot_double_double.h"
+#include "mandelbrot_fixed.h"
+#include "mandelbrot_deep.h"
+#include "mandelbrot_perturbation.h"
+#include "mandelbrot_mariani_silver.h"
+#include "mandelbrot_autotune.h"
+#include "mandelbrot_fractal.h"
+#ifdef GPU
+#include <cuda_runtime.h>
+#include "mandelbrot_cuda.h"
+#endif
+
+#ifdef GPU
+// Kept across frames, reallocated when the frame size changes
+sf::Uint8* mandelbrot_cuda_device_pixels(const RenderParams& params)
+{
+    static sf::Uint8* d_pixels = NULL;
+    static size_t     d_size   = 0;
+
+    const size_t size = (size_t)params.width * params.height * 4 * sizeof(sf::Uint8);
+    if (d_size != size)
+    {
+        cudaFree(d_pixels);
+        cudaMalloc(&d_pixels, size);
+        d_size = size;
+    }
+
+    return d_pixels;
+}
+
+static void mandelbrot_cuda_no_cpy_host(sf::Uint8* pixels, const RenderParams& params,
+                                        float magnifier, float shiftX)
+{
+    mandelbrot_cuda_no_cpy(mandelbrot_cuda_device_pixels(params), params, magnifier, shiftX);
+    cudaDeviceSynchronize();
+    (void) pixels;
+}
+#endif
+
+static void mandelbrot_double_deep(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                                   const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    mandelbrot_double(pixels, params, magnifier, bf_to_double(shiftX), bf_to_double(shiftY));
+}
+
+static void mandelbrot_double_double_deep(sf::Uint8* pixels, const RenderParams& params,
+                                          double magnifier,
+                                          const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    mandelbrot_double_double(pixels, params, magnifier, bf_to_dd(shiftX), bf_to_dd(shiftY));
+}
+
+static void mandelbrot_perturbation_deep(sf::Uint8* pixels, const RenderParams& params,
+                                         double magnifier,
+                                         const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    mandelbrot_perturbation(pixels, params, magnifier, shiftX, shiftY);
+}
+
+// Minimum rows per OpenMP chunk
+static const int OPENMP_CHUNKS[]      = { 4, 16, 0 };
+// Tile heights of the thread-pool, fixed instead of adapting
+static const int THREAD_POOL_CHUNKS[] = { 136, 64, 16, 0 };
+
+// One helper per kind of backend, so every entry below says what it is
+// instead of listing three flags in a row
+
+// Float kernels of the Mandelbrot set on the calling thread; naive and
+// the FMA chains of interleaved round differently from vectorized
+static constexpr MandelbrotBackend serial_backend(const char* name, MandelbrotFunc func,
+                                                  bool sameAsVectorized)
+{
+    MandelbrotBackend backend = {};
+    backend.name             = name;
+    backend.func             = func;
+    backend.cached           = true;
+    backend.sameAsVectorized = sameAsVectorized;
+    return backend;
+}
+
+// Float renders of any fractal on params.nThreads threads, tried by the autotuner
+static constexpr MandelbrotBackend parallel_backend(const char* name, MandelbrotFunc func,
+                                                    MandelbrotChunkFunc setChunk   = NULL,
+                                                    const int*          chunks     = NULL,
+                                                    MandelbrotStatsFunc printStats = NULL)
+{
+    MandelbrotBackend backend = {};
+    backend.name             = name;
+    backend.func             = func;
+    backend.cached           = true;
+    backend.parallel         = true;
+    backend.fractals         = true;
+    backend.sameAsVectorized = true;
+    backend.setChunk         = setChunk;
+    backend.chunks           = chunks;
+    backend.printStats       = printStats;
+    return backend;
+}
+
+// Float renders of any fractal that pick their own threads
+static constexpr MandelbrotBackend fractal_backend(const char* name, MandelbrotFunc func,
+                                                   MandelbrotStatsFunc printStats = NULL)
+{
+    MandelbrotBackend backend = {};
+    backend.name             = name;
+    backend.func             = func;
+    backend.cached           = true;
+    backend.fractals         = true;
+    backend.sameAsVectorized = true;
+    backend.printStats       = printStats;
+    return backend;
+}
+
+// Views of the Mandelbrot set off the real axis, at any depth
+static constexpr MandelbrotBackend deep_backend(const char* name, MandelbrotDeepFunc deepFunc)
+{
+    MandelbrotBackend backend = {};
+    backend.name     = name;
+    backend.deepFunc = deepFunc;
+    backend.cached   = true;
+    return backend;
+}
+
+#ifdef GPU
+// Renders on the device, no iteration counts on the host
+static constexpr MandelbrotBackend device_backend(const char* name, MandelbrotFunc func)
+{
+    MandelbrotBackend backend = {};
+    backend.name = name;
+    backend.func = func;
+    return backend;
+}
+#endif
+
+const MandelbrotBackend BACKENDS[] =
+{
+#ifdef GPU
+    device_backend  ("cuda_no_cpy",         mandelbrot_cuda_no_cpy_host),
+    device_backend  ("cuda",                mandelbrot_cuda),
+#endif
+    serial_backend  ("naive",               mandelbrot_naive, false),
+    serial_backend  ("vectorized",          mandelbrot_vectorized, true),
+    serial_backend  ("arrayed",             mandelbrot_arrayed, true),
+    serial_backend  ("interleaved",         mandelbrot_interleaved<INTERLEAVED_CHAINS>, false),
+    serial_backend  ("interleaved-1",       mandelbrot_interleaved<1>, false),
+    serial_backend  ("interleaved-3",       mandelbrot_interleaved<3>, false),
+    serial_backend  ("interleaved-4",       mandelbrot_interleaved<4>, false),
+    parallel_backend("openmp",              mandelbrot_openmp,
+                     mandelbrot_openmp_chunk_rows, OPENMP_CHUNKS),
+    parallel_backend("thread-pool",         mandelbrot_thread_pool,
+                     mandelbrot_thread_pool_tile_height, THREAD_POOL_CHUNKS,
+                     mandelbrot_thread_pool_print_stats),
+    parallel_backend("numa",                mandelbrot_numa,
+                     NULL, NULL, mandelbrot_numa_print_stats),
+    parallel_backend("mariani-silver",      mandelbrot_mariani_silver),
+    parallel_backend("mariani-silver-pool", mandelbrot_mariani_silver_pool),
+    fractal_backend ("fractal",             mandelbrot_fractal_render),
+    fractal_backend ("tuned",               mandelbrot_tuned, mandelbrot_tuned_print_stats),
+    deep_backend    ("double",              mandelbrot_double_deep),
+    deep_backend    ("fixed64",             mandelbrot_fixed64),
+    deep_backend    ("double-double",       mandelbrot_double_double_deep),
+    deep_backend    ("perturbation",        mandelbrot_perturbation_deep),
+    deep_backend    ("deep",                mandelbrot_deep),
+};
+
+const int N_BACKENDS = sizeof(BACKENDS) / sizeof(BACKENDS[0]);
+
+const MandelbrotBackend* mandelbrot_find_backend(const char* name)
+{
+    for (int i = 0; i < N_BACKENDS; i++)
+        if (strcmp(BACKENDS[i].name, name) == 0)
+            return &BACKENDS[i];
+
+    return NULL;
+}
@@ -0,0 +1,38 @@
+#include "mandelbrot_bands.h"
+#include "mandelbrot_palette.h"
+
+#include <algorithm>
+#include <cstring>
+#include <omp.h>
+#include <vector>
+
+void mandelbrot_bands(MandelbrotDeepFunc func, sf::Uint8* pixels, const RenderParams& params,
+                      double scale, const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    uint16_t* iterations = mandelbrot_iterations(params);
+
+    // Every thread colors with the palette of the view
+    const int paletteOffset = mandelbrot_palette(params).offset;
+    std::vector<RenderContext> contexts(params.nThreads);
+    for (RenderContext& context : contexts)
+        mandelbrot_palette_cycle(&context, paletteOffset);
+
+    const int nBands = (params.height + BAND_ROWS - 1) / BAND_ROWS;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(params.nThreads)
+    for (int band = 0; band < nBands; band++)
+    {
+        const int y_from = band * BAND_ROWS;
+
+        // A window of the view of params, which may itself be one
+        RenderParams bandParams = window_params(params, 0, y_from, params.width,
+                                                std::min(BAND_ROWS, params.height - y_from));
+        bandParams.nThreads = 1;
+        bandParams.context  = &contexts[omp_get_thread_num()];
+
+        func(pixels + (size_t)y_from * params.width * 4, bandParams, scale, shiftX, shiftY);
+
+        memcpy(iterations + (size_t)y_from * params.width, mandelbrot_iterations(bandParams),
+               (size_t)bandParams.height * params.width * sizeof(uint16_t));
+    }
+}
@@ -0,0 +1,205 @@
+#include "mandelbrot_batch.h"
+#include "mandelbrot_antialias.h"
+#include "mandelbrot_bands.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_frame_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+static const char CHECKPOINT_MAGIC[] = "mandelbrot-checkpoint 3";
+
+// The sign and every limb in hex, exact unlike a decimal of a few digits
+static std::string big_fixed_key(const BigFixed& value)
+{
+    std::string key = value.negative ? "-" : "+";
+
+    char limb[16] = "";
+    for (int i = 0; i < BIG_FIXED_LIMBS; i++)
+    {
+        snprintf(limb, sizeof(limb), "%08x", value.limbs[i]);
+        key += limb;
+    }
+
+    return key;
+}
+
+// Everything that must match for a checkpoint to be continued, one
+// "key value" per line followed by the file state. The strip height need
+// not, strips are windows of the image.
+static std::string job_key(const BatchJob& job, const RenderParams& params)
+{
+    char key[512] = "";
+    snprintf(key, sizeof(key),
+             "mode %s\nformat %s\nwidth %d\nheight %d\niterations %d\nradius %.9g\n"
+             "scale %.17g\naa %d\n",
+             job.modeName, mandelbrot_image_format_name(job.format),
+             params.width, params.height, params.maxIterations, params.maxRadius,
+             job.scale, job.aaSamples);
+
+    return std::string(key) + "shift_x " + big_fixed_key(job.shiftX) + "\n" +
+                              "shift_y " + big_fixed_key(job.shiftY) + "\n";
+}
+
+static bool save_checkpoint(const std::string& path, const std::string& key,
+                            const ImageFileState& state)
+{
+    // Written aside and renamed, so a crash leaves the old checkpoint
+    const std::string temporary = path + ".tmp";
+
+    FILE* file = fopen(temporary.c_str(), "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "%s\n%srows_done %d\noffset %llu\nadler %u\n",
+            CHECKPOINT_MAGIC, key.c_str(), state.rowsDone,
+            (unsigned long long)state.offset, state.adler);
+
+    const bool ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+
+    return ok && rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+// 1 if path holds a checkpoint of this job, 0 if there is none,
+// -1 if it belongs to another job or cannot be read
+static int load_checkpoint(const std::string& path, const std::string& key,
+                           ImageFileState* state)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file)
+        return 0;
+
+    std::string contents;
+    char buffer[512];
+    size_t size = 0;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        contents.append(buffer, size);
+    fclose(file);
+
+    const std::string expected = std::string(CHECKPOINT_MAGIC) + "\n" + key;
+    if (contents.compare(0, expected.size(), expected) != 0)
+        return -1;
+
+    unsigned long long offset = 0;
+    if (sscanf(contents.c_str() + expected.size(), "rows_done %d offset %llu adler %u",
+               &state->rowsDone, &offset, &state->adler) != 3)
+        return -1;
+
+    state->offset = offset;
+    return 1;
+}
+
+int mandelbrot_batch_render(const BatchJob& job, const RenderParams& params)
+{
+    const std::string checkpointPath = std::string(job.output) + ".checkpoint";
+    const std::string key            = job_key(job, params);
+
+    ImageFile      image = {};
+    ImageFileState state = {};
+
+    const int found = load_checkpoint(checkpointPath, key, &state);
+    if (found < 0)
+    {
+        fprintf(stderr, "%s belongs to another job, remove it to start over\n",
+                checkpointPath.c_str());
+        return 1;
+    }
+
+    if (found)
+    {
+        if (!mandelbrot_image_resume(&image, job.output, job.format,
+                                     params.width, params.height, state))
+        {
+            fprintf(stderr, "Can't resume %s\n", job.output);
+            return 1;
+        }
+        printf("Resuming %s at row %d\n", job.output, state.rowsDone);
+    }
+    else if (!mandelbrot_image_create(&image, job.output, job.format, params.width, params.height))
+    {
+        fprintf(stderr, "Can't create %s\n", job.output);
+        return 1;
+    }
+
+    // The rows above and below a strip anti-aliasing compares it with
+    const int apron = job.aaSamples > 1 ? 1 : 0;
+
+    sf::Uint8* pixels = (sf::Uint8*)mandelbrot_frame_buffer_alloc(params.width * 4,
+                                                                  job.stripRows + 2 * apron,
+                                                                  params.nThreads);
+
+    const auto start = std::chrono::steady_clock::now();
+    const int  firstRow = image.state.rowsDone;
+
+    AntialiasStats aaStats = {};
+    double         aaSeconds = 0;
+
+    bool ok = true;
+    while (ok && image.state.rowsDone < params.height)
+    {
+        const int y_from = image.state.rowsDone;
+        const int nRows  = std::min(job.stripRows, params.height - y_from);
+
+        // The strip and its apron rows, as far as the image goes
+        const int top    = std::min(apron, y_from);
+        const int bottom = std::min(apron, params.height - y_from - nRows);
+
+        // Every strip is a window of the image, so its pixels do not
+        // depend on the strip height or where a resumed render starts
+        const RenderParams stripParams = window_params(params, 0, y_from - top, params.width,
+                                                       top + nRows + bottom);
+
+        mandelbrot_bands(job.func, pixels, stripParams, job.scale, job.shiftX, job.shiftY);
+
+        if (apron)
+        {
+            const auto aaStart = std::chrono::steady_clock::now();
+            mandelbrot_antialias(pixels, stripParams, job.aaSamples, PROGRESSIVE_DOUBLE,
+                                 job.scale, job.shiftX, job.shiftY, top, top + nRows, &aaStats);
+            aaSeconds += std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - aaStart).count();
+        }
+
+        ok = mandelbrot_image_write_rows(&image, pixels + (size_t)top * params.width * 4, nRows) &&
+             mandelbrot_image_sync(&image)                      &&
+             save_checkpoint(checkpointPath, key, image.state);
+
+        const double seconds = std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() - start).count();
+        const int    rowsDone = image.state.rowsDone - firstRow;
+        printf("\r%s: %d / %d rows, %.1f s, %.2f Mpix/s", job.output,
+               image.state.rowsDone, params.height, seconds,
+               (double)params.width * rowsDone / seconds / 1e6);
+        fflush(stdout);
+    }
+    printf("\n");
+
+    if (aaStats.nPixels > 0)
+    {
+        const double seconds = std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() - start).count();
+        printf("Anti-aliasing: %.2f%% of the pixels supersampled, %.3f subsamples per pixel "
+               "(%d for all), %.1f%% of the time\n",
+               100.0 * aaStats.nEdgePixels / aaStats.nPixels,
+               (double)aaStats.nSubsamples / aaStats.nPixels, job.aaSamples,
+               100.0 * aaSeconds / seconds);
+    }
+
+    mandelbrot_frame_buffer_free(pixels);
+
+    if (!ok || !mandelbrot_image_finish(&image))
+    {
+        mandelbrot_image_close(&image);
+        fprintf(stderr, "Can't write %s\n", job.output);
+        return 1;
+    }
+
+    remove(checkpointPath.c_str());
+    return 0;
+}
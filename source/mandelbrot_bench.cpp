@@ -0,0 +1,276 @@
+#include "mandelbrot_bench.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_fractal.h"
+#include "mandelbrot_numa.h"
+#include "mandelbrot_profile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <x86intrin.h>
+
+const BenchViewport BENCH_VIEWPORTS[] =
+{
+    // Whole set, the default interactive view
+    { "full",      1.0f,     0.0f      },
+    // Neck between the main cardioid and the period-2 bulb at -0.75
+    { "seahorse",  20.0f,   -0.25f     },
+    // Feigenbaum point, boundary-heavy and close to the float limit
+    { "boundary",  2000.0f, -0.901155f },
+    // Centered at -0.15 inside the main cardioid, every pixel is black
+    { "interior",  20.0f,    0.35f     },
+};
+
+const int N_BENCH_VIEWPORTS = sizeof(BENCH_VIEWPORTS) / sizeof(BENCH_VIEWPORTS[0]);
+
+// Nominal iterations of the viewport: the escape counts of every pixel
+// with the float arithmetic of mandelbrot_naive, interior pixels at the
+// full depth. This is the work of a kernel without shortcuts, not the
+// steps a mode takes: interior checks, periodicity and guessed areas
+// skip most of them, so the same figure serves every mode as a measure
+// of the image. Other fractals are counted by the engine that renders
+// them.
+static uint64_t count_nominal_iterations(const RenderParams& params, float magnifier, float shiftX)
+{
+    if (!mandelbrot_fractal_is_mandelbrot())
+        return mandelbrot_fractal_iterations(params, magnifier, shiftX);
+
+    const float aspect      = aspect_ratio(params);
+    const float max_radius2 = max_radius_2(params);
+
+    shiftX    += SHIFT_X_OFFSET;
+    magnifier += MAGNIFIER_OFFSET;
+
+    const float inv_magnifier = 1.0f / magnifier;
+
+    const float pixel_step_x = aspect * inv_magnifier * (2.0f / params.width);
+    const float pixel_step_y = inv_magnifier          * (2.0f / params.height);
+
+    uint64_t total = 0;
+
+#pragma omp parallel for schedule(guided, 1) reduction(+:total) num_threads(params.nThreads)
+    for (int screen_y = 0; screen_y < params.height; screen_y++)
+    {
+        const float c_y = -1.0f * inv_magnifier + pixel_step_y * screen_y;
+        float c_x = shiftX - aspect * inv_magnifier;
+
+        for (int screen_x = 0; screen_x < params.width; screen_x++,
+                                                        c_x += pixel_step_x)
+        {
+            int iterations = 0;
+
+            float z_x  = 0.0f;
+            float z_y  = 0.0f;
+            float z_x2 = 0.0f;
+            float z_y2 = 0.0f;
+
+            while (z_x2 + z_y2 < max_radius2 &&
+                   iterations < params.maxIterations)
+            {
+                z_y = 2 * z_x * z_y + c_y;
+                z_x = z_x2 - z_y2 + c_x;
+
+                z_x2 = z_x * z_x;
+                z_y2 = z_y * z_y;
+
+                ++iterations;
+            }
+
+            total += iterations;
+        }
+    }
+
+    return total;
+}
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+template <typename Render>
+static void bench_viewports(Render render, const RenderParams& params, const char* name,
+                            int nWarmup, int nFrames, std::vector<BenchResult>* results)
+{
+    if (nFrames < 1)
+        nFrames = 1;
+
+    std::vector<double> frameMs(nFrames);
+
+    for (int v = 0; v < N_BENCH_VIEWPORTS; v++)
+    {
+        const BenchViewport& view = BENCH_VIEWPORTS[v];
+
+        for (int i = 0; i < nWarmup; i++)
+        {
+            mandelbrot_profile_frame_begin(name, view.name);
+            render(view);
+            mandelbrot_profile_frame_end();
+        }
+
+        uint64_t totalCycles = 0;
+        for (int i = 0; i < nFrames; i++)
+        {
+            mandelbrot_profile_frame_begin(name, view.name);
+
+            auto     start      = std::chrono::steady_clock::now();
+            uint64_t startCycle = __rdtsc();
+
+            render(view);
+
+            totalCycles += __rdtsc() - startCycle;
+            frameMs[i] = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start).count();
+
+            mandelbrot_profile_frame_end();
+        }
+
+        std::vector<double> sorted = frameMs;
+        std::sort(sorted.begin(), sorted.end());
+
+        double totalMs = 0;
+        for (double ms : frameMs)
+            totalMs += ms;
+
+        BenchResult result = {};
+        result.mode     = name;
+        result.viewport = view.name;
+        result.params   = params;
+        result.nFrames  = nFrames;
+
+        result.minMs    = sorted.front();
+        result.medianMs = percentile(sorted, 0.50);
+        result.p95Ms    = percentile(sorted, 0.95);
+        result.p99Ms    = percentile(sorted, 0.99);
+        result.meanMs   = totalMs / nFrames;
+
+        result.nominalIterationsPerFrame = count_nominal_iterations(params, view.magnifier,
+                                                                   view.shiftX);
+
+        const double totalSec    = totalMs / 1000.0;
+        const double totalPixels = (double)params.width * params.height * nFrames;
+
+        result.mpixelsPerSec      = totalPixels / totalSec / 1e6;
+        result.nominalItersPerSec = (double)result.nominalIterationsPerFrame * nFrames / totalSec;
+        result.cyclesPerPixel     = totalCycles / totalPixels;
+
+        results->push_back(result);
+        mandelbrot_bench_print(result);
+    }
+}
+
+void mandelbrot_bench(sf::Uint8* pixels, const RenderParams& params,
+                      MandelbrotFunc func, const char* name,
+                      int nWarmup, int nFrames, std::vector<BenchResult>* results)
+{
+    auto render = [=, &params](const BenchViewport& view)
+    {
+        func(pixels, params, view.magnifier, view.shiftX);
+    };
+    bench_viewports(render, params, name, nWarmup, nFrames, results);
+}
+
+void mandelbrot_bench(sf::Uint8* pixels, const RenderParams& params,
+                      MandelbrotDeepFunc func, const char* name,
+                      int nWarmup, int nFrames, std::vector<BenchResult>* results)
+{
+    const BigFixed zero = bf_from_double(0.0);
+
+    auto render = [=, &params](const BenchViewport& view)
+    {
+        func(pixels, params, view.magnifier, bf_from_double(view.shiftX), zero);
+    };
+    bench_viewports(render, params, name, nWarmup, nFrames, results);
+}
+
+void mandelbrot_bench_print(const BenchResult& result)
+{
+    printf("%-12s %-10s min %8.3f ms  median %8.3f ms  p95 %8.3f ms  p99 %8.3f ms  "
+           "%8.2f Mpix/s  %8.3f nominal Giter/s  %8.1f cycles/pixel\n",
+           result.mode, result.viewport,
+           result.minMs, result.medianMs, result.p95Ms, result.p99Ms,
+           result.mpixelsPerSec, result.nominalItersPerSec / 1e9, result.cyclesPerPixel);
+}
+
+void mandelbrot_bench_print_scaling(const std::vector<BenchResult>& results)
+{
+    printf("Scaling, median against the run with the fewest threads:\n");
+
+    for (const BenchResult& result : results)
+    {
+        const BenchResult* base = &result;
+        for (const BenchResult& other : results)
+            if (strcmp(other.mode,     result.mode)     == 0 &&
+                strcmp(other.viewport, result.viewport) == 0 &&
+                other.params.nThreads < base->params.nThreads)
+                base = &other;
+
+        const double speedup    = base->medianMs / result.medianMs;
+        const double efficiency = speedup * base->params.nThreads / result.params.nThreads;
+        printf("%-12s %-10s %3d threads on %d nodes  median %8.3f ms  %6.2fx  %5.1f%%\n",
+               result.mode, result.viewport, result.params.nThreads,
+               mandelbrot_numa_nodes_used(result.params.nThreads), result.medianMs,
+               speedup, efficiency * 100.0);
+    }
+}
+
+bool mandelbrot_bench_write_csv(const char* path, const std::vector<BenchResult>& results)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "mode,viewport,isa,width,height,max_iterations,threads,frames,"
+                  "min_ms,median_ms,p95_ms,p99_ms,mean_ms,"
+                  "mpixels_per_sec,nominal_iterations_per_sec,cycles_per_pixel,nominal_iterations_per_frame\n");
+
+    for (const BenchResult& r : results)
+    {
+        fprintf(file, "%s,%s,%s,%d,%d,%d,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.3f,%.1f,%.2f,%llu\n",
+                r.mode, r.viewport, mandelbrot_isa_name(r.params.isa), r.params.width, r.params.height, r.params.maxIterations,
+                r.params.nThreads, r.nFrames, r.minMs, r.medianMs, r.p95Ms, r.p99Ms, r.meanMs,
+                r.mpixelsPerSec, r.nominalItersPerSec, r.cyclesPerPixel,
+                (unsigned long long)r.nominalIterationsPerFrame);
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool mandelbrot_bench_write_json(const char* path, const std::vector<BenchResult>& results)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    // All results of one run share the parameters, but for the threads
+    // of a scaling run
+    const RenderParams params = results.empty() ? default_render_params() : results[0].params;
+
+    fprintf(file, "{\n  \"width\": %d,\n  \"height\": %d,\n  \"max_iterations\": %d,\n"
+                  "  \"max_radius\": %g,\n  \"threads\": %d,\n  \"isa\": \"%s\",\n"
+                  "  \"results\": [\n",
+            params.width, params.height, params.maxIterations, params.maxRadius, params.nThreads,
+            mandelbrot_isa_name(params.isa));
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        fprintf(file, "    { \"mode\": \"%s\", \"viewport\": \"%s\", \"threads\": %d, \"frames\": %d, "
+                      "\"min_ms\": %.4f, \"median_ms\": %.4f, \"p95_ms\": %.4f, "
+                      "\"p99_ms\": %.4f, \"mean_ms\": %.4f, \"mpixels_per_sec\": %.3f, "
+                      "\"nominal_iterations_per_sec\": %.1f, \"cycles_per_pixel\": %.2f, "
+                      "\"nominal_iterations_per_frame\": %llu }%s\n",
+                r.mode, r.viewport, r.params.nThreads, r.nFrames, r.minMs, r.medianMs, r.p95Ms,
+                r.p99Ms, r.meanMs, r.mpixelsPerSec, r.nominalItersPerSec, r.cyclesPerPixel,
+                (unsigned long long)r.nominalIterationsPerFrame,
+                i + 1 < results.size() ? "," : "");
+    }
+
+    fprintf(file, "  ]\n}\n");
+
+    fclose(file);
+    return true;
+}
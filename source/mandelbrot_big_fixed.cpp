@@ -0,0 +1,236 @@
+#include "mandelbrot_big_fixed.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+static const double LIMB_BASE = 4294967296.0;
+
+BigFixed bf_from_double(double value)
+{
+    BigFixed result = {};
+    result.negative = value < 0;
+
+    // Every step is exact: the fraction loses 32 bits per limb
+    double magnitude = std::fabs(value);
+    for (int i = 0; i < BIG_FIXED_LIMBS && magnitude != 0.0; i++)
+    {
+        double limb = std::floor(magnitude);
+        result.limbs[i] = (uint32_t)limb;
+        magnitude = (magnitude - limb) * LIMB_BASE;
+    }
+
+    return result;
+}
+
+// fraction = (fraction + digit) / 10, the integer limb is left alone
+static void push_fraction_digit(BigFixed* fraction, int digit)
+{
+    uint64_t remainder = (uint64_t)digit;
+    for (int i = 1; i < BIG_FIXED_LIMBS; i++)
+    {
+        const uint64_t current = remainder << 32 | fraction->limbs[i];
+        fraction->limbs[i] = (uint32_t)(current / 10);
+        remainder = current % 10;
+    }
+}
+
+bool bf_parse(const char* text, BigFixed* value)
+{
+    const char* cursor = text;
+
+    const bool negative = *cursor == '-';
+    if (*cursor == '-' || *cursor == '+')
+        cursor++;
+
+    // The digits without the point, and how many of them are the integer part
+    std::string digits;
+    long nIntegerDigits = 0;
+    bool point = false;
+    for (; isdigit((unsigned char)*cursor) || (*cursor == '.' && !point); cursor++)
+    {
+        if (*cursor == '.')
+            point = true;
+        else
+        {
+            digits.push_back(*cursor);
+            nIntegerDigits += !point;
+        }
+    }
+
+    if (digits.empty())
+        return false;
+
+    if (*cursor == 'e' || *cursor == 'E')
+    {
+        char* end = NULL;
+        const long exponent = strtol(cursor + 1, &end, 10);
+        if (end == cursor + 1 || exponent > INT_MAX || exponent < INT_MIN)
+            return false;
+
+        nIntegerDigits += exponent;
+        cursor = end;
+    }
+
+    if (*cursor != '\0')
+        return false;
+
+    BigFixed result = {};
+
+    // Ten digits past the given ones overflow anything but zero
+    uint64_t integer = 0;
+    for (long i = 0; i < std::min(nIntegerDigits, (long)digits.size() + 10); i++)
+    {
+        integer = integer * 10 + (i < (long)digits.size() ? digits[i] - '0' : 0);
+        if (integer > UINT32_MAX)
+            return false;
+    }
+    result.limbs[0] = (uint32_t)integer;
+
+    // Fraction digits from the last, then the zeros between the point and
+    // the first of them. Past about 340 zeros nothing is left.
+    for (long i = (long)digits.size() - 1; i >= std::max(nIntegerDigits, 0L); i--)
+        push_fraction_digit(&result, digits[i] - '0');
+    for (long i = std::min(-nIntegerDigits, 400L); i > 0; i--)
+        push_fraction_digit(&result, 0);
+
+    bool zero = true;
+    for (int i = 0; i < BIG_FIXED_LIMBS; i++)
+        zero = zero && result.limbs[i] == 0;
+    result.negative = negative && !zero;
+
+    *value = result;
+    return true;
+}
+
+DoubleDouble bf_to_dd(const BigFixed& value)
+{
+    DoubleDouble result = dd_from(0.0);
+
+    // From the least significant limb, so small limbs are not lost
+    for (int i = BIG_FIXED_LIMBS - 1; i >= 0; i--)
+        if (value.limbs[i])
+            result = dd_add(result, std::ldexp((double)value.limbs[i], -32 * i));
+
+    if (value.negative)
+        result = { -result.hi, -result.lo };
+
+    return result;
+}
+
+double bf_to_double(const BigFixed& value)
+{
+    DoubleDouble result = bf_to_dd(value);
+    return result.hi + result.lo;
+}
+
+int64_t bf_to_fixed(const BigFixed& value, int fractionBits)
+{
+    const uint64_t fraction = ((uint64_t)value.limbs[1] << 32) | value.limbs[2];
+
+    uint64_t magnitude = (uint64_t)value.limbs[0] << fractionBits;
+    if (fractionBits > 0)
+        magnitude |= fraction >> (64 - fractionBits);
+
+    return value.negative ? -(int64_t)magnitude : (int64_t)magnitude;
+}
+
+static int compare_magnitude(const BigFixed& a, const BigFixed& b)
+{
+    for (int i = 0; i < BIG_FIXED_LIMBS; i++)
+        if (a.limbs[i] != b.limbs[i])
+            return a.limbs[i] < b.limbs[i] ? -1 : 1;
+
+    return 0;
+}
+
+static void add_magnitude(BigFixed* result, const BigFixed& a, const BigFixed& b)
+{
+    uint64_t carry = 0;
+    for (int i = BIG_FIXED_LIMBS - 1; i >= 0; i--)
+    {
+        uint64_t sum = (uint64_t)a.limbs[i] + b.limbs[i] + carry;
+        result->limbs[i] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+}
+
+// |a| >= |b| is required
+static void sub_magnitude(BigFixed* result, const BigFixed& a, const BigFixed& b)
+{
+    int64_t borrow = 0;
+    for (int i = BIG_FIXED_LIMBS - 1; i >= 0; i--)
+    {
+        int64_t diff = (int64_t)a.limbs[i] - b.limbs[i] - borrow;
+        borrow = diff < 0;
+        result->limbs[i] = (uint32_t)(diff + (borrow << 32));
+    }
+}
+
+BigFixed bf_add(const BigFixed& a, const BigFixed& b)
+{
+    BigFixed result = {};
+
+    if (a.negative == b.negative)
+    {
+        add_magnitude(&result, a, b);
+        result.negative = a.negative;
+    }
+    else if (compare_magnitude(a, b) >= 0)
+    {
+        sub_magnitude(&result, a, b);
+        result.negative = a.negative;
+    }
+    else
+    {
+        sub_magnitude(&result, b, a);
+        result.negative = b.negative;
+    }
+
+    return result;
+}
+
+BigFixed bf_sub(const BigFixed& a, const BigFixed& b)
+{
+    BigFixed negB = b;
+    negB.negative = !b.negative;
+
+    return bf_add(a, negB);
+}
+
+BigFixed bf_mul(const BigFixed& a, const BigFixed& b)
+{
+    // columns[k + 1] collects the products of weight 2^(-32k), columns[0]
+    // is overflow of the integer part and is dropped. Products below the
+    // last limb are dropped too, which costs at most a few ulps.
+    uint64_t columns[BIG_FIXED_LIMBS + 1] = {};
+
+    for (int i = 0; i < BIG_FIXED_LIMBS; i++)
+    {
+        if (!a.limbs[i])
+            continue;
+
+        for (int j = 0; i + j < BIG_FIXED_LIMBS; j++)
+        {
+            uint64_t product = (uint64_t)a.limbs[i] * b.limbs[j];
+            columns[i + j + 1] += product & 0xFFFFFFFF;
+            columns[i + j]     += product >> 32;
+        }
+    }
+
+    BigFixed result = {};
+    result.negative = a.negative != b.negative;
+
+    uint64_t carry = 0;
+    for (int k = BIG_FIXED_LIMBS; k >= 1; k--)
+    {
+        uint64_t sum = columns[k] + carry;
+        result.limbs[k - 1] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+
+    return result;
+}
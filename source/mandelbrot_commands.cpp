@@ -0,0 +1,398 @@
+#include "mandelbrot_commands.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "mandelbrot_antialias.h"
+#include "mandelbrot_auto_depth.h"
+#include "mandelbrot_autotune.h"
+#include "mandelbrot_backends.h"
+#include "mandelbrot_deep.h"
+#include "mandelbrot_fractal.h"
+#include "mandelbrot_frame_buffer.h"
+#include "mandelbrot_numa.h"
+#include "mandelbrot_options.h"
+#include "mandelbrot_palette.h"
+
+int mandelbrot_run_batch(BatchJob job, bool formatGiven, RenderParams params, bool autoDepth)
+{
+    const MandelbrotBackend* mode = mandelbrot_find_backend(job.modeName);
+    if (!mode)
+    {
+        fprintf(stderr, "Unknown implementation %s\n", job.modeName);
+        return 1;
+    }
+
+    // Strips are views off the real axis, which the float kernels can't place
+    if (!mode->deepFunc)
+    {
+        fprintf(stderr, "%s can't render headless, use double, double-double, "
+                        "perturbation or deep\n", job.modeName);
+        return 1;
+    }
+
+    if (job.stripRows < 1)
+    {
+        fprintf(stderr, "Strips need at least one row\n");
+        return 1;
+    }
+
+    if (!formatGiven)
+        job.format = mandelbrot_image_format_of(job.output);
+
+    const int aaSide = (int)std::sqrt((double)job.aaSamples);
+    if (job.aaSamples < 1 || job.aaSamples > AA_MAX_SAMPLES || aaSide * aaSide != job.aaSamples)
+    {
+        fprintf(stderr, "--aa takes 1 (off) or a square of up to %d subsamples\n", AA_MAX_SAMPLES);
+        return 1;
+    }
+
+    // One depth for the whole image, the strips are rendered at it
+    if (autoDepth)
+    {
+        params.maxIterations = mandelbrot_auto_depth(params, job.scale,
+                                                     job.shiftX, job.shiftY).depth;
+        printf("Iteration depth %d\n", params.maxIterations);
+    }
+
+    // Edge pixels are supersampled with the double kernel, at the
+    // depth of the image
+    if (job.aaSamples > 1)
+    {
+        const MandelbrotPrecision precision =
+            mandelbrot_pick_precision(params, job.scale, job.shiftX, job.shiftY);
+        if (precision != PRECISION_FLOAT && precision != PRECISION_DOUBLE)
+        {
+            fprintf(stderr, "Anti-aliasing needs a view double precision resolves\n");
+            return 1;
+        }
+    }
+
+    job.func = mode->deepFunc;
+    return mandelbrot_batch_render(job, params);
+}
+
+// The start view and the mode come from the batch options
+int mandelbrot_run_video(VideoJob video, const BatchJob& job, RenderParams params, bool autoDepth)
+{
+    const MandelbrotBackend* mode = mandelbrot_find_backend(job.modeName);
+    if (!mode)
+    {
+        fprintf(stderr, "Unknown implementation %s\n", job.modeName);
+        return 1;
+    }
+
+    // Frames off the real axis, as for headless images
+    if (!mode->deepFunc)
+    {
+        fprintf(stderr, "%s can't render videos, use double, double-double, "
+                        "perturbation or deep\n", job.modeName);
+        return 1;
+    }
+
+    if (job.aaSamples > 1)
+    {
+        fprintf(stderr, "Anti-aliasing is for headless images\n");
+        return 1;
+    }
+
+    if (video.nFrames < 1 || video.zoomTo + MAGNIFIER_OFFSET <= 0)
+    {
+        fprintf(stderr, "A video needs at least one frame and a positive --zoom-to\n");
+        return 1;
+    }
+
+    // One depth for every frame, so the colors stay: the one of the deepest
+    if (autoDepth)
+    {
+        const double deepest = std::max(job.scale, video.zoomTo);
+        params.maxIterations = mandelbrot_auto_depth(params, deepest,
+                                                     job.shiftX, job.shiftY).depth;
+        fprintf(stderr, "Iteration depth %d\n", params.maxIterations);
+    }
+
+    video.modeName = job.modeName;
+    video.func     = mode->deepFunc;
+    video.scale    = job.scale;
+    video.shiftX   = job.shiftX;
+    video.shiftY   = job.shiftY;
+    return mandelbrot_video_render(video, params);
+}
+
+// The batch options give the output, the view and the mode
+int mandelbrot_run_farm(FarmJob farm, const BatchJob& job, bool formatGiven,
+                        const RenderParams& params, bool autoDepth)
+{
+    const MandelbrotBackend* mode = mandelbrot_find_backend(job.modeName);
+    if (!mode)
+    {
+        fprintf(stderr, "Unknown implementation %s\n", job.modeName);
+        return 1;
+    }
+
+    // Tiles are views off the real axis, as batch strips
+    if (!mode->deepFunc)
+    {
+        fprintf(stderr, "%s can't render on a farm, use double, double-double, "
+                        "perturbation or deep\n", job.modeName);
+        return 1;
+    }
+
+    // Every worker must render at the same depth
+    if (autoDepth)
+    {
+        fprintf(stderr, "A farm render needs a fixed iteration depth\n");
+        return 1;
+    }
+
+    if (job.aaSamples > 1)
+    {
+        fprintf(stderr, "Anti-aliasing is for headless images of a single process\n");
+        return 1;
+    }
+
+    if (!job.output || farm.nWorkers < 0 || farm.tileSize < 8 || farm.leaseMs < 1 ||
+        (farm.scaling && farm.nWorkers < 1))
+    {
+        fprintf(stderr, "A farm render needs --output, --workers of 0 or more, --farm-tile of "
+                        "at least 8, a positive --lease-ms and, for --scaling, local --workers\n");
+        return 1;
+    }
+
+    farm.batch = job;
+    if (!formatGiven)
+        farm.batch.format = mandelbrot_image_format_of(job.output);
+
+    return mandelbrot_farm_render(farm, params);
+}
+
+static MandelbrotDeepFunc find_deep_func(const char* name)
+{
+    const MandelbrotBackend* mode = mandelbrot_find_backend(name);
+    return mode ? mode->deepFunc : NULL;
+}
+
+// ./mandelbrot worker --connect ADDRESS [--threads N] [--isa ...]
+int mandelbrot_run_worker(int argc, char* argv[])
+{
+    RenderContext context;
+    RenderParams  params  = default_render_params();
+    const char*   address = NULL;
+    params.context = &context;
+
+    for (int i = 2; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value of %s\n", argv[i]);
+            mandelbrot_print_usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(argv[i], "--connect") == 0)
+            address = argv[i + 1];
+        else if (!mandelbrot_parse_render_option(argv[i], argv[i + 1], &params))
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (!address)
+    {
+        fprintf(stderr, "A worker needs the --connect address of its coordinator\n");
+        return 1;
+    }
+
+    if (!mandelbrot_check_render_params(params))
+        return 1;
+
+    return mandelbrot_farm_work(address, params, find_deep_func);
+}
+
+// ./mandelbrot tune [--profile FILE] [--width W] [--height H] [--iterations N] ...
+int mandelbrot_run_tune(int argc, char* argv[])
+{
+    RenderContext context;
+    RenderParams  params      = default_render_params();
+    const char*   profilePath = DEFAULT_TUNE_PROFILE;
+    params.context = &context;
+
+    for (int i = 2; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value of %s\n", argv[i]);
+            mandelbrot_print_usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(argv[i], "--profile") == 0)
+            profilePath = argv[i + 1];
+        else if (!mandelbrot_parse_render_option(argv[i], argv[i + 1], &params))
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (!mandelbrot_check_render_params(params))
+        return 1;
+
+    printf("Tuning at %dx%d, %d iterations (%s)\n", params.width, params.height,
+           params.maxIterations, mandelbrot_isa_name(params.isa));
+
+    TuneProfile profile;
+    mandelbrot_autotune(params, &profile);
+
+    if (!mandelbrot_tune_save(profilePath, profile))
+    {
+        fprintf(stderr, "Can't write %s\n", profilePath);
+        return 1;
+    }
+
+    mandelbrot_tune_print(stdout, profile);
+    printf("Saved to %s\n", profilePath);
+    return 0;
+}
+
+// The tuned backend renders as the thread-pool until it has a profile,
+// which only the tuned mode itself insists on
+bool mandelbrot_load_tune_profile(const char* path, const RenderParams& params, bool required)
+{
+    TuneProfile profile;
+    const int found = mandelbrot_tune_load(path, &profile);
+    if (found > 0)
+    {
+        mandelbrot_tuned_use(profile, params);
+        return true;
+    }
+
+    if (found < 0)
+        fprintf(stderr, "%s is not a tuning profile\n", path);
+    else if (required)
+        fprintf(stderr, "No tuning profile %s, create one with ./mandelbrot tune\n", path);
+
+    return !required;
+}
+
+int mandelbrot_run_server(TileServerConfig serve, const char* modeName, const RenderParams& params,
+                          bool autoDepth)
+{
+    const MandelbrotBackend* mode = mandelbrot_find_backend(modeName);
+    if (!mode)
+    {
+        fprintf(stderr, "Unknown implementation %s\n", modeName);
+        return 1;
+    }
+
+    // Tiles are views off the real axis, as for headless images
+    if (!mode->deepFunc)
+    {
+        fprintf(stderr, "%s can't render tiles, use double, double-double, "
+                        "perturbation or deep\n", modeName);
+        return 1;
+    }
+
+    // Neighbouring tiles must match, and cached ones stay valid
+    if (autoDepth)
+    {
+        fprintf(stderr, "Tiles need a fixed iteration depth\n");
+        return 1;
+    }
+
+    if (serve.cacheMb < 0)
+    {
+        fprintf(stderr, "The memory cache can't be negative\n");
+        return 1;
+    }
+
+    serve.modeName = modeName;
+    serve.func     = mode->deepFunc;
+    return mandelbrot_tile_server_run(serve, params);
+}
+
+// allFractals: every fractal in turn, on the modes that render them
+int mandelbrot_run_benchmark(const RenderParams& params, const BenchOptions& bench,
+                             bool allFractals, const char* modeName)
+{
+    // --scaling on: from one thread to every CPU, node after node
+    std::vector<int> threadCounts(1, params.nThreads);
+    if (bench.scaling)
+        threadCounts = mandelbrot_numa_scaling_threads();
+
+    sf::Uint8* pixels = (sf::Uint8*)mandelbrot_frame_buffer_alloc(params.width * 4, params.height,
+                                                                  params.nThreads);
+
+    std::vector<BenchResult> results;
+
+    // Results of other fractals are named mode/fractal
+    std::deque<std::string> names;
+
+    const bool all = strcmp(modeName, "all") == 0;
+    for (int f = 0; f < (allFractals ? N_FRACTALS : 1); f++)
+    {
+        if (allFractals)
+            mandelbrot_fractal_select(FRACTALS[f].name);
+
+        for (int i = 0; i < N_BACKENDS; i++)
+        {
+            const MandelbrotBackend& backend = BACKENDS[i];
+            if (!all && strcmp(backend.name, modeName) != 0)
+                continue;
+
+            const char* name = backend.name;
+            if (!mandelbrot_fractal_is_mandelbrot())
+            {
+                if (!backend.fractals)
+                    continue;
+
+                names.push_back(std::string(backend.name) + "/" + mandelbrot_fractal_current().name);
+                name = names.back().c_str();
+            }
+
+            for (int nThreads : threadCounts)
+            {
+                RenderParams modeParams = params;
+                modeParams.nThreads = nThreads;
+
+                printf("Testing %d times %s (%d warm-up, %s, %d threads)\n", bench.nFrames, name,
+                       bench.nWarmup, mandelbrot_isa_name(params.isa), nThreads);
+                if (backend.func)
+                    mandelbrot_bench(pixels, modeParams, backend.func,     name,
+                                     bench.nWarmup, bench.nFrames, &results);
+                else
+                    mandelbrot_bench(pixels, modeParams, backend.deepFunc, name,
+                                     bench.nWarmup, bench.nFrames, &results);
+
+                if (backend.printStats)
+                    backend.printStats(stdout);
+            }
+        }
+    }
+
+    if (bench.scaling && !results.empty())
+        mandelbrot_bench_print_scaling(results);
+
+    mandelbrot_frame_buffer_free(pixels);
+    mandelbrot_frame_buffer_print_stats(stdout);
+
+    if (results.empty())
+    {
+        fprintf(stderr, "Unknown implementation %s\n", modeName);
+        return 1;
+    }
+
+    if (bench.csvPath && !mandelbrot_bench_write_csv(bench.csvPath, results))
+        fprintf(stderr, "Can't write %s\n", bench.csvPath);
+    if (bench.jsonPath && !mandelbrot_bench_write_json(bench.jsonPath, results))
+        fprintf(stderr, "Can't write %s\n", bench.jsonPath);
+
+    return 0;
+}
+
@@ -4,27 +4,31 @@
 #include <assert.h>
 #include <SFML/Graphics.hpp>
 
-__global__ void mandelbrot_kernel(sf::Uint8* pixels, float magnifier, float shiftX)
+// params is passed by value, it lands in the kernel's constant bank
+__global__ void mandelbrot_kernel(sf::Uint8* pixels, RenderParams params,
+                                  float magnifier, float shiftX)
 {
     int x = blockIdx.x * blockDim.x + threadIdx.x;
     int y = blockIdx.y * blockDim.y + threadIdx.y;
     
-    if (x >= WINDOW_WIDTH || y >= WINDOW_HEIGHT)
+    if (x >= params.width || y >= params.height)
         return;
     
     const float inv_magnifier = 1.0f / magnifier;
-    const float COLOR_SCALE = 255.0f / MAX_ITERATION_DEPTH;
+    const float COLOR_SCALE = 255.0f / params.maxIterations;
+    const float aspect      = (float)params.width / params.height;
+    const float maxRadius2  = params.maxRadius * params.maxRadius;
 
-    float pixel_step_x = ASPECT_RATIO * inv_magnifier * (2.0f / WINDOW_WIDTH);
-    float pixel_step_y = inv_magnifier * (2.0f / WINDOW_HEIGHT);
+    float pixel_step_x = aspect * inv_magnifier * (2.0f / params.width);
+    float pixel_step_y = inv_magnifier * (2.0f / params.height);
 
-    float current_x_coord = shiftX - ASPECT_RATIO * inv_magnifier + x * pixel_step_x;
+    float current_x_coord = shiftX - aspect * inv_magnifier + x * pixel_step_x;
     float current_y_coord = -1.0f * inv_magnifier + y * pixel_step_y;
 
     int iterations = 0;
     float z_x = 0.0f, z_y = 0.0f, z_x2 = 0.0f, z_y2 = 0.0f;
 
-    while (z_x2 + z_y2 < MAX_RADIUS_2 && iterations < MAX_ITERATION_DEPTH) {
+    while (z_x2 + z_y2 < maxRadius2 && iterations < params.maxIterations) {
         z_y = 2 * z_x * z_y + current_y_coord;
         z_x = z_x2 - z_y2 + current_x_coord;
         z_x2 = z_x * z_x;
@@ -33,43 +37,50 @@ __global__ void mandelbrot_kernel(sf::Uint8* pixels, float magnifier, float shif
     }
 
     sf::Uint8 r = 0, g = 0, b = 0;
-    if (iterations < MAX_ITERATION_DEPTH) {
+    if (iterations < params.maxIterations) {
         float iterNormalized = iterations * COLOR_SCALE;
         r = (sf::Uint8)(iterNormalized / 2);
         g = (sf::Uint8)(iterNormalized * 2 + 2);
         b = (sf::Uint8)(iterNormalized * 2 + 5);
     }
 
-    int pixelIndex = (y * WINDOW_WIDTH + x) * 4;
+    int pixelIndex = (y * params.width + x) * 4;
     pixels[pixelIndex + 0] = r;
     pixels[pixelIndex + 1] = g;
     pixels[pixelIndex + 2] = b;
     pixels[pixelIndex + 3] = 255;
 }
 
-void mandelbrot_cuda(sf::Uint8* pixels, float magnifier, float shiftX) {
+void mandelbrot_cuda(sf::Uint8* pixels, const RenderParams& params, float magnifier, float shiftX) {
     shiftX    += SHIFT_X_OFFSET;
     magnifier += MAGNIFIER_OFFSET;
     
-    sf::Uint8* d_pixels;
-    size_t size = WINDOW_WIDTH * WINDOW_HEIGHT * 4 * sizeof(sf::Uint8);
-    cudaMalloc(&d_pixels, size);
+    // Kept across frames, reallocated when the frame size changes
+    static sf::Uint8* d_pixels = NULL;
+    static size_t     d_size   = 0;
+
+    size_t size = (size_t)params.width * params.height * 4 * sizeof(sf::Uint8);
+    if (d_size != size)
+    {
+        cudaFree(d_pixels);
+        cudaMalloc(&d_pixels, size);
+        d_size = size;
+    }
     
     dim3 blockSize(16, 16);
-    dim3 gridSize((WINDOW_WIDTH + blockSize.x - 1) / blockSize.x, (WINDOW_HEIGHT + blockSize.y - 1) / blockSize.y);
+    dim3 gridSize((params.width + blockSize.x - 1) / blockSize.x, (params.height + blockSize.y - 1) / blockSize.y);
     
-    mandelbrot_kernel<<<gridSize, blockSize>>>(d_pixels, magnifier, shiftX);
+    mandelbrot_kernel<<<gridSize, blockSize>>>(d_pixels, params, magnifier, shiftX);
     cudaMemcpy(pixels, d_pixels, size, cudaMemcpyDeviceToHost);
-    cudaFree(d_pixels);
 }
 
-void mandelbrot_cuda_no_cpy(sf::Uint8* pixels, float magnifier, float shiftX) {
+void mandelbrot_cuda_no_cpy(sf::Uint8* pixels, const RenderParams& params, float magnifier, float shiftX) {
     shiftX -= 0.5f;
     magnifier -= 0.3f;
 
     dim3 blockSize(16, 16);
-    dim3 gridSize((WINDOW_WIDTH  + blockSize.x - 1) / blockSize.x,
-                  (WINDOW_HEIGHT + blockSize.y - 1) / blockSize.y);
+    dim3 gridSize((params.width  + blockSize.x - 1) / blockSize.x,
+                  (params.height + blockSize.y - 1) / blockSize.y);
     
-    mandelbrot_kernel<<<gridSize, blockSize>>>(pixels, magnifier, shiftX);
+    mandelbrot_kernel<<<gridSize, blockSize>>>(pixels, params, magnifier, shiftX);
 }
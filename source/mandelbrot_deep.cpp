@@ -0,0 +1,114 @@
+#include "mandelbrot_deep.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_double.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_perturbation.h"
+#include "mandelbrot_vectorized.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <omp.h>
+#include <vector>
+
+const char* mandelbrot_precision_name(MandelbrotPrecision precision)
+{
+    switch (precision)
+    {
+        case PRECISION_FLOAT:         return "float";
+        case PRECISION_DOUBLE:        return "double";
+        case PRECISION_DOUBLE_DOUBLE: return "double-double";
+        case PRECISION_PERTURBATION:  return "perturbation";
+    }
+
+    return "unknown";
+}
+
+MandelbrotPrecision mandelbrot_pick_precision(const RenderParams& params, double magnifier,
+                                              const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    const double centerX = bf_to_double(shiftX) + SHIFT_X_OFFSET;
+    const double centerY = bf_to_double(shiftY);
+
+    const double invMagnifier = 1.0 / (magnifier + MAGNIFIER_OFFSET);
+
+    // Of the whole view, so that all windows of it pick the same
+    const RenderParams view = view_params(params);
+
+    const double pixelStep = invMagnifier * (2.0 / view.height);
+    const double maxCoord  = std::fmax(std::fabs(centerX) + std::fabs(aspect_ratio_double(view) * invMagnifier),
+                                       std::fabs(centerY) + std::fabs(invMagnifier));
+
+    // Relative to the largest coordinate, so the criterion is the same
+    // for any exponent
+    const double marginUlps   = MIN_PIXEL_STEP_ULPS * std::sqrt((double)std::max(1, params.maxIterations));
+    const double relativeStep = pixelStep / maxCoord / marginUlps;
+
+    if (relativeStep >= FLT_EPSILON && centerY == 0.0)
+        return PRECISION_FLOAT;
+    if (relativeStep >= DBL_EPSILON)
+        return PRECISION_DOUBLE;
+    if (relativeStep >= DBL_EPSILON * DBL_EPSILON)
+        return PRECISION_DOUBLE_DOUBLE;
+
+    return PRECISION_PERTURBATION;
+}
+
+void mandelbrot_deep(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                     const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    const MandelbrotPrecision precision = mandelbrot_pick_precision(params, magnifier, shiftX, shiftY);
+
+    // Parallel on its own, after the shared reference orbit
+    if (precision == PRECISION_PERTURBATION)
+    {
+        mandelbrot_perturbation(pixels, params, magnifier, shiftX, shiftY);
+        return;
+    }
+
+    const DoubleDouble shiftXdd = bf_to_dd(shiftX);
+    const DoubleDouble shiftYdd = bf_to_dd(shiftY);
+
+    // The points of mandelbrot_vectorized, which works on whole frames
+    // only, so a window gets the pixels of its view
+    std::vector<float> columnC_x;
+    std::vector<float> rowC_y;
+    if (precision == PRECISION_FLOAT)
+    {
+        columnC_x.resize(params.width);
+        rowC_y   .resize(params.height);
+        mandelbrot_vectorized_coords(params, (float)magnifier, (float)shiftXdd.hi,
+                                     columnC_x.data(), rowC_y.data());
+    }
+
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(params.nThreads)
+    for (int screenY = 0; screenY < params.height; screenY++)
+    {
+        switch (precision)
+        {
+            case PRECISION_FLOAT:
+            {
+                const std::vector<float> c_y(params.width, rowC_y[screenY]);
+                mandelbrot_vectorized_points(params, columnC_x.data(), c_y.data(),
+                                             iterations + (size_t)screenY * params.width,
+                                             params.width);
+                mandelbrot_colorize(pixels, params, iterations, palette,
+                                    0, params.width, screenY, screenY + 1);
+                break;
+            }
+            case PRECISION_DOUBLE:
+                mandelbrot_double_ranged(pixels, params, magnifier, shiftXdd.hi + shiftXdd.lo,
+                                         shiftYdd.hi + shiftYdd.lo, screenY, screenY + 1);
+                break;
+            case PRECISION_DOUBLE_DOUBLE:
+                mandelbrot_double_double_ranged(pixels, params, magnifier, shiftXdd, shiftYdd,
+                                                screenY, screenY + 1);
+                break;
+            case PRECISION_PERTURBATION:
+                break;
+        }
+    }
+}
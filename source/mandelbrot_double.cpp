@@ -0,0 +1,164 @@
+#include "mandelbrot_double.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_interior.h"
+#include "mandelbrot_palette.h"
+
+#include <x86intrin.h>
+
+void mandelbrot_double(sf::Uint8* pixels, const RenderParams& params,
+                       double magnifier, double shiftX, double shiftY)
+{
+    mandelbrot_double_ranged(pixels, params, magnifier, shiftX, shiftY, 0, params.height);
+}
+
+// Iteration counts of four points, one per 64-bit lane
+static inline __m256i iterate4(__m256d _c_x, __m256d _c_y, const RenderParams& params)
+{
+    const __m256d _maxRadius2 = _mm256_set1_pd(max_radius_2(params));
+    const __m256d _2 = _mm256_set1_pd(2.0);
+
+    __m256d _z_x = _mm256_setzero_pd();
+    __m256d _z_y = _mm256_setzero_pd();
+
+    __m256d _z_x2 = _mm256_setzero_pd();
+    __m256d _z_y2 = _mm256_setzero_pd();
+    __m256d _z_xy = _mm256_setzero_pd();
+
+    __m256i _iterations = _mm256_setzero_si256();
+
+    // Lanes known to never escape, as in the float kernel
+    __m256d _interior = cardioid_or_bulb_mask4(_c_x, _c_y);
+
+    __m256d _check_x = _mm256_setzero_pd();
+    __m256d _check_y = _mm256_setzero_pd();
+    int checkLength    = PERIOD_CHECK_START;
+    int checkRemaining = PERIOD_CHECK_START;
+
+    for (int iteration = 0; iteration < params.maxIterations; iteration++)
+    {
+        __m256d _radius2 = _mm256_add_pd(_z_x2, _z_y2);
+
+        __m256d _cmpMask = _mm256_andnot_pd(_interior,
+                                            _mm256_cmp_pd(_radius2, _maxRadius2, _CMP_LT_OQ));
+        if (!_mm256_movemask_pd(_cmpMask))
+            break;
+
+        _z_x = _mm256_add_pd(_c_x, _mm256_sub_pd(_z_x2, _z_y2));
+        _z_y = _mm256_add_pd(_c_y, _mm256_mul_pd(_2, _z_xy));
+
+        // Each lane of the mask is a 64-bit -1 for an active pixel
+        _iterations = _mm256_sub_epi64(_iterations, _mm256_castpd_si256(_cmpMask));
+
+        _z_x2 = _mm256_mul_pd(_z_x, _z_x);
+        _z_y2 = _mm256_mul_pd(_z_y, _z_y);
+        _z_xy = _mm256_mul_pd(_z_x, _z_y);
+
+        __m256d _periodic = _mm256_and_pd(_mm256_cmp_pd(_z_x, _check_x, _CMP_EQ_OQ),
+                                          _mm256_cmp_pd(_z_y, _check_y, _CMP_EQ_OQ));
+        _interior = _mm256_or_pd(_interior, _mm256_and_pd(_periodic, _cmpMask));
+
+        if (--checkRemaining == 0)
+        {
+            _check_x = _z_x;
+            _check_y = _z_y;
+            checkLength   *= 2;
+            checkRemaining = checkLength;
+        }
+    }
+
+    return _mm256_castpd_si256(
+               _mm256_blendv_pd(_mm256_castsi256_pd(_iterations),
+                                _mm256_castsi256_pd(_mm256_set1_epi64x(params.maxIterations)),
+                                _interior));
+}
+
+void mandelbrot_double_ranged(sf::Uint8* pixels, const RenderParams& params,
+                              double magnifier, double shiftX, double shiftY,
+                              int y_from, int y_to)
+{
+    shiftX    += SHIFT_X_OFFSET;
+    magnifier += MAGNIFIER_OFFSET;
+
+    const double invMagnifier = 1.0 / magnifier;
+
+    // Steps and indices of the whole view, if the frame is a window of it
+    const RenderParams view = view_params(params);
+
+    const double c_step_x = aspect_ratio_double(view) * invMagnifier * (2.0 / view.width);
+    const double c_step_y = invMagnifier * (2.0 / view.height);
+
+    const __m256d _0123 = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+    const __m256d _c_step_x = _mm256_set1_pd(c_step_x);
+
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+    for (int screenY = y_from; screenY < y_to; ++screenY)
+    {
+        const __m256d _c_y = _mm256_set1_pd(shiftY - invMagnifier +
+                                            c_step_y * (params.y_offset + screenY));
+
+        const __m256d _c_x0 = _mm256_set1_pd(shiftX - aspect_ratio_double(view) * invMagnifier);
+
+        uint16_t* rowIterations = iterations + (size_t)screenY * params.width;
+        for (int screenX = 0; screenX < params.width; screenX += 4)
+        {
+            // c_x0 + (x + 3, x + 2, x + 1, x) * dx, not accumulated: at deep zoom
+            // the summation error of += 4dx grows to a whole pixel step
+            __m256d _c_x = _mm256_add_pd(_mm256_set1_pd(params.x_offset + screenX), _0123);
+            _c_x = _mm256_add_pd(_c_x0, _mm256_mul_pd(_c_step_x, _c_x));
+
+            long long iterationsArray[4] = {};
+            _mm256_storeu_si256((__m256i*)iterationsArray, iterate4(_c_x, _c_y, params));
+            // Lanes past the last column are dropped
+            for (int i = 0; i < 4 && screenX + i < params.width; i++)
+                rowIterations[screenX + i] = (uint16_t)iterationsArray[i];
+        }
+
+        mandelbrot_colorize(pixels, params, iterations, palette,
+                            0, params.width, screenY, screenY + 1);
+    }
+}
+
+void mandelbrot_double_coords(const RenderParams& params, double magnifier,
+                              double shiftX, double shiftY, double* c_x, double* c_y)
+{
+    shiftX    += SHIFT_X_OFFSET;
+    magnifier += MAGNIFIER_OFFSET;
+
+    const double invMagnifier = 1.0 / magnifier;
+
+    const RenderParams view = view_params(params);
+
+    const double c_step_x = aspect_ratio_double(view) * invMagnifier * (2.0 / view.width);
+    const double c_step_y = invMagnifier * (2.0 / view.height);
+
+    const double c_x0 = shiftX - aspect_ratio_double(view) * invMagnifier;
+    for (int x = 0; x < params.width; x++)
+        c_x[x] = c_x0 + c_step_x * (params.x_offset + x);
+
+    for (int y = 0; y < params.height; y++)
+        c_y[y] = shiftY - invMagnifier + c_step_y * (params.y_offset + y);
+}
+
+void mandelbrot_double_points(const RenderParams& params, const double* c_x, const double* c_y,
+                              uint16_t* iterations, int n)
+{
+    for (int i = 0; i < n; i += 4)
+    {
+        double x[4] = {};
+        double y[4] = {};
+        for (int j = 0; j < 4 && i + j < n; j++)
+        {
+            x[j] = c_x[i + j];
+            y[j] = c_y[i + j];
+        }
+
+        long long iterationsArray[4] = {};
+        _mm256_storeu_si256((__m256i*)iterationsArray,
+                            iterate4(_mm256_loadu_pd(x), _mm256_loadu_pd(y), params));
+
+        for (int j = 0; j < 4 && i + j < n; j++)
+            iterations[i + j] = (uint16_t)iterationsArray[j];
+    }
+}
@@ -0,0 +1,170 @@
+#include "mandelbrot_double_double.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_interior.h"
+#include "mandelbrot_palette.h"
+
+#include <x86intrin.h>
+
+// Four double-double numbers, one per lane
+struct DD4
+{
+    __m256d hi;
+    __m256d lo;
+};
+
+static inline DD4 dd4_quick_two_sum(__m256d a, __m256d b)
+{
+    __m256d s = _mm256_add_pd(a, b);
+    return { s, _mm256_sub_pd(b, _mm256_sub_pd(s, a)) };
+}
+
+static inline DD4 dd4_add(DD4 a, DD4 b)
+{
+    __m256d s  = _mm256_add_pd(a.hi, b.hi);
+    __m256d bb = _mm256_sub_pd(s, a.hi);
+    __m256d e  = _mm256_add_pd(_mm256_sub_pd(a.hi, _mm256_sub_pd(s, bb)),
+                               _mm256_sub_pd(b.hi, bb));
+
+    e = _mm256_add_pd(e, _mm256_add_pd(a.lo, b.lo));
+    return dd4_quick_two_sum(s, e);
+}
+
+static inline DD4 dd4_sub(DD4 a, DD4 b)
+{
+    const __m256d _signMask = _mm256_set1_pd(-0.0);
+    return dd4_add(a, { _mm256_xor_pd(b.hi, _signMask), _mm256_xor_pd(b.lo, _signMask) });
+}
+
+static inline DD4 dd4_mul(DD4 a, DD4 b)
+{
+    __m256d p = _mm256_mul_pd(a.hi, b.hi);
+    // Exact low part of hi * hi, needs FMA
+    __m256d e = _mm256_fmsub_pd(a.hi, b.hi, p);
+
+    e = _mm256_add_pd(e, _mm256_fmadd_pd(a.hi, b.lo, _mm256_mul_pd(a.lo, b.hi)));
+    return dd4_quick_two_sum(p, e);
+}
+
+static inline DD4 dd4_mul2(DD4 a)
+{
+    // Multiplication by two is exact
+    return { _mm256_add_pd(a.hi, a.hi), _mm256_add_pd(a.lo, a.lo) };
+}
+
+void mandelbrot_double_double(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                              DoubleDouble shiftX, DoubleDouble shiftY)
+{
+    mandelbrot_double_double_ranged(pixels, params, magnifier, shiftX, shiftY, 0, params.height);
+}
+
+void mandelbrot_double_double_ranged(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                                     DoubleDouble shiftX, DoubleDouble shiftY,
+                                     int y_from, int y_to)
+{
+    magnifier += MAGNIFIER_OFFSET;
+
+    const double invMagnifier = 1.0 / magnifier;
+
+    // Steps and indices of the whole view, if the frame is a window of it
+    const RenderParams view = view_params(params);
+
+    const double c_step_x = aspect_ratio_double(view) * invMagnifier * (2.0 / view.width);
+    const double c_step_y = invMagnifier * (2.0 / view.height);
+
+    // Only the corner needs the extra precision, the offsets from it
+    // are small multiples of the pixel step and fit in a double
+    const DoubleDouble c_x0 = dd_add(dd_add(shiftX, SHIFT_X_OFFSET),
+                                     -aspect_ratio_double(view) * invMagnifier);
+    const DoubleDouble c_y0 = dd_add(shiftY, -1.0 * invMagnifier);
+
+    const __m256d _maxRadius2 = _mm256_set1_pd(max_radius_2(params));
+
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+    for (int screenY = y_from; screenY < y_to; ++screenY)
+    {
+        const DoubleDouble c_y = dd_add(c_y0, c_step_y * (params.y_offset + screenY));
+        const DD4 _c_y = { _mm256_set1_pd(c_y.hi), _mm256_set1_pd(c_y.lo) };
+
+        uint16_t* rowIterations = iterations + (size_t)screenY * params.width;
+        for (int screenX = 0; screenX < params.width; screenX += 4)
+        {
+            DoubleDouble c_x[4];
+            for (int i = 0; i < 4; i++)
+                c_x[i] = dd_add(c_x0, c_step_x * (params.x_offset + screenX + i));
+
+            const DD4 _c_x = { _mm256_set_pd(c_x[3].hi, c_x[2].hi, c_x[1].hi, c_x[0].hi),
+                               _mm256_set_pd(c_x[3].lo, c_x[2].lo, c_x[1].lo, c_x[0].lo) };
+
+            DD4 _z_x  = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+            DD4 _z_y  = _z_x;
+            DD4 _z_x2 = _z_x;
+            DD4 _z_y2 = _z_x;
+
+            __m256i _iterations = _mm256_setzero_si256();
+
+            // Lanes known to never escape, as in the double kernel. The
+            // test on c rounded to double is only wrong within an ulp of
+            // the boundary, where orbits take some 1 / sqrt(ulp) ~ 10^8
+            // iterations to escape.
+            __m256d _interior = cardioid_or_bulb_mask4(_mm256_add_pd(_c_x.hi, _c_x.lo),
+                                                       _mm256_add_pd(_c_y.hi, _c_y.lo));
+
+            DD4 _check_x = _z_x;
+            DD4 _check_y = _z_x;
+            int checkLength    = PERIOD_CHECK_START;
+            int checkRemaining = PERIOD_CHECK_START;
+
+            for (int iteration = 0; iteration < params.maxIterations; iteration++)
+            {
+                // The escape test does not need the low parts
+                __m256d _radius2 = _mm256_add_pd(_z_x2.hi, _z_y2.hi);
+
+                __m256d _cmpMask = _mm256_andnot_pd(_interior,
+                                                    _mm256_cmp_pd(_radius2, _maxRadius2, _CMP_LT_OQ));
+                if (!_mm256_movemask_pd(_cmpMask))
+                    break;
+
+                // y = 2xy + cy must use the old x
+                _z_y = dd4_add(dd4_mul2(dd4_mul(_z_x, _z_y)), _c_y);
+                _z_x = dd4_add(dd4_sub(_z_x2, _z_y2), _c_x);
+
+                _iterations = _mm256_sub_epi64(_iterations, _mm256_castpd_si256(_cmpMask));
+
+                _z_x2 = dd4_mul(_z_x, _z_x);
+                _z_y2 = dd4_mul(_z_y, _z_y);
+
+                // Both parts must meet the saved z again
+                __m256d _periodic = _mm256_and_pd(
+                    _mm256_and_pd(_mm256_cmp_pd(_z_x.hi, _check_x.hi, _CMP_EQ_OQ),
+                                  _mm256_cmp_pd(_z_x.lo, _check_x.lo, _CMP_EQ_OQ)),
+                    _mm256_and_pd(_mm256_cmp_pd(_z_y.hi, _check_y.hi, _CMP_EQ_OQ),
+                                  _mm256_cmp_pd(_z_y.lo, _check_y.lo, _CMP_EQ_OQ)));
+                _interior = _mm256_or_pd(_interior, _mm256_and_pd(_periodic, _cmpMask));
+
+                if (--checkRemaining == 0)
+                {
+                    _check_x = _z_x;
+                    _check_y = _z_y;
+                    checkLength   *= 2;
+                    checkRemaining = checkLength;
+                }
+            }
+
+            _iterations = _mm256_castpd_si256(
+                              _mm256_blendv_pd(_mm256_castsi256_pd(_iterations),
+                                               _mm256_castsi256_pd(_mm256_set1_epi64x(params.maxIterations)),
+                                               _interior));
+
+            long long iterationsArray[4] = {};
+            _mm256_storeu_si256((__m256i*)iterationsArray, _iterations);
+            // Lanes past the last column are dropped
+            for (int i = 0; i < 4 && screenX + i < params.width; i++)
+                rowIterations[screenX + i] = (uint16_t)iterationsArray[i];
+        }
+
+        mandelbrot_colorize(pixels, params, iterations, palette,
+                            0, params.width, screenY, screenY + 1);
+    }
+}
@@ -0,0 +1,664 @@
+#include "mandelbrot_farm.h"
+#include "mandelbrot_bands.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_frame_buffer.h"
+#include "mandelbrot_image_file.h"
+#include "mandelbrot_socket.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t FARM_MAGIC   = 0x4D424652;  // "MBFR"
+static const uint32_t FARM_VERSION = 1;
+
+// Longest the coordinator sleeps without looking at the leases
+const int FARM_POLL_MS = 100;
+
+typedef std::chrono::steady_clock Clock;
+
+// Coordinator to worker, once after it connects
+struct FarmJobMessage
+{
+    uint32_t magic;
+    uint32_t version;
+    char     modeName[32];
+    int32_t  maxIterations;
+    float    maxRadius;
+    int32_t  isa;
+    int32_t  width;   // of the whole image
+    int32_t  height;
+    double   scale;
+
+    // The center as BigFixed, every limb of it
+    int32_t  shiftXNegative;
+    int32_t  shiftYNegative;
+    uint32_t shiftX[BIG_FIXED_LIMBS];
+    uint32_t shiftY[BIG_FIXED_LIMBS];
+};
+
+static void pack_center(const BigFixed& value, int32_t* negative, uint32_t* limbs)
+{
+    *negative = value.negative;
+    memcpy(limbs, value.limbs, sizeof(value.limbs));
+}
+
+static BigFixed unpack_center(int32_t negative, const uint32_t* limbs)
+{
+    BigFixed value = {};
+    value.negative = negative != 0;
+    memcpy(value.limbs, limbs, sizeof(value.limbs));
+    return value;
+}
+
+// Coordinator to worker, tile -1 when the job is done. Worker to
+// coordinator, followed by width * height RGB pixels row by row.
+struct FarmTileMessage
+{
+    int32_t tile;
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+};
+
+struct FarmTile
+{
+    int  x;
+    int  y;
+    int  width;
+    int  height;
+    bool done;
+};
+
+struct FarmLease
+{
+    int               tile;
+    Clock::time_point deadline;
+    bool              expired;  // given to another worker too
+};
+
+struct FarmWorker
+{
+    int                    fd;
+    std::vector<FarmLease> leases;
+    int                    nTiles;  // results that counted
+    int                    nLate;   // results of tiles another worker had returned
+    uint64_t               nPixels;
+    Clock::time_point      connected;
+    Clock::time_point      left;
+};
+
+// One render of the whole job
+struct FarmRun
+{
+    int    nWorkers;
+    double seconds;
+    int    nReleased;  // leases that expired or whose worker left
+};
+
+//------------------------------------------------------------------------------
+// Worker
+//------------------------------------------------------------------------------
+
+static int connect_retrying(const char* address)
+{
+    const Clock::time_point giveUp = Clock::now() + std::chrono::milliseconds(FARM_CONNECT_TIMEOUT_MS);
+
+    for (;;)
+    {
+        const int fd = mandelbrot_socket_connect(address);
+        if (fd >= 0 || Clock::now() > giveUp)
+            return fd;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+}
+
+int mandelbrot_farm_work(const char* address, const RenderParams& params, FarmModeLookup lookup)
+{
+    const int fd = connect_retrying(address);
+    if (fd < 0)
+        return 1;
+
+    FarmJobMessage job;
+    if (!mandelbrot_socket_recv(fd, &job, sizeof(job)) ||
+        job.magic != FARM_MAGIC || job.version != FARM_VERSION)
+    {
+        fprintf(stderr, "%s is not a render farm coordinator of this version\n", address);
+        close(fd);
+        return 1;
+    }
+
+    job.modeName[sizeof(job.modeName) - 1] = '\0';
+    const MandelbrotDeepFunc func = lookup(job.modeName);
+    if (!func)
+    {
+        fprintf(stderr, "This worker can't render %s\n", job.modeName);
+        close(fd);
+        return 1;
+    }
+
+    // The whole image, every tile is a window of it as batch strips are
+    RenderParams view  = params;
+    view.width         = job.width;
+    view.height        = job.height;
+    view.maxIterations = job.maxIterations;
+    view.maxRadius     = job.maxRadius;
+    if (mandelbrot_isa_supported((MandelbrotIsa)job.isa))
+        view.isa = (MandelbrotIsa)job.isa;
+
+    const BigFixed shiftX = unpack_center(job.shiftXNegative, job.shiftX);
+    const BigFixed shiftY = unpack_center(job.shiftYNegative, job.shiftY);
+
+    std::vector<uint8_t> rgb;
+    int nTiles = 0;
+
+    FarmTileMessage lease;
+    while (mandelbrot_socket_recv(fd, &lease, sizeof(lease)) && lease.tile >= 0)
+    {
+        const RenderParams tileParams = window_params(view, lease.x, lease.y,
+                                                      lease.width, lease.height);
+
+        sf::Uint8* pixels = (sf::Uint8*)mandelbrot_frame_buffer_alloc(lease.width * 4, lease.height,
+                                                                      params.nThreads);
+        mandelbrot_bands(func, pixels, tileParams, job.scale, shiftX, shiftY);
+
+        // The rows as they are in the file
+        rgb.resize((size_t)lease.width * lease.height * 3);
+        for (size_t i = 0; i < (size_t)lease.width * lease.height; i++)
+            memcpy(&rgb[i * 3], pixels + i * 4, 3);
+        mandelbrot_frame_buffer_free(pixels);
+
+        if (!mandelbrot_socket_send(fd, &lease, sizeof(lease)) ||
+            !mandelbrot_socket_send(fd, rgb.data(), rgb.size()))
+            break;
+        nTiles++;
+    }
+
+    const bool done = lease.tile < 0;
+    close(fd);
+
+    if (!done)
+        fprintf(stderr, "Worker %d lost the coordinator after %d tiles\n", (int)getpid(), nTiles);
+
+    return done ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
+// Coordinator
+//------------------------------------------------------------------------------
+
+static std::vector<FarmTile> split_tiles(const RenderParams& params, int tileSize)
+{
+    std::vector<FarmTile> tiles;
+    for (int y = 0; y < params.height; y += tileSize)
+        for (int x = 0; x < params.width; x += tileSize)
+            tiles.push_back({ x, y, std::min(tileSize, params.width  - x),
+                                    std::min(tileSize, params.height - y), false });
+
+    return tiles;
+}
+
+static pid_t spawn_worker(const char* address, int nThreads)
+{
+    char threads[16];
+    snprintf(threads, sizeof(threads), "%d", nThreads);
+
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        execl("/proc/self/exe", "mandelbrot", "worker", "--connect", address,
+              "--threads", threads, (char*)NULL);
+        _exit(127);
+    }
+
+    return pid;
+}
+
+class FarmCoordinator
+{
+public:
+    FarmCoordinator(const FarmJob& job, const RenderParams& params, int listenFd, uint8_t* rows)
+        : job_(job),
+          params_(params),
+          listenFd_(listenFd),
+          rows_(rows),
+          tiles_(split_tiles(params, job.tileSize)),
+          nDone_(0),
+          nReleased_(0),
+          nDuplicated_(0)
+    {
+        for (int i = 0; i < (int)tiles_.size(); i++)
+            pending_.push_back(i);
+
+        message_ = {};
+        message_.magic         = FARM_MAGIC;
+        message_.version       = FARM_VERSION;
+        message_.maxIterations = params.maxIterations;
+        message_.maxRadius     = params.maxRadius;
+        message_.isa           = params.isa;
+        message_.width         = params.width;
+        message_.height        = params.height;
+        message_.scale         = job.batch.scale;
+        pack_center(job.batch.shiftX, &message_.shiftXNegative, message_.shiftX);
+        pack_center(job.batch.shiftY, &message_.shiftYNegative, message_.shiftY);
+        snprintf(message_.modeName, sizeof(message_.modeName), "%s", job.batch.modeName);
+    }
+
+    ~FarmCoordinator()
+    {
+        for (FarmWorker& worker : workers_)
+            if (worker.fd >= 0)
+                close(worker.fd);
+    }
+
+    FarmCoordinator(const FarmCoordinator&) = delete;
+    FarmCoordinator& operator=(const FarmCoordinator&) = delete;
+
+    // false if spawned workers are all gone before the end
+    bool run(const std::vector<pid_t>& spawned);
+
+    void finish();
+    void print_stats(FILE* file, double seconds) const;
+
+    int nReleased()   const { return nReleased_; }
+    int nDuplicated() const { return nDuplicated_; }
+
+private:
+    void accept_workers();
+    void lease_tiles();
+    void expire_leases();
+    void duplicate_leases();
+    bool receive_tile(FarmWorker& worker);
+    void drop_worker(FarmWorker& worker);
+    int  nConnected() const;
+
+    const FarmJob           job_;
+    const RenderParams      params_;
+    const int               listenFd_;
+    uint8_t*                rows_;
+    FarmJobMessage          message_;
+    std::vector<FarmTile>   tiles_;
+    std::deque<int>         pending_;
+    std::vector<FarmWorker> workers_;
+    std::vector<uint8_t>    discard_;
+    int                     nDone_;
+    int                     nReleased_;
+    int                     nDuplicated_;
+};
+
+int FarmCoordinator::nConnected() const
+{
+    return (int)std::count_if(workers_.begin(), workers_.end(),
+                              [](const FarmWorker& worker) { return worker.fd >= 0; });
+}
+
+void FarmCoordinator::accept_workers()
+{
+    for (;;)
+    {
+        const int fd = accept(listenFd_, NULL, NULL);
+        if (fd < 0)
+            return;
+
+        // A worker that takes longer to send a started tile is dead
+        mandelbrot_socket_timeout(fd, job_.leaseMs);
+
+        if (!mandelbrot_socket_send(fd, &message_, sizeof(message_)))
+        {
+            close(fd);
+            continue;
+        }
+
+        FarmWorker worker = {};
+        worker.fd        = fd;
+        worker.connected = Clock::now();
+        workers_.push_back(worker);
+    }
+}
+
+// With nothing left to lease, an idle worker races the oldest lease of
+// another, so the end of a job doesn't wait for the slowest worker
+void FarmCoordinator::duplicate_leases()
+{
+    for (const FarmWorker& idle : workers_)
+    {
+        if (idle.fd < 0 || !idle.leases.empty() || !pending_.empty())
+            continue;
+
+        FarmLease* oldest = NULL;
+        for (FarmWorker& worker : workers_)
+            for (FarmLease& lease : worker.leases)
+                if (!lease.expired && !tiles_[lease.tile].done &&
+                    (!oldest || lease.deadline < oldest->deadline))
+                    oldest = &lease;
+
+        if (!oldest)
+            return;
+
+        oldest->expired = true;
+        pending_.push_back(oldest->tile);
+        nDuplicated_++;
+    }
+}
+
+// Workers waiting on an expired lease get nothing until it comes back
+void FarmCoordinator::lease_tiles()
+{
+    for (FarmWorker& worker : workers_)
+    {
+        const bool stalled = std::any_of(worker.leases.begin(), worker.leases.end(),
+                                         [](const FarmLease& lease) { return lease.expired; });
+
+        while (worker.fd >= 0 && !stalled && !pending_.empty() &&
+               (int)worker.leases.size() < FARM_LEASES_PER_WORKER)
+        {
+            const int tile = pending_.front();
+            pending_.pop_front();
+            if (tiles_[tile].done)
+                continue;
+
+            const FarmTile&       t       = tiles_[tile];
+            const FarmTileMessage message = { tile, t.x, t.y, t.width, t.height };
+            if (!mandelbrot_socket_send(worker.fd, &message, sizeof(message)))
+            {
+                pending_.push_front(tile);
+                drop_worker(worker);
+                break;
+            }
+
+            worker.leases.push_back({ tile, Clock::now() + std::chrono::milliseconds(job_.leaseMs),
+                                      false });
+        }
+    }
+}
+
+void FarmCoordinator::expire_leases()
+{
+    const Clock::time_point now = Clock::now();
+
+    for (FarmWorker& worker : workers_)
+        for (FarmLease& lease : worker.leases)
+            if (!lease.expired && lease.deadline < now && !tiles_[lease.tile].done)
+            {
+                lease.expired = true;
+                pending_.push_front(lease.tile);
+                nReleased_++;
+            }
+}
+
+// Its leases that didn't expire already go to the others first
+void FarmCoordinator::drop_worker(FarmWorker& worker)
+{
+    for (const FarmLease& lease : worker.leases)
+        if (!lease.expired && !tiles_[lease.tile].done)
+        {
+            pending_.push_front(lease.tile);
+            nReleased_++;
+        }
+
+    worker.leases.clear();
+    close(worker.fd);
+    worker.fd   = -1;
+    worker.left = Clock::now();
+}
+
+// Rows go straight into the mapped file, late duplicates are read and dropped
+bool FarmCoordinator::receive_tile(FarmWorker& worker)
+{
+    FarmTileMessage result;
+    if (!mandelbrot_socket_recv(worker.fd, &result, sizeof(result)))
+        return false;
+
+    auto lease = std::find_if(worker.leases.begin(), worker.leases.end(),
+                              [&](const FarmLease& l) { return l.tile == result.tile; });
+    if (lease == worker.leases.end())
+        return false;
+
+    FarmTile& tile = tiles_[result.tile];
+    if (result.x != tile.x || result.y != tile.y ||
+        result.width != tile.width || result.height != tile.height)
+        return false;
+
+    const size_t tileRowBytes  = (size_t)tile.width * 3;
+    const size_t imageRowBytes = (size_t)params_.width * 3;
+
+    discard_.resize(tileRowBytes);
+    for (int y = 0; y < tile.height; y++)
+    {
+        uint8_t* row = tile.done ? discard_.data()
+                                 : rows_ + (size_t)(tile.y + y) * imageRowBytes + (size_t)tile.x * 3;
+        if (!mandelbrot_socket_recv(worker.fd, row, tileRowBytes))
+            return false;
+    }
+
+    worker.leases.erase(lease);
+    if (tile.done)
+    {
+        worker.nLate++;
+        return true;
+    }
+
+    tile.done = true;
+    nDone_++;
+    worker.nTiles++;
+    worker.nPixels += (uint64_t)tile.width * tile.height;
+
+    return true;
+}
+
+bool FarmCoordinator::run(const std::vector<pid_t>& spawned)
+{
+    const Clock::time_point start = Clock::now();
+    int nExited = 0;
+
+    while (nDone_ < (int)tiles_.size())
+    {
+        accept_workers();
+        expire_leases();
+        duplicate_leases();
+        lease_tiles();
+
+        std::vector<pollfd> fds(1, { listenFd_, POLLIN, 0 });
+        std::vector<int>    owners(1, -1);
+        for (int i = 0; i < (int)workers_.size(); i++)
+            if (workers_[i].fd >= 0)
+            {
+                fds.push_back({ workers_[i].fd, POLLIN, 0 });
+                owners.push_back(i);
+            }
+
+        if (poll(fds.data(), fds.size(), FARM_POLL_MS) < 0 && errno != EINTR)
+            return false;
+
+        for (size_t i = 1; i < fds.size(); i++)
+        {
+            FarmWorker& worker = workers_[owners[i]];
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !receive_tile(worker))
+                drop_worker(worker);
+        }
+
+        // Remote workers may still come, spawned ones not
+        while (nExited < (int)spawned.size() && waitpid(-1, NULL, WNOHANG) > 0)
+            nExited++;
+        if (!spawned.empty() && nExited == (int)spawned.size() && nConnected() == 0)
+        {
+            fprintf(stderr, "\nEvery worker exited with %d of %d tiles done\n",
+                    nDone_, (int)tiles_.size());
+            return false;
+        }
+
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        printf("\r%s: %d / %d tiles, %d workers, %.2f Mpix/s   ", job_.batch.output, nDone_,
+               (int)tiles_.size(), nConnected(),
+               (double)params_.width * params_.height * nDone_ / tiles_.size() / seconds / 1e6);
+        fflush(stdout);
+    }
+    printf("\n");
+
+    return true;
+}
+
+// Tells the workers there is no more work and waits for them to go
+void FarmCoordinator::finish()
+{
+    const FarmTileMessage done = { -1, 0, 0, 0, 0 };
+
+    for (FarmWorker& worker : workers_)
+        if (worker.fd >= 0)
+            mandelbrot_socket_send(worker.fd, &done, sizeof(done));
+
+    for (FarmWorker& worker : workers_)
+    {
+        if (worker.fd < 0)
+            continue;
+
+        // Tiles leased twice come before it, the worker blocks until they are read
+        while (!worker.leases.empty() && receive_tile(worker))
+            ;
+
+        close(worker.fd);
+        worker.fd   = -1;
+        worker.left = Clock::now();
+    }
+}
+
+void FarmCoordinator::print_stats(FILE* file, double seconds) const
+{
+    fprintf(file, "%d workers, %d tiles of %d pixels in %.3f s, %.2f Mpix/s, "
+                  "%d leases released, %d raced at the end\n",
+            (int)workers_.size(), (int)tiles_.size(), job_.tileSize, seconds,
+            (double)params_.width * params_.height / seconds / 1e6, nReleased_, nDuplicated_);
+
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+        const FarmWorker& worker = workers_[i];
+        const double connected = std::chrono::duration<double>(worker.left - worker.connected).count();
+
+        fprintf(file, "  worker %2d: %5d tiles, %4d late, %8.2f Mpix/s over %.3f s connected\n",
+                (int)i, worker.nTiles, worker.nLate,
+                connected > 0.0 ? worker.nPixels / connected / 1e6 : 0.0, connected);
+    }
+}
+
+static bool render_once(const FarmJob& job, const RenderParams& params, int nSpawn, FarmRun* run)
+{
+    const int listenFd = mandelbrot_socket_listen(job.address);
+    if (listenFd < 0)
+        return false;
+
+    ImageFile image = {};
+    if (!mandelbrot_image_create(&image, job.batch.output, job.batch.format,
+                                 params.width, params.height))
+    {
+        fprintf(stderr, "Can't create %s\n", job.batch.output);
+        mandelbrot_socket_close_listen(listenFd, job.address);
+        return false;
+    }
+
+    uint8_t* rows = mandelbrot_image_map_rows(&image);
+    if (!rows)
+    {
+        fprintf(stderr, "Can't map the rows of %s\n", job.batch.output);
+        mandelbrot_image_close(&image);
+        mandelbrot_socket_close_listen(listenFd, job.address);
+        return false;
+    }
+
+    std::vector<pid_t> spawned;
+    for (int i = 0; i < nSpawn; i++)
+        spawned.push_back(spawn_worker(job.address, params.nThreads));
+
+    printf("Rendering %s on %s with %s, %d local workers\n", job.batch.output, job.address,
+           job.batch.modeName, nSpawn);
+
+    const Clock::time_point start = Clock::now();
+
+    bool ok = false;
+    {
+        FarmCoordinator coordinator(job, params, listenFd, rows);
+        ok = coordinator.run(spawned);
+
+        // The image is complete, the workers may still be busy with raced tiles
+        run->nWorkers  = nSpawn;
+        run->seconds   = std::chrono::duration<double>(Clock::now() - start).count();
+        run->nReleased = coordinator.nReleased();
+
+        coordinator.finish();
+        coordinator.print_stats(stdout, run->seconds);
+    }
+
+    for (pid_t pid : spawned)
+    {
+        if (!ok)
+            kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+
+    mandelbrot_image_unmap_rows(&image, rows);
+    mandelbrot_socket_close_listen(listenFd, job.address);
+
+    if (!mandelbrot_image_finish(&image))
+    {
+        fprintf(stderr, "Can't write %s\n", job.batch.output);
+        return false;
+    }
+
+    return ok;
+}
+
+int mandelbrot_farm_render(const FarmJob& job, const RenderParams& params)
+{
+    if (job.batch.format == IMAGE_PNG)
+    {
+        fprintf(stderr, "Farm renders write tiles in any order, use tiff or raw\n");
+        return 1;
+    }
+
+    // 1, 2, 4 ... and all of them
+    std::vector<int> nWorkers(1, job.nWorkers);
+    if (job.scaling)
+    {
+        nWorkers.clear();
+        for (int n = 1; n < job.nWorkers; n *= 2)
+            nWorkers.push_back(n);
+        nWorkers.push_back(job.nWorkers);
+    }
+
+    std::vector<FarmRun> runs;
+    for (int n : nWorkers)
+    {
+        FarmRun run = {};
+        if (!render_once(job, params, n, &run))
+            return 1;
+        runs.push_back(run);
+    }
+
+    if (runs.size() > 1)
+    {
+        printf("Scaling against one worker:\n");
+        for (const FarmRun& run : runs)
+        {
+            const double speedup = runs[0].seconds / run.seconds;
+            printf("%3d workers  %8.3f s  %8.2f Mpix/s  %6.2fx  %5.1f%%  %d leases released\n",
+                   run.nWorkers, run.seconds,
+                   (double)params.width * params.height / run.seconds / 1e6,
+                   speedup, 100.0 * speedup / run.nWorkers, run.nReleased);
+        }
+    }
+
+    return 0;
+}
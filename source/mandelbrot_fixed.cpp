@@ -0,0 +1,273 @@
+#include "mandelbrot_fixed.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_double.h"
+#include "mandelbrot_interior.h"
+#include "mandelbrot_palette.h"
+
+#include <algorithm>
+#include <cmath>
+#include <x86intrin.h>
+
+// Frame constants in the fixed-point format of the frame
+struct FixedFrame
+{
+    int fractionBits;
+    // 2^fractionBits and 2^-fractionBits, exact
+    double  unit;
+    double  invUnit;
+
+    int64_t c_x0;
+    int64_t c_y0;
+    double  c_step_x;
+    double  c_step_y;
+
+    // |x| and |y| of a lane inside the radius are below maxRadius, so
+    // x^2 + y^2 can be formed without overflow
+    int64_t maxRadius;
+    int64_t maxRadius2;
+};
+
+// The format of totalBits with the most fraction bits that still holds
+// every value an active lane can reach: z of a lane that was inside the
+// radius stays below R^2 + |c|, and x^2 + y^2 with |x|, |y| < R below
+// 2R^2. false if that leaves fewer than minFractionBits.
+static bool fixed_frame(const RenderParams& params, double magnifier,
+                        const BigFixed& shiftX, const BigFixed& shiftY,
+                        int totalBits, int minFractionBits, FixedFrame* frame)
+{
+    magnifier += MAGNIFIER_OFFSET;
+
+    const double invMagnifier = 1.0 / magnifier;
+
+    // The origin, steps and format of the whole view, so that every
+    // window of it has the same
+    const RenderParams view = view_params(params);
+
+    const double c_step_x = aspect_ratio_double(view) * invMagnifier * (2.0 / view.width);
+    const double c_step_y = invMagnifier * (2.0 / view.height);
+
+    // Added one at a time: the offset and the half width summed in double
+    // would round the origin to double precision
+    const BigFixed originX = bf_add(bf_add(shiftX, bf_from_double(SHIFT_X_OFFSET)),
+                                    bf_from_double(-aspect_ratio_double(view) * invMagnifier));
+    const BigFixed originY = bf_add(shiftY, bf_from_double(-invMagnifier));
+
+    const double x0 = bf_to_double(originX);
+    const double y0 = bf_to_double(originY);
+    const double maxCoord = std::max(std::max(std::fabs(x0), std::fabs(x0 + c_step_x * view.width)),
+                                     std::max(std::fabs(y0), std::fabs(y0 + c_step_y * view.height)));
+
+    const double radius2 = max_radius_2(params);
+    const double bound   = std::max(2.0 * radius2, radius2 + maxCoord);
+
+    // Sign bit and the integer bits of bound
+    const int integerBits  = 1 + std::max(0, (int)std::ceil(std::log2(bound)));
+    const int fractionBits = totalBits - integerBits;
+    if (fractionBits < minFractionBits)
+        return false;
+
+    frame->fractionBits = fractionBits;
+    frame->unit         = std::ldexp(1.0, fractionBits);
+    frame->invUnit      = std::ldexp(1.0, -fractionBits);
+
+    frame->c_x0     = bf_to_fixed(originX, fractionBits);
+    frame->c_y0     = bf_to_fixed(originY, fractionBits);
+    frame->c_step_x = c_step_x;
+    frame->c_step_y = c_step_y;
+
+    frame->maxRadius  = (int64_t)std::ceil(std::ldexp(params.maxRadius, fractionBits));
+    frame->maxRadius2 = std::llround(std::ldexp(radius2, fractionBits));
+
+    return true;
+}
+
+// c_0 + i * step in the format of the frame. The offset is rounded as a
+// whole: a rounded step would drift by up to half an ulp per pixel,
+// several pixels across the frame at deep zoom.
+static inline int64_t fixed_coord(const FixedFrame& frame, int64_t c_0, double c_step, int i)
+{
+    return c_0 + std::llround(c_step * i * frame.unit);
+}
+
+// is_in_cardioid_or_bulb in double: past the float limit the float check
+// would mark exterior pixels next to the boundary
+static inline bool cardioid_or_bulb(double c_x, double c_y)
+{
+    const double x  = c_x - 0.25;
+    const double y2 = c_y * c_y;
+    const double q  = x * x + y2;
+
+    if (q * (q + x) < 0.25 * y2)
+        return true;
+
+    const double x1 = c_x + 1.0;
+    return x1 * x1 + y2 < 0.0625;
+}
+
+// a * b in the format of a and b for non-negative a and b, from the four
+// 32x32-bit products of their halves. Bits below the fraction are
+// truncated in each partial product, an error of at most 2 ulps.
+// shift is the number of fraction bits, from 33 to 63.
+static inline __m256i mul_fixed64(__m256i _a, __m256i _b, __m128i _shift, __m128i _shiftHigh,
+                                  __m128i _shiftCross)
+{
+    const __m256i _a_hi = _mm256_srli_epi64(_a, 32);
+    const __m256i _b_hi = _mm256_srli_epi64(_b, 32);
+
+    // a_hi < 2^31, so the sum of the cross products stays below 2^64
+    const __m256i _cross = _mm256_add_epi64(_mm256_mul_epu32(_a_hi, _b), _mm256_mul_epu32(_a, _b_hi));
+
+    return _mm256_add_epi64(_mm256_add_epi64(_mm256_sll_epi64(_mm256_mul_epu32(_a_hi, _b_hi), _shiftHigh),
+                                             _mm256_srl_epi64(_cross, _shiftCross)),
+                            _mm256_srl_epi64(_mm256_mul_epu32(_a, _b), _shift));
+}
+
+// a * a, the cross product is doubled in the shift
+static inline __m256i square_fixed64(__m256i _a, __m128i _shift, __m128i _shiftHigh,
+                                     __m128i _shiftCross2)
+{
+    const __m256i _a_hi = _mm256_srli_epi64(_a, 32);
+
+    return _mm256_add_epi64(_mm256_add_epi64(_mm256_sll_epi64(_mm256_mul_epu32(_a_hi, _a_hi), _shiftHigh),
+                                             _mm256_srl_epi64(_mm256_mul_epu32(_a_hi, _a), _shiftCross2)),
+                            _mm256_srl_epi64(_mm256_mul_epu32(_a, _a), _shift));
+}
+
+// Lanes known to never escape start in _interior, as in the double kernel
+static inline __m256i iterate_fixed64(__m256i _c_x, __m256i _c_y, __m256i _interior,
+                                      const RenderParams& params, const FixedFrame& frame)
+{
+    const int fractionBits = frame.fractionBits;
+
+    const __m128i _shift       = _mm_cvtsi32_si128(fractionBits);
+    const __m128i _shiftHigh   = _mm_cvtsi32_si128(64 - fractionBits);
+    const __m128i _shiftCross  = _mm_cvtsi32_si128(fractionBits - 32);
+    const __m128i _shiftCross2 = _mm_cvtsi32_si128(fractionBits - 33);
+
+    const __m256i _maxRadius  = _mm256_set1_epi64x(frame.maxRadius);
+    const __m256i _maxRadius2 = _mm256_set1_epi64x(frame.maxRadius2);
+    const __m256i _zero       = _mm256_setzero_si256();
+
+    __m256i _z_x = _mm256_setzero_si256();
+    __m256i _z_y = _mm256_setzero_si256();
+
+    __m256i _iterations = _mm256_setzero_si256();
+
+    // Overflowed lanes may wrap back inside the radius, so a lane stays
+    // done once it escaped
+    __m256i _active = _mm256_set1_epi64x(-1);
+
+    __m256i _check_x = _mm256_setzero_si256();
+    __m256i _check_y = _mm256_setzero_si256();
+    int checkLength    = PERIOD_CHECK_START;
+    int checkRemaining = PERIOD_CHECK_START;
+
+    for (int iteration = 0; iteration < params.maxIterations; iteration++)
+    {
+        // |x| = (x ^ sign) - sign, AVX2 has no 64-bit abs
+        const __m256i _sign_x = _mm256_cmpgt_epi64(_zero, _z_x);
+        const __m256i _sign_y = _mm256_cmpgt_epi64(_zero, _z_y);
+        const __m256i _abs_x  = _mm256_sub_epi64(_mm256_xor_si256(_z_x, _sign_x), _sign_x);
+        const __m256i _abs_y  = _mm256_sub_epi64(_mm256_xor_si256(_z_y, _sign_y), _sign_y);
+
+        const __m256i _inside = _mm256_and_si256(_mm256_cmpgt_epi64(_maxRadius, _abs_x),
+                                                 _mm256_cmpgt_epi64(_maxRadius, _abs_y));
+
+        const __m256i _z_x2 = square_fixed64(_abs_x, _shift, _shiftHigh, _shiftCross2);
+        const __m256i _z_y2 = square_fixed64(_abs_y, _shift, _shiftHigh, _shiftCross2);
+
+        const __m256i _radius2 = _mm256_add_epi64(_z_x2, _z_y2);
+
+        _active = _mm256_andnot_si256(_interior,
+                                      _mm256_and_si256(_active, _mm256_and_si256(_inside,
+                                                                                 _mm256_cmpgt_epi64(_maxRadius2, _radius2))));
+        if (_mm256_testz_si256(_active, _active))
+            break;
+
+        // Each lane of the mask is a 64-bit -1 for an active pixel
+        _iterations = _mm256_sub_epi64(_iterations, _active);
+
+        const __m256i _sign_xy = _mm256_xor_si256(_sign_x, _sign_y);
+        __m256i _z_xy = mul_fixed64(_abs_x, _abs_y, _shift, _shiftHigh, _shiftCross);
+        _z_xy = _mm256_sub_epi64(_mm256_xor_si256(_z_xy, _sign_xy), _sign_xy);
+
+        _z_x = _mm256_add_epi64(_c_x, _mm256_sub_epi64(_z_x2, _z_y2));
+        _z_y = _mm256_add_epi64(_c_y, _mm256_add_epi64(_z_xy, _z_xy));
+
+        // Fixed-point orbits are exact functions of z, so a repeat is a cycle
+        const __m256i _periodic = _mm256_and_si256(_mm256_cmpeq_epi64(_z_x, _check_x),
+                                                   _mm256_cmpeq_epi64(_z_y, _check_y));
+        _interior = _mm256_or_si256(_interior, _mm256_and_si256(_periodic, _active));
+
+        if (--checkRemaining == 0)
+        {
+            _check_x = _z_x;
+            _check_y = _z_y;
+            checkLength   *= 2;
+            checkRemaining = checkLength;
+        }
+    }
+
+    return _mm256_blendv_epi8(_iterations, _mm256_set1_epi64x(params.maxIterations), _interior);
+}
+
+void mandelbrot_fixed64_ranged(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                               const BigFixed& shiftX, const BigFixed& shiftY,
+                               int y_from, int y_to)
+{
+    FixedFrame frame = {};
+    if (!fixed_frame(params, magnifier, shiftX, shiftY, 64, 33, &frame))
+    {
+        mandelbrot_double_ranged(pixels, params, magnifier, bf_to_double(shiftX), bf_to_double(shiftY),
+                                 y_from, y_to);
+        return;
+    }
+
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+    for (int screenY = y_from; screenY < y_to; ++screenY)
+    {
+        const int64_t c_y_fixed = fixed_coord(frame, frame.c_y0, frame.c_step_y,
+                                              params.y_offset + screenY);
+        const __m256i _c_y      = _mm256_set1_epi64x(c_y_fixed);
+        const double  c_y       = (double)c_y_fixed * frame.invUnit;
+
+        uint16_t* rowIterations = iterations + (size_t)screenY * params.width;
+        for (int screenX = 0; screenX < params.width; screenX += 4)
+        {
+            const int x = params.x_offset + screenX;
+            const __m256i _c_x = _mm256_set_epi64x(fixed_coord(frame, frame.c_x0, frame.c_step_x, x + 3),
+                                                   fixed_coord(frame, frame.c_x0, frame.c_step_x, x + 2),
+                                                   fixed_coord(frame, frame.c_x0, frame.c_step_x, x + 1),
+                                                   fixed_coord(frame, frame.c_x0, frame.c_step_x, x));
+
+            alignas(32) int64_t c_x[4];
+            _mm256_store_si256((__m256i*)c_x, _c_x);
+
+            // The interior checks need c only to double precision
+            alignas(32) int64_t interior[4];
+            for (int i = 0; i < 4; i++)
+                interior[i] = cardioid_or_bulb((double)c_x[i] * frame.invUnit, c_y) ? -1 : 0;
+
+            const __m256i _iterations = iterate_fixed64(_c_x, _c_y,
+                                                        _mm256_load_si256((const __m256i*)interior),
+                                                        params, frame);
+
+            long long iterationsArray[4];
+            _mm256_storeu_si256((__m256i*)iterationsArray, _iterations);
+            // Lanes past the last column are dropped
+            for (int i = 0; i < 4 && screenX + i < params.width; i++)
+                rowIterations[screenX + i] = (uint16_t)iterationsArray[i];
+        }
+
+        mandelbrot_colorize(pixels, params, iterations, palette,
+                            0, params.width, screenY, screenY + 1);
+    }
+}
+
+void mandelbrot_fixed64(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                        const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    mandelbrot_fixed64_ranged(pixels, params, magnifier, shiftX, shiftY, 0, params.height);
+}
@@ -0,0 +1,612 @@
+#include "mandelbrot_fractal.h"
+#include "mandelbrot_deep.h"
+#include "mandelbrot_interior.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_vectorized.h"
+
+#include <cstring>
+#include <immintrin.h>
+#include <omp.h>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Lanes: the precision of a variant
+//------------------------------------------------------------------------------
+
+struct FloatLanes
+{
+    typedef __m256 Vec;
+    typedef float  Scalar;
+    static const int N = 8;
+
+    static inline Vec set1(Scalar a)       { return _mm256_set1_ps(a); }
+    static inline Vec ramp()               { return _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0); }
+    static inline Vec add (Vec a, Vec b)   { return _mm256_add_ps(a, b); }
+    static inline Vec sub (Vec a, Vec b)   { return _mm256_sub_ps(a, b); }
+    static inline Vec mul (Vec a, Vec b)   { return _mm256_mul_ps(a, b); }
+    static inline Vec abs (Vec a)          { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static inline Vec less(Vec a, Vec b)   { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline Vec equal(Vec a, Vec b)  { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static inline Vec both(Vec a, Vec b)   { return _mm256_and_ps(a, b); }
+    static inline Vec either(Vec a, Vec b) { return _mm256_or_ps(a, b); }
+    static inline Vec but (Vec a, Vec b)   { return _mm256_andnot_ps(b, a); }
+    static inline int any (Vec mask)       { return _mm256_movemask_ps(mask); }
+    static inline void store(Scalar* p, Vec a) { _mm256_storeu_ps(p, a); }
+};
+
+struct DoubleLanes
+{
+    typedef __m256d Vec;
+    typedef double  Scalar;
+    static const int N = 4;
+
+    static inline Vec set1(Scalar a)       { return _mm256_set1_pd(a); }
+    static inline Vec ramp()               { return _mm256_set_pd(3, 2, 1, 0); }
+    static inline Vec add (Vec a, Vec b)   { return _mm256_add_pd(a, b); }
+    static inline Vec sub (Vec a, Vec b)   { return _mm256_sub_pd(a, b); }
+    static inline Vec mul (Vec a, Vec b)   { return _mm256_mul_pd(a, b); }
+    static inline Vec abs (Vec a)          { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static inline Vec less(Vec a, Vec b)   { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static inline Vec equal(Vec a, Vec b)  { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    static inline Vec both(Vec a, Vec b)   { return _mm256_and_pd(a, b); }
+    static inline Vec either(Vec a, Vec b) { return _mm256_or_pd(a, b); }
+    static inline Vec but (Vec a, Vec b)   { return _mm256_andnot_pd(b, a); }
+    static inline int any (Vec mask)       { return _mm256_movemask_pd(mask); }
+    static inline void store(Scalar* p, Vec a) { _mm256_storeu_pd(p, a); }
+};
+
+//------------------------------------------------------------------------------
+// Formulas
+//------------------------------------------------------------------------------
+
+template <class L>
+static inline void complex_square(typename L::Vec x, typename L::Vec y,
+                                  typename L::Vec* r_x, typename L::Vec* r_y)
+{
+    *r_x = L::sub(L::mul(x, x), L::mul(y, y));
+    *r_y = L::mul(L::add(x, x), y);
+}
+
+template <class L>
+static inline void complex_multiply(typename L::Vec a_x, typename L::Vec a_y,
+                                    typename L::Vec b_x, typename L::Vec b_y,
+                                    typename L::Vec* r_x, typename L::Vec* r_y)
+{
+    *r_x = L::sub(L::mul(a_x, b_x), L::mul(a_y, b_y));
+    *r_y = L::add(L::mul(a_x, b_y), L::mul(a_y, b_x));
+}
+
+// z^N by squaring, unrolled at compile time: z^8 takes three squares,
+// z^7 two squares and two multiplications
+template <int N>
+struct ComplexPower
+{
+    template <class L>
+    static inline void apply(typename L::Vec x, typename L::Vec y,
+                             typename L::Vec* r_x, typename L::Vec* r_y)
+    {
+        typename L::Vec h_x, h_y;
+        ComplexPower<N / 2>::template apply<L>(x, y, &h_x, &h_y);
+        complex_square<L>(h_x, h_y, r_x, r_y);
+
+        // A constant, folded away
+        if (N % 2 == 1)
+            complex_multiply<L>(*r_x, *r_y, x, y, r_x, r_y);
+    }
+};
+
+template <>
+struct ComplexPower<1>
+{
+    template <class L>
+    static inline void apply(typename L::Vec x, typename L::Vec y,
+                             typename L::Vec* r_x, typename L::Vec* r_y)
+    {
+        *r_x = x;
+        *r_y = y;
+    }
+};
+
+// is_in_cardioid_or_bulb for a vector of points
+template <class L>
+static inline typename L::Vec cardioid_or_bulb(typename L::Vec c_x, typename L::Vec c_y)
+{
+    typedef typename L::Vec Vec;
+
+    const Vec x  = L::sub(c_x, L::set1(0.25));
+    const Vec y2 = L::mul(c_y, c_y);
+    const Vec q  = L::add(L::mul(x, x), y2);
+
+    const Vec cardioid = L::less(L::mul(q, L::add(q, x)), L::mul(L::set1(0.25), y2));
+
+    const Vec x1   = L::add(c_x, L::set1(1));
+    const Vec bulb = L::less(L::add(L::mul(x1, x1), y2), L::set1(0.0625));
+
+    return L::either(cardioid, bulb);
+}
+
+// z^2 + c from z_x2 = z_x^2, z_y2 = z_y^2 and z_xy = z_x z_y, the
+// operations of mandelbrot_vectorized in its order
+template <class L>
+static inline void square_step(typename L::Vec* z_x, typename L::Vec* z_y,
+                               typename L::Vec z_x2, typename L::Vec z_y2, typename L::Vec z_xy,
+                               typename L::Vec c_x, typename L::Vec c_y)
+{
+    *z_x = L::add(c_x, L::sub(z_x2, z_y2));
+    *z_y = L::add(c_y, L::mul(L::set1(2), z_xy));
+}
+
+// Formulas step z given also its squares, which the escape test needs
+// anyway. JULIA formulas start from z = pixel and add the Julia constant, the
+// others start from z = 0 and add the pixel. CARDIOID ones are the
+// Mandelbrot set, whose cardioid and period-2 bulb are never iterated.
+template <int N>
+struct Multibrot
+{
+    static const bool JULIA    = false;
+    static const bool CARDIOID = N == 2;
+
+    template <class L>
+    static inline void step(typename L::Vec* z_x, typename L::Vec* z_y,
+                            typename L::Vec z_x2, typename L::Vec z_y2,
+                            typename L::Vec c_x, typename L::Vec c_y)
+    {
+        if (N == 2)
+        {
+            square_step<L>(z_x, z_y, z_x2, z_y2, L::mul(*z_x, *z_y), c_x, c_y);
+            return;
+        }
+
+        typename L::Vec p_x, p_y;
+        ComplexPower<N>::template apply<L>(*z_x, *z_y, &p_x, &p_y);
+        *z_x = L::add(p_x, c_x);
+        *z_y = L::add(p_y, c_y);
+    }
+};
+
+template <int N>
+struct Julia : Multibrot<N>
+{
+    static const bool JULIA    = true;
+    static const bool CARDIOID = false;
+};
+
+struct BurningShip
+{
+    static const bool JULIA    = false;
+    static const bool CARDIOID = false;
+
+    template <class L>
+    static inline void step(typename L::Vec* z_x, typename L::Vec* z_y,
+                            typename L::Vec z_x2, typename L::Vec z_y2,
+                            typename L::Vec c_x, typename L::Vec c_y)
+    {
+        square_step<L>(z_x, z_y, z_x2, z_y2, L::mul(L::abs(*z_x), L::abs(*z_y)), c_x, c_y);
+    }
+};
+
+//------------------------------------------------------------------------------
+// Engine
+//------------------------------------------------------------------------------
+
+static float juliaX = DEFAULT_JULIA_X;
+static float juliaY = DEFAULT_JULIA_Y;
+
+// The pixel grid of a frame, set up with the operations of the kernel
+// of the same precision: mandelbrot_vectorized_coords in float,
+// mandelbrot_double_coords in double. The float z^2 variant thus
+// iterates the very points mandelbrot_vectorized does.
+template <class L>
+struct FractalGrid
+{
+    typename L::Scalar x0;
+    typename L::Scalar y0;
+    typename L::Scalar stepX;
+    typename L::Scalar stepY;
+};
+
+static FractalGrid<FloatLanes> fractal_grid(FloatLanes, const RenderParams& params,
+                                            float magnifier, float shiftX)
+{
+    shiftX    += SHIFT_X_OFFSET;
+    magnifier += MAGNIFIER_OFFSET;
+
+    const float invMagnifier = 1.0f / magnifier;
+
+    return { shiftX - aspect_ratio(params) * invMagnifier, -1.0f * invMagnifier,
+             aspect_ratio(params) * invMagnifier * (2.0f / params.width),
+             invMagnifier * (2.0f / params.height) };
+}
+
+static FractalGrid<DoubleLanes> fractal_grid(DoubleLanes, const RenderParams& params,
+                                             float magnifier, float shiftX)
+{
+    const double invMagnifier = 1.0 / ((double)magnifier + MAGNIFIER_OFFSET);
+
+    return { (double)shiftX + SHIFT_X_OFFSET - aspect_ratio_double(params) * invMagnifier,
+             0.0 - invMagnifier,
+             aspect_ratio_double(params) * invMagnifier * (2.0 / params.width),
+             invMagnifier * (2.0 / params.height) };
+}
+
+// c_x of successive blocks of a row and c_y of successive rows. Float
+// steps the columns as mandelbrot_vectorized does, 8 at a time from the
+// left edge, so a block in the middle of a row replays the steps before
+// it. Rows, and in double columns too, are computed from their index.
+template <class L>
+struct FractalCursor;
+
+template <>
+struct FractalCursor<FloatLanes>
+{
+    const FractalGrid<FloatLanes>& grid;
+
+    static __m256 column_step(const FractalGrid<FloatLanes>& grid)
+    {
+        return _mm256_set1_ps(grid.stepX * 8);
+    }
+
+    __m256 first_column(int x) const
+    {
+        __m256 _c_x = _mm256_add_ps(_mm256_set1_ps(grid.x0),
+                                    _mm256_mul_ps(_mm256_set1_ps(grid.stepX), FloatLanes::ramp()));
+        for (int block = 0; block < x; block += 8)
+            _c_x = _mm256_add_ps(_c_x, column_step(grid));
+        return _c_x;
+    }
+
+    __m256 next_column(__m256 _c_x, int) const
+    {
+        return _mm256_add_ps(_c_x, column_step(grid));
+    }
+
+    float first_row(int y) const
+    {
+        return grid.y0 + grid.stepY * y;
+    }
+
+    float next_row(float, int y) const
+    {
+        return first_row(y);
+    }
+};
+
+template <>
+struct FractalCursor<DoubleLanes>
+{
+    const FractalGrid<DoubleLanes>& grid;
+
+    __m256d first_column(int x) const
+    {
+        const __m256d _x = _mm256_add_pd(_mm256_set1_pd(x), DoubleLanes::ramp());
+        return _mm256_add_pd(_mm256_set1_pd(grid.x0), _mm256_mul_pd(_mm256_set1_pd(grid.stepX), _x));
+    }
+
+    __m256d next_column(__m256d, int x) const
+    {
+        return first_column(x);
+    }
+
+    double first_row(int y) const
+    {
+        return grid.y0 + grid.stepY * y;
+    }
+
+    double next_row(double, int y) const
+    {
+        return first_row(y);
+    }
+};
+
+// Iteration counts of the live lanes of p. Points in the cardioid or
+// the bulb and orbits that come back to a saved z (Brent, as in
+// mandelbrot_vectorized) stop early and count as maxIterations.
+template <class Formula, class L>
+static inline typename L::Vec fractal_lanes(const RenderParams& params,
+                                            typename L::Vec p_x, typename L::Vec p_y,
+                                            typename L::Vec live)
+{
+    typedef typename L::Vec    Vec;
+    typedef typename L::Scalar Scalar;
+
+    const Vec radius2 = L::set1((Scalar)max_radius_2(params));
+    const Vec one     = L::set1(1);
+
+    Vec z_x = Formula::JULIA ? p_x : L::set1(0);
+    Vec z_y = Formula::JULIA ? p_y : L::set1(0);
+    const Vec c_x = Formula::JULIA ? L::set1((Scalar)juliaX) : p_x;
+    const Vec c_y = Formula::JULIA ? L::set1((Scalar)juliaY) : p_y;
+
+    // Escaped lanes stay dead
+    Vec count    = L::set1(0);
+    Vec interior = L::set1(0);
+    if (Formula::CARDIOID)
+    {
+        interior = L::both(live, cardioid_or_bulb<L>(c_x, c_y));
+        live     = L::but(live, interior);
+    }
+
+    // The orbit starts at z, so that is the first z saved
+    Vec check_x = z_x;
+    Vec check_y = z_y;
+    int checkLength    = PERIOD_CHECK_START;
+    int checkRemaining = PERIOD_CHECK_START;
+
+    Vec z_x2 = L::mul(z_x, z_x);
+    Vec z_y2 = L::mul(z_y, z_y);
+
+    for (int it = 0; it < params.maxIterations; it++)
+    {
+        live = L::both(live, L::less(L::add(z_x2, z_y2), radius2));
+        if (!L::any(live))
+            break;
+
+        count = L::add(count, L::both(live, one));
+        Formula::template step<L>(&z_x, &z_y, z_x2, z_y2, c_x, c_y);
+
+        z_x2 = L::mul(z_x, z_x);
+        z_y2 = L::mul(z_y, z_y);
+
+        const Vec periodic = L::both(live, L::both(L::equal(z_x, check_x), L::equal(z_y, check_y)));
+        interior = L::either(interior, periodic);
+        live     = L::but(live, periodic);
+
+        if (--checkRemaining == 0)
+        {
+            check_x = z_x;
+            check_y = z_y;
+            checkLength   *= 2;
+            checkRemaining = checkLength;
+        }
+    }
+
+    return L::either(L::but(count, interior), L::both(interior, L::set1((Scalar)params.maxIterations)));
+}
+
+template <class L>
+static inline void store_counts(uint16_t* counts, typename L::Vec count, int n)
+{
+    typename L::Scalar lanes[L::N];
+    L::store(lanes, count);
+    for (int i = 0; i < L::N && i < n; i++)
+        counts[i] = (uint16_t)lanes[i];
+}
+
+// Counts of the columns x_from to x_to of row y, c_y the row's
+template <class Formula, class L>
+static void fractal_row(const RenderParams& params, const FractalCursor<L>& cursor,
+                        typename L::Scalar c_y, int x_from, int x_to, uint16_t* counts)
+{
+    typedef typename L::Vec    Vec;
+    typedef typename L::Scalar Scalar;
+
+    const Vec end = L::set1((Scalar)x_to);
+    const Vec p_y = L::set1(c_y);
+
+    Vec p_x = cursor.first_column(x_from);
+    for (int x = x_from; x < x_to; x += L::N)
+    {
+        // Lanes past x_to are never live
+        const Vec live = L::less(L::add(L::ramp(), L::set1((Scalar)x)), end);
+        store_counts<L>(counts + x, fractal_lanes<Formula, L>(params, p_x, p_y, live), x_to - x);
+
+        p_x = cursor.next_column(p_x, x + L::N);
+    }
+}
+
+template <class Formula, class L>
+static void fractal_tile(sf::Uint8* pixels, const RenderParams& params,
+                         float magnifier, float shiftX,
+                         int x_from, int x_to, int y_from, int y_to)
+{
+    const FractalGrid<L>   grid   = fractal_grid(L(), params, magnifier, shiftX);
+    const FractalCursor<L> cursor = { grid };
+
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+    typename L::Scalar c_y = cursor.first_row(y_from);
+    for (int y = y_from; y < y_to; y++, c_y = cursor.next_row(c_y, y))
+    {
+        fractal_row<Formula, L>(params, cursor, c_y, x_from, x_to,
+                                iterations + (size_t)y * params.width);
+        mandelbrot_colorize(pixels, params, iterations, palette, x_from, x_to, y, y + 1);
+    }
+}
+
+template <class Formula>
+static void fractal_points(const RenderParams& params, const float* c_x, const float* c_y,
+                           uint16_t* iterations, int n)
+{
+    const __m256 end = _mm256_set1_ps((float)n);
+
+    for (int i = 0; i < n; i += 8)
+    {
+        float x[8] = {};
+        float y[8] = {};
+        for (int j = 0; j < 8 && i + j < n; j++)
+        {
+            x[j] = c_x[i + j];
+            y[j] = c_y[i + j];
+        }
+
+        const __m256 live = FloatLanes::less(FloatLanes::add(FloatLanes::ramp(), _mm256_set1_ps((float)i)), end);
+        store_counts<FloatLanes>(iterations + i,
+                                 fractal_lanes<Formula, FloatLanes>(params, _mm256_loadu_ps(x),
+                                                                   _mm256_loadu_ps(y), live),
+                                 n - i);
+    }
+}
+
+template <class Formula, class L>
+static uint64_t fractal_count(const RenderParams& params, float magnifier, float shiftX)
+{
+    const FractalGrid<L>   grid   = fractal_grid(L(), params, magnifier, shiftX);
+    const FractalCursor<L> cursor = { grid };
+
+    uint64_t total = 0;
+
+#pragma omp parallel for schedule(guided, 1) reduction(+:total) num_threads(params.nThreads)
+    for (int y = 0; y < params.height; y++)
+    {
+        static thread_local std::vector<uint16_t> counts;
+        counts.resize(params.width);
+
+        fractal_row<Formula, L>(params, cursor, cursor.first_row(y), 0, params.width, counts.data());
+        for (uint16_t count : counts)
+            total += count;
+    }
+
+    return total;
+}
+
+//------------------------------------------------------------------------------
+// Variants
+//------------------------------------------------------------------------------
+
+typedef uint64_t (*FractalCountFunc)(const RenderParams& params, float magnifier, float shiftX);
+
+// The instantiations of a fractal, float lanes first
+struct FractalKernels
+{
+    MandelbrotTileFunc   tile[2];
+    FractalCountFunc     count[2];
+    MandelbrotPointsFunc points;
+};
+
+#define FRACTAL_KERNELS(Formula) \
+    { { fractal_tile <Formula, FloatLanes>, fractal_tile <Formula, DoubleLanes> }, \
+      { fractal_count<Formula, FloatLanes>, fractal_count<Formula, DoubleLanes> }, \
+      fractal_points<Formula> }
+
+const Fractal FRACTALS[] =
+{
+    { "mandelbrot",   FRACTAL_MULTIBROT,    2 },
+    { "multibrot-3",  FRACTAL_MULTIBROT,    3 },
+    { "multibrot-4",  FRACTAL_MULTIBROT,    4 },
+    { "multibrot-5",  FRACTAL_MULTIBROT,    5 },
+    { "multibrot-6",  FRACTAL_MULTIBROT,    6 },
+    { "multibrot-7",  FRACTAL_MULTIBROT,    7 },
+    { "multibrot-8",  FRACTAL_MULTIBROT,    8 },
+    { "julia",        FRACTAL_JULIA,        2 },
+    { "burning-ship", FRACTAL_BURNING_SHIP, 2 },
+};
+
+const int N_FRACTALS = sizeof(FRACTALS) / sizeof(FRACTALS[0]);
+
+// In the order of FRACTALS
+static const FractalKernels KERNELS[] =
+{
+    FRACTAL_KERNELS(Multibrot<2>),
+    FRACTAL_KERNELS(Multibrot<3>),
+    FRACTAL_KERNELS(Multibrot<4>),
+    FRACTAL_KERNELS(Multibrot<5>),
+    FRACTAL_KERNELS(Multibrot<6>),
+    FRACTAL_KERNELS(Multibrot<7>),
+    FRACTAL_KERNELS(Multibrot<8>),
+    FRACTAL_KERNELS(Julia<2>),
+    FRACTAL_KERNELS(BurningShip),
+};
+
+static int current = 0;
+
+// The Julia set of k is connected if the orbit of 0 stays bounded
+static bool julia_connected(double k_x, double k_y)
+{
+    const int JULIA_CONNECTED_ITERATIONS = 100000;
+
+    double z_x = 0, z_y = 0;
+    for (int i = 0; i < JULIA_CONNECTED_ITERATIONS; i++)
+    {
+        if (z_x * z_x + z_y * z_y > 4)
+            return false;
+
+        const double t = z_x * z_x - z_y * z_y + k_x;
+        z_y = 2 * z_x * z_y + k_y;
+        z_x = t;
+    }
+
+    return true;
+}
+
+static bool juliaConnected = julia_connected(DEFAULT_JULIA_X, DEFAULT_JULIA_Y);
+
+bool mandelbrot_fractal_select(const char* name)
+{
+    for (int i = 0; i < N_FRACTALS; i++)
+        if (strcmp(FRACTALS[i].name, name) == 0)
+        {
+            current = i;
+            return true;
+        }
+
+    return false;
+}
+
+const Fractal& mandelbrot_fractal_current()
+{
+    return FRACTALS[current];
+}
+
+void mandelbrot_fractal_set_julia(float k_x, float k_y)
+{
+    juliaX = k_x;
+    juliaY = k_y;
+    juliaConnected = julia_connected(k_x, k_y);
+}
+
+void mandelbrot_fractal_julia(float* k_x, float* k_y)
+{
+    *k_x = juliaX;
+    *k_y = juliaY;
+}
+
+// 0 for float lanes, 1 for double ones
+static int lanes_for(const RenderParams& params, float magnifier, float shiftX)
+{
+    const MandelbrotPrecision precision =
+        mandelbrot_pick_precision(params, magnifier, bf_from_double(shiftX), bf_from_double(0.0));
+
+    return precision == PRECISION_FLOAT ? 0 : 1;
+}
+
+MandelbrotTileFunc mandelbrot_fractal_tile_func(const RenderParams& params,
+                                                float magnifier, float shiftX)
+{
+    // Always float for the Mandelbrot set, the image of mandelbrot_vectorized
+    if (mandelbrot_fractal_is_mandelbrot())
+        return KERNELS[current].tile[0];
+
+    return KERNELS[current].tile[lanes_for(params, magnifier, shiftX)];
+}
+
+MandelbrotPointsFunc mandelbrot_fractal_points_func()
+{
+    if (mandelbrot_fractal_is_mandelbrot())
+        return mandelbrot_vectorized_points;
+
+    return KERNELS[current].points;
+}
+
+bool mandelbrot_fractal_connected()
+{
+    switch (FRACTALS[current].formula)
+    {
+        case FRACTAL_MULTIBROT:    return true;
+        case FRACTAL_JULIA:        return juliaConnected;
+        case FRACTAL_BURNING_SHIP: return false;
+    }
+
+    return false;
+}
+
+void mandelbrot_fractal_render(sf::Uint8* pixels, const RenderParams& params,
+                               float magnifier, float shiftX)
+{
+    KERNELS[current].tile[0](pixels, params, magnifier, shiftX, 0, params.width, 0, params.height);
+}
+
+uint64_t mandelbrot_fractal_iterations(const RenderParams& params, float magnifier, float shiftX)
+{
+    return KERNELS[current].count[lanes_for(params, magnifier, shiftX)](params, magnifier, shiftX);
+}
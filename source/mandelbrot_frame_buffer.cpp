@@ -0,0 +1,187 @@
+#include "mandelbrot_frame_buffer.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// Freed buffers kept for reuse, beyond this the smallest are unmapped
+const size_t FRAME_BUFFER_POOL = 8;
+
+// A freed buffer is only handed out for a request it fits this many
+// times over at most, so tiles and strips don't pin whole frames
+const size_t FRAME_BUFFER_MAX_OVERSIZE = 2;
+
+enum PageKind
+{
+    PAGES_SMALL,
+    PAGES_TRANSPARENT,  // madvise(MADV_HUGEPAGE), the kernel may still split them
+    PAGES_HUGETLB,
+};
+
+struct FrameBlock
+{
+    char*    data;
+    size_t   capacity;
+    PageKind pages;
+};
+
+static std::mutex              blockMutex;
+static bool                    hugePages = false;
+static std::vector<FrameBlock> liveBlocks;
+static std::vector<FrameBlock> freeBlocks;
+
+static int    nMapped     = 0;
+static int    nReused     = 0;
+static size_t bytesMapped = 0;
+static int    nPages[PAGES_HUGETLB + 1] = {};
+
+static size_t round_up(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+static char* map_anonymous(size_t size, int flags)
+{
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    return data == MAP_FAILED ? NULL : (char*)data;
+}
+
+// What a buffer of size bytes would be mapped as
+static size_t mapped_capacity(size_t size)
+{
+    if (!hugePages || size < HUGE_PAGE_SIZE)
+        return round_up(size, (size_t)sysconf(_SC_PAGESIZE));
+
+    return round_up(size, HUGE_PAGE_SIZE);
+}
+
+static bool map_block(size_t size, FrameBlock* block)
+{
+    if (!hugePages || size < HUGE_PAGE_SIZE)
+    {
+        block->capacity = mapped_capacity(size);
+        block->data     = map_anonymous(block->capacity, 0);
+        block->pages    = PAGES_SMALL;
+        return block->data != NULL;
+    }
+
+    block->capacity = mapped_capacity(size);
+
+    // Fails without enough pages reserved in /proc/sys/vm/nr_hugepages
+    block->data  = map_anonymous(block->capacity, MAP_HUGETLB);
+    block->pages = PAGES_HUGETLB;
+    if (block->data)
+        return true;
+
+    // Transparent huge pages only back 2 MiB aligned ranges: one page
+    // more is mapped and what lies outside the aligned range given back
+    const size_t mapped = block->capacity + HUGE_PAGE_SIZE;
+    char* raw = map_anonymous(mapped, 0);
+    if (!raw)
+        return false;
+
+    char* aligned = (char*)round_up((uintptr_t)raw, HUGE_PAGE_SIZE);
+    if (aligned > raw)
+        munmap(raw, aligned - raw);
+    munmap(aligned + block->capacity, raw + mapped - (aligned + block->capacity));
+
+    block->data  = aligned;
+    block->pages = madvise(aligned, block->capacity, MADV_HUGEPAGE) == 0 ? PAGES_TRANSPARENT
+                                                                         : PAGES_SMALL;
+    return true;
+}
+
+void mandelbrot_frame_buffer_huge_pages(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(blockMutex);
+    hugePages = enabled;
+}
+
+void* mandelbrot_frame_buffer_alloc(size_t rowBytes, int rows, int nThreads)
+{
+    const size_t size = std::max(rowBytes * rows, (size_t)1);
+
+    FrameBlock block;
+    {
+        std::lock_guard<std::mutex> lock(blockMutex);
+
+        // The smallest that fits, unless even that one is far too large
+        const size_t maxCapacity = FRAME_BUFFER_MAX_OVERSIZE * mapped_capacity(size);
+
+        auto best = freeBlocks.end();
+        for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+            if (it->capacity >= size && it->capacity <= maxCapacity &&
+                (best == freeBlocks.end() || it->capacity < best->capacity))
+                best = it;
+
+        if (best != freeBlocks.end())
+        {
+            block = *best;
+            freeBlocks.erase(best);
+            nReused++;
+        }
+        else
+        {
+            if (!map_block(size, &block))
+            {
+                fprintf(stderr, "Can't map a frame buffer of %zu bytes\n", size);
+                abort();
+            }
+            nMapped++;
+            nPages[block.pages]++;
+            bytesMapped += block.capacity;
+        }
+
+        liveBlocks.push_back(block);
+    }
+
+    // Faults in new pages and clears reused ones on every thread, for the
+    // bandwidth: the consumers' dynamic schedules place no row on a thread
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+    for (int y = 0; y < rows; y++)
+        memset(block.data + (size_t)y * rowBytes, 0, rowBytes);
+
+    return block.data;
+}
+
+void mandelbrot_frame_buffer_free(void* buffer)
+{
+    if (!buffer)
+        return;
+
+    std::lock_guard<std::mutex> lock(blockMutex);
+
+    auto it = std::find_if(liveBlocks.begin(), liveBlocks.end(),
+                           [buffer](const FrameBlock& block) { return block.data == buffer; });
+    if (it == liveBlocks.end())
+        return;
+
+    freeBlocks.push_back(*it);
+    liveBlocks.erase(it);
+
+    if (freeBlocks.size() > FRAME_BUFFER_POOL)
+    {
+        auto smallest = std::min_element(freeBlocks.begin(), freeBlocks.end(),
+                                         [](const FrameBlock& a, const FrameBlock& b)
+                                         { return a.capacity < b.capacity; });
+        munmap(smallest->data, smallest->capacity);
+        bytesMapped -= smallest->capacity;
+        freeBlocks.erase(smallest);
+    }
+}
+
+void mandelbrot_frame_buffer_print_stats(FILE* file)
+{
+    std::lock_guard<std::mutex> lock(blockMutex);
+
+    fprintf(file, "frame buffers: %d mapped (%d small pages, %d transparent huge, %d hugetlb), "
+                  "%d reused, %.1f MiB held\n",
+            nMapped, nPages[PAGES_SMALL], nPages[PAGES_TRANSPARENT], nPages[PAGES_HUGETLB],
+            nReused, bytesMapped / (1024.0 * 1024.0));
+}
@@ -0,0 +1,102 @@
+#include "mandelbrot_frame_cache.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_fractal.h"
+#include "mandelbrot_palette.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <omp.h>
+#include <vector>
+
+double mandelbrot_pixel_step(const RenderParams& params, double scale)
+{
+    // aspect * 2 / width == 2 / height
+    return 2.0 / (params.height * (scale + MAGNIFIER_OFFSET));
+}
+
+void mandelbrot_shift_iterations(const RenderParams& params, int dx, int dy)
+{
+    uint16_t* iterations = mandelbrot_iterations(params);
+
+    const int WIDTH  = params.width;
+    const int HEIGHT = params.height;
+
+    const int width = WIDTH - std::abs(dx);
+    if (width <= 0 || std::abs(dy) >= HEIGHT)
+        return;
+
+    const int x_to   = std::max(0, -dx);
+    const int x_from = std::max(0,  dx);
+
+    // Rows are walked away from their source so none is overwritten
+    // before it is read
+    const int y_first = dy > 0 ? 0                  : HEIGHT - 1;
+    const int y_step  = dy > 0 ? 1                  : -1;
+    const int nRows   = HEIGHT - std::abs(dy);
+
+    for (int i = 0, y = y_first; i < nRows; i++, y += y_step)
+    {
+        memmove(iterations + (size_t)y * WIDTH + x_to,
+                iterations + (size_t)(y + dy) * WIDTH + x_from,
+                width * sizeof(uint16_t));
+    }
+}
+
+void mandelbrot_resample_iterations(const RenderParams& params,
+                                    double zoom, double offsetX, double offsetY)
+{
+    static std::vector<uint16_t> previous;
+
+    const int WIDTH  = params.width;
+    const int HEIGHT = params.height;
+
+    uint16_t* iterations = mandelbrot_iterations(params);
+    previous.assign(iterations, iterations + (size_t)WIDTH * HEIGHT);
+
+    std::vector<int> sourceX(WIDTH);
+    for (int x = 0; x < WIDTH; x++)
+        sourceX[x] = (int)std::floor(WIDTH / 2 + offsetX + (x - WIDTH / 2) * zoom + 0.5);
+
+#pragma omp parallel for schedule(static) num_threads(params.nThreads)
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        const int sourceY = (int)std::floor(HEIGHT / 2 + offsetY +
+                                            (y - HEIGHT / 2) * zoom + 0.5);
+        uint16_t* row = iterations + (size_t)y * WIDTH;
+
+        if (sourceY < 0 || sourceY >= HEIGHT)
+        {
+            std::fill(row, row + WIDTH, (uint16_t)params.maxIterations);
+            continue;
+        }
+
+        const uint16_t* sourceRow = previous.data() + (size_t)sourceY * WIDTH;
+        for (int x = 0; x < WIDTH; x++)
+        {
+            const bool inside = 0 <= sourceX[x] && sourceX[x] < WIDTH;
+            row[x] = inside ? sourceRow[sourceX[x]] : (uint16_t)params.maxIterations;
+        }
+    }
+}
+
+void mandelbrot_render_columns(sf::Uint8* pixels, const RenderParams& params,
+                               float scale, float shiftX, int x_from, int x_to)
+{
+    const int HEIGHT = params.height;
+
+    x_from = x_from / 8 * 8;
+    x_to   = std::min((x_to + 7) / 8 * 8, params.width);
+
+    if (x_from >= x_to)
+        return;
+
+    const int BAND_HEIGHT = 8;
+
+    const MandelbrotTileFunc tileFunc = mandelbrot_fractal_tile_func(params, scale, shiftX);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(params.nThreads)
+    for (int y_from = 0; y_from < HEIGHT; y_from += BAND_HEIGHT)
+        tileFunc(pixels, params, scale, shiftX, x_from, x_to,
+                 y_from, std::min(y_from + BAND_HEIGHT, HEIGHT));
+}
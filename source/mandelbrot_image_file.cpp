@@ -0,0 +1,478 @@
+#include "mandelbrot_image_file.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+// Levels past 3 cost several times the time for a few percent of size
+const int PNG_DEFLATE_LEVEL = 1;
+
+// Compressed rows go out in IDAT chunks of at most this many bytes
+const size_t PNG_IDAT_BYTES = 1 << 16;
+
+// TIFF strips are about this large, independent of how rows are written
+const int TIFF_STRIP_BYTES = 1 << 20;
+
+static const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+bool mandelbrot_image_format(const char* name, ImageFormat* format)
+{
+    if      (strcmp(name, "png" ) == 0) *format = IMAGE_PNG;
+    else if (strcmp(name, "tiff") == 0) *format = IMAGE_TIFF;
+    else if (strcmp(name, "raw" ) == 0) *format = IMAGE_RAW;
+    else
+        return false;
+
+    return true;
+}
+
+const char* mandelbrot_image_format_name(ImageFormat format)
+{
+    switch (format)
+    {
+        case IMAGE_PNG:  return "png";
+        case IMAGE_TIFF: return "tiff";
+        case IMAGE_RAW:  return "raw";
+    }
+
+    return "unknown";
+}
+
+ImageFormat mandelbrot_image_format_of(const char* path)
+{
+    const char* extension = strrchr(path, '.');
+    if (!extension)
+        return IMAGE_RAW;
+
+    if (strcasecmp(extension, ".png") == 0)
+        return IMAGE_PNG;
+    if (strcasecmp(extension, ".tif") == 0 || strcasecmp(extension, ".tiff") == 0)
+        return IMAGE_TIFF;
+
+    return IMAGE_RAW;
+}
+
+//------------------------------------------------------------------------------
+// Byte order helpers, PNG is big endian and the TIFF is written little endian
+//------------------------------------------------------------------------------
+
+static void put_be32(std::vector<uint8_t>* out, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out->push_back((uint8_t)(value >> shift));
+}
+
+static void put_le(std::vector<uint8_t>* out, uint64_t value, int nBytes)
+{
+    for (int i = 0; i < nBytes; i++)
+        out->push_back((uint8_t)(value >> (8 * i)));
+}
+
+static bool write_bytes(ImageFile* image, const uint8_t* data, size_t size)
+{
+    if (size == 0)
+        return true;
+
+    if (fwrite(data, 1, size, image->file) != size)
+        return false;
+
+    image->state.offset += size;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// PNG
+//------------------------------------------------------------------------------
+
+static bool png_chunk(ImageFile* image, const char type[4],
+                      const uint8_t* prefix, size_t prefixSize,
+                      const uint8_t* data, size_t size)
+{
+    std::vector<uint8_t> header;
+    put_be32(&header, (uint32_t)(prefixSize + size));
+    header.insert(header.end(), type, type + 4);
+
+    // zlib takes a NULL buffer as a request for the initial value
+    uLong crc = crc32(0, header.data() + 4, 4);
+    if (prefixSize > 0)
+        crc = crc32(crc, prefix, prefixSize);
+    if (size > 0)
+        crc = crc32(crc, data, size);
+
+    std::vector<uint8_t> trailer;
+    put_be32(&trailer, crc);
+
+    return write_bytes(image, header.data(), header.size()) &&
+           write_bytes(image, prefix, prefixSize)           &&
+           write_bytes(image, data, size)                   &&
+           write_bytes(image, trailer.data(), trailer.size());
+}
+
+static bool png_header(ImageFile* image)
+{
+    std::vector<uint8_t> ihdr;
+    put_be32(&ihdr, image->width);
+    put_be32(&ihdr, image->height);
+    ihdr.push_back(8);  // Bit depth
+    ihdr.push_back(2);  // RGB
+    ihdr.push_back(0);  // Deflate
+    ihdr.push_back(0);  // Adaptive filtering
+    ihdr.push_back(0);  // Not interlaced
+
+    // zlib header: deflate with a 32K window, no dictionary, fastest
+    const uint8_t zlibHeader[2] = { 0x78, 0x01 };
+
+    return write_bytes(image, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) &&
+           png_chunk(image, "IHDR", NULL, 0, ihdr.data(), ihdr.size()) &&
+           png_chunk(image, "IDAT", NULL, 0, zlibHeader, sizeof(zlibHeader));
+}
+
+// Each call deflates its rows as a raw stream of its own ending in a full
+// flush, which leaves the output byte aligned with nothing referring
+// back past it. The blocks of all calls chain into one zlib stream, and
+// a resumed file continues it without the deflate state of the run
+// before. The last rows end in the final block.
+static bool png_rows(ImageFile* image, const std::vector<uint8_t>& data, bool last)
+{
+    image->state.adler = adler32(image->state.adler, data.data(), data.size());
+
+    z_stream stream = {};
+    if (deflateInit2(&stream, PNG_DEFLATE_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+
+    std::vector<uint8_t> compressed(deflateBound(&stream, data.size()) + 16);
+    stream.next_in   = (Bytef*)data.data();
+    stream.avail_in  = (uInt)data.size();
+    stream.next_out  = compressed.data();
+    stream.avail_out = (uInt)compressed.size();
+
+    const int  result = deflate(&stream, last ? Z_FINISH : Z_FULL_FLUSH);
+    const bool ok     = result == (last ? Z_STREAM_END : Z_OK) && stream.avail_in == 0;
+    const size_t size = compressed.size() - stream.avail_out;
+    deflateEnd(&stream);
+    if (!ok)
+        return false;
+
+    for (size_t done = 0; done < size; )
+    {
+        const size_t chunk = std::min(size - done, PNG_IDAT_BYTES);
+        if (!png_chunk(image, "IDAT", NULL, 0, compressed.data() + done, chunk))
+            return false;
+
+        done += chunk;
+    }
+
+    return true;
+}
+
+static bool png_trailer(ImageFile* image)
+{
+    std::vector<uint8_t> adler;
+    put_be32(&adler, image->state.adler);
+
+    return png_chunk(image, "IDAT", NULL, 0, adler.data(), adler.size()) &&
+           png_chunk(image, "IEND", NULL, 0, NULL, 0);
+}
+
+//------------------------------------------------------------------------------
+// TIFF, a single image file directory followed by the strips back to back
+//------------------------------------------------------------------------------
+
+enum TiffType
+{
+    TIFF_SHORT = 3,
+    TIFF_LONG  = 4,
+    TIFF_LONG8 = 16,
+};
+
+struct TiffEntry
+{
+    uint16_t              tag;
+    TiffType              type;
+    std::vector<uint64_t> values;
+};
+
+static int tiff_type_size(TiffType type)
+{
+    return type == TIFF_SHORT ? 2 : type == TIFF_LONG ? 4 : 8;
+}
+
+static bool tiff_header(ImageFile* image)
+{
+    const uint64_t rowBytes     = (uint64_t)image->width * 3;
+    const int      rowsPerStrip = (int)std::max<uint64_t>(1, TIFF_STRIP_BYTES / rowBytes);
+    const int      nStrips      = (image->height + rowsPerStrip - 1) / rowsPerStrip;
+    const uint64_t imageBytes   = rowBytes * image->height;
+
+    // Classic TIFF offsets are 32 bits, leave room for the header
+    const bool big = imageBytes + 16 * (uint64_t)nStrips + 4096 > UINT32_MAX;
+
+    const TiffType offsetType = big ? TIFF_LONG8 : TIFF_LONG;
+
+    std::vector<uint64_t> stripOffsets(nStrips);
+    std::vector<uint64_t> stripBytes(nStrips);
+    for (int i = 0; i < nStrips; i++)
+        stripBytes[i] = rowBytes * (std::min(image->height, (i + 1) * rowsPerStrip) - i * rowsPerStrip);
+
+    // Ascending tag order, as TIFF requires
+    std::vector<TiffEntry> entries =
+    {
+        { 256, TIFF_LONG,  { (uint64_t)image->width  } },  // ImageWidth
+        { 257, TIFF_LONG,  { (uint64_t)image->height } },  // ImageLength
+        { 258, TIFF_SHORT, { 8, 8, 8 } },                  // BitsPerSample
+        { 259, TIFF_SHORT, { 1 } },                        // No compression
+        { 262, TIFF_SHORT, { 2 } },                        // RGB
+        { 273, offsetType, stripOffsets },                 // StripOffsets
+        { 277, TIFF_SHORT, { 3 } },                        // SamplesPerPixel
+        { 278, TIFF_LONG,  { (uint64_t)rowsPerStrip } },   // RowsPerStrip
+        { 279, offsetType, stripBytes },                   // StripByteCounts
+        { 284, TIFF_SHORT, { 1 } },                        // Chunky
+    };
+
+    const int headerSize = big ? 16 : 8;
+    const int countSize  = big ? 8  : 2;
+    const int entrySize  = big ? 20 : 12;
+    const int inlineSize = big ? 8  : 4;
+
+    const uint64_t ifdEnd = headerSize + countSize + entries.size() * entrySize + inlineSize;
+
+    // Values that do not fit in their entry follow the directory
+    uint64_t externalSize = 0;
+    for (const TiffEntry& entry : entries)
+    {
+        const uint64_t size = entry.values.size() * tiff_type_size(entry.type);
+        if (size > (uint64_t)inlineSize)
+            externalSize += (size + 1) / 2 * 2;
+    }
+
+    const uint64_t dataOffset = (ifdEnd + externalSize + 7) / 8 * 8;
+    for (int i = 0; i < nStrips; i++)
+        entries[5].values[i] = dataOffset + (uint64_t)i * rowsPerStrip * rowBytes;
+
+    std::vector<uint8_t> header;
+    header.push_back('I');
+    header.push_back('I');
+    if (big)
+    {
+        put_le(&header, 43, 2);
+        put_le(&header, 8,  2);  // Offset size
+        put_le(&header, 0,  2);
+        put_le(&header, headerSize, 8);
+    }
+    else
+    {
+        put_le(&header, 42, 2);
+        put_le(&header, headerSize, 4);
+    }
+
+    std::vector<uint8_t> external;
+    put_le(&header, entries.size(), countSize);
+    for (const TiffEntry& entry : entries)
+    {
+        const int      typeSize = tiff_type_size(entry.type);
+        const uint64_t size     = entry.values.size() * typeSize;
+
+        put_le(&header, entry.tag,  2);
+        put_le(&header, entry.type, 2);
+        put_le(&header, entry.values.size(), big ? 8 : 4);
+
+        std::vector<uint8_t>* target = &header;
+        if (size > (uint64_t)inlineSize)
+        {
+            put_le(&header, ifdEnd + external.size(), inlineSize);
+            target = &external;
+        }
+
+        for (uint64_t value : entry.values)
+            put_le(target, value, typeSize);
+
+        if (target == &header)
+            put_le(&header, 0, inlineSize - (int)size);
+        else if (external.size() % 2)
+            external.push_back(0);
+    }
+    put_le(&header, 0, inlineSize);  // No next directory
+
+    header.insert(header.end(), external.begin(), external.end());
+    header.resize(dataOffset, 0);
+
+    return write_bytes(image, header.data(), header.size());
+}
+
+//------------------------------------------------------------------------------
+
+static bool open_image(ImageFile* image, const char* path, const char* fileMode,
+                       ImageFormat format, int width, int height)
+{
+    image->file   = fopen(path, fileMode);
+    image->format = format;
+    image->width  = width;
+    image->height = height;
+    image->state  = { 0, 0, 1 };
+
+    return image->file != NULL;
+}
+
+static bool write_header(ImageFile* image)
+{
+    switch (image->format)
+    {
+        case IMAGE_PNG:  return png_header(image);
+        case IMAGE_TIFF: return tiff_header(image);
+        case IMAGE_RAW:  break;
+    }
+
+    return true;
+}
+
+bool mandelbrot_image_create(ImageFile* image, const char* path, ImageFormat format,
+                             int width, int height)
+{
+    if (!open_image(image, path, "w+b", format, width, height))
+        return false;
+
+    const bool ok = write_header(image);
+    if (!ok)
+        mandelbrot_image_close(image);
+
+    return ok;
+}
+
+bool mandelbrot_image_resume(ImageFile* image, const char* path, ImageFormat format,
+                             int width, int height, const ImageFileState& state)
+{
+    if (!open_image(image, path, "r+b", format, width, height))
+        return false;
+
+    // Rows after the checkpoint may be incomplete, they are written again
+    const bool ok = fseeko(image->file, 0, SEEK_END) == 0             &&
+                    (uint64_t)ftello(image->file) >= state.offset     &&
+                    ftruncate(fileno(image->file), state.offset) == 0 &&
+                    fseeko(image->file, state.offset, SEEK_SET) == 0;
+
+    if (!ok)
+    {
+        mandelbrot_image_close(image);
+        return false;
+    }
+
+    image->state = state;
+    return true;
+}
+
+bool mandelbrot_image_write_rows(ImageFile* image, const sf::Uint8* pixels, int nRows)
+{
+    const bool png = image->format == IMAGE_PNG;
+
+    // PNG rows start with their filter type, 0 is none
+    const size_t rowSize = (size_t)image->width * 3 + (png ? 1 : 0);
+
+    std::vector<uint8_t> rows(rowSize * nRows);
+    for (int y = 0; y < nRows; y++)
+    {
+        uint8_t*         row    = rows.data() + rowSize * y;
+        const sf::Uint8* source = pixels + (size_t)image->width * 4 * y;
+
+        if (png)
+            *row++ = 0;
+
+        for (int x = 0; x < image->width; x++, row += 3, source += 4)
+        {
+            row[0] = source[0];
+            row[1] = source[1];
+            row[2] = source[2];
+        }
+    }
+
+    image->state.rowsDone += nRows;
+
+    if (png)
+        return png_rows(image, rows, image->state.rowsDone == image->height);
+
+    return write_bytes(image, rows.data(), rows.size());
+}
+
+static uint64_t mapped_size(const ImageFile* image)
+{
+    return image->state.offset + (uint64_t)image->width * 3 * image->height;
+}
+
+uint8_t* mandelbrot_image_map_rows(ImageFile* image)
+{
+    if (image->format == IMAGE_PNG || image->state.rowsDone != 0)
+        return NULL;
+
+    const int fd = fileno(image->file);
+    if (fflush(image->file) != 0 || ftruncate(fd, mapped_size(image)) != 0)
+        return NULL;
+
+    void* file = mmap(NULL, mapped_size(image), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (file == MAP_FAILED)
+        return NULL;
+
+    return (uint8_t*)file + image->state.offset;
+}
+
+void mandelbrot_image_unmap_rows(ImageFile* image, uint8_t* rows)
+{
+    munmap(rows - image->state.offset, mapped_size(image));
+
+    // The file is fsynced by mandelbrot_image_finish, mapped pages too
+    image->state.offset   = mapped_size(image);
+    image->state.rowsDone = image->height;
+    fseeko(image->file, image->state.offset, SEEK_SET);
+}
+
+bool mandelbrot_image_sync(ImageFile* image)
+{
+    return fflush(image->file) == 0 && fsync(fileno(image->file)) == 0;
+}
+
+bool mandelbrot_image_finish(ImageFile* image)
+{
+    const bool ok = (image->format != IMAGE_PNG || png_trailer(image)) &&
+                    mandelbrot_image_sync(image);
+
+    mandelbrot_image_close(image);
+    return ok;
+}
+
+void mandelbrot_image_close(ImageFile* image)
+{
+    if (image->file)
+        fclose(image->file);
+
+    image->file = NULL;
+}
+
+bool mandelbrot_image_encode(ImageFormat format, const sf::Uint8* pixels, int width, int height,
+                             std::vector<uint8_t>* data)
+{
+    char*  buffer = NULL;
+    size_t size   = 0;
+
+    ImageFile image = {};
+    image.file   = open_memstream(&buffer, &size);
+    image.format = format;
+    image.width  = width;
+    image.height = height;
+    image.state  = { 0, 0, 1 };
+    if (!image.file)
+        return false;
+
+    // Nothing to sync in memory, finish is only the trailer
+    const bool ok = write_header(&image)                                &&
+                    mandelbrot_image_write_rows(&image, pixels, height) &&
+                    (format != IMAGE_PNG || png_trailer(&image));
+
+    mandelbrot_image_close(&image);
+    if (ok)
+        data->assign(buffer, buffer + size);
+    free(buffer);
+
+    return ok;
+}
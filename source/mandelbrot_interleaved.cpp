@@ -0,0 +1,485 @@
+#include "mandelbrot_interleaved.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_vectorized.h"
+
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+#include <vector>
+
+// One 8-wide vector of pixels in flight. Lanes without a pixel, past
+// the end of the frame, are idle: they iterate c = 0 and are never live.
+struct Chain
+{
+    // Lanes still iterating, cleared when they escape or come back to
+    // their saved z
+    __m256  live;
+    __m256  c_x;
+    __m256  c_y;
+    __m256  z_x;
+    __m256  z_y;
+    __m256  check_x;
+    __m256  check_y;
+    // Count at which z is saved next
+    __m256i nextCheck;
+    __m256i iterations;
+    // Index of the pixel of every lane, -1 if idle
+    __m256i pixel;
+    int     idle;
+};
+
+// The pixels of the frame in row order that did not finish in the first
+// INTERLEAVED_BURST iterations, which are run when their row is scanned
+struct PixelStream
+{
+    // Scanned pixels waiting for a lane with their z and count so far,
+    // from head to size, padded so 8 can always be loaded from head
+    std::vector<int>   pixel;
+    std::vector<float> c_x;
+    std::vector<float> c_y;
+    std::vector<float> z_x;
+    std::vector<float> z_y;
+    std::vector<int>   iterations;
+    int head;
+    int size;
+
+    // Next row to scan
+    int y;
+    int y_to;
+
+    // Coordinates of the columns (padded to a multiple of 8) and rows
+    std::vector<float> columnC_x;
+    std::vector<float> rowC_y;
+};
+
+// is_in_cardioid_or_bulb for eight points
+static inline __m256 cardioid_or_bulb_mask(__m256 _c_x, __m256 _c_y)
+{
+    __m256 _x  = _mm256_sub_ps(_c_x, _mm256_set1_ps(0.25f));
+    __m256 _y2 = _mm256_mul_ps(_c_y, _c_y);
+    __m256 _q  = _mm256_add_ps(_mm256_mul_ps(_x, _x), _y2);
+
+    __m256 _cardioid = _mm256_cmp_ps(_mm256_mul_ps(_q, _mm256_add_ps(_q, _x)),
+                                     _mm256_mul_ps(_mm256_set1_ps(0.25f), _y2), _CMP_LT_OQ);
+
+    __m256 _x1 = _mm256_add_ps(_c_x, _mm256_set1_ps(1.0f));
+    __m256 _bulb = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_x1, _x1), _y2),
+                                 _mm256_set1_ps(0.0625f), _CMP_LT_OQ);
+
+    return _mm256_or_ps(_cardioid, _bulb);
+}
+
+// Lane permutations of every 8-bit mask: rank spreads consecutive
+// elements over the set lanes, pack gathers the set lanes to the front
+struct LanePermutations
+{
+    uint8_t rank[256][8];
+    uint8_t pack[256][8];
+};
+
+static const LanePermutations& lane_permutations()
+{
+    static const LanePermutations permutations = []
+    {
+        LanePermutations table = {};
+        for (int mask = 0; mask < 256; mask++)
+        {
+            int rank = 0;
+            for (int lane = 0; lane < 8; lane++)
+            {
+                table.rank[mask][lane] = (uint8_t)rank;
+                if ((mask >> lane) & 1)
+                    table.pack[mask][rank++] = (uint8_t)lane;
+            }
+        }
+        return table;
+    }();
+
+    return permutations;
+}
+
+static inline __m256i load_permutation(const uint8_t* permutation)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)permutation));
+}
+
+// Lanes of the bits of mask as a vector mask
+static inline __m256 lanes_mask(int mask)
+{
+    const __m256i _bits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(mask), _bits),
+                                                  _bits));
+}
+
+// Iterates the pixels of the next row outside the cardioid and the bulb,
+// stores the counts of those done in the first INTERLEAVED_BURST
+// iterations and queues the others. Most pixels of a view are either
+// interior or escape within a few iterations; they never take a lane.
+static void scan_row(PixelStream* stream, uint16_t* iterations, const RenderParams& params)
+{
+    const LanePermutations& permutations = lane_permutations();
+
+    const int width = params.width;
+    const int y     = stream->y++;
+    const int depth = std::min(INTERLEAVED_BURST, params.maxIterations);
+
+    const __m256  _c_y  = _mm256_set1_ps(stream->rowC_y[y]);
+    const __m256i _0to7 = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256  _maxRadius2 = _mm256_set1_ps(max_radius_2(params));
+    uint16_t* rowIterations = iterations + (size_t)y * width;
+
+    for (int x = 0; x < width; x += 8)
+    {
+        const int    valid = width - x < 8 ? (1 << (width - x)) - 1 : 0xFF;
+        const __m256 _c_x  = _mm256_loadu_ps(stream->columnC_x.data() + x);
+
+        const __m256 _interior = cardioid_or_bulb_mask(_c_x, _c_y);
+        if (_mm256_movemask_ps(_interior) == 0xFF && valid == 0xFF)
+        {
+            _mm_storeu_si128((__m128i*)(rowIterations + x), _mm_set1_epi16((short)params.maxIterations));
+            continue;
+        }
+
+        __m256  _z_x  = _mm256_setzero_ps();
+        __m256  _z_y  = _mm256_setzero_ps();
+        __m256  _live = _mm256_andnot_ps(_interior, lanes_mask(valid));
+        __m256i _iterations = _mm256_setzero_si256();
+
+        for (int iteration = 0; iteration < depth; iteration++)
+        {
+            const __m256 _radius2 = _mm256_fmadd_ps(_z_x, _z_x, _mm256_mul_ps(_z_y, _z_y));
+            _live = _mm256_and_ps(_live, _mm256_cmp_ps(_radius2, _maxRadius2, _CMP_LT_OQ));
+            if (_mm256_testz_ps(_live, _live))
+                break;
+
+            _iterations = _mm256_sub_epi32(_iterations, _mm256_castps_si256(_live));
+
+            const __m256 _x = _z_x;
+            _z_x = _mm256_fmadd_ps(_x, _x, _mm256_fnmadd_ps(_z_y, _z_y, _c_x));
+            _z_y = _mm256_fmadd_ps(_mm256_add_ps(_x, _x), _z_y, _c_y);
+        }
+
+        // Lanes at the depth count as interior
+        const int queued = depth == params.maxIterations ? 0 : _mm256_movemask_ps(_live);
+        const int stored = valid & ~queued;
+
+        alignas(32) int counts[8];
+        _mm256_store_si256((__m256i*)counts, _mm256_castps_si256(
+                               _mm256_blendv_ps(_mm256_castsi256_ps(_iterations),
+                                                _mm256_castsi256_ps(_mm256_set1_epi32(params.maxIterations)),
+                                                _mm256_or_ps(_interior, _live))));
+
+        if (stored == 0xFF)
+            _mm_storeu_si128((__m128i*)(rowIterations + x), _mm_packus_epi32(
+                                 _mm_load_si128((const __m128i*)counts),
+                                 _mm_load_si128((const __m128i*)(counts + 4))));
+        else
+            for (int lanes = stored; lanes; lanes &= lanes - 1)
+                rowIterations[x + __builtin_ctz(lanes)] = (uint16_t)counts[__builtin_ctz(lanes)];
+
+        if (!queued)
+            continue;
+
+        const __m256i _pack  = load_permutation(permutations.pack[queued]);
+        const __m256i _pixel = _mm256_add_epi32(_mm256_set1_epi32(y * width + x), _0to7);
+
+        const int size = stream->size;
+        _mm256_storeu_si256((__m256i*)(stream->pixel.data() + size),
+                            _mm256_permutevar8x32_epi32(_pixel, _pack));
+        _mm256_storeu_ps(stream->c_x.data() + size, _mm256_permutevar8x32_ps(_c_x, _pack));
+        _mm256_storeu_ps(stream->c_y.data() + size, _c_y);
+        _mm256_storeu_ps(stream->z_x.data() + size, _mm256_permutevar8x32_ps(_z_x, _pack));
+        _mm256_storeu_ps(stream->z_y.data() + size, _mm256_permutevar8x32_ps(_z_y, _pack));
+        _mm256_storeu_si256((__m256i*)(stream->iterations.data() + size),
+                            _mm256_permutevar8x32_epi32(_iterations, _pack));
+
+        stream->size += _mm_popcnt_u32(queued);
+    }
+}
+
+// Moves the pixels from head to size to the front of the queue
+template <typename T>
+static inline void rewind(std::vector<T>* queue, int head, int size)
+{
+    memmove(queue->data(), queue->data() + head, (size - head) * sizeof(T));
+}
+
+// Scans rows until at least 8 pixels are queued or the frame is done
+static void fill_stream(PixelStream* stream, uint16_t* iterations, const RenderParams& params)
+{
+    const int queued = stream->size - stream->head;
+    if (queued >= 8)
+        return;
+
+    rewind(&stream->pixel,      stream->head, stream->size);
+    rewind(&stream->c_x,        stream->head, stream->size);
+    rewind(&stream->c_y,        stream->head, stream->size);
+    rewind(&stream->z_x,        stream->head, stream->size);
+    rewind(&stream->z_y,        stream->head, stream->size);
+    rewind(&stream->iterations, stream->head, stream->size);
+    stream->head = 0;
+    stream->size = queued;
+
+    while (stream->size < 8 && stream->y < stream->y_to)
+        scan_row(stream, iterations, params);
+}
+
+// Puts the next pixels of stream in the lanes of mask, lanes past the
+// end of the stream become idle
+static inline void refill(Chain* chain, int mask, PixelStream* stream, uint16_t* iterations,
+                          const RenderParams& params)
+{
+    fill_stream(stream, iterations, params);
+
+    const int count  = _mm_popcnt_u32(mask);
+    const int queued = stream->size - stream->head;
+
+    __m256i _pixel;
+    __m256  _c_x;
+    __m256  _c_y;
+    __m256  _z_x;
+    __m256  _z_y;
+    __m256i _iterations;
+
+    if (queued >= count)
+    {
+        const __m256i _rank = load_permutation(lane_permutations().rank[mask]);
+        const int     head  = stream->head;
+
+        _pixel = _mm256_permutevar8x32_epi32(
+                     _mm256_loadu_si256((const __m256i*)(stream->pixel.data() + head)), _rank);
+        _c_x   = _mm256_permutevar8x32_ps(_mm256_loadu_ps(stream->c_x.data() + head), _rank);
+        _c_y   = _mm256_permutevar8x32_ps(_mm256_loadu_ps(stream->c_y.data() + head), _rank);
+        _z_x   = _mm256_permutevar8x32_ps(_mm256_loadu_ps(stream->z_x.data() + head), _rank);
+        _z_y   = _mm256_permutevar8x32_ps(_mm256_loadu_ps(stream->z_y.data() + head), _rank);
+        _iterations = _mm256_permutevar8x32_epi32(
+                          _mm256_loadu_si256((const __m256i*)(stream->iterations.data() + head)), _rank);
+
+        stream->head += count;
+    }
+    else
+    {
+        alignas(32) int   pixel[8]  = {};
+        alignas(32) float c_x[8]    = {};
+        alignas(32) float c_y[8]    = {};
+        alignas(32) float z_x[8]    = {};
+        alignas(32) float z_y[8]    = {};
+        alignas(32) int   counts[8] = {};
+
+        for (int lanes = mask; lanes; lanes &= lanes - 1)
+        {
+            const int lane = __builtin_ctz(lanes);
+            if (stream->head == stream->size)
+            {
+                pixel[lane]  = -1;
+                chain->idle |= 1 << lane;
+                continue;
+            }
+
+            pixel [lane] = stream->pixel     [stream->head];
+            c_x   [lane] = stream->c_x       [stream->head];
+            c_y   [lane] = stream->c_y       [stream->head];
+            z_x   [lane] = stream->z_x       [stream->head];
+            z_y   [lane] = stream->z_y       [stream->head];
+            counts[lane] = stream->iterations[stream->head];
+            stream->head++;
+        }
+
+        _pixel = _mm256_load_si256((const __m256i*)pixel);
+        _c_x   = _mm256_load_ps(c_x);
+        _c_y   = _mm256_load_ps(c_y);
+        _z_x   = _mm256_load_ps(z_x);
+        _z_y   = _mm256_load_ps(z_y);
+        _iterations = _mm256_load_si256((const __m256i*)counts);
+    }
+
+    const __m256 _refilled = lanes_mask(mask);
+
+    chain->pixel = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(chain->pixel),
+                                                        _mm256_castsi256_ps(_pixel), _refilled));
+    chain->c_x   = _mm256_blendv_ps(chain->c_x, _c_x, _refilled);
+    chain->c_y   = _mm256_blendv_ps(chain->c_y, _c_y, _refilled);
+
+    chain->z_x        = _mm256_blendv_ps(chain->z_x, _z_x, _refilled);
+    chain->z_y        = _mm256_blendv_ps(chain->z_y, _z_y, _refilled);
+    chain->iterations = _mm256_castps_si256(
+                            _mm256_blendv_ps(_mm256_castsi256_ps(chain->iterations),
+                                             _mm256_castsi256_ps(_iterations), _refilled));
+
+    chain->live = _mm256_blendv_ps(chain->live, _mm256_andnot_ps(lanes_mask(chain->idle), _refilled),
+                                   _refilled);
+
+    // The z of the scan is the first saved z, as if the lane had been
+    // iterated from the start
+    chain->check_x   = _mm256_blendv_ps(chain->check_x, _z_x, _refilled);
+    chain->check_y   = _mm256_blendv_ps(chain->check_y, _z_y, _refilled);
+    chain->nextCheck = _mm256_castps_si256(
+                           _mm256_blendv_ps(_mm256_castsi256_ps(chain->nextCheck),
+                                            _mm256_castsi256_ps(_mm256_add_epi32(_iterations, _iterations)),
+                                            _refilled));
+}
+
+// INTERLEAVED_BURST iterations of every chain. The chains only share the
+// loop, so the FMAs of one hide the latency of the others. The state the
+// loop changes is copied out of the chains, so it stays in registers.
+template <int CHAINS>
+static inline void iterate_burst(Chain* chains, __m256 _maxRadius2)
+{
+    __m256  _z_x[CHAINS];
+    __m256  _z_y[CHAINS];
+    __m256  _live[CHAINS];
+    __m256i _iterations[CHAINS];
+    for (int i = 0; i < CHAINS; i++)
+    {
+        _z_x[i]        = chains[i].z_x;
+        _z_y[i]        = chains[i].z_y;
+        _live[i]       = chains[i].live;
+        _iterations[i] = chains[i].iterations;
+    }
+
+    for (int iteration = 0; iteration < INTERLEAVED_BURST; iteration++)
+    {
+        for (int i = 0; i < CHAINS; i++)
+        {
+            const __m256 _x = _z_x[i];
+            const __m256 _y = _z_y[i];
+
+            // Escaped lanes stop counting
+            const __m256 _radius2 = _mm256_fmadd_ps(_x, _x, _mm256_mul_ps(_y, _y));
+            _live[i] = _mm256_and_ps(_live[i], _mm256_cmp_ps(_radius2, _maxRadius2, _CMP_LT_OQ));
+            _iterations[i] = _mm256_sub_epi32(_iterations[i], _mm256_castps_si256(_live[i]));
+
+            // x = x^2 - y^2 + cx
+            // y = 2xy + cy
+            _z_x[i] = _mm256_fmadd_ps(_x, _x, _mm256_fnmadd_ps(_y, _y, chains[i].c_x));
+            _z_y[i] = _mm256_fmadd_ps(_mm256_add_ps(_x, _x), _y, chains[i].c_y);
+
+            const __m256 _periodic = _mm256_and_ps(_mm256_cmp_ps(_z_x[i], chains[i].check_x, _CMP_EQ_OQ),
+                                                   _mm256_cmp_ps(_z_y[i], chains[i].check_y, _CMP_EQ_OQ));
+            _live[i] = _mm256_andnot_ps(_periodic, _live[i]);
+        }
+    }
+
+    for (int i = 0; i < CHAINS; i++)
+    {
+        chains[i].z_x        = _z_x[i];
+        chains[i].z_y        = _z_y[i];
+        chains[i].live       = _live[i];
+        chains[i].iterations = _iterations[i];
+    }
+}
+
+// Stores the counts of the finished lanes and refills them. A lane is
+// finished when it escaped, reached the depth or came back to its saved
+// z. Live lanes save z when their count passed the next check and then
+// wait twice as long, Brent's schedule counted per lane.
+static inline void retire(Chain* chain, PixelStream* stream, uint16_t* iterations,
+                          const RenderParams& params, __m256 _maxRadius2)
+{
+    const __m256i _maxIterations = _mm256_set1_epi32(params.maxIterations);
+
+    const __m256 _radius2 = _mm256_fmadd_ps(chain->z_x, chain->z_x,
+                                            _mm256_mul_ps(chain->z_y, chain->z_y));
+
+    // Lanes that stopped without escaping came back to their saved z
+    const __m256 _escaped  = _mm256_cmp_ps(_radius2, _maxRadius2, _CMP_NLT_UQ);
+    const __m256 _periodic = _mm256_andnot_ps(_escaped, _mm256_andnot_ps(chain->live,
+                                 _mm256_castsi256_ps(_mm256_set1_epi32(-1))));
+    const __m256 _maxed    = _mm256_castsi256_ps(
+                                 _mm256_cmpgt_epi32(chain->iterations,
+                                                    _mm256_set1_epi32(params.maxIterations - 1)));
+
+    const __m256 _save = _mm256_and_ps(chain->live, _mm256_castsi256_ps(
+                             _mm256_cmpgt_epi32(chain->iterations,
+                                                _mm256_sub_epi32(chain->nextCheck, _mm256_set1_epi32(1)))));
+    chain->check_x   = _mm256_blendv_ps(chain->check_x, chain->z_x, _save);
+    chain->check_y   = _mm256_blendv_ps(chain->check_y, chain->z_y, _save);
+    chain->nextCheck = _mm256_castps_si256(
+                           _mm256_blendv_ps(_mm256_castsi256_ps(chain->nextCheck),
+                                            _mm256_castsi256_ps(_mm256_add_epi32(chain->iterations,
+                                                                                 chain->iterations)),
+                                            _save));
+
+    const int done = (~_mm256_movemask_ps(chain->live) | _mm256_movemask_ps(_maxed))
+                     & ~chain->idle & 0xFF;
+    if (!done)
+        return;
+
+    // Lanes past the depth may have counted a few iterations too many
+    alignas(32) int pixel[8];
+    alignas(32) int counts[8];
+    _mm256_store_si256((__m256i*)pixel, chain->pixel);
+    _mm256_store_si256((__m256i*)counts, _mm256_castps_si256(
+                           _mm256_blendv_ps(_mm256_castsi256_ps(_mm256_min_epu32(chain->iterations,
+                                                                                 _maxIterations)),
+                                            _mm256_castsi256_ps(_maxIterations), _periodic)));
+
+    for (int lanes = done; lanes; lanes &= lanes - 1)
+    {
+        const int lane = __builtin_ctz(lanes);
+        iterations[pixel[lane]] = (uint16_t)counts[lane];
+    }
+
+    refill(chain, done, stream, iterations, params);
+}
+
+template <int CHAINS>
+void mandelbrot_interleaved_ranged(sf::Uint8* pixels, const RenderParams& params,
+                                   float magnifier, float shiftX, int y_from, int y_to)
+{
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+    PixelStream stream = {};
+    stream.pixel.resize(params.width + 16);
+    stream.c_x  .resize(params.width + 16);
+    stream.c_y  .resize(params.width + 16);
+    stream.z_x  .resize(params.width + 16);
+    stream.z_y  .resize(params.width + 16);
+    stream.iterations.resize(params.width + 16);
+    stream.y    = y_from;
+    stream.y_to = y_to;
+
+    stream.columnC_x.resize(params.width + 8);
+    stream.rowC_y   .resize(params.height);
+    mandelbrot_vectorized_coords(params, magnifier, shiftX,
+                                 stream.columnC_x.data(), stream.rowC_y.data());
+
+    const __m256 _maxRadius2 = _mm256_set1_ps(max_radius_2(params));
+
+    Chain chains[CHAINS] = {};
+    for (int i = 0; i < CHAINS; i++)
+        refill(&chains[i], 0xFF, &stream, iterations, params);
+
+    bool running = true;
+    while (running)
+    {
+        iterate_burst<CHAINS>(chains, _maxRadius2);
+
+        running = false;
+        for (int i = 0; i < CHAINS; i++)
+        {
+            retire(&chains[i], &stream, iterations, params, _maxRadius2);
+            running |= chains[i].idle != 0xFF;
+        }
+    }
+
+    mandelbrot_colorize(pixels, params, iterations, palette, 0, params.width, y_from, y_to);
+}
+
+template <int CHAINS>
+void mandelbrot_interleaved(sf::Uint8* pixels, const RenderParams& params,
+                            float magnifier, float shiftX)
+{
+    mandelbrot_interleaved_ranged<CHAINS>(pixels, params, magnifier, shiftX, 0, params.height);
+}
+
+template void mandelbrot_interleaved_ranged<1>(sf::Uint8*, const RenderParams&, float, float, int, int);
+template void mandelbrot_interleaved_ranged<2>(sf::Uint8*, const RenderParams&, float, float, int, int);
+template void mandelbrot_interleaved_ranged<3>(sf::Uint8*, const RenderParams&, float, float, int, int);
+template void mandelbrot_interleaved_ranged<4>(sf::Uint8*, const RenderParams&, float, float, int, int);
+
+template void mandelbrot_interleaved<1>(sf::Uint8*, const RenderParams&, float, float);
+template void mandelbrot_interleaved<2>(sf::Uint8*, const RenderParams&, float, float);
+template void mandelbrot_interleaved<3>(sf::Uint8*, const RenderParams&, float, float);
+template void mandelbrot_interleaved<4>(sf::Uint8*, const RenderParams&, float, float);
@@ -0,0 +1,80 @@
+#include "mandelbrot_isa.h"
+
+#include <cpuid.h>
+#include <cstdint>
+#include <cstring>
+
+static const char* const ISA_NAMES[N_ISAS] = { "sse4.2", "avx2", "avx512" };
+
+// XCR0 bits of the register state the OS saves on context switches
+const uint64_t XCR0_AVX    = 0x06;  // XMM, YMM
+const uint64_t XCR0_AVX512 = 0xE6;  // and opmask, ZMM0-15 upper halves, ZMM16-31
+
+const char* mandelbrot_isa_name(MandelbrotIsa isa)
+{
+    return (unsigned)isa < (unsigned)N_ISAS ? ISA_NAMES[isa] : "unknown";
+}
+
+bool mandelbrot_isa_parse(const char* name, MandelbrotIsa* isa)
+{
+    for (int i = 0; i < N_ISAS; i++)
+    {
+        if (strcmp(name, ISA_NAMES[i]) == 0)
+        {
+            *isa = (MandelbrotIsa)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint64_t read_xcr0()
+{
+    uint32_t eax = 0;
+    uint32_t edx = 0;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+    return ((uint64_t)edx << 32) | eax;
+}
+
+bool mandelbrot_isa_supported(MandelbrotIsa isa)
+{
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+
+    if (!(ecx & bit_SSE4_2))
+        return false;
+    if (isa == ISA_SSE42)
+        return true;
+
+    // xgetbv is only there with OSXSAVE
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX) || !(ecx & bit_FMA))
+        return false;
+
+    const uint64_t xcr0 = read_xcr0();
+    if ((xcr0 & XCR0_AVX) != XCR0_AVX)
+        return false;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & bit_AVX2))
+        return false;
+    if (isa == ISA_AVX2)
+        return true;
+
+    return (ebx & bit_AVX512F) && (xcr0 & XCR0_AVX512) == XCR0_AVX512;
+}
+
+MandelbrotIsa mandelbrot_isa_best()
+{
+    static const MandelbrotIsa best = []
+    {
+        for (int i = N_ISAS - 1; i > 0; i--)
+            if (mandelbrot_isa_supported((MandelbrotIsa)i))
+                return (MandelbrotIsa)i;
+
+        return ISA_SSE42;
+    }();
+
+    return best;
+}
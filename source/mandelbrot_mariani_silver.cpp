@@ -0,0 +1,277 @@
+#include "mandelbrot_mariani_silver.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_fractal.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_thread_pool.h"
+#include "mandelbrot_vectorized.h"
+
+#include <algorithm>
+#include <vector>
+
+const uint16_t UNKNOWN = 0xFFFF;
+
+// Inclusive pixel bounds
+struct Rect
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+struct MarianiSilverFrame
+{
+    RenderParams       params;
+    std::vector<float> c_x;
+    std::vector<float> c_y;
+    // mandelbrot_iterations(), the tiles colorize from it
+    uint16_t*          iterations;
+
+    // Of the picked fractal
+    MandelbrotPointsFunc points;
+    bool                 connected;
+};
+
+// Per-thread scratch for a batch of pixels
+struct PixelBatch
+{
+    std::vector<int>      index;
+    std::vector<float>    c_x;
+    std::vector<float>    c_y;
+    std::vector<uint16_t> iterations;
+
+    std::vector<float>    rowC_y;
+};
+
+static void batch_add(const MarianiSilverFrame& frame, PixelBatch* batch, int x, int y)
+{
+    const int index = y * frame.params.width + x;
+    if (frame.iterations[index] != UNKNOWN)
+        return;
+
+    // Marked right away, so corners shared by two sides go in once
+    frame.iterations[index] = frame.params.maxIterations + 1;
+
+    batch->index.push_back(index);
+    batch->c_x.push_back(frame.c_x[x]);
+    batch->c_y.push_back(frame.c_y[y]);
+}
+
+static void batch_compute(const MarianiSilverFrame& frame, PixelBatch* batch)
+{
+    const int n = (int)batch->index.size();
+    batch->iterations.resize(n);
+
+    frame.points(frame.params, batch->c_x.data(), batch->c_y.data(), batch->iterations.data(), n);
+
+    for (int i = 0; i < n; i++)
+        frame.iterations[batch->index[i]] = batch->iterations[i];
+
+    batch->index.clear();
+    batch->c_x.clear();
+    batch->c_y.clear();
+}
+
+// The set is connected, so a uniform border means a uniform inside, with
+// one exception: a rectangle around the whole set. It contains c = 0,
+// as do the other connected sets of --fractal. Sets that are not
+// connected may have islands inside any border, they are never filled.
+//
+// A border of interior pixels is not enough though: exterior channels
+// thinner than a pixel reach deep into the set between the border
+// samples. Such rectangles are iterated instead, which the interior
+// checks of the kernel make cheap.
+static bool can_fill(const MarianiSilverFrame& frame, const Rect& rect, int value)
+{
+    if (!frame.connected || value == frame.params.maxIterations)
+        return false;
+
+    const bool hasOrigin = frame.c_x[rect.x0] <= 0.0f && 0.0f <= frame.c_x[rect.x1] &&
+                           frame.c_y[rect.y0] <= 0.0f && 0.0f <= frame.c_y[rect.y1];
+    return !hasOrigin;
+}
+
+static void batch_add_border(const MarianiSilverFrame& frame, PixelBatch* batch,
+                             const Rect& rect)
+{
+    for (int x = rect.x0; x <= rect.x1; x++)
+    {
+        batch_add(frame, batch, x, rect.y0);
+        batch_add(frame, batch, x, rect.y1);
+    }
+    for (int y = rect.y0 + 1; y < rect.y1; y++)
+    {
+        batch_add(frame, batch, rect.x0, y);
+        batch_add(frame, batch, rect.x1, y);
+    }
+}
+
+// Nothing inside a rectangle has been computed yet: siblings only share
+// borders. Wide rows are contiguous in frame.c_x and go to the kernel
+// directly, narrow ones are batched.
+static void compute_inside(const MarianiSilverFrame& frame, PixelBatch* batch, const Rect& rect)
+{
+    const int width = rect.x1 - rect.x0 - 1;
+    if (width <= 0)
+        return;
+
+    const float* c_x = &frame.c_x[rect.x0 + 1];
+
+    if (width >= MARIANI_SILVER_MIN_ROW)
+    {
+        std::vector<float>& c_y = batch->rowC_y;
+        c_y.resize(width);
+
+        for (int y = rect.y0 + 1; y < rect.y1; y++)
+        {
+            std::fill(c_y.begin(), c_y.end(), frame.c_y[y]);
+            frame.points(frame.params, c_x, c_y.data(),
+                         &frame.iterations[y * frame.params.width + rect.x0 + 1], width);
+        }
+        return;
+    }
+
+    for (int y = rect.y0 + 1; y < rect.y1; y++)
+    {
+        const int index = y * frame.params.width + rect.x0 + 1;
+        for (int i = 0; i < width; i++)
+            batch->index.push_back(index + i);
+
+        batch->c_x.insert(batch->c_x.end(), c_x, c_x + width);
+        batch->c_y.insert(batch->c_y.end(), width, frame.c_y[y]);
+    }
+}
+
+static bool border_is_uniform(const MarianiSilverFrame& frame, const Rect& rect, int* value)
+{
+    *value = frame.iterations[rect.y0 * frame.params.width + rect.x0];
+
+    for (int x = rect.x0; x <= rect.x1; x++)
+        if (frame.iterations[rect.y0 * frame.params.width + x] != *value ||
+            frame.iterations[rect.y1 * frame.params.width + x] != *value)
+            return false;
+
+    for (int y = rect.y0 + 1; y < rect.y1; y++)
+        if (frame.iterations[y * frame.params.width + rect.x0] != *value ||
+            frame.iterations[y * frame.params.width + rect.x1] != *value)
+            return false;
+
+    return true;
+}
+
+// Rectangles are subdivided level by level: the borders of a whole level
+// go through the kernel in one batch, so it runs on full vectors instead
+// of a few pixels per call.
+static void render_tile(const MarianiSilverFrame& frame, const Rect& tile, PixelBatch* batch)
+{
+    for (int y = tile.y0; y <= tile.y1; y++)
+        std::fill(&frame.iterations[y * frame.params.width + tile.x0],
+                  &frame.iterations[y * frame.params.width + tile.x1] + 1, UNKNOWN);
+
+    std::vector<Rect> level(1, tile);
+    std::vector<Rect> next;
+
+    batch_add_border(frame, batch, tile);
+    batch_compute(frame, batch);
+
+    while (!level.empty())
+    {
+        next.clear();
+
+        for (const Rect& rect : level)
+        {
+            int value = 0;
+            const bool uniform = border_is_uniform(frame, rect, &value);
+
+            const bool small = rect.x1 - rect.x0 < MARIANI_SILVER_MIN_SIDE ||
+                               rect.y1 - rect.y0 < MARIANI_SILVER_MIN_SIDE;
+
+            if (uniform && can_fill(frame, rect, value))
+            {
+                for (int y = rect.y0 + 1; y < rect.y1; y++)
+                    std::fill(&frame.iterations[y * frame.params.width + rect.x0 + 1],
+                              &frame.iterations[y * frame.params.width + rect.x1], value);
+                continue;
+            }
+
+            if (uniform || small)
+            {
+                compute_inside(frame, batch, rect);
+                continue;
+            }
+
+            // Halves share the middle line, it becomes part of both borders
+            Rect first  = rect;
+            Rect second = rect;
+            if (rect.x1 - rect.x0 >= rect.y1 - rect.y0)
+                first.x1 = second.x0 = (rect.x0 + rect.x1) / 2;
+            else
+                first.y1 = second.y0 = (rect.y0 + rect.y1) / 2;
+
+            next.push_back(first);
+            next.push_back(second);
+            batch_add_border(frame, batch, first);
+            batch_add_border(frame, batch, second);
+        }
+
+        batch_compute(frame, batch);
+        level.swap(next);
+    }
+}
+
+// Frame and tiles belong to one call, so renders of other contexts may
+// run at the same time
+static void prepare_frame(const RenderParams& params, float magnifier, float shiftX,
+                          MarianiSilverFrame* frame, std::vector<Tile>* tiles)
+{
+    frame->params = params;
+    frame->c_x.resize(params.width);
+    frame->c_y.resize(params.height);
+    frame->iterations = mandelbrot_iterations(params);
+    frame->points     = mandelbrot_fractal_points_func();
+    frame->connected  = mandelbrot_fractal_connected();
+
+    mandelbrot_vectorized_coords(params, magnifier, shiftX, frame->c_x.data(), frame->c_y.data());
+
+    tiles->clear();
+    for (int y = 0; y < params.height; y += MARIANI_SILVER_TILE)
+        for (int x = 0; x < params.width; x += MARIANI_SILVER_TILE)
+            tiles->push_back({ x, std::min(x + MARIANI_SILVER_TILE, params.width),
+                               y, std::min(y + MARIANI_SILVER_TILE, params.height) });
+}
+
+static void process_tile(const MarianiSilverFrame& frame, sf::Uint8* pixels, const Tile& tile)
+{
+    static thread_local PixelBatch batch;
+
+    // Tiles do not share pixels, so tasks never touch each other's data
+    const Rect rect = { tile.x_from, tile.y_from, tile.x_to - 1, tile.y_to - 1 };
+    render_tile(frame, rect, &batch);
+    mandelbrot_colorize(pixels, frame.params, frame.iterations, mandelbrot_palette(frame.params),
+                        tile.x_from, tile.x_to, tile.y_from, tile.y_to);
+}
+
+void mandelbrot_mariani_silver(sf::Uint8* pixels, const RenderParams& params,
+                               float magnifier, float shiftX)
+{
+    MarianiSilverFrame frame;
+    std::vector<Tile>  tiles;
+    prepare_frame(params, magnifier, shiftX, &frame, &tiles);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(params.nThreads)
+    for (size_t i = 0; i < tiles.size(); i++)
+        process_tile(frame, pixels, tiles[i]);
+}
+
+void mandelbrot_mariani_silver_pool(sf::Uint8* pixels, const RenderParams& params,
+                                    float magnifier, float shiftX)
+{
+    MarianiSilverFrame frame;
+    std::vector<Tile>  tiles;
+    prepare_frame(params, magnifier, shiftX, &frame, &tiles);
+
+    mandelbrot_thread_pool_scheduler(params).run(tiles, [=, &frame](const Tile& tile)
+    {
+        process_tile(frame, pixels, tile);
+    });
+}
@@ -1,25 +1,32 @@
 #include "mandelbrot_naive.h"
 #include "mandelbrot_config.h"
+#include "mandelbrot_interior.h"
+#include "mandelbrot_palette.h"
 
-void mandelbrot_naive(sf::Uint8* pixels, float magnifier, float shiftX) 
+void mandelbrot_naive(sf::Uint8* pixels, const RenderParams& params,
+                      float magnifier, float shiftX)
 {
     shiftX    += SHIFT_X_OFFSET;
     magnifier += MAGNIFIER_OFFSET;
 
     const float inv_magnifier = 1.0f / magnifier;
-    const float COLOR_SCALE = 255.0f / MAX_ITERATION_DEPTH;
 
-    const float pixel_step_x = ASPECT_RATIO * inv_magnifier * (2.0f / WINDOW_WIDTH);
-    const float pixel_step_y = inv_magnifier                * (2.0f / WINDOW_HEIGHT);
+    const float aspect       = aspect_ratio(params);
+    const float pixel_step_x = aspect * inv_magnifier * (2.0f / params.width);
+    const float pixel_step_y = inv_magnifier          * (2.0f / params.height);
 
-    float c_y = -1.0f * inv_magnifier;
+    const float max_radius2    = max_radius_2(params);
+    const int   max_iterations = params.maxIterations;
 
-    for (int screen_y = 0; screen_y < WINDOW_HEIGHT; screen_y++,
-                                                     c_y += pixel_step_y) 
+    uint16_t* buffer = mandelbrot_iterations(params);
+
+    for (int screen_y = 0; screen_y < params.height; screen_y++) 
     {
-        float c_x = shiftX - ASPECT_RATIO * inv_magnifier;
+        const float c_y = -1.0f * inv_magnifier + pixel_step_y * screen_y;
+
+        float c_x = shiftX - aspect * inv_magnifier;
 
-        for (int screen_x = 0; screen_x < WINDOW_WIDTH; screen_x++, 
+        for (int screen_x = 0; screen_x < params.width; screen_x++, 
                                                         c_x += pixel_step_x) 
         {
             int iterations = 0;
@@ -29,8 +36,16 @@ void mandelbrot_naive(sf::Uint8* pixels, float magnifier, float shiftX)
             float z_x2 = 0.0f;
             float z_y2 = 0.0f;
 
-            while (z_x2 + z_y2 < MAX_RADIUS_2 &&
-                   iterations < MAX_ITERATION_DEPTH) 
+            float check_x = 0.0f;
+            float check_y = 0.0f;
+            int checkLength    = PERIOD_CHECK_START;
+            int checkRemaining = PERIOD_CHECK_START;
+
+            if (is_in_cardioid_or_bulb(c_x, c_y))
+                iterations = max_iterations;
+
+            while (z_x2 + z_y2 < max_radius2 &&
+                   iterations < max_iterations) 
             {
                 z_y = 2 * z_x * z_y + c_y;
                 z_x = z_x2 - z_y2 + c_x;
@@ -39,24 +54,25 @@ void mandelbrot_naive(sf::Uint8* pixels, float magnifier, float shiftX)
                 z_y2 = z_y * z_y;
 
                 ++iterations;
-            }
 
-                sf::Uint8 r = 0;
-                sf::Uint8 g = 0;
-                sf::Uint8 b = 0;
-                if (iterations < MAX_ITERATION_DEPTH)
+                if (z_x == check_x && z_y == check_y)
                 {
-                    float iterNormalized = iterations * COLOR_SCALE;
-                    r = (sf::Uint8)(iterNormalized / 2);
-                    g = (sf::Uint8)(iterNormalized * 2 + 2);
-                    b = (sf::Uint8)(iterNormalized * 2 + 5);
+                    iterations = max_iterations;
+                    break;
                 }
 
-                int pixelIndex = (screen_y * WINDOW_WIDTH + screen_x) * 4;
-                pixels[pixelIndex + 0] = r;
-                pixels[pixelIndex + 1] = g;
-                pixels[pixelIndex + 2] = b;
-                pixels[pixelIndex + 3] = 255;
+                if (--checkRemaining == 0)
+                {
+                    check_x = z_x;
+                    check_y = z_y;
+                    checkLength   *= 2;
+                    checkRemaining = checkLength;
+                }
+            }
+
+            buffer[(size_t)screen_y * params.width + screen_x] = (uint16_t)iterations;
         }
     }
+
+    mandelbrot_colorize(pixels, params);
 }
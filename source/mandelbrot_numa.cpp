@@ -0,0 +1,295 @@
+#include "mandelbrot_numa.h"
+#include "mandelbrot_fractal.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_profile.h"
+#include "mandelbrot_scheduler.h"
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+// Tiles are small enough to steal from a band, widths are multiples of 8
+const int NUMA_TILE_WIDTH  = 128;
+const int NUMA_TILE_HEIGHT = 32;
+
+// Size of the mbind node mask, nodes past it are not bound
+const int NUMA_MAX_NODES = 1024;
+
+const int BITS_PER_LONG = 8 * sizeof(unsigned long);
+
+// "0-3,8,10-11" as in /sys/devices/system/node
+static std::vector<int> parse_list(const char* text)
+{
+    std::vector<int> values;
+
+    for (;;)
+    {
+        char* end = NULL;
+        const long first = strtol(text, &end, 10);
+        if (end == text)
+            break;
+
+        long last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+
+        for (long value = first; value <= last; value++)
+            values.push_back((int)value);
+
+        if (*end != ',')
+            break;
+        text = end + 1;
+    }
+
+    return values;
+}
+
+static std::vector<int> read_list(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return {};
+
+    char line[4096] = {};
+    const bool ok = fgets(line, sizeof(line), file) != NULL;
+    fclose(file);
+
+    return ok ? parse_list(line) : std::vector<int>();
+}
+
+static std::vector<NumaNode> find_nodes()
+{
+    cpu_set_t allowed;
+    const bool haveAffinity = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    std::vector<int> allCpus;
+    for (int cpu = 0; haveAffinity && cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &allowed))
+            allCpus.push_back(cpu);
+    if (allCpus.empty())
+        for (int cpu = 0; cpu < (int)std::max(1u, std::thread::hardware_concurrency()); cpu++)
+            allCpus.push_back(cpu);
+
+    std::vector<NumaNode> nodes;
+    for (int id : read_list("/sys/devices/system/node/online"))
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+
+        NumaNode node = { id, {} };
+        for (int cpu : read_list(path))
+            if (std::find(allCpus.begin(), allCpus.end(), cpu) != allCpus.end())
+                node.cpus.push_back(cpu);
+
+        // Memory-only nodes, and the ones this process is kept off
+        if (!node.cpus.empty())
+            nodes.push_back(node);
+    }
+
+    if (nodes.empty())
+        nodes.push_back({ 0, allCpus });
+
+    return nodes;
+}
+
+const std::vector<NumaNode>& mandelbrot_numa_nodes()
+{
+    static const std::vector<NumaNode> nodes = find_nodes();
+    return nodes;
+}
+
+// Workers of every node for nThreads
+static std::vector<int> place_workers(int nThreads)
+{
+    const std::vector<NumaNode>& nodes = mandelbrot_numa_nodes();
+    std::vector<int> nWorkers(nodes.size(), 0);
+
+    int left = nThreads;
+    for (size_t node = 0; node < nodes.size() && left > 0; node++)
+    {
+        nWorkers[node] = std::min(left, (int)nodes[node].cpus.size());
+        left -= nWorkers[node];
+    }
+
+    for (size_t node = 0; left > 0; node = (node + 1) % nodes.size(), left--)
+        nWorkers[node]++;
+
+    return nWorkers;
+}
+
+int mandelbrot_numa_nodes_used(int nThreads)
+{
+    const std::vector<int> nWorkers = place_workers(nThreads);
+    return (int)std::count_if(nWorkers.begin(), nWorkers.end(), [](int n) { return n > 0; });
+}
+
+bool mandelbrot_numa_bind_rows(void* buffer, size_t rowBytes, int y_from, int y_to, int node)
+{
+    if (node >= NUMA_MAX_NODES)
+        return false;
+
+    // Pages shared with the rows around stay where they are
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t from = ((uintptr_t)buffer + y_from * rowBytes + page - 1) / page * page;
+    const uintptr_t to   = ((uintptr_t)buffer + y_to   * rowBytes) / page * page;
+    if (to <= from)
+        return true;
+
+    unsigned long mask[NUMA_MAX_NODES / BITS_PER_LONG] = {};
+    mask[node / BITS_PER_LONG] |= 1UL << (node % BITS_PER_LONG);
+
+    // The kernel reads one bit less than maxnode
+    return syscall(SYS_mbind, from, to - from, MPOL_BIND, mask,
+                   (unsigned long)NUMA_MAX_NODES + 1, MPOL_MF_MOVE) == 0;
+}
+
+// Destroyed at exit, which joins the workers
+static std::unique_ptr<TileScheduler> pool;
+
+// The buffers whose bands are on their nodes
+struct BoundFrame
+{
+    const void* pixels;
+    const void* iterations;
+    int         width;
+    int         height;
+    int         nThreads;
+};
+
+static BoundFrame boundFrame;
+static bool       bindFailed = false;
+
+static TileScheduler& numa_scheduler(const RenderParams& params)
+{
+    if (pool && pool->nThreads() == params.nThreads)
+        return *pool;
+
+    const std::vector<NumaNode>& nodes    = mandelbrot_numa_nodes();
+    const std::vector<int>       nWorkers = place_workers(params.nThreads);
+
+    std::vector<SchedulerNode> schedulerNodes;
+    for (size_t node = 0; node < nodes.size(); node++)
+        schedulerNodes.push_back({ nWorkers[node], nodes[node].cpus });
+
+    pool.reset(new TileScheduler(schedulerNodes));
+    return *pool;
+}
+
+static void build_tiles(const RenderParams& params, std::vector<Tile>* tiles)
+{
+    tiles->clear();
+    for (int y = 0; y < params.height; y += NUMA_TILE_HEIGHT)
+        for (int x = 0; x < params.width; x += NUMA_TILE_WIDTH)
+            tiles->push_back({ x, std::min(x + NUMA_TILE_WIDTH,  params.width),
+                               y, std::min(y + NUMA_TILE_HEIGHT, params.height) });
+}
+
+// Moves the band of every node to it, once per buffer and split. The
+// band of a node starts at the row of its first tile.
+static void bind_bands(const TileScheduler& scheduler, const std::vector<Tile>& tiles,
+                       sf::Uint8* pixels, uint16_t* iterations, const RenderParams& params)
+{
+    const BoundFrame frame = { pixels, iterations, params.width, params.height, params.nThreads };
+    const bool bound = frame.pixels     == boundFrame.pixels     &&
+                       frame.iterations == boundFrame.iterations &&
+                       frame.width      == boundFrame.width      &&
+                       frame.height     == boundFrame.height     &&
+                       frame.nThreads   == boundFrame.nThreads;
+    if (bindFailed || bound)
+        return;
+    boundFrame = frame;
+
+    const std::vector<NumaNode>& nodes = mandelbrot_numa_nodes();
+    for (int node = 0; node < scheduler.nNodes(); node++)
+    {
+        const size_t first = scheduler.nodeFirstTile(node,     tiles.size());
+        const size_t next  = scheduler.nodeFirstTile(node + 1, tiles.size());
+        if (first == next)
+            continue;
+
+        const int y_from = tiles[first].y_from;
+        const int y_to   = next < tiles.size() ? tiles[next].y_from : params.height;
+
+        const bool ok = mandelbrot_numa_bind_rows(pixels, params.width * 4, y_from, y_to,
+                                                  nodes[node].id) &&
+                        mandelbrot_numa_bind_rows(iterations, params.width * sizeof(uint16_t),
+                                                  y_from, y_to, nodes[node].id);
+        if (!ok)
+        {
+            fprintf(stderr, "Can't move the frame to NUMA node %d, rendering without\n",
+                    nodes[node].id);
+            bindFailed = true;
+            return;
+        }
+    }
+}
+
+void mandelbrot_numa(sf::Uint8* pixels, const RenderParams& params,
+                     float magnifier, float shiftX)
+{
+    TileScheduler& scheduler  = numa_scheduler(params);
+    uint16_t*      iterations = mandelbrot_iterations(params);
+
+    static std::vector<Tile> tiles;
+    build_tiles(params, &tiles);
+
+    // Nothing to move between on a single node
+    if (scheduler.nNodes() > 1)
+        bind_bands(scheduler, tiles, pixels, iterations, params);
+
+    const MandelbrotTileFunc tileFunc = mandelbrot_fractal_tile_func(params, magnifier, shiftX);
+
+    scheduler.run(tiles, [=, &params](const Tile& tile)
+    {
+        const ProfileSpan span = profile_span_begin();
+        tileFunc(pixels, params, magnifier, shiftX, tile.x_from, tile.x_to, tile.y_from, tile.y_to);
+        profile_span_end(span, "tile", params, tile.x_from, tile.x_to, tile.y_from, tile.y_to);
+    });
+}
+
+void mandelbrot_numa_print_stats(FILE* file)
+{
+    if (!pool)
+        return;
+
+    const TileScheduler&         scheduler = *pool;
+    const std::vector<NumaNode>& nodes     = mandelbrot_numa_nodes();
+
+    fprintf(file, "numa: %d threads on %d nodes, last frame %.3f ms\n",
+            scheduler.nThreads(), mandelbrot_numa_nodes_used(scheduler.nThreads()),
+            scheduler.frameMs());
+
+    for (int i = 0; i < scheduler.nThreads(); i++)
+    {
+        const WorkerStats& stats = scheduler.stats()[i];
+        fprintf(file, "  thread %2d on node %d: busy %8.3f ms  idle %8.3f ms  %4d tiles  "
+                      "%4d stolen, %4d from other nodes\n",
+                i, nodes[scheduler.workerNode(i)].id, stats.busyMs, stats.idleMs,
+                stats.nTiles, stats.nStolen, stats.nRemote);
+    }
+}
+
+std::vector<int> mandelbrot_numa_scaling_threads()
+{
+    std::vector<int> nThreads;
+
+    int before = 0;
+    for (const NumaNode& node : mandelbrot_numa_nodes())
+    {
+        const int nCpus = (int)node.cpus.size();
+        for (int n = 1; n < nCpus; n *= 2)
+            nThreads.push_back(before + n);
+        nThreads.push_back(before + nCpus);
+
+        before += nCpus;
+    }
+
+    return nThreads;
+}
@@ -0,0 +1,159 @@
+#include "mandelbrot_options.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "mandelbrot_image_file.h"
+#include "mandelbrot_isa.h"
+
+void mandelbrot_print_usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s {mode} [number_of_test_iterations] "
+                    "[--warmup N] [--csv file] [--json file] [--scaling on|off] "
+                    "[--width W] [--height H] [--iterations N|auto] [--radius R] "
+                    "[--threads N] [--isa sse4.2|avx2|avx512] [--budget MS] [--profile file] "
+                    "[--fractal NAME|all] [--julia-c X,Y] "
+                    "[--trace file] [--huge-pages on|off] [--output file [--format png|tiff|raw] "
+                    "[--strip-rows N] [--scale S] [--shift-x X] [--shift-y Y] [--aa N]] "
+                    "[--video file|- [--frames N] [--zoom-to S] [--key-frames on|off]] "
+                    "[--serve unix:path|[host:]port [--cache-dir dir] [--cache-mb N]] "
+                    "[--farm unix:path|[host:]port [--workers N] [--farm-tile N] "
+                    "[--lease-ms MS] [--scaling on|off]]\n"
+                    "       %s worker --connect unix:path|[host:]port [--threads N]\n"
+                    "       %s tune [--profile file] [--width W] [--height H] [--iterations N]\n",
+            program, program, program);
+}
+
+int mandelbrot_parse_int(const char* value, int invalid)
+{
+    char* end = NULL;
+    errno = 0;
+    const long number = strtol(value, &end, 10);
+
+    if (end == value || *end != '\0' || errno == ERANGE || number < INT_MIN || number > INT_MAX)
+        return invalid;
+
+    return (int)number;
+}
+
+bool mandelbrot_parse_render_option(const char* option, const char* value, RenderParams* params)
+{
+    if      (strcmp(option, "--width"     ) == 0) sscanf(value, "%d", &params->width);
+    else if (strcmp(option, "--height"    ) == 0) sscanf(value, "%d", &params->height);
+    else if (strcmp(option, "--iterations") == 0) sscanf(value, "%d", &params->maxIterations);
+    else if (strcmp(option, "--radius"    ) == 0) sscanf(value, "%f", &params->maxRadius);
+    else if (strcmp(option, "--threads"   ) == 0) sscanf(value, "%d", &params->nThreads);
+    else if (strcmp(option, "--isa"       ) == 0)
+    {
+        if (!mandelbrot_isa_parse(value, &params->isa))
+            fprintf(stderr, "Unknown instruction set %s, using %s\n",
+                    value, mandelbrot_isa_name(params->isa));
+    }
+    else
+        return false;
+
+    return true;
+}
+
+bool mandelbrot_check_render_params(const RenderParams& params)
+{
+    if (params.width < 1 || params.height < 1)
+    {
+        fprintf(stderr, "Invalid resolution %dx%d\n", params.width, params.height);
+        return false;
+    }
+    if (params.maxIterations < 1 || params.maxIterations > MAX_ITERATION_LIMIT)
+    {
+        fprintf(stderr, "Iteration depth must be in [1, %d]\n", MAX_ITERATION_LIMIT);
+        return false;
+    }
+    if (!(params.maxRadius > 0.0f))
+    {
+        fprintf(stderr, "Escape radius must be positive\n");
+        return false;
+    }
+    if (params.nThreads < 1)
+    {
+        fprintf(stderr, "Number of threads must be positive\n");
+        return false;
+    }
+    if (!mandelbrot_isa_supported(params.isa))
+    {
+        fprintf(stderr, "This CPU does not support %s\n", mandelbrot_isa_name(params.isa));
+        return false;
+    }
+
+    return true;
+}
+
+bool mandelbrot_parse_batch_option(const char* option, const char* value, BatchJob* job,
+                                   bool* formatGiven)
+{
+    if      (strcmp(option, "--output"    ) == 0) job->output = value;
+    else if (strcmp(option, "--strip-rows") == 0) sscanf(value, "%d",  &job->stripRows);
+    else if (strcmp(option, "--scale"     ) == 0) sscanf(value, "%lf", &job->scale);
+    else if (strcmp(option, "--aa"        ) == 0) sscanf(value, "%d",  &job->aaSamples);
+    else if (strcmp(option, "--format"    ) == 0)
+    {
+        if (!mandelbrot_image_format(value, &job->format))
+            fprintf(stderr, "Unknown format %s, using raw\n", value);
+        *formatGiven = true;
+    }
+    else
+        return false;
+
+    return true;
+}
+
+bool mandelbrot_parse_video_option(const char* option, const char* value, VideoJob* video)
+{
+    if      (strcmp(option, "--video"     ) == 0) video->output = value;
+    else if (strcmp(option, "--frames"    ) == 0) sscanf(value, "%d",  &video->nFrames);
+    else if (strcmp(option, "--zoom-to"   ) == 0) sscanf(value, "%lf", &video->zoomTo);
+    else if (strcmp(option, "--key-frames") == 0) video->keyFrames = strcmp(value, "off") != 0;
+    else if (strcmp(option, "--tolerance" ) == 0) sscanf(value, "%d",  &video->tolerance);
+    else
+        return false;
+
+    return true;
+}
+
+bool mandelbrot_parse_farm_option(const char* option, const char* value, FarmJob* farm)
+{
+    if      (strcmp(option, "--farm"     ) == 0) farm->address = value;
+    else if (strcmp(option, "--workers"  ) == 0) farm->nWorkers = mandelbrot_parse_int(value, -1);
+    else if (strcmp(option, "--farm-tile") == 0) farm->tileSize = mandelbrot_parse_int(value, -1);
+    else if (strcmp(option, "--lease-ms" ) == 0) farm->leaseMs  = mandelbrot_parse_int(value, -1);
+    else if (strcmp(option, "--scaling"  ) == 0) farm->scaling = strcmp(value, "on") == 0;
+    else
+        return false;
+
+    return true;
+}
+
+bool mandelbrot_parse_bench_option(const char* option, const char* value, BenchOptions* bench)
+{
+    if      (strcmp(option, "--warmup" ) == 0) bench->nWarmup  = mandelbrot_parse_int(value, -1);
+    else if (strcmp(option, "--csv"    ) == 0) bench->csvPath  = value;
+    else if (strcmp(option, "--json"   ) == 0) bench->jsonPath = value;
+    else if (strcmp(option, "--scaling") == 0) bench->scaling  = strcmp(value, "on") == 0;
+    else
+        return false;
+
+    return true;
+}
+
+bool mandelbrot_parse_serve_option(const char* option, const char* value, TileServerConfig* serve)
+{
+    if      (strcmp(option, "--serve"    ) == 0) serve->address  = value;
+    else if (strcmp(option, "--cache-dir") == 0) serve->cacheDir = value;
+    else if (strcmp(option, "--cache-mb" ) == 0) sscanf(value, "%d", &serve->cacheMb);
+    else
+        return false;
+
+    return true;
+}
+
@@ -0,0 +1,122 @@
+#include "mandelbrot_palette.h"
+#include "mandelbrot_frame_buffer.h"
+
+#include <cstring>
+#include <x86intrin.h>
+
+static uint32_t pack_rgba(sf::Uint8 r, sf::Uint8 g, sf::Uint8 b, sf::Uint8 a)
+{
+    const sf::Uint8 bytes[4] = { r, g, b, a };
+
+    uint32_t rgba = 0;
+    memcpy(&rgba, bytes, sizeof(rgba));
+    return rgba;
+}
+
+void mandelbrot_palette_build(Palette* palette, int maxIterations, int offset)
+{
+    const float COLOR_SCALE = 255.0f / maxIterations;
+
+    palette->maxIterations = maxIterations;
+    palette->offset        = offset;
+    palette->rgba.resize(maxIterations + 1);
+
+    offset %= maxIterations;
+    if (offset < 0)
+        offset += maxIterations;
+
+    for (int iterations = 0; iterations < maxIterations; iterations++)
+    {
+        const int shifted = (iterations + offset) % maxIterations;
+
+        float iterNormalized = shifted * COLOR_SCALE;
+        sf::Uint8 r = (sf::Uint8)(iterNormalized / 2);
+        sf::Uint8 g = (sf::Uint8)(iterNormalized * 2 + 2);
+        sf::Uint8 b = (sf::Uint8)(iterNormalized * 2 + 5);
+
+        palette->rgba[iterations] = pack_rgba(r, g, b, 255);
+    }
+
+    palette->rgba[maxIterations] = pack_rgba(0, 0, 0, 255);
+}
+
+RenderContext::RenderContext()
+    : palette{ 0, 0, {} },
+      iterations(NULL),
+      size(0)
+{
+}
+
+RenderContext::~RenderContext()
+{
+    mandelbrot_frame_buffer_free(iterations);
+}
+
+const Palette& mandelbrot_palette(const RenderParams& params)
+{
+    RenderContext* context = params.context;
+    std::lock_guard<std::mutex> lock(context->mutex);
+
+    if (context->palette.maxIterations != params.maxIterations)
+        mandelbrot_palette_build(&context->palette, params.maxIterations, context->palette.offset);
+
+    return context->palette;
+}
+
+void mandelbrot_palette_cycle(RenderContext* context, int offset)
+{
+    std::lock_guard<std::mutex> lock(context->mutex);
+
+    if (context->palette.maxIterations > 0)
+        mandelbrot_palette_build(&context->palette, context->palette.maxIterations, offset);
+    else
+        context->palette.offset = offset;
+}
+
+uint16_t* mandelbrot_iterations(const RenderParams& params)
+{
+    RenderContext* context = params.context;
+    std::lock_guard<std::mutex> lock(context->mutex);
+
+    if (context->size != (size_t)params.width * params.height)
+    {
+        mandelbrot_frame_buffer_free(context->iterations);
+        context->iterations = (uint16_t*)mandelbrot_frame_buffer_alloc(params.width * sizeof(uint16_t),
+                                                                       params.height, params.nThreads);
+        context->size = (size_t)params.width * params.height;
+    }
+
+    return context->iterations;
+}
+
+void mandelbrot_colorize(sf::Uint8* pixels, const RenderParams& params,
+                         const uint16_t* iterations, const Palette& palette,
+                         int x_from, int x_to, int y_from, int y_to)
+{
+    const int* lut = (const int*)palette.rgba.data();
+
+    for (int screenY = y_from; screenY < y_to; screenY++)
+    {
+        const uint16_t* rowIterations = iterations + (size_t)screenY * params.width;
+        uint32_t*       rowPixels     = (uint32_t*)pixels + (size_t)screenY * params.width;
+
+        int screenX = x_from;
+        for (; screenX + 8 <= x_to; screenX += 8)
+        {
+            // 8 counts -> 8 palette entries -> 8 RGBA pixels in one store
+            __m256i _index = _mm256_cvtepu16_epi32(
+                                 _mm_loadu_si128((const __m128i*)(rowIterations + screenX)));
+            __m256i _rgba  = _mm256_i32gather_epi32(lut, _index, 4);
+            _mm256_storeu_si256((__m256i*)(rowPixels + screenX), _rgba);
+        }
+
+        for (; screenX < x_to; screenX++)
+            rowPixels[screenX] = palette.rgba[rowIterations[screenX]];
+    }
+}
+
+void mandelbrot_colorize(sf::Uint8* pixels, const RenderParams& params)
+{
+    mandelbrot_colorize(pixels, params, mandelbrot_iterations(params), mandelbrot_palette(params),
+                        0, params.width, 0, params.height);
+}
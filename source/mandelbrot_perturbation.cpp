@@ -0,0 +1,374 @@
+#include "mandelbrot_perturbation.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_interior.h"
+#include "mandelbrot_palette.h"
+
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <x86intrin.h>
+#include <omp.h>
+
+typedef std::complex<double> Complex;
+
+// Z_0 .. Z_length of the reference point, Z_length is either the first
+// escaped point, Z_maxIterations or, for a periodic orbit, the first point
+// that is Z_(length - period) again
+struct ReferenceOrbit
+{
+    std::vector<double> x;
+    std::vector<double> y;
+    int length;
+    int period;  // 0 unless the orbit is periodic
+};
+
+static bool same_big_fixed(const BigFixed& a, const BigFixed& b)
+{
+    return a.negative == b.negative && memcmp(a.limbs, b.limbs, sizeof(a.limbs)) == 0;
+}
+
+// Coefficients of dz_n ~ a u + b u^2 + c u^3 with u = delta / deltaMax
+struct SeriesApproximation
+{
+    int skip;
+    Complex a;
+    Complex b;
+    Complex c;
+};
+
+static void compute_reference(const RenderParams& params,
+                              const BigFixed& c_x, const BigFixed& c_y, ReferenceOrbit* orbit)
+{
+    const int    maxIterations = params.maxIterations;
+    const double maxRadius2    = max_radius_2(params);
+
+    orbit->x.assign(maxIterations + 1, 0.0);
+    orbit->y.assign(maxIterations + 1, 0.0);
+
+    BigFixed z_x = bf_from_double(0.0);
+    BigFixed z_y = bf_from_double(0.0);
+
+    // Brent's cycle detection on the exact orbit: an interior reference
+    // point would cost the whole depth in BigFixed otherwise
+    BigFixed check_x = z_x;
+    BigFixed check_y = z_y;
+    int checkIndex     = 0;
+    int checkLength    = PERIOD_CHECK_START;
+    int checkRemaining = PERIOD_CHECK_START;
+
+    orbit->period = 0;
+
+    int n = 0;
+    for (; n < maxIterations; n++)
+    {
+        const double x = bf_to_double(z_x);
+        const double y = bf_to_double(z_y);
+        orbit->x[n] = x;
+        orbit->y[n] = y;
+
+        if (x * x + y * y >= maxRadius2)
+            break;
+
+        if (n > checkIndex && same_big_fixed(z_x, check_x) && same_big_fixed(z_y, check_y))
+        {
+            orbit->period = n - checkIndex;
+            break;
+        }
+
+        if (--checkRemaining == 0)
+        {
+            check_x    = z_x;
+            check_y    = z_y;
+            checkIndex = n;
+            checkLength   *= 2;
+            checkRemaining = checkLength;
+        }
+
+        BigFixed z_xy = bf_mul(z_x, z_y);
+        z_x = bf_add(bf_sub(bf_mul(z_x, z_x), bf_mul(z_y, z_y)), c_x);
+        z_y = bf_add(bf_add(z_xy, z_xy), c_y);
+    }
+
+    if (n == maxIterations)
+    {
+        orbit->x[n] = bf_to_double(z_x);
+        orbit->y[n] = bf_to_double(z_y);
+    }
+
+    orbit->length = n;
+}
+
+static SeriesApproximation compute_series(const RenderParams& params,
+                                          const ReferenceOrbit& orbit, double deltaMax)
+{
+    SeriesApproximation series = { 0, 0.0, 0.0, 0.0 };
+
+    Complex a = 0.0;
+    Complex b = 0.0;
+    Complex c = 0.0;
+
+    for (int n = 0; n + 1 < orbit.length; n++)
+    {
+        const Complex z2 = 2.0 * Complex(orbit.x[n], orbit.y[n]);
+
+        // dz' = 2 Z dz + dz^2 + delta, collected by powers of u
+        const Complex nextA = z2 * a + deltaMax;
+        const Complex nextB = z2 * b + a * a;
+        const Complex nextC = z2 * c + 2.0 * a * b;
+
+        if (std::abs(nextC) > SERIES_TOLERANCE * std::abs(nextB))
+            break;
+
+        // No pixel may escape during the skipped iterations
+        const double zMax = std::abs(Complex(orbit.x[n + 1], orbit.y[n + 1])) +
+                            std::abs(nextA) + std::abs(nextB) + std::abs(nextC);
+        if (zMax >= params.maxRadius)
+            break;
+
+        a = nextA;
+        b = nextB;
+        c = nextC;
+
+        series = { n + 1, a, b, c };
+    }
+
+    return series;
+}
+
+// The orbit and series of a view and what they were computed for
+struct ViewReference
+{
+    BigFixed c_x;
+    BigFixed c_y;
+    int      maxIterations;
+    float    maxRadius;
+    double   deltaMax;
+
+    ReferenceOrbit      orbit;
+    SeriesApproximation series;
+};
+
+// The reference of the last view rendered, which the bands, strips and
+// tiles of a view all share. A render of another view replaces it, the
+// renders still iterating the old one keep it alive.
+static std::mutex                           lastReferenceMutex;
+static std::shared_ptr<const ViewReference> lastReference;
+
+static std::shared_ptr<const ViewReference> view_reference(const RenderParams& params,
+                                                           const BigFixed& c_x, const BigFixed& c_y,
+                                                           double deltaMax)
+{
+    // Held while the orbit is computed: the other windows of the view
+    // wait for it instead of computing it again
+    std::lock_guard<std::mutex> lock(lastReferenceMutex);
+
+    const ViewReference* last = lastReference.get();
+    if (last && last->maxIterations == params.maxIterations && last->maxRadius == params.maxRadius &&
+        last->deltaMax == deltaMax && same_big_fixed(last->c_x, c_x) && same_big_fixed(last->c_y, c_y))
+        return lastReference;
+
+    std::shared_ptr<ViewReference> reference = std::make_shared<ViewReference>();
+    reference->c_x           = c_x;
+    reference->c_y           = c_y;
+    reference->maxIterations = params.maxIterations;
+    reference->maxRadius     = params.maxRadius;
+    reference->deltaMax      = deltaMax;
+
+    compute_reference(params, c_x, c_y, &reference->orbit);
+    reference->series = compute_series(params, reference->orbit, deltaMax);
+
+    lastReference = reference;
+    return reference;
+}
+
+static void perturbation_row(sf::Uint8* pixels, const RenderParams& params,
+                             uint16_t* iterations, const Palette& palette,
+                             const ReferenceOrbit& orbit,
+                             const SeriesApproximation& series, double deltaMax,
+                             double center_x, double center_y,
+                             double delta_x0, double c_step_x, double delta_y, int screenY)
+{
+    const __m256d _0123 = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+    const __m256d _maxRadius2 = _mm256_set1_pd(max_radius_2(params));
+    const __m256d _zero = _mm256_setzero_pd();
+
+    const __m256i _one    = _mm256_set1_epi64x(1);
+    const __m256i _length = _mm256_set1_epi64x(orbit.length);
+    const __m256i _loop   = _mm256_set1_epi64x(orbit.length - orbit.period);
+
+    const __m256d _delta_y = _mm256_set1_pd(delta_y);
+
+    uint16_t* rowIterations = iterations + (size_t)screenY * params.width;
+    for (int screenX = 0; screenX < params.width; screenX += 4)
+    {
+        // Columns of a window from their index in the view
+        __m256d _delta_x = _mm256_add_pd(_mm256_set1_pd(params.x_offset + screenX), _0123);
+        _delta_x = _mm256_add_pd(_mm256_set1_pd(delta_x0),
+                                 _mm256_mul_pd(_mm256_set1_pd(c_step_x), _delta_x));
+
+        // Starting delta from the series, per lane
+        double delta_x[4] = {};
+        _mm256_storeu_pd(delta_x, _delta_x);
+
+        double dz_x[4] = {};
+        double dz_y[4] = {};
+        for (int i = 0; i < 4; i++)
+        {
+            const Complex u = Complex(delta_x[i], delta_y) / deltaMax;
+            const Complex dz = u * (series.a + u * (series.b + u * series.c));
+            dz_x[i] = dz.real();
+            dz_y[i] = dz.imag();
+        }
+
+        __m256d _dz_x = _mm256_loadu_pd(dz_x);
+        __m256d _dz_y = _mm256_loadu_pd(dz_y);
+
+        __m256i _refIndex   = _mm256_set1_epi64x(series.skip);
+        __m256i _iterations = _mm256_set1_epi64x(params.maxIterations);
+
+        // Lanes in the cardioid or bulb keep maxIterations from the start.
+        // c rounded to double is only wrong within an ulp of the boundary,
+        // where orbits take some 1 / sqrt(ulp) ~ 10^8 iterations to escape.
+        __m256d _active = _mm256_andnot_pd(
+                              cardioid_or_bulb_mask4(_mm256_add_pd(_mm256_set1_pd(center_x), _delta_x),
+                                                     _mm256_set1_pd(center_y + delta_y)),
+                              _mm256_castsi256_pd(_mm256_set1_epi64x(-1)));
+
+        // Brent's cycle detection on the state of a lane, its delta and
+        // reference index: meeting both again exactly means the delta has
+        // stagnated on a cycle and the point is interior
+        __m256d _check_x    = _dz_x;
+        __m256d _check_y    = _dz_y;
+        __m256i _checkIndex = _refIndex;
+        int checkLength    = PERIOD_CHECK_START;
+        int checkRemaining = PERIOD_CHECK_START;
+
+        for (int iteration = series.skip; iteration < params.maxIterations; iteration++)
+        {
+            // Lanes were rebased independently, so each one has its own Z_m
+            __m256d _Z_x = _mm256_i64gather_pd(orbit.x.data(), _refIndex, 8);
+            __m256d _Z_y = _mm256_i64gather_pd(orbit.y.data(), _refIndex, 8);
+
+            __m256d _z_x = _mm256_add_pd(_Z_x, _dz_x);
+            __m256d _z_y = _mm256_add_pd(_Z_y, _dz_y);
+
+            __m256d _radius2 = _mm256_fmadd_pd(_z_x, _z_x, _mm256_mul_pd(_z_y, _z_y));
+
+            // if (active && radius^2 >= maxRadius^2) iterations = iteration
+            __m256d _escaped = _mm256_and_pd(_active,
+                                             _mm256_cmp_pd(_radius2, _maxRadius2, _CMP_GE_OQ));
+            _iterations = _mm256_castpd_si256(
+                              _mm256_blendv_pd(_mm256_castsi256_pd(_iterations),
+                                               _mm256_castsi256_pd(_mm256_set1_epi64x(iteration)),
+                                               _escaped));
+            _active = _mm256_andnot_pd(_escaped, _active);
+
+            if (!_mm256_movemask_pd(_active))
+                break;
+
+            // Rebase when the delta outgrows the full value or the
+            // reference orbit ends: dz = Z + dz, m = 0 (Z_0 = 0). A
+            // periodic orbit goes round its cycle again instead, Z_length
+            // is Z_(length - period).
+            __m256d _dzRadius2 = _mm256_fmadd_pd(_dz_x, _dz_x, _mm256_mul_pd(_dz_y, _dz_y));
+            __m256d _end    = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_refIndex, _length));
+            __m256d _rebase = _mm256_cmp_pd(_radius2, _dzRadius2, _CMP_LT_OQ);
+            if (orbit.period)
+                _refIndex = _mm256_castpd_si256(
+                                _mm256_blendv_pd(_mm256_castsi256_pd(_refIndex),
+                                                 _mm256_castsi256_pd(_loop), _end));
+            else
+                _rebase = _mm256_or_pd(_rebase, _end);
+
+            _dz_x = _mm256_blendv_pd(_dz_x, _z_x, _rebase);
+            _dz_y = _mm256_blendv_pd(_dz_y, _z_y, _rebase);
+            _Z_x  = _mm256_blendv_pd(_Z_x, _zero, _rebase);
+            _Z_y  = _mm256_blendv_pd(_Z_y, _zero, _rebase);
+            _refIndex = _mm256_andnot_si256(_mm256_castpd_si256(_rebase), _refIndex);
+
+            // dz = (2Z + dz) dz + delta
+            __m256d _t_x = _mm256_add_pd(_mm256_add_pd(_Z_x, _Z_x), _dz_x);
+            __m256d _t_y = _mm256_add_pd(_mm256_add_pd(_Z_y, _Z_y), _dz_y);
+
+            __m256d _new_dz_x = _mm256_fmsub_pd(_t_x, _dz_x, _mm256_fmsub_pd(_t_y, _dz_y, _delta_x));
+            __m256d _new_dz_y = _mm256_fmadd_pd(_t_x, _dz_y, _mm256_fmadd_pd(_t_y, _dz_x, _delta_y));
+
+            _dz_x = _new_dz_x;
+            _dz_y = _new_dz_y;
+
+            _refIndex = _mm256_add_epi64(_refIndex, _one);
+
+            __m256d _periodic = _mm256_and_pd(
+                _mm256_and_pd(_mm256_cmp_pd(_dz_x, _check_x, _CMP_EQ_OQ),
+                              _mm256_cmp_pd(_dz_y, _check_y, _CMP_EQ_OQ)),
+                _mm256_castsi256_pd(_mm256_cmpeq_epi64(_refIndex, _checkIndex)));
+            _active = _mm256_andnot_pd(_periodic, _active);
+
+            if (--checkRemaining == 0)
+            {
+                _check_x    = _dz_x;
+                _check_y    = _dz_y;
+                _checkIndex = _refIndex;
+                checkLength   *= 2;
+                checkRemaining = checkLength;
+            }
+        }
+
+        long long iterationsArray[4] = {};
+        _mm256_storeu_si256((__m256i*)iterationsArray, _iterations);
+        // Lanes past the last column are dropped
+        for (int i = 0; i < 4 && screenX + i < params.width; i++)
+            rowIterations[screenX + i] = (uint16_t)iterationsArray[i];
+    }
+
+    mandelbrot_colorize(pixels, params, iterations, palette,
+                        0, params.width, screenY, screenY + 1);
+}
+
+void mandelbrot_perturbation(sf::Uint8* pixels, const RenderParams& params, double magnifier,
+                             const BigFixed& shiftX, const BigFixed& shiftY,
+                             PerturbationStats* stats)
+{
+    magnifier += MAGNIFIER_OFFSET;
+
+    const double invMagnifier = 1.0 / magnifier;
+
+    // Steps and indices of the whole view, if the frame is a window of it
+    const RenderParams view = view_params(params);
+
+    const double c_step_x = aspect_ratio_double(view) * invMagnifier * (2.0 / view.width);
+    const double c_step_y = invMagnifier * (2.0 / view.height);
+
+    // Deltas are taken from the view center, which is the reference point
+    const double delta_x0 = -aspect_ratio_double(view) * invMagnifier;
+    const double delta_y0 = -1.0 * invMagnifier;
+    const double deltaMax = std::hypot(delta_x0, delta_y0);
+
+    const BigFixed c_x = bf_add(shiftX, bf_from_double(SHIFT_X_OFFSET));
+
+    // The view center rounded to double, for the cardioid and bulb test
+    const double center_x = bf_to_double(c_x);
+    const double center_y = bf_to_double(shiftY);
+
+    const std::shared_ptr<const ViewReference> reference = view_reference(params, c_x, shiftY,
+                                                                          deltaMax);
+    const ReferenceOrbit&      orbit  = reference->orbit;
+    const SeriesApproximation& series = reference->series;
+
+    if (stats)
+        *stats = { orbit.length, series.skip };
+
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(params.nThreads)
+    for (int screenY = 0; screenY < params.height; screenY++)
+    {
+        perturbation_row(pixels, params, iterations, palette, orbit, series, deltaMax,
+                         center_x, center_y, delta_x0, c_step_x, delta_y0 + c_step_y * (params.y_offset + screenY),
+                         screenY);
+    }
+}
@@ -0,0 +1,263 @@
+#include "mandelbrot_profile.h"
+#include "mandelbrot_palette.h"
+
+#include <cstdio>
+#include <mutex>
+
+#ifdef PROFILE
+
+// Beyond this the trace only counts what it drops, about 100 bytes each
+const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+struct ProfileEvent
+{
+    const char* name;
+    const char* viewport;  // frames only
+    bool        frame;
+
+    int    thread;
+    double startUs;
+    double durationUs;
+
+    int x_from;
+    int x_to;
+    int y_from;
+    int y_to;
+
+    uint64_t iterations;
+    int      nEscaped;
+    int      nMaxDepth;
+    uint64_t laneTrips;
+    uint64_t lanes;
+    uint64_t activeLanes;
+};
+
+// Written only by its own thread, read by frame_end once the kernels
+// of the frame have joined
+struct ThreadLog
+{
+    int                       id;
+    std::vector<ProfileEvent> events;
+};
+
+thread_local ProfileLanes profileLanes;
+
+static thread_local ThreadLog* threadLog = nullptr;
+
+static const ProfileClock::time_point epoch = ProfileClock::now();
+
+// Logs are never freed, pool and OpenMP threads may outlive main
+static std::mutex              registryMutex;
+static std::vector<ThreadLog*> threadLogs;
+static std::vector<ProfileEvent> trace;
+static size_t                  nDropped = 0;
+
+static ProfileClock::time_point frameStart;
+static const char*              frameMode     = nullptr;
+static const char*              frameViewport = nullptr;
+
+static std::mutex               lastFrameMutex;
+static std::vector<ProfileCell> lastFrame;
+
+static double to_us(ProfileClock::time_point time)
+{
+    return std::chrono::duration<double, std::micro>(time - epoch).count();
+}
+
+static ThreadLog* thread_log()
+{
+    if (!threadLog)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        threadLog = new ThreadLog{ (int)threadLogs.size(), {} };
+        threadLogs.push_back(threadLog);
+    }
+
+    return threadLog;
+}
+
+void profile_span_end(const ProfileSpan& span, const char* name, const RenderParams& params,
+                      int x_from, int x_to, int y_from, int y_to)
+{
+    const ProfileClock::time_point end = ProfileClock::now();
+
+    ProfileEvent event = {};
+    event.name       = name;
+    event.thread     = thread_log()->id;
+    event.startUs    = to_us(span.start);
+    event.durationUs = std::chrono::duration<double, std::micro>(end - span.start).count();
+    event.x_from = x_from;
+    event.x_to   = x_to;
+    event.y_from = y_from;
+    event.y_to   = y_to;
+
+    event.laneTrips   = profileLanes.trips  - span.laneTrips;
+    event.lanes       = profileLanes.lanes  - span.lanes;
+    event.activeLanes = profileLanes.active - span.activeLanes;
+
+    const uint16_t* iterations = mandelbrot_iterations(params);
+    for (int y = y_from; y < y_to; y++)
+        for (int x = x_from; x < x_to; x++)
+        {
+            const int count = iterations[(size_t)y * params.width + x];
+            event.iterations += count;
+            if (count < params.maxIterations)
+                event.nEscaped++;
+            else
+                event.nMaxDepth++;
+        }
+
+    threadLog->events.push_back(event);
+}
+
+void mandelbrot_profile_frame_begin(const char* mode, const char* viewport)
+{
+    frameStart    = ProfileClock::now();
+    frameMode     = mode;
+    frameViewport = viewport;
+}
+
+void mandelbrot_profile_frame_end()
+{
+    ProfileEvent frame = {};
+    frame.name       = frameMode;
+    frame.viewport   = frameViewport;
+    frame.frame      = true;
+    frame.thread     = thread_log()->id;
+    frame.startUs    = to_us(frameStart);
+    frame.durationUs = std::chrono::duration<double, std::micro>(ProfileClock::now() - frameStart).count();
+
+    std::vector<ProfileCell> cells;
+
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+
+        for (ThreadLog* log : threadLogs)
+        {
+            for (const ProfileEvent& event : log->events)
+            {
+                if (event.startUs >= frame.startUs)
+                    cells.push_back({ event.x_from, event.x_to, event.y_from, event.y_to,
+                                      event.durationUs / 1000.0 });
+
+                if (trace.size() < MAX_TRACE_EVENTS)
+                    trace.push_back(event);
+                else
+                    nDropped++;
+            }
+            log->events.clear();
+        }
+
+        if (trace.size() < MAX_TRACE_EVENTS)
+            trace.push_back(frame);
+        else
+            nDropped++;
+    }
+
+    // Frames of kernels without spans keep the last heatmap
+    if (cells.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(lastFrameMutex);
+    lastFrame.swap(cells);
+}
+
+bool mandelbrot_profile_enabled()
+{
+    return true;
+}
+
+bool mandelbrot_profile_last_frame(std::vector<ProfileCell>* cells)
+{
+    std::lock_guard<std::mutex> lock(lastFrameMutex);
+    *cells = lastFrame;
+    return !cells->empty();
+}
+
+static void write_event(FILE* file, const ProfileEvent& event)
+{
+    fprintf(file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,"
+                  "\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+            event.name ? event.name : "frame", event.frame ? "frame" : "span",
+            event.thread, event.startUs, event.durationUs);
+
+    if (event.frame)
+    {
+        fprintf(file, "\"viewport\":\"%s\"}}", event.viewport ? event.viewport : "");
+        return;
+    }
+
+    fprintf(file, "\"x\":[%d,%d],\"y\":[%d,%d],\"iterations\":%llu,"
+                  "\"escaped\":%d,\"max_depth\":%d",
+            event.x_from, event.x_to, event.y_from, event.y_to,
+            (unsigned long long)event.iterations, event.nEscaped, event.nMaxDepth);
+
+    // Share of the lanes that were still iterating over all loop trips
+    if (event.laneTrips > 0)
+        fprintf(file, ",\"loop_trips\":%llu,\"lane_utilization\":%.4f",
+                (unsigned long long)event.laneTrips,
+                (double)event.activeLanes / event.lanes);
+
+    fprintf(file, "}}");
+}
+
+bool mandelbrot_profile_write_trace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    // Spans after the last frame
+    for (ThreadLog* log : threadLogs)
+    {
+        trace.insert(trace.end(), log->events.begin(), log->events.end());
+        log->events.clear();
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    const char* separator = "\n";
+    for (size_t i = 0; i < threadLogs.size(); i++)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+                      "\"args\":{\"name\":\"thread %d\"}}",
+                separator, (int)i, (int)i);
+        separator = ",\n";
+    }
+
+    for (const ProfileEvent& event : trace)
+    {
+        fputs(separator, file);
+        write_event(file, event);
+        separator = ",\n";
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    if (nDropped > 0)
+        fprintf(stderr, "Trace full, %zu events dropped\n", nDropped);
+
+    return true;
+}
+
+#else
+
+bool mandelbrot_profile_enabled()
+{
+    return false;
+}
+
+bool mandelbrot_profile_last_frame(std::vector<ProfileCell>*)
+{
+    return false;
+}
+
+bool mandelbrot_profile_write_trace(const char*)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "mandelbrot_progressive.h"
+#include "mandelbrot_double.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_vectorized.h"
+
+#include <algorithm>
+#include <omp.h>
+
+// Per-thread scratch for the new samples of one row
+struct SampleBatch
+{
+    std::vector<int>      x;
+    std::vector<float>    c_x;
+    std::vector<float>    c_y;
+    std::vector<double>   c_xd;
+    std::vector<double>   c_yd;
+    std::vector<uint16_t> iterations;
+};
+
+void mandelbrot_progressive_start(ProgressiveFrame* frame, const RenderParams& params,
+                                  ProgressiveKernel kernel, double scale,
+                                  const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    frame->kernel  = kernel;
+    frame->stride  = PROGRESSIVE_FIRST_STRIDE;
+    frame->nextRow = 0;
+
+    // The arguments the mode itself would get
+    if (kernel == PROGRESSIVE_FLOAT)
+    {
+        frame->columnC_x.resize(params.width);
+        frame->rowC_y   .resize(params.height);
+        mandelbrot_vectorized_coords(params, (float)scale, (float)bf_to_double(shiftX),
+                                     frame->columnC_x.data(), frame->rowC_y.data());
+    }
+    else
+    {
+        frame->columnC_xd.resize(params.width);
+        frame->rowC_yd   .resize(params.height);
+        mandelbrot_double_coords(params, scale, bf_to_double(shiftX), bf_to_double(shiftY),
+                                 frame->columnC_xd.data(), frame->rowC_yd.data());
+    }
+}
+
+// Iterates the samples of row y the coarser passes have not and fills
+// the stride x stride block of each, clipped to the frame
+static void refine_row(const ProgressiveFrame& frame, const RenderParams& params,
+                       uint16_t* iterations, int y)
+{
+    static thread_local SampleBatch batch;
+
+    const int stride = frame.stride;
+    uint16_t* row    = iterations + (size_t)y * params.width;
+
+    // Rows of the coarser pass already have every other sample
+    const bool coarseRow = stride < PROGRESSIVE_FIRST_STRIDE && y % (2 * stride) == 0;
+    const int  x_first   = coarseRow ? stride     : 0;
+    const int  x_step    = coarseRow ? 2 * stride : stride;
+
+    // The other rows of the last pass are whole rows of the frame
+    const bool wholeRow = x_step == 1;
+
+    batch.x.clear();
+    for (int x = x_first; x < params.width; x += x_step)
+        batch.x.push_back(x);
+
+    const int n = (int)batch.x.size();
+    batch.iterations.resize(n);
+    uint16_t* counts = wholeRow ? row : batch.iterations.data();
+
+    if (frame.kernel == PROGRESSIVE_FLOAT)
+    {
+        batch.c_y.assign(n, frame.rowC_y[y]);
+        const float* c_x = frame.columnC_x.data();
+        if (!wholeRow)
+        {
+            batch.c_x.resize(n);
+            for (int i = 0; i < n; i++)
+                batch.c_x[i] = frame.columnC_x[batch.x[i]];
+            c_x = batch.c_x.data();
+        }
+
+        mandelbrot_vectorized_points(params, c_x, batch.c_y.data(), counts, n);
+    }
+    else
+    {
+        batch.c_yd.assign(n, frame.rowC_yd[y]);
+        const double* c_x = frame.columnC_xd.data();
+        if (!wholeRow)
+        {
+            batch.c_xd.resize(n);
+            for (int i = 0; i < n; i++)
+                batch.c_xd[i] = frame.columnC_xd[batch.x[i]];
+            c_x = batch.c_xd.data();
+        }
+
+        mandelbrot_double_points(params, c_x, batch.c_yd.data(), counts, n);
+    }
+
+    if (wholeRow)
+        return;
+
+    // Row y gets the blocks of the new samples next to those of the
+    // coarser ones and is then the row of every block; the rows below it
+    // up to the next sample row have no samples of this or earlier passes
+    for (int i = 0; i < n; i++)
+        std::fill(row + batch.x[i], row + std::min(batch.x[i] + stride, params.width),
+                  batch.iterations[i]);
+
+    const int y_to = std::min(y + stride, params.height);
+    for (int blockY = y + 1; blockY < y_to; blockY++)
+        std::copy(row, row + params.width, iterations + (size_t)blockY * params.width);
+}
+
+bool mandelbrot_progressive_continue(ProgressiveFrame* frame, sf::Uint8* pixels,
+                                     const RenderParams& params,
+                                     std::chrono::steady_clock::time_point deadline)
+{
+    if (mandelbrot_progressive_done(*frame))
+        return false;
+
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+    // Two sample rows per thread between the deadline checks
+    const int bandRows = 2 * params.nThreads;
+
+    do
+    {
+        const int stride = frame->stride;
+        const int y_from = frame->nextRow;
+        const int y_to   = std::min(y_from + bandRows * stride, params.height);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(params.nThreads)
+        for (int y = y_from; y < y_to; y += stride)
+            refine_row(*frame, params, iterations, y);
+
+        mandelbrot_colorize(pixels, params, iterations, palette, 0, params.width, y_from, y_to);
+
+        frame->nextRow = y_to;
+        if (frame->nextRow >= params.height)
+        {
+            frame->stride /= 2;
+            frame->nextRow = 0;
+        }
+    }
+    while (!mandelbrot_progressive_done(*frame) &&
+           (frame->stride == PROGRESSIVE_FIRST_STRIDE || std::chrono::steady_clock::now() < deadline));
+
+    return true;
+}
@@ -0,0 +1,133 @@
+#include "mandelbrot_render_thread.h"
+#include "mandelbrot_frame_buffer.h"
+
+#include <algorithm>
+#include <cassert>
+
+RenderThread::RenderThread(const RenderParams& params, const RenderFunc& func)
+    : func_(func),
+      size_((size_t)params.width * params.height * 4),
+      work_((sf::Uint8*)mandelbrot_frame_buffer_alloc(params.width * 4, params.height,
+                                                      params.nThreads)),
+      view_(),
+      generation_(0),
+      stopping_(false)
+{
+    for (Slot& slot : slots_)
+    {
+        slot.pixels = (sf::Uint8*)mandelbrot_frame_buffer_alloc(params.width * 4, params.height,
+                                                                params.nThreads);
+        slot.state  = SLOT_FREE;
+    }
+
+    thread_ = std::thread(&RenderThread::render_loop, this);
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeCond_.notify_one();
+
+    thread_.join();
+
+    mandelbrot_frame_buffer_free(work_);
+    for (Slot& slot : slots_)
+        mandelbrot_frame_buffer_free(slot.pixels);
+}
+
+void RenderThread::post(const RenderView& view)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        view_ = view;
+        generation_++;
+    }
+    wakeCond_.notify_one();
+}
+
+const sf::Uint8* RenderThread::acquire_frame()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (Slot& slot : slots_)
+        if (slot.state == SLOT_READY)
+        {
+            slot.state = SLOT_SHOWING;
+            return slot.pixels;
+        }
+
+    return NULL;
+}
+
+void RenderThread::release_frame()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (Slot& slot : slots_)
+        if (slot.state == SLOT_SHOWING)
+            slot.state = SLOT_FREE;
+}
+
+// The working buffer stays with the render thread, as the next frame
+// starts from it, and is copied into a free slot
+void RenderThread::publish()
+{
+    Slot* target = NULL;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // At most one slot is ready and one showing
+        for (Slot& slot : slots_)
+            if (slot.state == SLOT_FREE)
+            {
+                target = &slot;
+                break;
+            }
+        assert(target);
+
+        target->state = SLOT_WRITING;
+    }
+
+    std::copy(work_, work_ + size_, target->pixels);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Dropped, the UI never took it
+    for (Slot& slot : slots_)
+        if (slot.state == SLOT_READY)
+            slot.state = SLOT_FREE;
+
+    target->state = SLOT_READY;
+}
+
+void RenderThread::render_loop()
+{
+    unsigned seen = 0;
+    Clock::time_point again = Clock::time_point::max();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        auto wake = [&] { return stopping_ || generation_ != seen; };
+        if (again == Clock::time_point::max())
+            wakeCond_.wait(lock, wake);
+        else
+            wakeCond_.wait_until(lock, again, wake);
+
+        if (stopping_)
+            return;
+
+        seen = generation_;
+        const RenderView view = view_;
+        lock.unlock();
+
+        again = Clock::time_point::max();
+        if (func_(work_, view, &again))
+            publish();
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,218 @@
+#include "mandelbrot_scheduler.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_ms(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+static int count_workers(const std::vector<SchedulerNode>& nodes)
+{
+    int nWorkers = 0;
+    for (const SchedulerNode& node : nodes)
+        nWorkers += node.nWorkers;
+
+    return nWorkers;
+}
+
+// Left unpinned if the CPUs can't be set, which is only slower
+static void pin_thread(const std::vector<int>& cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+TileScheduler::TileScheduler(int nThreads)
+    : TileScheduler(std::vector<SchedulerNode>{ { nThreads, {} } })
+{
+}
+
+TileScheduler::TileScheduler(const std::vector<SchedulerNode>& nodes)
+    : queues_(count_workers(nodes)),
+      stats_(count_workers(nodes)),
+      func_(nullptr),
+      generation_(0),
+      stopping_(false),
+      activeWorkers_(0),
+      frameMs_(0.0)
+{
+    nodeFirstWorker_.push_back(0);
+    for (size_t node = 0; node < nodes.size(); node++)
+    {
+        workerNode_.insert(workerNode_.end(), nodes[node].nWorkers, (int)node);
+        nodeFirstWorker_.push_back((int)workerNode_.size());
+        nodeCpus_.push_back(nodes[node].cpus);
+    }
+
+    for (int i = 0; i < (int)workerNode_.size(); i++)
+        workers_.emplace_back(&TileScheduler::worker_loop, this, i);
+}
+
+TileScheduler::~TileScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    startCond_.notify_all();
+
+    for (std::thread& worker : workers_)
+        worker.join();
+}
+
+void TileScheduler::run(const std::vector<Tile>& tiles, const TileFunc& func)
+{
+    if (tiles.empty())
+        return;
+
+    const int n = nThreads();
+    auto start = Clock::now();
+
+    // Contiguous blocks per worker: the owner walks its block from the
+    // back, thieves take from the front
+    for (int i = 0; i < n; i++)
+    {
+        const size_t from = tiles.size() *  i      / n;
+        const size_t to   = tiles.size() * (i + 1) / n;
+
+        std::lock_guard<std::mutex> lock(queues_[i].mutex);
+        queues_[i].tiles.assign(tiles.begin() + from, tiles.begin() + to);
+
+        stats_[i] = {};
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        func_ = &func;
+        activeWorkers_ = n;
+        generation_++;
+    }
+    startCond_.notify_all();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // Not just until the last tile: a worker still looking for
+        // work must not see the next frame's queues with this func
+        doneCond_.wait(lock, [this] { return activeWorkers_ == 0; });
+        func_ = nullptr;
+    }
+
+    frameMs_ = elapsed_ms(start, Clock::now());
+    for (WorkerStats& stats : stats_)
+        stats.idleMs = frameMs_ - stats.busyMs;
+}
+
+size_t TileScheduler::nodeFirstTile(int node, size_t nTiles) const
+{
+    return nTiles * nodeFirstWorker_[node] / nThreads();
+}
+
+bool TileScheduler::steal_tile(int victim, Tile* tile)
+{
+    WorkerQueue& queue = queues_[victim];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tiles.empty())
+        return false;
+
+    *tile = queue.tiles.front();
+    queue.tiles.pop_front();
+    return true;
+}
+
+bool TileScheduler::pop_tile(int id, Tile* tile, bool* stolen, bool* remote)
+{
+    *stolen = false;
+    *remote = false;
+
+    {
+        WorkerQueue& own = queues_[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tiles.empty())
+        {
+            *tile = own.tiles.back();
+            own.tiles.pop_back();
+            return true;
+        }
+    }
+
+    // The tiles of its own node stay in that node's memory
+    const int node   = workerNode_[id];
+    const int first  = nodeFirstWorker_[node];
+    const int nLocal = nodeFirstWorker_[node + 1] - first;
+    for (int i = 1; i < nLocal; i++)
+        if (steal_tile(first + (id - first + i) % nLocal, tile))
+        {
+            *stolen = true;
+            return true;
+        }
+
+    const int n = nThreads();
+    for (int i = 1; i < n; i++)
+    {
+        const int victim = (id + i) % n;
+        if (workerNode_[victim] != node && steal_tile(victim, tile))
+        {
+            *stolen = true;
+            *remote = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TileScheduler::worker_loop(int id)
+{
+    const std::vector<int>& cpus = nodeCpus_[workerNode_[id]];
+    if (!cpus.empty())
+        pin_thread(cpus);
+
+    unsigned seenGeneration = 0;
+
+    while (true)
+    {
+        const TileFunc* func = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            startCond_.wait(lock, [&] { return stopping_ || generation_ != seenGeneration; });
+
+            if (stopping_)
+                return;
+
+            seenGeneration = generation_;
+            func = func_;
+        }
+
+        // Tiles are only added before the start, so empty queues
+        // everywhere mean there is nothing left for this frame
+        WorkerStats& stats = stats_[id];
+        Tile tile = {};
+        bool stolen = false;
+        bool remote = false;
+        while (pop_tile(id, &tile, &stolen, &remote))
+        {
+            auto start = Clock::now();
+            (*func)(tile);
+            stats.busyMs += elapsed_ms(start, Clock::now());
+
+            stats.nTiles++;
+            stats.nStolen += stolen;
+            stats.nRemote += remote;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--activeWorkers_ == 0)
+            doneCond_.notify_one();
+    }
+}
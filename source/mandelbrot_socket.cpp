@@ -0,0 +1,192 @@
+#include "mandelbrot_socket.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static bool is_unix(const char* address)
+{
+    return strncmp(address, "unix:", 5) == 0;
+}
+
+static bool unix_address(const char* path, sockaddr_un* address)
+{
+    *address = {};
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path))
+    {
+        fprintf(stderr, "Socket path %s is too long\n", path);
+        return false;
+    }
+    strcpy(address->sun_path, path);
+
+    return true;
+}
+
+static int listen_unix(const char* path)
+{
+    sockaddr_un address;
+    if (!unix_address(path, &address))
+        return -1;
+
+    // A socket left by an earlier server, anything else is not ours to remove
+    struct stat status;
+    if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode))
+        unlink(path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (const sockaddr*)&address, sizeof(address)) != 0)
+    {
+        fprintf(stderr, "Can't listen on %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Binds, or connects, to the first address of host:port that takes it
+static int open_tcp(const char* hostAndPort, bool server)
+{
+    // Local only unless a host is given, ":port" is every interface
+    std::string host = "127.0.0.1", port = hostAndPort;
+    const char* colon = strrchr(hostAndPort, ':');
+    if (colon)
+    {
+        host = std::string(hostAndPort, colon);
+        port = colon + 1;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = server ? AI_PASSIVE : 0;
+
+    addrinfo* addresses = NULL;
+    const int error = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &addresses);
+    if (error != 0)
+    {
+        fprintf(stderr, "Can't resolve %s: %s\n", hostAndPort, gai_strerror(error));
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo* address = addresses; address && fd < 0; address = address->ai_next)
+    {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0)
+            continue;
+
+        const int reuse = 1;
+        if (server)
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        const int status = server ? bind   (fd, address->ai_addr, address->ai_addrlen)
+                                  : connect(fd, address->ai_addr, address->ai_addrlen);
+        if (status != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (fd < 0)
+        fprintf(stderr, "Can't %s %s: %s\n", server ? "listen on" : "connect to",
+                hostAndPort, strerror(errno));
+
+    return fd;
+}
+
+int mandelbrot_socket_listen(const char* address)
+{
+    const int fd = is_unix(address) ? listen_unix(address + 5) : open_tcp(address, true);
+    if (fd < 0)
+        return -1;
+
+    if (listen(fd, SOMAXCONN) != 0 ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0)
+    {
+        fprintf(stderr, "Can't listen on %s: %s\n", address, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+void mandelbrot_socket_close_listen(int fd, const char* address)
+{
+    close(fd);
+    if (is_unix(address))
+        unlink(address + 5);
+}
+
+int mandelbrot_socket_connect(const char* address)
+{
+    if (!is_unix(address))
+        return open_tcp(address, false);
+
+    sockaddr_un unixAddress;
+    if (!unix_address(address + 5, &unixAddress))
+        return -1;
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (const sockaddr*)&unixAddress, sizeof(unixAddress)) != 0)
+    {
+        fprintf(stderr, "Can't connect to %s: %s\n", address, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+void mandelbrot_socket_timeout(int fd, int ms)
+{
+    const timeval timeout = { ms / 1000, (ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+bool mandelbrot_socket_send(int fd, const void* data, size_t size)
+{
+    const char* bytes = (const char*)data;
+    while (size > 0)
+    {
+        const ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent <= 0)
+            return false;
+
+        bytes += sent;
+        size  -= sent;
+    }
+
+    return true;
+}
+
+bool mandelbrot_socket_recv(int fd, void* data, size_t size)
+{
+    char* bytes = (char*)data;
+    while (size > 0)
+    {
+        const ssize_t received = recv(fd, bytes, size, 0);
+        if (received <= 0)
+            return false;
+
+        bytes += received;
+        size  -= received;
+    }
+
+    return true;
+}
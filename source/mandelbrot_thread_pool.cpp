@@ -1,64 +1,128 @@
 #include "mandelbrot_thread_pool.h"
-#include "mandelbrot_arrayed.h"
+#include "mandelbrot_fractal.h"
 #include "mandelbrot_config.h"
+#include "mandelbrot_profile.h"
 
-extern "C" {
-#include "thread_pool.h"
-}
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+// Tile sizes from coarse to fine, widths are multiples of 8
+static const int TILE_SIZES[][2] =
+{
+    { 480, 270 },
+    { 240, 136 },
+    { 128,  64 },
+    {  64,  32 },
+    {  32,  16 },
+    {  16,   8 },
+};
 
+const int N_TILE_SIZES = sizeof(TILE_SIZES) / sizeof(TILE_SIZES[0]);
 
-TH_Pool pool;
+// Finer tiles when workers finish further apart than this part of the frame
+const double MAX_IMBALANCE = 0.05;
+// Coarser tiles when an average tile is cheaper than this
+const double MIN_TILE_MS = 0.05;
 
-struct MandelbrotArgs
+static int  tileSizeIndex = 2;
+static bool tileSizeFixed = false;
+
+// Destroyed at exit, which joins the workers
+static std::unique_ptr<TileScheduler> pool;
+
+TileScheduler& mandelbrot_thread_pool_scheduler(const RenderParams& params)
 {
-    sf::Uint8* pixels;
-    float magnifier;
-    float shiftX;
-    int leftBound;
-    int rightBound;
-};
+    if (!pool || pool->nThreads() != params.nThreads)
+        pool.reset(new TileScheduler(params.nThreads));
 
-void mandelbrot_pool_internal(void* mandelStruct)
+    return *pool;
+}
+
+void mandelbrot_thread_pool_tile_height(int height)
 {
-    MandelbrotArgs* args = (MandelbrotArgs*) mandelStruct;
+    tileSizeFixed = height > 0;
+    if (!tileSizeFixed)
+        return;
 
-    mandelbrot_arrayed_ranged(args->pixels, args->magnifier, 
-                              args->shiftX, args->leftBound, args->rightBound);
+    for (int i = 0; i < N_TILE_SIZES; i++)
+        if (std::abs(TILE_SIZES[i][1] - height) < std::abs(TILE_SIZES[tileSizeIndex][1] - height))
+            tileSizeIndex = i;
 }
 
-void mandelbrot_thread_pool(sf::Uint8* pixels, float magnifier, float shiftX)
+static void build_tiles(const RenderParams& params, std::vector<Tile>* tiles)
 {
-    // FIXME: causes a memleak
-    static bool isPoolInitialized = false;
-    if (!isPoolInitialized)
+    const int tileWidth  = TILE_SIZES[tileSizeIndex][0];
+    const int tileHeight = TILE_SIZES[tileSizeIndex][1];
+
+    tiles->clear();
+    for (int y = 0; y < params.height; y += tileHeight)
+        for (int x = 0; x < params.width; x += tileWidth)
+            tiles->push_back({ x, std::min(x + tileWidth,  params.width),
+                               y, std::min(y + tileHeight, params.height) });
+}
+
+static void adapt_tile_size(const TileScheduler& scheduler)
+{
+    double minBusy = scheduler.frameMs();
+    double maxBusy = 0;
+    double totalBusy = 0;
+    int    nTiles = 0;
+
+    for (const WorkerStats& stats : scheduler.stats())
     {
-        TH_PoolInit(&pool, N_THREADS);
-        isPoolInitialized = true;
+        minBusy = std::min(minBusy, stats.busyMs);
+        maxBusy = std::max(maxBusy, stats.busyMs);
+        totalBusy += stats.busyMs;
+        nTiles    += stats.nTiles;
     }
 
-    const int STEP = 8;
+    if (tileSizeFixed || scheduler.frameMs() <= 0 || nTiles == 0)
+        return;
+
+    const double imbalance = (maxBusy - minBusy) / scheduler.frameMs();
 
-    MandelbrotArgs args[WINDOW_HEIGHT / 8] = {};
-    for (int i = 0; i < WINDOW_HEIGHT; i += STEP)
+    if (imbalance > MAX_IMBALANCE && tileSizeIndex + 1 < N_TILE_SIZES)
+        tileSizeIndex++;
+    else if (totalBusy / nTiles < MIN_TILE_MS && tileSizeIndex > 0)
+        tileSizeIndex--;
+}
+
+void mandelbrot_thread_pool(sf::Uint8* pixels, const RenderParams& params,
+                            float magnifier, float shiftX)
+{
+    TileScheduler& scheduler = mandelbrot_thread_pool_scheduler(params);
+
+    std::vector<Tile> tiles;
+    build_tiles(params, &tiles);
+
+    const MandelbrotTileFunc tileFunc = mandelbrot_fractal_tile_func(params, magnifier, shiftX);
+
+    scheduler.run(tiles, [=, &params](const Tile& tile)
     {
-        args[i / STEP] = 
-        {
-            .pixels = pixels,
-            .magnifier = magnifier,
-            .shiftX = shiftX,
-            .leftBound = i,
-            .rightBound = i + STEP,
-        };
-
-        TH_Job job = 
-        {
-            .func = (void (*)(void*)) mandelbrot_pool_internal,
-            .args = &args[i / STEP],
-        };
-        TH_PoolAddJob(&pool, job);
-    }
+        const ProfileSpan span = profile_span_begin();
+        tileFunc(pixels, params, magnifier, shiftX, tile.x_from, tile.x_to, tile.y_from, tile.y_to);
+        profile_span_end(span, "tile", params, tile.x_from, tile.x_to, tile.y_from, tile.y_to);
+    });
 
-    TH_PoolWait(&pool);
-    
-    return;
+    adapt_tile_size(scheduler);
+}
+
+void mandelbrot_thread_pool_print_stats(FILE* file)
+{
+    if (!pool)
+        return;
+
+    const TileScheduler& scheduler = *pool;
+
+    fprintf(file, "thread-pool: %d threads, %dx%d tiles%s, last frame %.3f ms\n",
+            scheduler.nThreads(), TILE_SIZES[tileSizeIndex][0], TILE_SIZES[tileSizeIndex][1],
+            tileSizeFixed ? " (fixed)" : "", scheduler.frameMs());
+
+    for (int i = 0; i < scheduler.nThreads(); i++)
+    {
+        const WorkerStats& stats = scheduler.stats()[i];
+        fprintf(file, "  thread %2d: busy %8.3f ms  idle %8.3f ms  %4d tiles  %4d stolen\n",
+                i, stats.busyMs, stats.idleMs, stats.nTiles, stats.nStolen);
+    }
 }
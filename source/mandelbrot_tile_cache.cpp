@@ -0,0 +1,159 @@
+#include "mandelbrot_tile_cache.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+uint64_t mandelbrot_tile_hash(const std::string& text)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+// Memory
+//------------------------------------------------------------------------------
+
+TileMemoryCache::TileMemoryCache(size_t capacityBytes, int nShards)
+    : shardCapacity_(capacityBytes / std::max(nShards, 1))
+{
+    for (int i = 0; i < std::max(nShards, 1); i++)
+    {
+        shards_.emplace_back(new Shard);
+        shards_.back()->bytes = 0;
+    }
+}
+
+TileMemoryCache::Shard& TileMemoryCache::shard(uint64_t key)
+{
+    // The low bits of FNV-1a are as good as the high ones
+    return *shards_[key % shards_.size()];
+}
+
+TileData TileMemoryCache::get(uint64_t key)
+{
+    Shard& shard = this->shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.index.find(key);
+    if (found == shard.index.end())
+        return NULL;
+
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    return found->second->second;
+}
+
+void TileMemoryCache::put(uint64_t key, const TileData& data)
+{
+    if (!data || data->size() > shardCapacity_)
+        return;
+
+    Shard& shard = this->shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // Renders of the same tile are coalesced, but a disk hit can race one
+    if (shard.index.count(key))
+        return;
+
+    shard.entries.emplace_front(key, data);
+    shard.index[key] = shard.entries.begin();
+    shard.bytes += data->size();
+
+    while (shard.bytes > shardCapacity_)
+    {
+        shard.bytes -= shard.entries.back().second->size();
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+    }
+}
+
+size_t TileMemoryCache::bytes()
+{
+    size_t total = 0;
+    for (const std::unique_ptr<Shard>& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        total += shard->bytes;
+    }
+
+    return total;
+}
+
+//------------------------------------------------------------------------------
+// Disk
+//------------------------------------------------------------------------------
+
+TileDiskCache::TileDiskCache(const std::string& dir)
+    : dir_(dir)
+{
+}
+
+std::string TileDiskCache::path(uint64_t key) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/%02x/%016llx.png", (unsigned)(key >> 56), (unsigned long long)key);
+
+    return dir_ + name;
+}
+
+TileData TileDiskCache::get(uint64_t key) const
+{
+    FILE* file = fopen(path(key).c_str(), "rb");
+    if (!file)
+        return NULL;
+
+    std::vector<uint8_t>* data = new std::vector<uint8_t>;
+    TileData tile(data);
+
+    uint8_t buffer[65536];
+    size_t  size = 0;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data->insert(data->end(), buffer, buffer + size);
+
+    const bool ok = !ferror(file) && !data->empty();
+    fclose(file);
+
+    return ok ? tile : NULL;
+}
+
+bool TileDiskCache::put(uint64_t key, const TileData& data) const
+{
+    const std::string target = path(key);
+    const std::string subdir = target.substr(0, target.rfind('/'));
+
+    if ((mkdir(dir_.c_str(),   0755) != 0 && errno != EEXIST) ||
+        (mkdir(subdir.c_str(), 0755) != 0 && errno != EEXIST))
+        return false;
+
+    // Unique per writer, the last rename wins with the same bytes
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%d.%zx.tmp", (int)getpid(),
+             std::hash<std::thread::id>()(std::this_thread::get_id()));
+    const std::string temporary = target + suffix;
+
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file)
+        return false;
+
+    const bool written = fwrite(data->data(), 1, data->size(), file) == data->size();
+    const bool closed  = fclose(file) == 0;
+
+    if (!written || !closed || rename(temporary.c_str(), target.c_str()) != 0)
+    {
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
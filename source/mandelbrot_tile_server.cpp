@@ -0,0 +1,698 @@
+#include "mandelbrot_tile_server.h"
+#include "mandelbrot_bands.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_frame_buffer.h"
+#include "mandelbrot_image_file.h"
+#include "mandelbrot_socket.h"
+#include "mandelbrot_tile_cache.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Enough shards for the handlers to rarely meet on one
+const int TILE_CACHE_SHARDS = 64;
+
+// Requests whose headers don't end within this are refused
+const int MAX_REQUEST_BYTES = 8192;
+
+// How often idle handlers look for a signal
+const int POLL_MS = 200;
+
+// Clients that stall longer than this are dropped
+const int SOCKET_TIMEOUT_MS = 10000;
+
+// Part of every key, bump it when the pixels of a tile change
+static const char TILE_KEY_VERSION[] = "mandelbrot-tile 2";
+
+typedef std::chrono::steady_clock Clock;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void request_stop(int)
+{
+    stopRequested = 1;
+}
+
+struct TileId
+{
+    int     z;
+    int64_t x;
+    int64_t y;
+};
+
+// Where a tile request was served from
+enum TileLayer
+{
+    LAYER_MEMORY,
+    LAYER_DISK,
+    LAYER_RENDER,     // rendered for this request
+    LAYER_COALESCED,  // waited for a render another request started
+    N_LAYERS,
+};
+
+static const char* const LAYER_NAMES[N_LAYERS] = { "memory", "disk", "render", "coalesced" };
+
+// A miss on its way through the render thread
+struct PendingTile
+{
+    TileId   tile;
+    uint64_t key;
+    TileData data;  // NULL if it could not be encoded
+    bool     done;
+};
+
+typedef std::shared_ptr<PendingTile> PendingPtr;
+
+// The most recent latencies of one layer
+struct LatencyRing
+{
+    std::vector<double> samples;
+    size_t              next;
+};
+
+static double percentile(std::vector<double> samples, double fraction)
+{
+    if (samples.empty())
+        return 0.0;
+
+    // Nearest rank
+    const size_t rank = (size_t)std::ceil(fraction * samples.size());
+    const size_t index = std::min(std::max(rank, (size_t)1), samples.size()) - 1;
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+
+    return samples[index];
+}
+
+class TileServer
+{
+public:
+    TileServer(const TileServerConfig& config, const RenderParams& params)
+        : config_(config),
+          params_(params),
+          memory_((size_t)config.cacheMb << 20, TILE_CACHE_SHARDS),
+          stop_(false),
+          nRequests_(0),
+          nErrors_(0),
+          nBlocks_(0),
+          nTilesRendered_(0),
+          renderMs_(0.0)
+    {
+        if (config.cacheDir)
+            disk_.reset(new TileDiskCache(config.cacheDir));
+
+        for (int layer = 0; layer < N_LAYERS; layer++)
+        {
+            nServed_[layer]        = 0;
+            latencies_[layer].next = 0;
+        }
+
+        renderer_ = std::thread(&TileServer::render_loop, this);
+    }
+
+    ~TileServer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        queueChanged_.notify_one();
+        renderer_.join();
+    }
+
+    TileServer(const TileServer&) = delete;
+    TileServer& operator=(const TileServer&) = delete;
+
+    TileData tile(const TileId& id, TileLayer* layer)
+    {
+        const uint64_t key = tile_key(id);
+
+        if (TileData data = memory_.get(key))
+        {
+            *layer = LAYER_MEMORY;
+            return data;
+        }
+
+        if (disk_)
+        {
+            if (TileData data = disk_->get(key))
+            {
+                memory_.put(key, data);
+                *layer = LAYER_DISK;
+                return data;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        PendingPtr& pending = inFlight_[key];
+        if (pending)
+            *layer = LAYER_COALESCED;
+        else
+        {
+            // Rendered and cached since the lookup above
+            if (TileData data = memory_.get(key))
+            {
+                inFlight_.erase(key);
+                *layer = LAYER_MEMORY;
+                return data;
+            }
+
+            pending.reset(new PendingTile{ id, key, NULL, false });
+            queue_.push_back(pending);
+            queueChanged_.notify_one();
+            *layer = LAYER_RENDER;
+        }
+
+        const PendingPtr mine = pending;
+        tileDone_.wait(lock, [&] { return mine->done; });
+
+        return mine->data;
+    }
+
+    void record(TileLayer layer, double ms)
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+
+        nRequests_++;
+        nServed_[layer]++;
+
+        LatencyRing& ring = latencies_[layer];
+        if (ring.samples.size() < (size_t)TILE_LATENCY_SAMPLES)
+            ring.samples.push_back(ms);
+        else
+            ring.samples[ring.next] = ms;
+        ring.next = (ring.next + 1) % TILE_LATENCY_SAMPLES;
+    }
+
+    void record_error()
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        nErrors_++;
+    }
+
+    std::string stats_json();
+    void        print_stats(FILE* file);
+
+private:
+    uint64_t tile_key(const TileId& id) const
+    {
+        char text[512];
+        snprintf(text, sizeof(text),
+                 "%s\nmode %s\niterations %d\nradius %.9g\nsize %d\nz %d\nx %lld\ny %lld\n",
+                 TILE_KEY_VERSION, config_.modeName, params_.maxIterations, params_.maxRadius,
+                 TILE_SIZE, id.z, (long long)id.x, (long long)id.y);
+
+        return mandelbrot_tile_hash(text);
+    }
+
+    void render_loop();
+    void render_block(const std::vector<PendingPtr>& tiles);
+
+    // Samples of the layers, all of them for layer N_LAYERS
+    std::vector<double> samples(int layer);
+
+    const TileServerConfig         config_;
+    const RenderParams             params_;
+    TileMemoryCache                memory_;
+    std::unique_ptr<TileDiskCache> disk_;
+
+    std::mutex                               mutex_;
+    std::condition_variable                  queueChanged_;
+    std::condition_variable                  tileDone_;
+    std::vector<PendingPtr>                  queue_;
+    std::unordered_map<uint64_t, PendingPtr> inFlight_;
+    bool                                     stop_;
+    std::thread                              renderer_;
+
+    std::mutex  statsMutex_;
+    int64_t     nRequests_;
+    int64_t     nErrors_;
+    int64_t     nServed_[N_LAYERS];
+    LatencyRing latencies_[N_LAYERS];
+    int64_t     nBlocks_;
+    int64_t     nTilesRendered_;
+    double      renderMs_;
+};
+
+// Splits the misses of one zoom until every part fills at least half
+// of its bounding box and fits TILE_BATCH_MAX. The bounding box has a
+// tile on each edge, so neither half of a split is ever empty.
+static void split_blocks(const std::vector<PendingPtr>& tiles,
+                         std::vector<std::vector<PendingPtr>>* blocks)
+{
+    int64_t x_from = tiles[0]->tile.x, x_to = x_from + 1;
+    int64_t y_from = tiles[0]->tile.y, y_to = y_from + 1;
+    for (const PendingPtr& pending : tiles)
+    {
+        x_from = std::min(x_from, pending->tile.x);
+        x_to   = std::max(x_to,   pending->tile.x + 1);
+        y_from = std::min(y_from, pending->tile.y);
+        y_to   = std::max(y_to,   pending->tile.y + 1);
+    }
+
+    const int64_t width  = x_to - x_from;
+    const int64_t height = y_to - y_from;
+    if (width <= TILE_BATCH_MAX && height <= TILE_BATCH_MAX &&
+        width * height <= 2 * (int64_t)tiles.size())
+    {
+        blocks->push_back(tiles);
+        return;
+    }
+
+    const bool    alongX = width >= height;
+    const int64_t middle = alongX ? x_from + width / 2 : y_from + height / 2;
+
+    std::vector<PendingPtr> before, after;
+    for (const PendingPtr& pending : tiles)
+        ((alongX ? pending->tile.x : pending->tile.y) < middle ? before : after).push_back(pending);
+
+    split_blocks(before, blocks);
+    split_blocks(after,  blocks);
+}
+
+void TileServer::render_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (;;)
+    {
+        queueChanged_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty())
+            return;
+
+        // A viewer asks for the neighbours of a tile within moments
+        lock.unlock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(TILE_BATCH_WAIT_MS));
+        lock.lock();
+
+        std::vector<PendingPtr> batch;
+        batch.swap(queue_);
+        lock.unlock();
+
+        // Blocks never cross the TILE_BATCH_MAX aligned squares, each
+        // square is the view its tiles are windows of
+        std::map<std::tuple<int, int64_t, int64_t>, std::vector<PendingPtr>> squares;
+        for (const PendingPtr& pending : batch)
+            squares[std::make_tuple(pending->tile.z, pending->tile.x / TILE_BATCH_MAX,
+                                    pending->tile.y / TILE_BATCH_MAX)].push_back(pending);
+
+        std::vector<std::vector<PendingPtr>> blocks;
+        for (const auto& square : squares)
+            split_blocks(square.second, &blocks);
+
+        for (const std::vector<PendingPtr>& block : blocks)
+        {
+            render_block(block);
+
+            lock.lock();
+            for (const PendingPtr& pending : block)
+            {
+                pending->done = true;
+                inFlight_.erase(pending->key);
+            }
+            lock.unlock();
+            tileDone_.notify_all();
+        }
+
+        lock.lock();
+    }
+}
+
+// Renders the bounding box of tiles as a window of their square and
+// caches every tile of it, the ones nobody asked for yet too
+void TileServer::render_block(const std::vector<PendingPtr>& tiles)
+{
+    const Clock::time_point start = Clock::now();
+
+    const int z = tiles[0]->tile.z;
+    int64_t x_from = tiles[0]->tile.x, x_to = x_from + 1;
+    int64_t y_from = tiles[0]->tile.y, y_to = y_from + 1;
+    for (const PendingPtr& pending : tiles)
+    {
+        x_from = std::min(x_from, pending->tile.x);
+        x_to   = std::max(x_to,   pending->tile.x + 1);
+        y_from = std::min(y_from, pending->tile.y);
+        y_to   = std::max(y_to,   pending->tile.y + 1);
+    }
+
+    const int nx = (int)(x_to - x_from);
+    const int ny = (int)(y_to - y_from);
+
+    // The view is the whole square, clipped to the tiles of the zoom, so
+    // a tile gets the same pixels whichever of its neighbours were
+    // missing with it: the same pixel coordinates, the same precision
+    // pick of deep and the same perturbation reference
+    const int64_t squareX = x_from - x_from % TILE_BATCH_MAX;
+    const int64_t squareY = y_from - y_from % TILE_BATCH_MAX;
+    const int     nSquare = (int)std::min((int64_t)TILE_BATCH_MAX, (int64_t)1 << z);
+
+    RenderParams viewParams = params_;
+    viewParams.width  = nSquare * TILE_SIZE;
+    viewParams.height = nSquare * TILE_SIZE;
+
+    const RenderParams blockParams = window_params(viewParams,
+                                                   (int)(x_from - squareX) * TILE_SIZE,
+                                                   (int)(y_from - squareY) * TILE_SIZE,
+                                                   nx * TILE_SIZE, ny * TILE_SIZE);
+
+    // Corners and centers are multiples of side / 2 below 4 in
+    // magnitude: exact in double for every zoom up to TILE_MAX_ZOOM.
+    // The pixel step is not, it goes through the magnifier and comes
+    // back within a few ulps.
+    const double side    = std::ldexp(3.0, -z);
+    const double step    = side / TILE_SIZE;
+    const double centerX = -2.25 + squareX * side + side * nSquare / 2;
+    const double centerY = -1.5  + squareY * side + side * nSquare / 2;
+    const double scale   = 2.0 / (step * viewParams.height) - MAGNIFIER_OFFSET;
+
+    sf::Uint8* pixels = (sf::Uint8*)mandelbrot_frame_buffer_alloc(blockParams.width * 4,
+                                                                  blockParams.height,
+                                                                  params_.nThreads);
+
+    mandelbrot_bands(config_.func, pixels, blockParams, scale,
+                     bf_from_double(centerX - SHIFT_X_OFFSET), bf_from_double(centerY));
+
+    std::unordered_map<uint64_t, PendingPtr> wanted;
+    for (const PendingPtr& pending : tiles)
+        wanted[pending->key] = pending;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(params_.nThreads)
+    for (int i = 0; i < nx * ny; i++)
+    {
+        const TileId   id  = { z, x_from + i % nx, y_from + i / nx };
+        const uint64_t key = tile_key(id);
+
+        std::vector<sf::Uint8> tilePixels((size_t)TILE_SIZE * TILE_SIZE * 4);
+        for (int y = 0; y < TILE_SIZE; y++)
+            memcpy(tilePixels.data() + (size_t)y * TILE_SIZE * 4,
+                   pixels + ((size_t)((i / nx) * TILE_SIZE + y) * blockParams.width +
+                             (size_t)(i % nx) * TILE_SIZE) * 4,
+                   TILE_SIZE * 4);
+
+        std::vector<uint8_t>* png = new std::vector<uint8_t>;
+        TileData data(png);
+        if (!mandelbrot_image_encode(IMAGE_PNG, tilePixels.data(), TILE_SIZE, TILE_SIZE, png))
+            data = NULL;
+
+        if (data)
+        {
+            memory_.put(key, data);
+            if (disk_ && !disk_->put(key, data))
+                fprintf(stderr, "Can't write tile %d/%lld/%lld to %s\n",
+                        id.z, (long long)id.x, (long long)id.y, config_.cacheDir);
+        }
+
+        auto found = wanted.find(key);
+        if (found != wanted.end())
+            found->second->data = data;
+    }
+
+    mandelbrot_frame_buffer_free(pixels);
+
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    nBlocks_++;
+    nTilesRendered_ += nx * ny;
+    renderMs_       += ms;
+}
+
+std::vector<double> TileServer::samples(int layer)
+{
+    if (layer < N_LAYERS)
+        return latencies_[layer].samples;
+
+    std::vector<double> all;
+    for (const LatencyRing& ring : latencies_)
+        all.insert(all.end(), ring.samples.begin(), ring.samples.end());
+
+    return all;
+}
+
+std::string TileServer::stats_json()
+{
+    const size_t cacheBytes = memory_.bytes();
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+
+    const int64_t nMemory = nServed_[LAYER_MEMORY];
+    const int64_t nDisk   = nServed_[LAYER_DISK];
+    const double  total   = std::max<int64_t>(nRequests_, 1);
+
+    char text[4096];
+    int  length = snprintf(text, sizeof(text),
+                           "{\"requests\": %lld, \"errors\": %lld, "
+                           "\"hit_rate\": {\"memory\": %.4f, \"disk\": %.4f, \"total\": %.4f}, "
+                           "\"served\": {",
+                           (long long)nRequests_, (long long)nErrors_,
+                           nMemory / total, nDisk / std::max<double>(nRequests_ - nMemory, 1),
+                           (nMemory + nDisk) / total);
+
+    for (int layer = 0; layer < N_LAYERS; layer++)
+        length += snprintf(text + length, sizeof(text) - length, "%s\"%s\": %lld",
+                           layer ? ", " : "", LAYER_NAMES[layer], (long long)nServed_[layer]);
+
+    length += snprintf(text + length, sizeof(text) - length,
+                       "}, \"blocks\": %lld, \"tiles_rendered\": %lld, \"render_ms\": %.3f, "
+                       "\"memory_cache_bytes\": %zu, \"latency_ms\": {",
+                       (long long)nBlocks_, (long long)nTilesRendered_, renderMs_, cacheBytes);
+
+    // All first
+    for (int i = 0; i <= N_LAYERS; i++)
+    {
+        const int layer = (i + N_LAYERS) % (N_LAYERS + 1);
+        const std::vector<double> layerSamples = samples(layer);
+        length += snprintf(text + length, sizeof(text) - length,
+                           "%s\"%s\": {\"samples\": %zu, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f}",
+                           i ? ", " : "", layer == N_LAYERS ? "all" : LAYER_NAMES[layer],
+                           layerSamples.size(),
+                           percentile(layerSamples, 0.50), percentile(layerSamples, 0.95),
+                           percentile(layerSamples, 0.99));
+    }
+
+    snprintf(text + length, sizeof(text) - length, "}}\n");
+    return text;
+}
+
+void TileServer::print_stats(FILE* file)
+{
+    const size_t cacheBytes = memory_.bytes();
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+
+    const double total = std::max<int64_t>(nRequests_, 1);
+    fprintf(file, "%lld tile requests, %lld errors, %lld blocks of %lld tiles rendered in %.1f ms, "
+                  "%.1f MiB in memory\n",
+            (long long)nRequests_, (long long)nErrors_, (long long)nBlocks_,
+            (long long)nTilesRendered_, renderMs_, cacheBytes / (1024.0 * 1024.0));
+
+    for (int i = 0; i <= N_LAYERS; i++)
+    {
+        const int layer = (i + N_LAYERS) % (N_LAYERS + 1);
+        const std::vector<double> layerSamples = samples(layer);
+        const int64_t nServed = layer == N_LAYERS ? nRequests_ : nServed_[layer];
+
+        fprintf(file, "  %-9s %8lld (%5.1f%%)  p50 %8.3f ms  p95 %8.3f ms  p99 %8.3f ms\n",
+                layer == N_LAYERS ? "all" : LAYER_NAMES[layer], (long long)nServed,
+                100.0 * nServed / total, percentile(layerSamples, 0.50),
+                percentile(layerSamples, 0.95), percentile(layerSamples, 0.99));
+    }
+}
+
+//------------------------------------------------------------------------------
+// HTTP
+//------------------------------------------------------------------------------
+
+static bool respond(int fd, const char* status, const char* contentType,
+                    const void* body, size_t size, const char* extraHeaders = "")
+{
+    char header[512];
+    const int length = snprintf(header, sizeof(header),
+                                "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                                "%sConnection: close\r\n\r\n",
+                                status, contentType, size, extraHeaders);
+
+    return mandelbrot_socket_send(fd, header, length) && mandelbrot_socket_send(fd, body, size);
+}
+
+static bool respond_error(int fd, const char* status)
+{
+    const std::string body = std::string(status) + "\n";
+    return respond(fd, status, "text/plain", body.data(), body.size());
+}
+
+// The whole header, so closing the socket doesn't reset it under the response
+static bool read_request(int fd, std::string* request)
+{
+    char buffer[1024];
+    while (request->find("\r\n\r\n") == std::string::npos)
+    {
+        if (request->size() > (size_t)MAX_REQUEST_BYTES)
+            return false;
+
+        const ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+        if (size <= 0)
+            return false;
+
+        request->append(buffer, size);
+    }
+
+    return true;
+}
+
+// "/z/x/y.png" inside the tile pyramid
+static bool parse_tile_path(const char* path, TileId* id)
+{
+    long long x = 0, y = 0;
+    int length = 0;
+    if (sscanf(path, "/%d/%lld/%lld.png%n", &id->z, &x, &y, &length) != 3 ||
+        path[length] != '\0')
+        return false;
+
+    if (id->z < 0 || id->z > TILE_MAX_ZOOM)
+        return false;
+
+    const long long nTiles = 1LL << id->z;
+    if (x < 0 || x >= nTiles || y < 0 || y >= nTiles)
+        return false;
+
+    id->x = x;
+    id->y = y;
+    return true;
+}
+
+static void serve_connection(TileServer& server, int fd)
+{
+    const Clock::time_point start = Clock::now();
+
+    std::string request;
+    if (!read_request(fd, &request))
+    {
+        respond_error(fd, "400 Bad Request");
+        server.record_error();
+        return;
+    }
+
+    char method[16] = "", target[256] = "";
+    sscanf(request.c_str(), "%15s %255s", method, target);
+
+    // Tile URLs are immutable, query strings only break caching proxies
+    char* query = strchr(target, '?');
+    if (query)
+        *query = '\0';
+
+    if (strcmp(method, "GET") != 0)
+    {
+        respond_error(fd, "405 Method Not Allowed");
+        server.record_error();
+        return;
+    }
+
+    if (strcmp(target, "/stats") == 0)
+    {
+        const std::string json = server.stats_json();
+        respond(fd, "200 OK", "application/json", json.data(), json.size(),
+                "Cache-Control: no-store\r\n");
+        return;
+    }
+
+    TileId id;
+    if (!parse_tile_path(target, &id))
+    {
+        respond_error(fd, "404 Not Found");
+        server.record_error();
+        return;
+    }
+
+    TileLayer layer = LAYER_MEMORY;
+    const TileData data = server.tile(id, &layer);
+    if (!data)
+    {
+        respond_error(fd, "500 Internal Server Error");
+        server.record_error();
+        return;
+    }
+
+    char headers[128];
+    snprintf(headers, sizeof(headers),
+             "Cache-Control: public, max-age=31536000, immutable\r\nX-Tile-Cache: %s\r\n",
+             LAYER_NAMES[layer]);
+
+    // Latency until the last byte is handed to the kernel
+    if (respond(fd, "200 OK", "image/png", data->data(), data->size(), headers))
+        server.record(layer, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+}
+
+static void handle_connections(TileServer& server, int listenFd)
+{
+    while (!stopRequested)
+    {
+        pollfd listening = { listenFd, POLLIN, 0 };
+        if (poll(&listening, 1, POLL_MS) <= 0)
+            continue;
+
+        // Another handler may have taken it, the socket doesn't block
+        const int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0)
+            continue;
+
+        mandelbrot_socket_timeout(fd, SOCKET_TIMEOUT_MS);
+
+        serve_connection(server, fd);
+        close(fd);
+    }
+}
+
+int mandelbrot_tile_server_run(const TileServerConfig& config, const RenderParams& params)
+{
+    const int listenFd = mandelbrot_socket_listen(config.address);
+    if (listenFd < 0)
+        return 1;
+
+    // Not restarted, so the handlers see the signal at their next poll
+    struct sigaction action = {};
+    action.sa_handler = request_stop;
+    sigaction(SIGINT,  &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    printf("Serving %s tiles on %s: /{z}/{x}/{y}.png up to zoom %d and /stats, "
+           "iterations %d, %d threads, %d MiB memory cache%s%s\n",
+           config.modeName, config.address, TILE_MAX_ZOOM, params.maxIterations, params.nThreads,
+           config.cacheMb, config.cacheDir ? ", disk cache in " : "",
+           config.cacheDir ? config.cacheDir : "");
+    fflush(stdout);
+
+    {
+        TileServer server(config, params);
+
+        std::vector<std::thread> handlers;
+        for (int i = 0; i < TILE_SERVER_HANDLERS; i++)
+            handlers.emplace_back(handle_connections, std::ref(server), listenFd);
+
+        for (std::thread& handler : handlers)
+            handler.join();
+
+        server.print_stats(stdout);
+    }
+
+    mandelbrot_socket_close_listen(listenFd, config.address);
+
+    return 0;
+}
@@ -1,105 +1,296 @@
 #include "mandelbrot_vectorized.h"
+#include "mandelbrot_vectorized_isa.h"
 #include "mandelbrot_config.h"
+#include "mandelbrot_interior.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_profile.h"
 
 #include <x86intrin.h>
 
-void mandelbrot_vectorized(sf::Uint8* pixels, float magnifier, float shiftX)
+// is_in_cardioid_or_bulb for eight points
+static inline __m256 cardioid_or_bulb_mask(__m256 _c_x, __m256 _c_y)
 {
-    mandelbrot_vectorized_ranged(pixels, magnifier, shiftX, 0, WINDOW_HEIGHT);
+    __m256 _x  = _mm256_sub_ps(_c_x, _mm256_set1_ps(0.25f));
+    __m256 _y2 = _mm256_mul_ps(_c_y, _c_y);
+    __m256 _q  = _mm256_add_ps(_mm256_mul_ps(_x, _x), _y2);
+
+    __m256 _cardioid = _mm256_cmp_ps(_mm256_mul_ps(_q, _mm256_add_ps(_q, _x)),
+                                     _mm256_mul_ps(_mm256_set1_ps(0.25f), _y2), _CMP_LT_OQ);
+
+    __m256 _x1 = _mm256_add_ps(_c_x, _mm256_set1_ps(1.0f));
+    __m256 _bulb = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_x1, _x1), _y2),
+                                 _mm256_set1_ps(0.0625f), _CMP_LT_OQ);
+
+    return _mm256_or_ps(_cardioid, _bulb);
 }
 
-void mandelbrot_vectorized_ranged(sf::Uint8* pixels, float magnifier, float shiftX,
-                                  int y_from, int y_to)
+// Iteration counts of eight points. With MASKED, lanes set in _skip are
+// done from the start, so columns past the frame do not keep the loop going.
+template <bool MASKED>
+static inline __m256i iterate8(__m256 _c_x, __m256 _c_y, const RenderParams& params,
+                               __m256 _skip = _mm256_setzero_ps())
+{
+    const __m256 _maxRadius2 = _mm256_set1_ps(max_radius_2(params));
+    const int maxIterations  = params.maxIterations;
+
+    __m256 _z_x = _mm256_setzero_ps();
+    __m256 _z_y = _mm256_setzero_ps();
+
+    __m256 _z_x2 = _mm256_setzero_ps();
+    __m256 _z_y2 = _mm256_setzero_ps();
+    __m256 _z_xy = _mm256_setzero_ps();
+
+    __m256i _iterations = _mm256_setzero_si256();
+
+    // Lanes known to never escape, they stop counting and no longer
+    // keep the loop running
+    __m256 _interior = cardioid_or_bulb_mask(_c_x, _c_y);
+    if (MASKED)
+        _interior = _mm256_or_ps(_interior, _skip);
+
+    __m256 _check_x = _mm256_setzero_ps();
+    __m256 _check_y = _mm256_setzero_ps();
+    int checkLength    = PERIOD_CHECK_START;
+    int checkRemaining = PERIOD_CHECK_START;
+
+    for (int iteration = 0; iteration < maxIterations; iteration++)
+    {
+        __m256 _radius2 = _mm256_add_ps(_z_x2, _z_y2);
+
+        __m256 _cmpMask = _mm256_cmp_ps(_radius2, _maxRadius2, _CMP_LT_OQ);
+        _cmpMask = _mm256_andnot_ps(_interior, _cmpMask);
+        int mask = _mm256_movemask_ps(_cmpMask);
+        // for each float:
+        //      if (radius^2 < maxRadius^2 && !interior)
+        //          mask = -1
+        //      else
+        //          mask = 0
+
+        if (!mask)
+            break;
+
+        profile_count_lanes(_mm_popcnt_u32(mask), 8);
+
+        // x = x^2 - y^2 + cx
+        // y = 2xy + cy
+        _z_x = _mm256_add_ps(_c_x, _mm256_sub_ps(_z_x2, _z_y2));
+        _z_y = _mm256_add_ps(_c_y, _mm256_mul_ps(_mm256_set1_ps(2.0f), _z_xy));
+
+        // if (radius^2 < maxRadiud^2) iteration++
+        _iterations = _mm256_sub_epi32(_iterations, _mm256_castps_si256(_cmpMask));
+
+        _z_x2 = _mm256_mul_ps(_z_x, _z_x);
+        _z_y2 = _mm256_mul_ps(_z_y, _z_y);
+        _z_xy = _mm256_mul_ps(_z_x, _z_y);
+
+        // An active lane back at the saved z is periodic
+        __m256 _periodic = _mm256_and_ps(_mm256_cmp_ps(_z_x, _check_x, _CMP_EQ_OQ),
+                                         _mm256_cmp_ps(_z_y, _check_y, _CMP_EQ_OQ));
+        _interior = _mm256_or_ps(_interior, _mm256_and_ps(_periodic, _cmpMask));
+
+        if (--checkRemaining == 0)
+        {
+            _check_x = _z_x;
+            _check_y = _z_y;
+            checkLength   *= 2;
+            checkRemaining = checkLength;
+        }
+    }
+
+    _iterations = _mm256_castps_si256(
+                      _mm256_blendv_ps(_mm256_castsi256_ps(_iterations),
+                                       _mm256_castsi256_ps(_mm256_set1_epi32(maxIterations)),
+                                       _interior));
+
+    return _iterations;
+}
+
+// Eight counts (at most MAX_ITERATION_LIMIT) as uint16_t
+static inline void store_iterations8(uint16_t* iterations, __m256i _iterations)
+{
+    __m128i _packed = _mm_packus_epi32(_mm256_castsi256_si128(_iterations),
+                                       _mm256_extracti128_si256(_iterations, 1));
+    _mm_storeu_si128((__m128i*)iterations, _packed);
+}
+
+// Lanes of the last block of a row that are past the last column
+static inline __m256 tail_mask(int nValid)
+{
+    const __m256i _lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_lanes, _mm256_set1_epi32(nValid - 1)));
+}
+
+void mandelbrot_vectorized(sf::Uint8* pixels, const RenderParams& params,
+                           float magnifier, float shiftX)
+{
+    mandelbrot_vectorized_ranged(pixels, params, magnifier, shiftX, 0, params.height);
+}
+
+// HAS_TAIL: the width is not a multiple of 8 and the last block of every
+// row is masked. The common frame sizes never pay for it.
+template <bool HAS_TAIL>
+static void vectorized_rows(sf::Uint8* pixels, const RenderParams& params,
+                            float magnifier, float shiftX, int y_from, int y_to)
 {
     shiftX    += SHIFT_X_OFFSET;
     magnifier += MAGNIFIER_OFFSET;
 
     const float invMagnifier = 1.0f / magnifier;
-    const float COLOR_SCALE = 255.0f / MAX_ITERATION_DEPTH;
 
-    const float c_step_x = ASPECT_RATIO * invMagnifier * (2.0f / WINDOW_WIDTH);
-    const float c_step_y = invMagnifier * (2.0f / WINDOW_HEIGHT);
+    const float c_step_x = aspect_ratio(params) * invMagnifier * (2.0f / params.width);
+    const float c_step_y = invMagnifier * (2.0f / params.height);
 
     __m256 _01234567 = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f,
                                      3.0f, 2.0f, 1.0f, 0.0f);
     __m256 _8_c_step_x = _mm256_set1_ps(c_step_x * 8);
     __m256   _c_step_x = _mm256_set1_ps(c_step_x);
-    __m256   _c_step_y = _mm256_set1_ps(c_step_y);
 
-    __m256 _maxRadius2 = _mm256_set1_ps(MAX_RADIUS_2);
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+    const int fullWidth = params.width / 8 * 8;
+    const __m256 _tail  = tail_mask(params.width - fullWidth);
 
-    float c_y = -1.0f * invMagnifier + c_step_y * y_from;
-    __m256 _c_y = _mm256_set1_ps(c_y);
-    for (int screenY = y_from; screenY < y_to; ++screenY, c_y += c_step_y)
+    for (int screenY = y_from; screenY < y_to; ++screenY)
     {
-        float c_x = shiftX - ASPECT_RATIO * invMagnifier;
+        const ProfileSpan span = profile_span_begin();
+
+        // From the row index, not accumulated: a range starting anywhere
+        // gets the rows of the whole frame
+        const __m256 _c_y = _mm256_set1_ps(-1.0f * invMagnifier + c_step_y * screenY);
+
+        float c_x = shiftX - aspect_ratio(params) * invMagnifier;
         __m256 _c_x = _mm256_set1_ps(c_x);
 
         // _cx + ( 7dx, 6dx, 5dx, 4dx, 3dx, 2dx, 1dx, 0 )
         _c_x = _mm256_add_ps(_c_x, _mm256_mul_ps(_c_step_x, _01234567));
-        for (int screenX = 0; screenX < WINDOW_WIDTH; screenX += 8)
+
+        uint16_t* rowIterations = iterations + (size_t)screenY * params.width;
+        for (int screenX = 0; screenX < fullWidth; screenX += 8)
         {
-            __m256 _z_x = _mm256_setzero_ps();
-            __m256 _z_y = _mm256_setzero_ps();
-
-            __m256 _z_x2 = _mm256_setzero_ps();
-            __m256 _z_y2 = _mm256_setzero_ps();
-            __m256 _z_xy = _mm256_setzero_ps();
-
-            __m256i _iterations = _mm256_setzero_si256();
-
-            for (int iteration = 0; iteration < MAX_ITERATION_DEPTH; iteration++)
-            {
-                __m256 _radius2 = _mm256_add_ps(_z_x2, _z_y2);
-
-                __m256 _cmpMask = _mm256_cmp_ps(_radius2, _maxRadius2, _CMP_LT_OQ);
-                int mask = _mm256_movemask_ps(_cmpMask);
-                // for each float:
-                //      if (radius^2 < maxRadius^2)
-                //          mask = -1
-                //      else
-                //          mask = 0
-
-                if (!mask)
-                    break;
-
-                // x = x^2 - y^2 + cx
-                // y = 2xy + cy
-                _z_x = _mm256_add_ps(_c_x, _mm256_sub_ps(_z_x2, _z_y2));
-                _z_y = _mm256_add_ps(_c_y, _mm256_mul_ps(_mm256_set1_ps(2.0f), _z_xy));
-
-                // if (radius^2 < maxRadiud^2) iteration++
-                _iterations = _mm256_sub_epi32(_iterations, _mm256_castps_si256(_cmpMask));
-
-                _z_x2 = _mm256_mul_ps(_z_x, _z_x);
-                _z_y2 = _mm256_mul_ps(_z_y, _z_y);
-                _z_xy = _mm256_mul_ps(_z_x, _z_y);
-            }
-
-            int iterationsArray[8] = {};
-            _mm256_storeu_si256((__m256i*)iterationsArray, _iterations);
-            for (int i = 0; i < 8; i++)
-            {
-                sf::Uint8 r = 0;
-                sf::Uint8 g = 0;
-                sf::Uint8 b = 0;
-                if (iterationsArray[i] < MAX_ITERATION_DEPTH)
-                {
-                    float iterNormalized = iterationsArray[i] * COLOR_SCALE;
-                    r = (sf::Uint8)(iterNormalized / 2);
-                    g = (sf::Uint8)(iterNormalized * 2 + 2);
-                    b = (sf::Uint8)(iterNormalized * 2 + 5);
-                }
-
-                int pixelIndex = (screenY * WINDOW_WIDTH + screenX + i) * 4;
-                pixels[pixelIndex + 0] = r;
-                pixels[pixelIndex + 1] = g;
-                pixels[pixelIndex + 2] = b;
-                pixels[pixelIndex + 3] = 255;
-            }
+            store_iterations8(rowIterations + screenX, iterate8<false>(_c_x, _c_y, params));
 
             _c_x = _mm256_add_ps(_c_x, _8_c_step_x);
         }
-        _c_y = _mm256_add_ps(_c_y, _c_step_y);
+
+        if (HAS_TAIL)
+        {
+            uint16_t tailIterations[8] = {};
+            store_iterations8(tailIterations, iterate8<true>(_c_x, _c_y, params, _tail));
+
+            for (int i = 0; fullWidth + i < params.width; i++)
+                rowIterations[fullWidth + i] = tailIterations[i];
+        }
+
+        profile_span_end(span, "row", params, 0, params.width, screenY, screenY + 1);
+
+        // While the row is still in cache
+        mandelbrot_colorize(pixels, params, iterations, palette,
+                            0, params.width, screenY, screenY + 1);
+    }
+}
+
+void mandelbrot_vectorized_ranged(sf::Uint8* pixels, const RenderParams& params,
+                                  float magnifier, float shiftX, int y_from, int y_to)
+{
+    switch (params.isa)
+    {
+        case ISA_SSE42:
+            mandelbrot_vectorized_rows_sse42(pixels, params, magnifier, shiftX, y_from, y_to);
+            return;
+        case ISA_AVX512:
+            mandelbrot_vectorized_rows_avx512(pixels, params, magnifier, shiftX, y_from, y_to);
+            return;
+        case ISA_AVX2:
+            break;
+    }
+
+    if (params.width % 8 == 0)
+        vectorized_rows<false>(pixels, params, magnifier, shiftX, y_from, y_to);
+    else
+        vectorized_rows<true >(pixels, params, magnifier, shiftX, y_from, y_to);
+}
+
+void mandelbrot_vectorized_coords(const RenderParams& params, float magnifier, float shiftX,
+                                  float* c_x, float* c_y)
+{
+    // Same operations as mandelbrot_vectorized, so the coordinates match
+    // it bit for bit
+    shiftX    += SHIFT_X_OFFSET;
+    magnifier += MAGNIFIER_OFFSET;
+
+    const float invMagnifier = 1.0f / magnifier;
+
+    // Steps and indices of the whole view, if the frame is a window of it
+    const RenderParams view = view_params(params);
+
+    const float c_step_x = aspect_ratio(view) * invMagnifier * (2.0f / view.width);
+    const float c_step_y = invMagnifier * (2.0f / view.height);
+
+    __m256 _01234567 = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f,
+                                     3.0f, 2.0f, 1.0f, 0.0f);
+    __m256 _8_c_step_x = _mm256_set1_ps(c_step_x * 8);
+    __m256   _c_step_x = _mm256_set1_ps(c_step_x);
+
+    for (int screenY = 0; screenY < params.height; ++screenY)
+        c_y[screenY] = -1.0f * invMagnifier + c_step_y * (params.y_offset + screenY);
+
+    // The columns are stepped from the left edge of the view, those of
+    // the window kept
+    const int x_from = params.x_offset;
+    const int x_to   = params.x_offset + params.width;
+
+    float c_x0 = shiftX - aspect_ratio(view) * invMagnifier;
+    __m256 _c_x = _mm256_add_ps(_mm256_set1_ps(c_x0), _mm256_mul_ps(_c_step_x, _01234567));
+    for (int screenX = 0; screenX < x_to; screenX += 8)
+    {
+        float block[8] = {};
+        _mm256_storeu_ps(block, _c_x);
+        for (int i = 0; i < 8 && screenX + i < x_to; i++)
+            if (screenX + i >= x_from)
+                c_x[screenX + i - x_from] = block[i];
+
+        _c_x = _mm256_add_ps(_c_x, _8_c_step_x);
     }
 }
+
+void mandelbrot_vectorized_points(const RenderParams& params, const float* c_x, const float* c_y,
+                                  uint16_t* iterations, int n)
+{
+    switch (params.isa)
+    {
+        case ISA_SSE42:
+            mandelbrot_vectorized_points_sse42(params, c_x, c_y, iterations, n);
+            return;
+        case ISA_AVX512:
+            mandelbrot_vectorized_points_avx512(params, c_x, c_y, iterations, n);
+            return;
+        case ISA_AVX2:
+            break;
+    }
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        store_iterations8(iterations + i,
+                          iterate8<false>(_mm256_loadu_ps(c_x + i), _mm256_loadu_ps(c_y + i), params));
+    }
+
+    if (i == n)
+        return;
+
+    float tail_x[8] = {};
+    float tail_y[8] = {};
+    for (int j = 0; i + j < n; j++)
+    {
+        tail_x[j] = c_x[i + j];
+        tail_y[j] = c_y[i + j];
+    }
+
+    uint16_t tailIterations[8] = {};
+    store_iterations8(tailIterations, iterate8<true>(_mm256_loadu_ps(tail_x), _mm256_loadu_ps(tail_y),
+                                                     params, tail_mask(n - i)));
+
+    for (int j = 0; i + j < n; j++)
+        iterations[i + j] = tailIterations[j];
+}
@@ -0,0 +1,189 @@
+#include "mandelbrot_vectorized_isa.h"
+#include "mandelbrot_interior.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_profile.h"
+
+#include <immintrin.h>
+
+// The AVX2 kernel on 16-wide registers: one register holds two 8-wide
+// blocks of the AVX2 kernel, and lanes are retired in mask registers
+// instead of vector masks
+
+// is_in_cardioid_or_bulb for sixteen points
+static inline __mmask16 cardioid_or_bulb_mask16(__m512 _c_x, __m512 _c_y)
+{
+    __m512 _x  = _mm512_sub_ps(_c_x, _mm512_set1_ps(0.25f));
+    __m512 _y2 = _mm512_mul_ps(_c_y, _c_y);
+    __m512 _q  = _mm512_add_ps(_mm512_mul_ps(_x, _x), _y2);
+
+    __mmask16 cardioid = _mm512_cmp_ps_mask(_mm512_mul_ps(_q, _mm512_add_ps(_q, _x)),
+                                            _mm512_mul_ps(_mm512_set1_ps(0.25f), _y2), _CMP_LT_OQ);
+
+    __m512 _x1 = _mm512_add_ps(_c_x, _mm512_set1_ps(1.0f));
+    __mmask16 bulb = _mm512_cmp_ps_mask(_mm512_add_ps(_mm512_mul_ps(_x1, _x1), _y2),
+                                        _mm512_set1_ps(0.0625f), _CMP_LT_OQ);
+
+    return cardioid | bulb;
+}
+
+// Iteration counts of sixteen points, lanes set in skip are done from the start
+template <bool MASKED>
+static inline __m512i iterate16(__m512 _c_x, __m512 _c_y, const RenderParams& params,
+                                __mmask16 skip = 0)
+{
+    const __m512 _maxRadius2 = _mm512_set1_ps(max_radius_2(params));
+    const int maxIterations  = params.maxIterations;
+
+    const __m512i _one = _mm512_set1_epi32(1);
+
+    __m512 _z_x = _mm512_setzero_ps();
+    __m512 _z_y = _mm512_setzero_ps();
+
+    __m512 _z_x2 = _mm512_setzero_ps();
+    __m512 _z_y2 = _mm512_setzero_ps();
+    __m512 _z_xy = _mm512_setzero_ps();
+
+    __m512i _iterations = _mm512_setzero_si512();
+
+    __mmask16 interior = cardioid_or_bulb_mask16(_c_x, _c_y);
+    if (MASKED)
+        interior |= skip;
+
+    __m512 _check_x = _mm512_setzero_ps();
+    __m512 _check_y = _mm512_setzero_ps();
+    int checkLength    = PERIOD_CHECK_START;
+    int checkRemaining = PERIOD_CHECK_START;
+
+    for (int iteration = 0; iteration < maxIterations; iteration++)
+    {
+        __m512 _radius2 = _mm512_add_ps(_z_x2, _z_y2);
+
+        const __mmask16 active = _mm512_cmp_ps_mask(_radius2, _maxRadius2, _CMP_LT_OQ) & ~interior;
+        if (!active)
+            break;
+
+        profile_count_lanes(_mm_popcnt_u32(active), 16);
+
+        _z_x = _mm512_add_ps(_c_x, _mm512_sub_ps(_z_x2, _z_y2));
+        _z_y = _mm512_add_ps(_c_y, _mm512_mul_ps(_mm512_set1_ps(2.0f), _z_xy));
+
+        _iterations = _mm512_mask_add_epi32(_iterations, active, _iterations, _one);
+
+        _z_x2 = _mm512_mul_ps(_z_x, _z_x);
+        _z_y2 = _mm512_mul_ps(_z_y, _z_y);
+        _z_xy = _mm512_mul_ps(_z_x, _z_y);
+
+        interior |= _mm512_mask_cmp_ps_mask(active, _z_x, _check_x, _CMP_EQ_OQ) &
+                    _mm512_cmp_ps_mask(_z_y, _check_y, _CMP_EQ_OQ);
+
+        if (--checkRemaining == 0)
+        {
+            _check_x = _z_x;
+            _check_y = _z_y;
+            checkLength   *= 2;
+            checkRemaining = checkLength;
+        }
+    }
+
+    return _mm512_mask_mov_epi32(_iterations, interior, _mm512_set1_epi32(maxIterations));
+}
+
+// Lanes at or past nValid, 0 <= nValid < 16
+static inline __mmask16 tail_mask16(int nValid)
+{
+    return (__mmask16)(0xFFFF << nValid);
+}
+
+// The counts of the lanes in mask as uint16_t
+static inline void store_iterations16(uint16_t* iterations, __mmask16 mask, __m512i _iterations)
+{
+    _mm512_mask_cvtusepi32_storeu_epi16(iterations, mask, _iterations);
+}
+
+template <bool HAS_TAIL>
+static void vectorized_rows(sf::Uint8* pixels, const RenderParams& params,
+                            float magnifier, float shiftX, int y_from, int y_to)
+{
+    shiftX    += SHIFT_X_OFFSET;
+    magnifier += MAGNIFIER_OFFSET;
+
+    const float invMagnifier = 1.0f / magnifier;
+
+    const float c_step_x = aspect_ratio(params) * invMagnifier * (2.0f / params.width);
+    const float c_step_y = invMagnifier * (2.0f / params.height);
+
+    const __m512 _0to7_0to7 = _mm512_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f,
+                                            7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+    const __m512 _8_c_step_x = _mm512_set1_ps(c_step_x * 8);
+
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+    const int fullWidth = params.width / 16 * 16;
+    const __mmask16 tail = tail_mask16(params.width - fullWidth);
+
+    for (int screenY = y_from; screenY < y_to; ++screenY)
+    {
+        const ProfileSpan span = profile_span_begin();
+
+        // From the row index, as the AVX2 kernel
+        const __m512 _c_y = _mm512_set1_ps(-1.0f * invMagnifier + c_step_y * screenY);
+
+        // The first two blocks of the AVX2 kernel, computed the same way:
+        // the second one is the first plus one 8-wide step
+        __m512 _c_x = _mm512_add_ps(_mm512_set1_ps(shiftX - aspect_ratio(params) * invMagnifier),
+                                    _mm512_mul_ps(_mm512_set1_ps(c_step_x), _0to7_0to7));
+        _c_x = _mm512_mask_add_ps(_c_x, 0xFF00, _c_x, _8_c_step_x);
+
+        uint16_t* rowIterations = iterations + (size_t)screenY * params.width;
+        for (int screenX = 0; screenX < fullWidth; screenX += 16)
+        {
+            store_iterations16(rowIterations + screenX, 0xFFFF, iterate16<false>(_c_x, _c_y, params));
+
+            // Two 8-wide steps, as the AVX2 kernel takes them
+            _c_x = _mm512_add_ps(_mm512_add_ps(_c_x, _8_c_step_x), _8_c_step_x);
+        }
+
+        if (HAS_TAIL)
+        {
+            store_iterations16(rowIterations + fullWidth, (__mmask16)~tail,
+                               iterate16<true>(_c_x, _c_y, params, tail));
+        }
+
+        profile_span_end(span, "row", params, 0, params.width, screenY, screenY + 1);
+
+        mandelbrot_colorize(pixels, params, iterations, palette,
+                            0, params.width, screenY, screenY + 1);
+    }
+}
+
+void mandelbrot_vectorized_rows_avx512(sf::Uint8* pixels, const RenderParams& params,
+                                       float magnifier, float shiftX, int y_from, int y_to)
+{
+    if (params.width % 16 == 0)
+        vectorized_rows<false>(pixels, params, magnifier, shiftX, y_from, y_to);
+    else
+        vectorized_rows<true >(pixels, params, magnifier, shiftX, y_from, y_to);
+}
+
+void mandelbrot_vectorized_points_avx512(const RenderParams& params,
+                                         const float* c_x, const float* c_y,
+                                         uint16_t* iterations, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        store_iterations16(iterations + i, 0xFFFF,
+                           iterate16<false>(_mm512_loadu_ps(c_x + i), _mm512_loadu_ps(c_y + i), params));
+    }
+
+    if (i == n)
+        return;
+
+    const __mmask16 tail = tail_mask16(n - i);
+    const __m512i _iterations = iterate16<true>(_mm512_maskz_loadu_ps((__mmask16)~tail, c_x + i),
+                                                _mm512_maskz_loadu_ps((__mmask16)~tail, c_y + i),
+                                                params, tail);
+
+    store_iterations16(iterations + i, (__mmask16)~tail, _iterations);
+}
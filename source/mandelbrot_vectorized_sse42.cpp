@@ -0,0 +1,208 @@
+#include "mandelbrot_vectorized_isa.h"
+#include "mandelbrot_interior.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_profile.h"
+
+#include <nmmintrin.h>
+
+// The AVX2 kernel on 4-wide SSE registers: every 8-wide block of the
+// AVX2 kernel is iterated as a low and a high half
+
+// is_in_cardioid_or_bulb for four points
+static inline __m128 cardioid_or_bulb_mask4(__m128 _c_x, __m128 _c_y)
+{
+    __m128 _x  = _mm_sub_ps(_c_x, _mm_set1_ps(0.25f));
+    __m128 _y2 = _mm_mul_ps(_c_y, _c_y);
+    __m128 _q  = _mm_add_ps(_mm_mul_ps(_x, _x), _y2);
+
+    __m128 _cardioid = _mm_cmplt_ps(_mm_mul_ps(_q, _mm_add_ps(_q, _x)),
+                                    _mm_mul_ps(_mm_set1_ps(0.25f), _y2));
+
+    __m128 _x1 = _mm_add_ps(_c_x, _mm_set1_ps(1.0f));
+    __m128 _bulb = _mm_cmplt_ps(_mm_add_ps(_mm_mul_ps(_x1, _x1), _y2),
+                                _mm_set1_ps(0.0625f));
+
+    return _mm_or_ps(_cardioid, _bulb);
+}
+
+// Iteration counts of four points, lanes set in _skip are done from the start
+template <bool MASKED>
+static inline __m128i iterate4(__m128 _c_x, __m128 _c_y, const RenderParams& params,
+                               __m128 _skip = _mm_setzero_ps())
+{
+    const __m128 _maxRadius2 = _mm_set1_ps(max_radius_2(params));
+    const int maxIterations  = params.maxIterations;
+
+    __m128 _z_x = _mm_setzero_ps();
+    __m128 _z_y = _mm_setzero_ps();
+
+    __m128 _z_x2 = _mm_setzero_ps();
+    __m128 _z_y2 = _mm_setzero_ps();
+    __m128 _z_xy = _mm_setzero_ps();
+
+    __m128i _iterations = _mm_setzero_si128();
+
+    __m128 _interior = cardioid_or_bulb_mask4(_c_x, _c_y);
+    if (MASKED)
+        _interior = _mm_or_ps(_interior, _skip);
+
+    __m128 _check_x = _mm_setzero_ps();
+    __m128 _check_y = _mm_setzero_ps();
+    int checkLength    = PERIOD_CHECK_START;
+    int checkRemaining = PERIOD_CHECK_START;
+
+    for (int iteration = 0; iteration < maxIterations; iteration++)
+    {
+        __m128 _radius2 = _mm_add_ps(_z_x2, _z_y2);
+
+        __m128 _cmpMask = _mm_andnot_ps(_interior, _mm_cmplt_ps(_radius2, _maxRadius2));
+        const int mask = _mm_movemask_ps(_cmpMask);
+        if (!mask)
+            break;
+
+        profile_count_lanes(_mm_popcnt_u32(mask), 4);
+
+        _z_x = _mm_add_ps(_c_x, _mm_sub_ps(_z_x2, _z_y2));
+        _z_y = _mm_add_ps(_c_y, _mm_mul_ps(_mm_set1_ps(2.0f), _z_xy));
+
+        _iterations = _mm_sub_epi32(_iterations, _mm_castps_si128(_cmpMask));
+
+        _z_x2 = _mm_mul_ps(_z_x, _z_x);
+        _z_y2 = _mm_mul_ps(_z_y, _z_y);
+        _z_xy = _mm_mul_ps(_z_x, _z_y);
+
+        __m128 _periodic = _mm_and_ps(_mm_cmpeq_ps(_z_x, _check_x),
+                                      _mm_cmpeq_ps(_z_y, _check_y));
+        _interior = _mm_or_ps(_interior, _mm_and_ps(_periodic, _cmpMask));
+
+        if (--checkRemaining == 0)
+        {
+            _check_x = _z_x;
+            _check_y = _z_y;
+            checkLength   *= 2;
+            checkRemaining = checkLength;
+        }
+    }
+
+    return _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(_iterations),
+                                          _mm_castsi128_ps(_mm_set1_epi32(maxIterations)),
+                                          _interior));
+}
+
+// Lanes at or past nValid, nValid may be outside [0, 4]
+static inline __m128 tail_mask4(int nValid)
+{
+    const __m128i _lanes = _mm_set_epi32(3, 2, 1, 0);
+    return _mm_castsi128_ps(_mm_cmpgt_epi32(_lanes, _mm_set1_epi32(nValid - 1)));
+}
+
+template <bool MASKED>
+static inline __m128i iterate8(__m128 _c_x_lo, __m128 _c_x_hi, __m128 _c_y,
+                               const RenderParams& params, int nValid = 8)
+{
+    return _mm_packus_epi32(iterate4<MASKED>(_c_x_lo, _c_y, params, tail_mask4(nValid)),
+                            iterate4<MASKED>(_c_x_hi, _c_y, params, tail_mask4(nValid - 4)));
+}
+
+template <bool HAS_TAIL>
+static void vectorized_rows(sf::Uint8* pixels, const RenderParams& params,
+                            float magnifier, float shiftX, int y_from, int y_to)
+{
+    shiftX    += SHIFT_X_OFFSET;
+    magnifier += MAGNIFIER_OFFSET;
+
+    const float invMagnifier = 1.0f / magnifier;
+
+    const float c_step_x = aspect_ratio(params) * invMagnifier * (2.0f / params.width);
+    const float c_step_y = invMagnifier * (2.0f / params.height);
+
+    const __m128 _0123 = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 _4567 = _mm_set_ps(7.0f, 6.0f, 5.0f, 4.0f);
+    const __m128 _8_c_step_x = _mm_set1_ps(c_step_x * 8);
+    const __m128   _c_step_x = _mm_set1_ps(c_step_x);
+
+    uint16_t*      iterations = mandelbrot_iterations(params);
+    const Palette& palette    = mandelbrot_palette(params);
+
+    const int fullWidth = params.width / 8 * 8;
+
+    for (int screenY = y_from; screenY < y_to; ++screenY)
+    {
+        const ProfileSpan span = profile_span_begin();
+
+        // From the row index, as the AVX2 kernel
+        const __m128 _c_y = _mm_set1_ps(-1.0f * invMagnifier + c_step_y * screenY);
+
+        const __m128 _c_x0 = _mm_set1_ps(shiftX - aspect_ratio(params) * invMagnifier);
+
+        __m128 _c_x_lo = _mm_add_ps(_c_x0, _mm_mul_ps(_c_step_x, _0123));
+        __m128 _c_x_hi = _mm_add_ps(_c_x0, _mm_mul_ps(_c_step_x, _4567));
+
+        uint16_t* rowIterations = iterations + (size_t)screenY * params.width;
+        for (int screenX = 0; screenX < fullWidth; screenX += 8)
+        {
+            _mm_storeu_si128((__m128i*)(rowIterations + screenX),
+                             iterate8<false>(_c_x_lo, _c_x_hi, _c_y, params));
+
+            _c_x_lo = _mm_add_ps(_c_x_lo, _8_c_step_x);
+            _c_x_hi = _mm_add_ps(_c_x_hi, _8_c_step_x);
+        }
+
+        if (HAS_TAIL)
+        {
+            uint16_t tailIterations[8] = {};
+            _mm_storeu_si128((__m128i*)tailIterations,
+                             iterate8<true>(_c_x_lo, _c_x_hi, _c_y, params,
+                                            params.width - fullWidth));
+
+            for (int i = 0; fullWidth + i < params.width; i++)
+                rowIterations[fullWidth + i] = tailIterations[i];
+        }
+
+        profile_span_end(span, "row", params, 0, params.width, screenY, screenY + 1);
+
+        mandelbrot_colorize(pixels, params, iterations, palette,
+                            0, params.width, screenY, screenY + 1);
+    }
+}
+
+void mandelbrot_vectorized_rows_sse42(sf::Uint8* pixels, const RenderParams& params,
+                                      float magnifier, float shiftX, int y_from, int y_to)
+{
+    if (params.width % 8 == 0)
+        vectorized_rows<false>(pixels, params, magnifier, shiftX, y_from, y_to);
+    else
+        vectorized_rows<true >(pixels, params, magnifier, shiftX, y_from, y_to);
+}
+
+void mandelbrot_vectorized_points_sse42(const RenderParams& params,
+                                        const float* c_x, const float* c_y,
+                                        uint16_t* iterations, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i _iterations = iterate4<false>(_mm_loadu_ps(c_x + i), _mm_loadu_ps(c_y + i), params);
+        _mm_storel_epi64((__m128i*)(iterations + i), _mm_packus_epi32(_iterations, _iterations));
+    }
+
+    if (i == n)
+        return;
+
+    float tail_x[4] = {};
+    float tail_y[4] = {};
+    for (int j = 0; i + j < n; j++)
+    {
+        tail_x[j] = c_x[i + j];
+        tail_y[j] = c_y[i + j];
+    }
+
+    __m128i _iterations = iterate4<true>(_mm_loadu_ps(tail_x), _mm_loadu_ps(tail_y),
+                                         params, tail_mask4(n - i));
+
+    uint16_t tailIterations[8] = {};
+    _mm_storeu_si128((__m128i*)tailIterations, _mm_packus_epi32(_iterations, _iterations));
+
+    for (int j = 0; i + j < n; j++)
+        iterations[i + j] = tailIterations[j];
+}
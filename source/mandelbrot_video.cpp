@@ -0,0 +1,384 @@
+#include "mandelbrot_video.h"
+#include "mandelbrot_bands.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_deep.h"
+#include "mandelbrot_double.h"
+#include "mandelbrot_frame_buffer.h"
+#include "mandelbrot_palette.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pixels iterated again per call of the points kernel
+const int VIDEO_POINT_CHUNK = 256;
+
+typedef std::chrono::steady_clock Clock;
+
+// Writes the frames in order from a ring of buffers. Frame i goes to
+// slot i % nSlots once frame i - nSlots is written, so a frame only
+// ever waits for an earlier one.
+class FrameWriter
+{
+public:
+    FrameWriter(FILE* file, const RenderParams& params, int nSlots, int nFrames)
+        : file_(file),
+          frameBytes_((size_t)params.width * params.height * 4),
+          slots_(nSlots),
+          ready_(nSlots, false),
+          nFrames_(nFrames),
+          nWritten_(0),
+          failed_(false)
+    {
+        for (sf::Uint8*& slot : slots_)
+            slot = (sf::Uint8*)mandelbrot_frame_buffer_alloc(params.width * 4, params.height,
+                                                             params.nThreads);
+
+        thread_ = std::thread(&FrameWriter::write_loop, this);
+    }
+
+    ~FrameWriter()
+    {
+        thread_.join();
+
+        for (sf::Uint8* slot : slots_)
+            mandelbrot_frame_buffer_free(slot);
+    }
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    sf::Uint8* begin_frame(int index)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&] { return nWritten_ > index - (int)slots_.size(); });
+
+        return slots_[index % slots_.size()];
+    }
+
+    void end_frame(int index)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_[index % slots_.size()] = true;
+        }
+        cond_.notify_all();
+    }
+
+    // Waits for every frame, false if one could not be written
+    bool finish()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&] { return nWritten_ == nFrames_; });
+
+        return !failed_ && fflush(file_) == 0;
+    }
+
+private:
+    void write_loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (nWritten_ < nFrames_)
+        {
+            const size_t slot = nWritten_ % slots_.size();
+            cond_.wait(lock, [&] { return ready_[slot]; });
+
+            // Frames after a failed write are still taken, so no one waits
+            lock.unlock();
+            const bool ok = failed_ || fwrite(slots_[slot], 1, frameBytes_, file_) == frameBytes_;
+            lock.lock();
+
+            failed_ = !ok;
+            ready_[slot] = false;
+            nWritten_++;
+            cond_.notify_all();
+        }
+    }
+
+    FILE*  file_;
+    size_t frameBytes_;
+
+    std::vector<sf::Uint8*> slots_;
+    std::vector<bool>       ready_;
+
+    std::mutex              mutex_;
+    std::condition_variable cond_;
+
+    const int nFrames_;
+    int       nWritten_;
+    bool      failed_;
+
+    std::thread thread_;
+};
+
+// Counts of a key frame and where its pixels are in the plane
+struct KeyFrame
+{
+    const uint16_t* counts;
+    int             width;
+    int             height;
+
+    double c_x0;
+    double c_y0;
+    double stepX;
+    double stepY;
+};
+
+// Per-thread scratch of one derived frame
+struct DeriveBatch
+{
+    std::vector<double>   columnC_x;
+    std::vector<double>   rowC_y;
+    std::vector<int>      keyColumn;
+    std::vector<int>      keyRow;
+    std::vector<uint16_t> counts;
+
+    std::vector<size_t>   index;
+    std::vector<double>   c_x;
+    std::vector<double>   c_y;
+    std::vector<uint16_t> pointCounts;
+};
+
+static KeyFrame key_frame(const RenderParams& keyParams, double scale, double shiftX, double shiftY)
+{
+    std::vector<double> columnC_x(keyParams.width);
+    std::vector<double> rowC_y(keyParams.height);
+    mandelbrot_double_coords(keyParams, scale, shiftX, shiftY, columnC_x.data(), rowC_y.data());
+
+    KeyFrame key = {};
+    key.counts = mandelbrot_iterations(keyParams);
+    key.width  = keyParams.width;
+    key.height = keyParams.height;
+    key.c_x0   = columnC_x.front();
+    key.c_y0   = rowC_y.front();
+    key.stepX  = (columnC_x.back() - columnC_x.front()) / std::max(keyParams.width  - 1, 1);
+    key.stepY  = (rowC_y.back()    - rowC_y.front())    / std::max(keyParams.height - 1, 1);
+
+    return key;
+}
+
+// The key frame pixel left of or above c, -1 if the 2x2 block starting
+// there is not inside the key frame
+static int key_index(double c, double c0, double step, int size)
+{
+    const double position = std::floor((c - c0) / step);
+    return position >= 0 && position + 1 < size ? (int)position : -1;
+}
+
+// Returns the pixels iterated again
+static size_t derive_frame(const KeyFrame& key, const RenderParams& params, int tolerance,
+                           double scale, double shiftX, double shiftY, const Palette& palette,
+                           sf::Uint8* pixels)
+{
+    static thread_local DeriveBatch batch;
+
+    const int WIDTH  = params.width;
+    const int HEIGHT = params.height;
+
+    batch.columnC_x.resize(WIDTH);
+    batch.rowC_y   .resize(HEIGHT);
+    mandelbrot_double_coords(params, scale, shiftX, shiftY,
+                             batch.columnC_x.data(), batch.rowC_y.data());
+
+    batch.keyColumn.resize(WIDTH);
+    batch.keyRow   .resize(HEIGHT);
+    for (int x = 0; x < WIDTH; x++)
+        batch.keyColumn[x] = key_index(batch.columnC_x[x], key.c_x0, key.stepX, key.width);
+    for (int y = 0; y < HEIGHT; y++)
+        batch.keyRow[y] = key_index(batch.rowC_y[y], key.c_y0, key.stepY, key.height);
+
+    batch.counts.resize((size_t)WIDTH * HEIGHT);
+    batch.index.clear();
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+        {
+            const size_t index = (size_t)y * WIDTH + x;
+            if (batch.keyColumn[x] < 0 || batch.keyRow[y] < 0)
+            {
+                batch.index.push_back(index);
+                continue;
+            }
+
+            const uint16_t* block = key.counts + (size_t)batch.keyRow[y] * key.width + batch.keyColumn[x];
+            const int low  = std::min(std::min(block[0], block[1]),
+                                      std::min(block[key.width], block[key.width + 1]));
+            const int high = std::max(std::max(block[0], block[1]),
+                                      std::max(block[key.width], block[key.width + 1]));
+
+            // Interior pixels next to escaped ones are never guessed
+            if (high - low <= tolerance && (high < params.maxIterations || low == high))
+                batch.counts[index] = (uint16_t)((low + high + 1) / 2);
+            else
+                batch.index.push_back(index);
+        }
+
+    const int n = (int)batch.index.size();
+    batch.c_x.resize(n);
+    batch.c_y.resize(n);
+    batch.pointCounts.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        batch.c_x[i] = batch.columnC_x[batch.index[i] % WIDTH];
+        batch.c_y[i] = batch.rowC_y   [batch.index[i] / WIDTH];
+    }
+
+    for (int i = 0; i < n; i += VIDEO_POINT_CHUNK)
+        mandelbrot_double_points(params, batch.c_x.data() + i, batch.c_y.data() + i,
+                                 batch.pointCounts.data() + i, std::min(VIDEO_POINT_CHUNK, n - i));
+
+    for (int i = 0; i < n; i++)
+        batch.counts[batch.index[i]] = batch.pointCounts[i];
+
+    mandelbrot_colorize(pixels, params, batch.counts.data(), palette, 0, WIDTH, 0, HEIGHT);
+    return batch.index.size();
+}
+
+int mandelbrot_video_render(const VideoJob& job, const RenderParams& params)
+{
+    const bool toStdout = strcmp(job.output, "-") == 0;
+    FILE* file = toStdout ? stdout : fopen(job.output, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Can't create %s\n", job.output);
+        return 1;
+    }
+
+    const int nFrames = std::max(job.nFrames, 1);
+
+    // The magnification grows by zoomPerFrame every frame
+    const double firstMagnifier = job.scale  + MAGNIFIER_OFFSET;
+    const double lastMagnifier  = job.zoomTo + MAGNIFIER_OFFSET;
+    const double zoomPerFrame   = nFrames > 1 ? std::pow(lastMagnifier / firstMagnifier,
+                                                         1.0 / (nFrames - 1))
+                                              : 1.0;
+    auto frame_scale = [&](int frame)
+    {
+        return firstMagnifier * std::pow(zoomPerFrame, frame) - MAGNIFIER_OFFSET;
+    };
+
+    // Frames of a key frame differ by at most VIDEO_KEY_RESOLUTION in
+    // magnification, zooming in or out
+    const double logZoom  = std::fabs(std::log(zoomPerFrame));
+    const int    keySpace = logZoom > 0 ? (int)std::floor(std::log((double)VIDEO_KEY_RESOLUTION) / logZoom) + 1
+                                        : nFrames;
+
+    // A key frame costs as much as VIDEO_KEY_RESOLUTION^2 frames, it has
+    // to save more than that
+    const bool useKeyFrames = job.keyFrames &&
+                              keySpace > VIDEO_KEY_RESOLUTION * VIDEO_KEY_RESOLUTION;
+
+    RenderParams keyParams = params;
+    keyParams.width  *= VIDEO_KEY_RESOLUTION;
+    keyParams.height *= VIDEO_KEY_RESOLUTION;
+
+    const BigFixed& shiftX = job.shiftX;
+    const BigFixed& shiftY = job.shiftY;
+
+    // Key frames are only used where double resolves the view
+    const double shiftXd = bf_to_double(shiftX);
+    const double shiftYd = bf_to_double(shiftY);
+
+    const Palette& palette = mandelbrot_palette(params);
+
+    if (!toStdout)
+    {
+        printf("Writing %d frames of %dx%d RGBA to %s\n", nFrames, params.width, params.height,
+               job.output);
+        fflush(stdout);
+    }
+
+    sf::Uint8* keyPixels = NULL;
+    if (useKeyFrames)
+        keyPixels = (sf::Uint8*)mandelbrot_frame_buffer_alloc(keyParams.width * 4, keyParams.height,
+                                                              params.nThreads);
+
+    const auto start = Clock::now();
+    int    nKeyFrames  = 0;
+    size_t nRecomputed = 0;
+    size_t nDerived    = 0;
+
+    {
+        const int nSlots = std::max(VIDEO_QUEUE_FRAMES, params.nThreads + 2);
+        FrameWriter writer(file, params, nSlots, nFrames);
+
+        for (int first = 0; first < nFrames; first += keySpace)
+        {
+            const int last = std::min(first + keySpace, nFrames) - 1;
+
+            // The widest view of the segment, the one with the smaller magnification
+            const double keyScale = zoomPerFrame >= 1.0 ? frame_scale(first) : frame_scale(last);
+
+            // The key frame has the finest pixel step of the segment
+            const bool derive = useKeyFrames &&
+                                mandelbrot_pick_precision(keyParams, keyScale, shiftX, shiftY)
+                                    <= PRECISION_DOUBLE;
+            if (!derive)
+            {
+                for (int frame = first; frame <= last; frame++)
+                {
+                    mandelbrot_bands(job.func, writer.begin_frame(frame), params,
+                                     frame_scale(frame), shiftX, shiftY);
+                    writer.end_frame(frame);
+                }
+            }
+            else
+            {
+                mandelbrot_bands(job.func, keyPixels, keyParams, keyScale, shiftX, shiftY);
+                nKeyFrames++;
+
+                const KeyFrame key = key_frame(keyParams, keyScale, shiftXd, shiftYd);
+
+                size_t nSegmentRecomputed = 0;
+
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:nSegmentRecomputed) num_threads(params.nThreads)
+                for (int frame = first; frame <= last; frame++)
+                {
+                    nSegmentRecomputed += derive_frame(key, params, job.tolerance, frame_scale(frame),
+                                                       shiftXd, shiftYd, palette,
+                                                       writer.begin_frame(frame));
+                    writer.end_frame(frame);
+                }
+
+                nRecomputed += nSegmentRecomputed;
+                nDerived    += last - first + 1;
+            }
+
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            fprintf(stderr, "\r%d / %d frames, %d key frames, %.0f frames/h", last + 1, nFrames,
+                    nKeyFrames, (last + 1) / seconds * 3600.0);
+        }
+
+        if (!writer.finish())
+        {
+            fprintf(stderr, "\nCan't write %s\n", job.output);
+            mandelbrot_frame_buffer_free(keyPixels);
+            if (!toStdout)
+                fclose(file);
+            return 1;
+        }
+    }
+
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    fprintf(stderr, "\n%d frames in %.1f s, %.0f frames/h", nFrames, seconds,
+            nFrames / seconds * 3600.0);
+    if (nDerived > 0)
+        fprintf(stderr, ", %zu derived from %d key frames with %.1f%% of their pixels iterated",
+                nDerived, nKeyFrames,
+                100.0 * nRecomputed / ((double)nDerived * params.width * params.height));
+    fprintf(stderr, "\n");
+
+    mandelbrot_frame_buffer_free(keyPixels);
+    if (!toStdout && fclose(file) != 0)
+    {
+        fprintf(stderr, "Can't write %s\n", job.output);
+        return 1;
+    }
+
+    return 0;
+}
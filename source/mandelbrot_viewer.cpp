@@ -0,0 +1,433 @@
+#include "mandelbrot_viewer.h"
+
+#include <SFML/Graphics.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifdef GPU
+#include <cuda_runtime.h>
+#include "mandelbrot_cuda.h"
+#endif
+
+#include "mandelbrot_auto_depth.h"
+#include "mandelbrot_deep.h"
+#include "mandelbrot_fractal.h"
+#include "mandelbrot_frame_cache.h"
+#include "mandelbrot_palette.h"
+#include "mandelbrot_profile.h"
+#include "mandelbrot_progressive.h"
+#include "mandelbrot_render_thread.h"
+
+// About 0.1 / scale, rounded to whole pixels so the cached frame can be shifted
+static double pan_step(const RenderParams& params, double scale)
+{
+    const double pixelStep = mandelbrot_pixel_step(params, scale);
+    return std::max(1.0, std::round(0.1 / scale / pixelStep)) * pixelStep;
+}
+
+static void render_frame(const MandelbrotBackend* mode, sf::Uint8* pixels,
+                         const RenderParams& params, double scale,
+                         const BigFixed& shiftX, const BigFixed& shiftY)
+{
+#ifdef GPU
+    if (strcmp(mode->name, "cuda_no_cpy") == 0) {
+        sf::Uint8* d_pixels = mandelbrot_cuda_device_pixels(params);
+        size_t size = (size_t)params.width * params.height * 4 * sizeof(sf::Uint8);
+        mandelbrot_cuda_no_cpy(d_pixels, params, scale, bf_to_double(shiftX));
+        cudaMemcpy(pixels, d_pixels, size, cudaMemcpyDeviceToHost);
+        return;
+    }
+#endif
+    if (mode->deepFunc)
+        mode->deepFunc(pixels, params, scale, shiftX, shiftY);
+    else
+        mode->func(pixels, params, scale, bf_to_double(shiftX));
+}
+
+static bool same_view(const FrameCache& cache,
+                      double scale, const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    return cache.scale == scale &&
+           memcmp(&cache.shiftX, &shiftX, sizeof(BigFixed)) == 0 &&
+           memcmp(&cache.shiftY, &shiftY, sizeof(BigFixed)) == 0;
+}
+
+// The points kernel that refines the view of mode progressively: the
+// float modes flagged sameAsVectorized render the image of the
+// vectorized kernel, the deep ones that of the double kernel as long as
+// double resolves the view. false if the view has to be rendered by the
+// mode itself, naive and interleaved always are.
+static bool progressive_kernel(const MandelbrotBackend* mode, const RenderParams& params,
+                               double scale, const BigFixed& shiftX, const BigFixed& shiftY,
+                               ProgressiveKernel* kernel)
+{
+    // The CUDA kernels do not fill the iteration buffer
+    if (!mode->cached)
+        return false;
+
+    // The points kernels only know the Mandelbrot set
+    if (!mandelbrot_fractal_is_mandelbrot())
+        return false;
+
+    if (mode->func)
+    {
+        if (!mode->sameAsVectorized)
+            return false;
+
+        *kernel = PROGRESSIVE_FLOAT;
+        return true;
+    }
+
+    const MandelbrotPrecision precision = mandelbrot_pick_precision(params, scale, shiftX, shiftY);
+    if (precision != PRECISION_FLOAT && precision != PRECISION_DOUBLE)
+        return false;
+
+    *kernel = PROGRESSIVE_DOUBLE;
+    return true;
+}
+
+// A full frame of the view. A depth raised above baseIterations by
+// --iterations auto is rendered at baseIterations first and then only
+// refined on the boundary tiles, if the mode has a points kernel for it.
+static void render_full_frame(const MandelbrotBackend* mode, sf::Uint8* pixels,
+                              const RenderParams& params, int baseIterations, double scale,
+                              const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    ProgressiveKernel kernel;
+    if (params.maxIterations <= baseIterations ||
+        !progressive_kernel(mode, params, scale, shiftX, shiftY, &kernel))
+    {
+        render_frame(mode, pixels, params, scale, shiftX, shiftY);
+        return;
+    }
+
+    RenderParams base = params;
+    base.maxIterations = baseIterations;
+
+    render_frame(mode, pixels, base, scale, shiftX, shiftY);
+    mandelbrot_auto_refine(pixels, params, baseIterations, kernel, scale, shiftX, shiftY);
+}
+
+// Brings pixels to the view, reusing the cached frame when there is one:
+// a horizontal pan of a mode that renders the image of the vectorized
+// kernel over the Mandelbrot set only renders the exposed columns, with
+// the fractal engine; any other move shows the old frame resampled and
+// sets *refine, a full render once the view has settled. Returns false
+// if nothing changed.
+static bool update_frame(const MandelbrotBackend* mode, sf::Uint8* pixels,
+                         const RenderParams& params, int baseIterations, FrameCache* cache,
+                         bool* refine, bool settled,
+                         double scale, const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    const bool sameView = cache->valid && same_view(*cache, scale, shiftX, shiftY);
+
+    if (sameView && !(*refine && settled))
+        return false;
+
+    const FrameCache old = *cache;
+
+    cache->valid  = mode->cached;
+    cache->scale  = scale;
+    cache->shiftX = shiftX;
+    cache->shiftY = shiftY;
+    *refine = false;
+
+    if (!old.valid || sameView)
+    {
+        render_full_frame(mode, pixels, params, baseIterations, scale, shiftX, shiftY);
+        return true;
+    }
+
+    // The view in pixels of the old frame
+    const double oldStep = mandelbrot_pixel_step(params, old.scale);
+    const double offsetX = bf_to_double(bf_sub(shiftX, old.shiftX)) / oldStep;
+    const double offsetY = bf_to_double(bf_sub(shiftY, old.shiftY)) / oldStep;
+
+    const int dx = (int)std::lround(offsetX);
+    if (mode->sameAsVectorized && mandelbrot_fractal_is_mandelbrot() &&
+        scale == old.scale && offsetY == 0 && std::abs(dx) < params.width)
+    {
+        mandelbrot_shift_iterations(params, dx, 0);
+        mandelbrot_colorize(pixels, params);
+
+        if (dx > 0)
+            mandelbrot_render_columns(pixels, params, scale, bf_to_double(shiftX),
+                                      params.width - dx, params.width);
+        else
+            mandelbrot_render_columns(pixels, params, scale, bf_to_double(shiftX), 0, -dx);
+        return true;
+    }
+
+    mandelbrot_resample_iterations(params, mandelbrot_pixel_step(params, scale) / oldStep,
+                                   offsetX, offsetY);
+    mandelbrot_colorize(pixels, params);
+    *refine = true;
+    return true;
+}
+
+// What the render thread keeps of the interactive view between frames
+struct ViewRenderer
+{
+    const MandelbrotBackend* mode;
+    RenderParams          params;
+
+    // Depth the frames are rendered at before the boundary tiles are
+    // refined to params.maxIterations. With autoDepth both come from
+    // probing depthView, never below minIterations.
+    int        baseIterations;
+    bool       autoDepth;
+    int        minIterations;
+    FrameCache depthView;
+
+    FrameCache cache;
+    bool       refine;
+    int        paletteOffset;
+
+    // Progressive rendering in slices of budget, 0 renders whole frames
+    std::chrono::milliseconds budget;
+    ProgressiveFrame          progressive;
+
+    std::chrono::steady_clock::time_point lastMove;
+};
+
+// A preview is refined once the view has not moved for this long
+static const std::chrono::milliseconds REFINE_DELAY(150);
+
+// Runs on the render thread, which owns the iteration buffer and the
+// palette. A progressive frame asks to be continued right away, so a
+// newer view cancels it between slices; a preview asks to be refined
+// once it has settled.
+static bool render_view(ViewRenderer* renderer, sf::Uint8* pixels, const RenderView& view,
+                        std::chrono::steady_clock::time_point* again)
+{
+    const MandelbrotBackend* mode   = renderer->mode;
+    const RenderParams&   params = renderer->params;
+
+    const auto now = std::chrono::steady_clock::now();
+
+    // Color cycling only recolors the last frame's iteration counts
+    const bool paletteChanged = view.paletteOffset != renderer->paletteOffset;
+    if (paletteChanged)
+    {
+        renderer->paletteOffset = view.paletteOffset;
+        mandelbrot_palette_cycle(params.context, view.paletteOffset);
+    }
+
+    mandelbrot_profile_frame_begin(mode->name, NULL);
+
+    if (renderer->autoDepth &&
+        !(renderer->depthView.valid && same_view(renderer->depthView, view.scale, view.shiftX, view.shiftY)))
+    {
+        RenderParams probe = params;
+        probe.maxIterations = renderer->minIterations;
+
+        const AutoDepth depth = mandelbrot_auto_depth(probe, view.scale, view.shiftX, view.shiftY);
+        renderer->depthView      = { true, view.scale, view.shiftX, view.shiftY };
+        renderer->baseIterations = depth.base;
+
+        // Counts of another depth are not reused, the palette is that of the new one
+        if (depth.depth != params.maxIterations)
+        {
+            renderer->params.maxIterations = depth.depth;
+            renderer->cache.valid = false;
+        }
+    }
+
+    bool changed = false;
+    ProgressiveKernel kernel;
+    if (renderer->budget.count() > 0 &&
+        progressive_kernel(mode, params, view.scale, view.shiftX, view.shiftY, &kernel))
+    {
+        // A new view drops what is left of the old one
+        if (!same_view(renderer->cache, view.scale, view.shiftX, view.shiftY))
+        {
+            mandelbrot_progressive_start(&renderer->progressive, params, kernel,
+                                         view.scale, view.shiftX, view.shiftY);
+            renderer->cache = { false, view.scale, view.shiftX, view.shiftY };
+        }
+
+        changed = mandelbrot_progressive_continue(&renderer->progressive, pixels, params,
+                                                  now + renderer->budget);
+        renderer->cache.valid = mandelbrot_progressive_done(renderer->progressive);
+        if (!renderer->cache.valid)
+            *again = now;
+    }
+    else
+    {
+        const bool settled = now - renderer->lastMove >= REFINE_DELAY;
+
+        changed = update_frame(mode, pixels, params, renderer->baseIterations,
+                               &renderer->cache, &renderer->refine,
+                               settled, view.scale, view.shiftX, view.shiftY);
+        if (changed)
+            renderer->lastMove = now;
+        if (renderer->refine)
+            *again = renderer->lastMove + REFINE_DELAY;
+    }
+
+    // The CUDA kernels do not fill the iteration buffer
+    if (!changed && paletteChanged && mode->cached)
+    {
+        mandelbrot_colorize(pixels, params);
+        changed = true;
+    }
+
+    mandelbrot_profile_frame_end();
+
+    return changed;
+}
+
+// The span times of the last profiled frame as translucent quads from
+// blue (cheapest per pixel) to red (most expensive)
+static void build_heatmap(sf::VertexArray* heatmap)
+{
+    heatmap->clear();
+
+    std::vector<ProfileCell> cells;
+    if (!mandelbrot_profile_last_frame(&cells))
+        return;
+
+    double maxCost = 0;
+    for (const ProfileCell& cell : cells)
+        maxCost = std::max(maxCost, cell.ms / ((cell.x_to - cell.x_from) * (cell.y_to - cell.y_from)));
+
+    for (const ProfileCell& cell : cells)
+    {
+        const double cost = cell.ms / ((cell.x_to - cell.x_from) * (cell.y_to - cell.y_from));
+        const double t    = maxCost > 0 ? cost / maxCost : 0.0;
+        const sf::Color color((sf::Uint8)(255 * t), 0, (sf::Uint8)(255 * (1 - t)), 128);
+
+        heatmap->append(sf::Vertex(sf::Vector2f((float)cell.x_from, (float)cell.y_from), color));
+        heatmap->append(sf::Vertex(sf::Vector2f((float)cell.x_to,   (float)cell.y_from), color));
+        heatmap->append(sf::Vertex(sf::Vector2f((float)cell.x_to,   (float)cell.y_to  ), color));
+        heatmap->append(sf::Vertex(sf::Vector2f((float)cell.x_from, (float)cell.y_to  ), color));
+    }
+}
+
+int mandelbrot_run_viewer(const MandelbrotBackend* mode, const RenderParams& params, int budgetMs,
+                          bool autoDepth)
+{
+    sf::RenderWindow window(sf::VideoMode(params.width, params.height), "Mandelbrot");
+
+    sf::Texture texture;
+    texture.create(params.width, params.height);
+
+    // Black until the first frame is in
+    std::vector<sf::Uint8> black((size_t)params.width * params.height * 4);
+    texture.update(black.data());
+
+    sf::Sprite sprite(texture);
+
+    // Panning by 0.1 / scale must not be lost at any magnification
+    RenderView view = { 1.0, bf_from_double(0.0), bf_from_double(0.0), 0 };
+    const int PALETTE_STEP = 8;
+
+    ViewRenderer renderer = {};
+    renderer.mode   = mode;
+    renderer.params = params;
+    renderer.budget = std::chrono::milliseconds(budgetMs);
+
+    renderer.baseIterations = params.maxIterations;
+    renderer.autoDepth      = autoDepth;
+    renderer.minIterations  = params.maxIterations;
+
+    // Compute overlaps the upload and the vsync of the frames before
+    RenderThread renderThread(params,
+        [&renderer](sf::Uint8* pixels, const RenderView& view,
+                    std::chrono::steady_clock::time_point* again)
+        {
+            return render_view(&renderer, pixels, view, again);
+        });
+    renderThread.post(view);
+
+    // Render time per pixel of the last frame's spans, H toggles it
+    bool showHeatmap = false;
+    sf::VertexArray heatmap(sf::Quads);
+
+    // The UI thread stays responsive however long a frame takes
+    window.setFramerateLimit(60);
+
+    while (window.isOpen())
+    {
+        bool moved = false;
+
+        sf::Event event;
+        while (window.pollEvent(event)) {
+            if (event.type == sf::Event::Closed)
+                window.close();
+            else if (event.type == sf::Event::KeyPressed)
+            {
+                moved = true;
+
+                if (event.key.code == sf::Keyboard::H)
+                {
+                    moved = false;
+                    showHeatmap = !showHeatmap && mandelbrot_profile_enabled();
+                    if (!mandelbrot_profile_enabled())
+                        fprintf(stderr, "Built without PROFILE=1, no heatmap\n");
+                    else if (showHeatmap)
+                        build_heatmap(&heatmap);
+                }
+                else if (event.key.code == sf::Keyboard::C)
+                {
+                    view.paletteOffset += PALETTE_STEP;
+                }
+                else if (event.key.code == sf::Keyboard::RBracket)
+                {
+                    view.scale *= 1.1;
+                }
+                else if (event.key.code == sf::Keyboard::LBracket)
+                {
+                    view.scale *= 0.9;
+                }
+                else if (event.key.code == sf::Keyboard::Left)
+                {
+                    view.shiftX = bf_add(view.shiftX, bf_from_double(-pan_step(params, view.scale)));
+                }
+                else if (event.key.code == sf::Keyboard::Right)
+                {
+                    view.shiftX = bf_add(view.shiftX, bf_from_double( pan_step(params, view.scale)));
+                }
+                // Only the double and deeper modes can leave the real axis
+                else if (event.key.code == sf::Keyboard::Up && mode->deepFunc)
+                {
+                    view.shiftY = bf_add(view.shiftY, bf_from_double(-pan_step(params, view.scale)));
+                }
+                else if (event.key.code == sf::Keyboard::Down && mode->deepFunc)
+                {
+                    view.shiftY = bf_add(view.shiftY, bf_from_double( pan_step(params, view.scale)));
+                }
+                else
+                {
+                    moved = false;
+                }
+            }    
+        }
+
+        // Once per frame, however many keys came in
+        if (moved)
+            renderThread.post(view);
+
+        if (const sf::Uint8* pixels = renderThread.acquire_frame())
+        {
+            texture.update(pixels);
+            renderThread.release_frame();
+
+            if (showHeatmap)
+                build_heatmap(&heatmap);
+        }
+
+        window.clear();
+        window.draw(sprite);
+        if (showHeatmap)
+            window.draw(heatmap);
+        window.display();
+    }
+
+    return 0;
+}
+
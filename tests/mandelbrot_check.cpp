@@ -0,0 +1,101 @@
+#include "mandelbrot_check.h"
+#include "mandelbrot_backends.h"
+#include "mandelbrot_bands.h"
+#include "mandelbrot_bench.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+#include "mandelbrot_isa.h"
+#include "mandelbrot_palette.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static int nChecks   = 0;
+static int nFailures = 0;
+
+void check(bool passed, const char* text, const char* file, int line)
+{
+    nChecks++;
+    if (passed)
+        return;
+
+    nFailures++;
+    fprintf(stderr, "%s:%d: failed: %s\n", file, line, text);
+}
+
+std::vector<uint16_t> counts_of(const char* mode, const RenderParams& params,
+                                const BenchViewport& view)
+{
+    std::vector<sf::Uint8> pixels((size_t)params.width * params.height * 4);
+    mandelbrot_find_backend(mode)->func(pixels.data(), params, view.magnifier, view.shiftX);
+
+    const uint16_t* iterations = mandelbrot_iterations(params);
+    return std::vector<uint16_t>(iterations, iterations + (size_t)params.width * params.height);
+}
+
+std::vector<uint16_t> deep_counts_of(MandelbrotDeepFunc func, const RenderParams& params,
+                                     double scale, const BigFixed& shiftX, const BigFixed& shiftY)
+{
+    std::vector<sf::Uint8> pixels((size_t)params.width * params.height * 4);
+    mandelbrot_bands(func, pixels.data(), params, scale, shiftX, shiftY);
+
+    const uint16_t* iterations = mandelbrot_iterations(params);
+    return std::vector<uint16_t>(iterations, iterations + (size_t)params.width * params.height);
+}
+
+//------------------------------------------------------------------------------
+// Mode equivalence
+//------------------------------------------------------------------------------
+
+static void check_modes(int width, int height)
+{
+    RenderContext context;
+    RenderParams  params = default_render_params();
+    params.context = &context;
+    params.width   = width;
+    params.height  = height;
+
+    for (int v = 0; v < N_BENCH_VIEWPORTS; v++)
+    {
+        const BenchViewport& view = BENCH_VIEWPORTS[v];
+
+        params.isa = ISA_AVX2;
+        const std::vector<uint16_t> reference = counts_of("vectorized", params, view);
+
+        for (int isa = 0; isa < N_ISAS; isa++)
+        {
+            params.isa = (MandelbrotIsa)isa;
+            if (mandelbrot_isa_supported(params.isa))
+                CHECK(counts_of("vectorized", params, view) == reference);
+        }
+        params.isa = mandelbrot_isa_best();
+
+        // The viewer patches frames of these with columns of the engine
+        for (int b = 0; b < N_BACKENDS; b++)
+            if (BACKENDS[b].sameAsVectorized &&
+                counts_of(BACKENDS[b].name, params, view) != reference)
+            {
+                fprintf(stderr, "%s differs from vectorized at %dx%d, viewport %s\n",
+                        BACKENDS[b].name, width, height, view.name);
+                CHECK(false);
+            }
+    }
+}
+
+int main()
+{
+    check_modes(320, 200);
+    // Widths past a multiple of 8 and 16 take the masked tails
+    check_modes(333, 201);
+    check_reference();
+    check_contexts();
+    check_windows();
+    check_farm();
+    check_precision();
+    check_big_fixed();
+    check_tile_cache();
+
+    printf("%d checks, %d failed\n", nChecks, nFailures);
+    return nFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+#ifndef MANDELBROT_CHECK_H_
+#define MANDELBROT_CHECK_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "mandelbrot_bench.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_config.h"
+
+// Checks of behaviour the rest of the program relies on, run by
+// `make check`. Every file of checks covers one part of the program and
+// is run from main in mandelbrot_check.cpp, which prints every failed
+// check and exits non-zero if any.
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+void check(bool passed, const char* text, const char* file, int line);
+
+// Iteration counts of a frame of mode
+std::vector<uint16_t> counts_of(const char* mode, const RenderParams& params,
+                                const BenchViewport& view);
+
+// Iteration counts of a frame of a deep mode, rendered in bands
+std::vector<uint16_t> deep_counts_of(MandelbrotDeepFunc func, const RenderParams& params,
+                                     double scale, const BigFixed& shiftX, const BigFixed& shiftY);
+
+// BigFixed arithmetic and parsing, in mandelbrot_check_big_fixed.cpp
+void check_big_fixed();
+
+// LRU eviction of the tile server's memory cache, in
+// mandelbrot_check_tile_cache.cpp
+void check_tile_cache();
+
+// Renders with their own RenderContexts on two threads at once, in
+// mandelbrot_check_contexts.cpp
+void check_contexts();
+
+// Strips and tiles of a view render the pixels of the whole view, in
+// mandelbrot_check_windows.cpp
+void check_windows();
+
+// A farm render writes the file of a batch render, in
+// mandelbrot_check_farm.cpp
+void check_farm();
+
+// The precision deep picks at known magnifications, in
+// mandelbrot_check_precision.cpp
+void check_precision();
+
+// Escape counts of the modes against a scalar quad-precision reference,
+// in mandelbrot_check_reference.cpp
+void check_reference();
+
+#endif // MANDELBROT_CHECK_H_
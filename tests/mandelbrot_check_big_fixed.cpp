@@ -0,0 +1,73 @@
+#include "mandelbrot_check.h"
+#include "mandelbrot_big_fixed.h"
+
+#include <cstring>
+
+// 2^exponent, exponent from -(BIG_FIXED_LIMBS - 1) * 32 to 31
+static BigFixed bf_pow2(int exponent, bool negative = false)
+{
+    BigFixed value = {};
+    value.negative = negative;
+
+    if (exponent >= 0)
+        value.limbs[0] = 1u << exponent;
+    else
+        value.limbs[(-exponent - 1) / 32 + 1] = 1u << (31 - (-exponent - 1) % 32);
+
+    return value;
+}
+
+static bool bf_equal(const BigFixed& a, const BigFixed& b)
+{
+    return a.negative == b.negative && memcmp(a.limbs, b.limbs, sizeof(a.limbs)) == 0;
+}
+
+void check_big_fixed()
+{
+    const int LAST_BIT = -(BIG_FIXED_LIMBS - 1) * 32;
+
+    const double values[] = { 0.0, 1.0, -1.0, 0.75, -1.40115, 3.0e-300, 12345.678 };
+    for (double value : values)
+        CHECK(bf_to_double(bf_from_double(value)) == value);
+
+    const BigFixed one = bf_pow2(0);
+
+    // Carries run through every limb
+    BigFixed allOnes = {};
+    for (int limb = 1; limb < BIG_FIXED_LIMBS; limb++)
+        allOnes.limbs[limb] = 0xffffffffu;
+    CHECK(bf_equal(bf_add(allOnes, bf_pow2(LAST_BIT)), one));
+    CHECK(bf_equal(bf_sub(one, bf_pow2(LAST_BIT)), allOnes));
+
+    // Signs
+    const BigFixed a = bf_from_double(-1.5);
+    const BigFixed b = bf_from_double(2.25);
+    CHECK(bf_to_double(bf_add(a, b))          ==  0.75);
+    CHECK(bf_to_double(bf_add(b, a))          ==  0.75);
+    CHECK(bf_to_double(bf_add(a, a))          == -3.0);
+    CHECK(bf_to_double(bf_sub(a, b))          == -3.75);
+    CHECK(bf_to_double(bf_mul(a, b))          == -3.375);
+    CHECK(bf_to_double(bf_mul(a, a))          ==  2.25);
+    CHECK(bf_to_double(bf_add(a, bf_from_double(1.5))) == 0.0);
+
+    // (1 + 2^-500)(1 - 2^-500) = 1 - 2^-1000, far past double
+    const BigFixed tiny    = bf_pow2(-500);
+    const BigFixed product = bf_mul(bf_add(one, tiny), bf_sub(one, tiny));
+    CHECK(bf_equal(bf_sub(product, one), bf_pow2(-1000, true)));
+    CHECK(bf_equal(bf_mul(tiny, tiny), bf_pow2(-1000)));
+
+    // Products below the last bit are truncated to zero
+    CHECK(bf_equal(bf_mul(bf_pow2(-600), bf_pow2(-600)), BigFixed()));
+
+    // Decimals, exact where the binary fraction is
+    BigFixed parsed = {};
+    CHECK(bf_parse("-3.375", &parsed) && bf_equal(parsed, bf_mul(a, b)));
+    CHECK(bf_parse("0.00075e3", &parsed) && bf_to_double(parsed) == 0.75);
+    CHECK(bf_parse("0.1", &parsed) && bf_to_double(parsed) == 0.1);
+    CHECK(bf_parse("-0", &parsed) && bf_equal(parsed, BigFixed()));
+    CHECK(bf_parse("4294967295", &parsed) && parsed.limbs[0] == 0xffffffffu);
+
+    const char* const invalid[] = { "", "-", ".", "1.2.3", "0.1x", "1e", "4294967296" };
+    for (const char* text : invalid)
+        CHECK(!bf_parse(text, &parsed));
+}
@@ -0,0 +1,29 @@
+#include "mandelbrot_check.h"
+#include "mandelbrot_bench.h"
+#include "mandelbrot_palette.h"
+
+#include <thread>
+#include <vector>
+
+// Frames of two sizes on two threads at once, each with its own context
+void check_contexts()
+{
+    RenderContext contexts[2];
+    RenderParams  params[2] = { default_render_params(), default_render_params() };
+    std::vector<uint16_t> together[2];
+
+    for (int i = 0; i < 2; i++)
+    {
+        params[i].context  = &contexts[i];
+        params[i].width    = 320 + 13 * i;
+        params[i].height   = 200 + i;
+        params[i].nThreads = 1;
+    }
+
+    std::thread other([&] { together[1] = counts_of("vectorized", params[1], BENCH_VIEWPORTS[1]); });
+    together[0] = counts_of("vectorized", params[0], BENCH_VIEWPORTS[1]);
+    other.join();
+
+    for (int i = 0; i < 2; i++)
+        CHECK(together[i] == counts_of("vectorized", params[i], BENCH_VIEWPORTS[1]));
+}
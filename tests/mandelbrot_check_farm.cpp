@@ -0,0 +1,79 @@
+#include "mandelbrot_check.h"
+#include "mandelbrot_backends.h"
+#include "mandelbrot_batch.h"
+#include "mandelbrot_farm.h"
+#include "mandelbrot_palette.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+static std::vector<char> file_bytes(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static MandelbrotDeepFunc find_deep_func(const char* modeName)
+{
+    const MandelbrotBackend* backend = mandelbrot_find_backend(modeName);
+    return backend ? backend->deepFunc : NULL;
+}
+
+// A farm render, with a worker on a thread of its own, writes the file of
+// a batch render whose strips don't line up with the tiles
+void check_farm()
+{
+    RenderContext context;
+    RenderParams  params = default_render_params();
+    params.context       = &context;
+    params.width         = 333;
+    params.height        = 301;
+    params.maxIterations = 1000;
+    params.nThreads      = 1;
+
+    char batchPath[64], farmPath[64], address[64];
+    snprintf(batchPath, sizeof(batchPath), "/tmp/mandelbrot-check-%d-batch.raw", (int)getpid());
+    snprintf(farmPath,  sizeof(farmPath),  "/tmp/mandelbrot-check-%d-farm.raw",  (int)getpid());
+    snprintf(address,   sizeof(address),   "unix:/tmp/mandelbrot-check-%d.sock", (int)getpid());
+
+    const char* const MODES[] = { "double", "perturbation" };
+    for (const char* mode : MODES)
+    {
+        BatchJob batch  = default_batch_job();
+        batch.output    = batchPath;
+        batch.stripRows = 100;
+        batch.modeName  = mode;
+        batch.func      = find_deep_func(mode);
+        batch.scale     = 1e5;
+        batch.shiftX    = bf_from_double(0.25);
+        batch.shiftY    = bf_from_double(0.1);
+        CHECK(mandelbrot_batch_render(batch, params) == 0);
+
+        FarmJob farm      = default_farm_job();
+        farm.address      = address;
+        farm.tileSize     = 64;
+        farm.batch        = batch;
+        farm.batch.output = farmPath;
+
+        int workResult = -1;
+        std::thread worker([&]() { workResult = mandelbrot_farm_work(address, params, find_deep_func); });
+        CHECK(mandelbrot_farm_render(farm, params) == 0);
+        worker.join();
+        CHECK(workResult == 0);
+
+        const std::vector<char> batchBytes = file_bytes(batchPath);
+        if (batchBytes.empty() || batchBytes != file_bytes(farmPath))
+        {
+            fprintf(stderr, "%s farm render differs from the batch render\n", mode);
+            CHECK(false);
+        }
+    }
+
+    unlink(batchPath);
+    unlink(farmPath);
+}
@@ -0,0 +1,36 @@
+#include "mandelbrot_check.h"
+#include "mandelbrot_deep.h"
+
+static MandelbrotPrecision precision_at(const RenderParams& params, double magnifier, double shiftY)
+{
+    return mandelbrot_pick_precision(params, magnifier, bf_from_double(0.0), bf_from_double(shiftY));
+}
+
+// The precision deep picks for a 1080p view at known magnifications
+void check_precision()
+{
+    RenderParams params = default_render_params();
+    params.width         = 1920;
+    params.height        = 1080;
+    params.maxIterations = 256;
+
+    CHECK(precision_at(params, 1.0, 0.0) == PRECISION_FLOAT);
+    // The float kernels have no vertical shift
+    CHECK(precision_at(params, 1.0, 0.1) == PRECISION_DOUBLE);
+    CHECK(precision_at(params, 100.0, 0.0) == PRECISION_DOUBLE);
+
+    // A band of a view picks what the whole view does
+    const RenderParams band = window_params(params, 0, 512, params.width, 32);
+    CHECK(precision_at(band, 100.0, 0.0) == PRECISION_DOUBLE);
+
+    params.maxIterations = 1000;
+    CHECK(precision_at(params, 1.0, 0.0) == PRECISION_FLOAT);
+    CHECK(precision_at(params, 1e8, 0.0) == PRECISION_DOUBLE);
+    CHECK(precision_at(params, 1e10, 0.0) == PRECISION_DOUBLE);
+    CHECK(precision_at(params, 1e12, 0.0) == PRECISION_DOUBLE_DOUBLE);
+    CHECK(precision_at(params, 1e35, 0.0) == PRECISION_PERTURBATION);
+
+    // Deeper orbits need a finer precision at the same magnification
+    params.maxIterations = 100000;
+    CHECK(precision_at(params, 1e10, 0.0) == PRECISION_DOUBLE_DOUBLE);
+}
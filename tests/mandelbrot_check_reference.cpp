@@ -0,0 +1,189 @@
+#include "mandelbrot_check.h"
+#include "mandelbrot_backends.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_palette.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Escape counts of the modes against a plain scalar iteration in quad
+// precision (113-bit mantissa), at pixel steps down to 1e-21. The modes
+// round c and z to their own precision, and orbits near the boundary
+// are chaotic, so a few boundary pixels escape an iteration or more
+// apart from the reference in any mode. A mode passes while at most its
+// tolerance of the pixels differ; a wrong coordinate or a broken kernel
+// moves whole areas.
+
+typedef __float128 Quad;
+
+// The view of a frame: its center and the distance from it to the top
+// and bottom edges, as the kernels compute their corners
+struct ReferenceView
+{
+    Quad centerX;
+    Quad centerY;
+    Quad invMagnifier;
+};
+
+static Quad quad_of(const BigFixed& value)
+{
+    // Five limbs are 128 bits past the point, more than a quad holds
+    Quad result = 0;
+    Quad weight = 1;
+    for (int limb = 0; limb < 5 && limb < BIG_FIXED_LIMBS; limb++)
+    {
+        result += weight * value.limbs[limb];
+        weight /= 4294967296.0;
+    }
+
+    return value.negative ? -result : result;
+}
+
+static std::vector<uint16_t> reference_counts(const RenderParams& params, const ReferenceView& view)
+{
+    const Quad aspect     = (Quad)params.width / params.height;
+    const Quad stepX      = aspect * view.invMagnifier * 2 / params.width;
+    const Quad stepY      = view.invMagnifier * 2 / params.height;
+    const Quad maxRadius2 = max_radius_2(params);
+
+    std::vector<uint16_t> counts((size_t)params.width * params.height);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(params.nThreads)
+    for (int y = 0; y < params.height; y++)
+        for (int x = 0; x < params.width; x++)
+        {
+            const Quad c_x = view.centerX - aspect * view.invMagnifier + stepX * x;
+            const Quad c_y = view.centerY - view.invMagnifier + stepY * y;
+
+            Quad z_x  = 0;
+            Quad z_y  = 0;
+            Quad z_x2 = 0;
+            Quad z_y2 = 0;
+
+            int iterations = 0;
+            while (z_x2 + z_y2 < maxRadius2 && iterations < params.maxIterations)
+            {
+                z_y = 2 * z_x * z_y + c_y;
+                z_x = z_x2 - z_y2 + c_x;
+
+                z_x2 = z_x * z_x;
+                z_y2 = z_y * z_y;
+
+                iterations++;
+            }
+
+            counts[(size_t)y * params.width + x] = (uint16_t)iterations;
+        }
+
+    return counts;
+}
+
+// Fails if more than tolerance of the pixels differ from the reference
+static void check_against(const char* mode, const char* viewName, const std::vector<uint16_t>& counts,
+                          const std::vector<uint16_t>& reference, double tolerance)
+{
+    size_t nDiffer = 0;
+    for (size_t i = 0; i < counts.size(); i++)
+        nDiffer += counts[i] != reference[i];
+
+    const double differ = (double)nDiffer / counts.size();
+    if (differ > tolerance)
+    {
+        fprintf(stderr, "%s differs from the reference in %.2f%% of %s, more than %.2f%%\n",
+                mode, 100.0 * differ, viewName, 100.0 * tolerance);
+        CHECK(false);
+    }
+}
+
+struct ReferenceMode
+{
+    const char* name;
+    double      tolerance;
+};
+
+void check_reference()
+{
+    RenderContext context;
+    RenderParams  params = default_render_params();
+    params.context       = &context;
+    params.width         = 96;
+    params.height        = 64;
+
+    // The float modes, on the real axis. Their precision is that of c in
+    // float; interleaved also contracts into FMAs, which moves a few more
+    // boundary pixels. The boundary viewport is at the float limit on
+    // purpose, a quarter of its pixels are off there.
+    {
+        const ReferenceMode MODES[] = { { "naive", 0.005 }, { "interleaved", 0.01 } };
+
+        params.maxIterations = 256;
+        for (int v = 0; v < N_BENCH_VIEWPORTS; v++)
+        {
+            const BenchViewport& bench = BENCH_VIEWPORTS[v];
+            if (strcmp(bench.name, "boundary") == 0)
+                continue;
+            const ReferenceView  view  = { (Quad)bench.shiftX + (Quad)SHIFT_X_OFFSET, 0,
+                                           1 / ((Quad)bench.magnifier + (Quad)MAGNIFIER_OFFSET) };
+
+            const std::vector<uint16_t> reference = reference_counts(params, view);
+            for (const ReferenceMode& mode : MODES)
+                check_against(mode.name, bench.name, counts_of(mode.name, params, bench),
+                              reference, mode.tolerance);
+        }
+    }
+
+    // The deep modes, off the axis: in seahorse valley at a zoom double
+    // resolves and one only double-double and perturbation do. double,
+    // fixed64 and deep at 1e5 round c to about 53 bits.
+    struct DeepView
+    {
+        const char*          name;
+        double               scale;
+        int                  maxIterations;
+        const ReferenceMode* modes;
+        int                  nModes;
+    };
+
+    const ReferenceMode SHALLOW[] =
+    {
+        { "double", 0.02 }, { "fixed64", 0.02 }, { "double-double", 0.01 },
+        { "perturbation", 0.01 }, { "deep", 0.02 },
+    };
+    const ReferenceMode DEEP[] =
+    {
+        { "double-double", 0.01 }, { "perturbation", 0.01 }, { "deep", 0.01 },
+    };
+
+    const DeepView VIEWS[] =
+    {
+        { "seahorse at 1e5",  1e5,  1000, SHALLOW, (int)(sizeof(SHALLOW) / sizeof(SHALLOW[0])) },
+        { "seahorse at 1e20", 1e20, 20000, DEEP,    (int)(sizeof(DEEP)    / sizeof(DEEP[0]))    },
+    };
+
+    BigFixed shiftX = {};
+    BigFixed shiftY = {};
+    CHECK(bf_parse("-0.243643887037158704752191506114774", &shiftX));
+    CHECK(bf_parse("0.131825904205311970493132056385139", &shiftY));
+
+    // Orbits of up to 20000 iterations in quad take a while
+    params.width  = 64;
+    params.height = 40;
+    for (const DeepView& deep : VIEWS)
+    {
+        params.maxIterations = deep.maxIterations;
+
+        const ReferenceView view = { quad_of(shiftX) + (Quad)SHIFT_X_OFFSET, quad_of(shiftY),
+                                     1 / ((Quad)deep.scale + (Quad)MAGNIFIER_OFFSET) };
+
+        const std::vector<uint16_t> reference = reference_counts(params, view);
+        for (int m = 0; m < deep.nModes; m++)
+        {
+            const ReferenceMode& mode = deep.modes[m];
+            check_against(mode.name, deep.name,
+                          deep_counts_of(mandelbrot_find_backend(mode.name)->deepFunc, params,
+                                         deep.scale, shiftX, shiftY),
+                          reference, mode.tolerance);
+        }
+    }
+}
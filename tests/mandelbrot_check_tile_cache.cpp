@@ -0,0 +1,40 @@
+#include "mandelbrot_check.h"
+#include "mandelbrot_tile_cache.h"
+
+static TileData tile_of_size(size_t size)
+{
+    return TileData(new std::vector<uint8_t>(size));
+}
+
+void check_tile_cache()
+{
+    // One shard of three 100-byte tiles
+    TileMemoryCache cache(300, 1);
+
+    cache.put(1, tile_of_size(100));
+    cache.put(2, tile_of_size(100));
+    cache.put(3, tile_of_size(100));
+    CHECK(cache.bytes() == 300);
+
+    // 1 becomes the most recent, so 2 is evicted for 4
+    CHECK(cache.get(1) != NULL);
+    cache.put(4, tile_of_size(100));
+    CHECK(cache.get(2) == NULL);
+    CHECK(cache.get(1) != NULL);
+    CHECK(cache.get(3) != NULL);
+    CHECK(cache.get(4) != NULL);
+    CHECK(cache.bytes() == 300);
+
+    // A large tile evicts as many as it needs, one larger than the
+    // shard is not cached
+    cache.put(5, tile_of_size(250));
+    CHECK(cache.get(5) != NULL);
+    CHECK(cache.get(1) == NULL && cache.get(3) == NULL && cache.get(4) == NULL);
+    cache.put(6, tile_of_size(301));
+    CHECK(cache.get(6) == NULL);
+    CHECK(cache.bytes() == 250);
+
+    // A key already held keeps its tile
+    cache.put(5, tile_of_size(10));
+    CHECK(cache.get(5)->size() == 250);
+}
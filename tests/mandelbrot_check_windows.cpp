@@ -0,0 +1,70 @@
+#include "mandelbrot_check.h"
+#include "mandelbrot_backends.h"
+#include "mandelbrot_big_fixed.h"
+#include "mandelbrot_palette.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Strips of any height and tiles anywhere in a view get the counts of
+// the whole view, in every deep mode
+void check_windows()
+{
+    RenderContext context;
+    RenderParams  params = default_render_params();
+    params.context       = &context;
+    params.width         = 301;
+    params.height        = 203;
+    params.maxIterations = 1000;
+
+    const double   scale  = 1e5;
+    const BigFixed shiftX = bf_from_double(0.25);
+    const BigFixed shiftY = bf_from_double(0.1);
+
+    for (int b = 0; b < N_BACKENDS; b++)
+    {
+        const MandelbrotDeepFunc func = BACKENDS[b].deepFunc;
+        if (!func)
+            continue;
+
+        const std::vector<uint16_t> whole = deep_counts_of(func, params, scale, shiftX, shiftY);
+
+        const int STRIP_ROWS[] = { 37, 64 };
+        for (int stripRows : STRIP_ROWS)
+        {
+            std::vector<uint16_t> strips;
+            for (int y = 0; y < params.height; y += stripRows)
+            {
+                const RenderParams strip = window_params(params, 0, y, params.width,
+                                                         std::min(stripRows, params.height - y));
+                const std::vector<uint16_t> counts = deep_counts_of(func, strip, scale, shiftX, shiftY);
+                strips.insert(strips.end(), counts.begin(), counts.end());
+            }
+
+            if (strips != whole)
+            {
+                fprintf(stderr, "%s strips of %d rows differ from the whole view\n",
+                        BACKENDS[b].name, stripRows);
+                CHECK(false);
+            }
+        }
+
+        // A tile of a strip is a window of the view too
+        const RenderParams strip = window_params(params, 0, 50, params.width, 100);
+        const RenderParams tile  = window_params(strip, 67, 13, 90, 41);
+        const std::vector<uint16_t> counts = deep_counts_of(func, tile, scale, shiftX, shiftY);
+
+        bool same = true;
+        for (int y = 0; y < tile.height; y++)
+            for (int x = 0; x < tile.width; x++)
+                same &= counts[(size_t)y * tile.width + x] ==
+                        whole[(size_t)(63 + y) * params.width + 67 + x];
+
+        if (!same)
+        {
+            fprintf(stderr, "%s tile differs from the whole view\n", BACKENDS[b].name);
+            CHECK(false);
+        }
+    }
+}